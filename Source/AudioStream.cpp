@@ -0,0 +1,233 @@
+#include <cassert>
+#include <cmath>
+#include <chrono>
+#include <algorithm>
+#include "AudioStream.h"
+
+//Maximum deviation from the nominal rate used to correct the ring fill level
+#define MAX_RATE_ADJUST (0.005)
+#define SPEED_UPDATE_INTERVAL_MS (250)
+#define READ_CHUNK_FRAMES (1024)
+
+CAudioStream::CAudioStream(CSoundHandler* soundHandler)
+    : m_soundHandler(soundHandler)
+    , m_threadDone(false)
+    , m_ring(new int16[RING_FRAMES * CHANNEL_COUNT])
+    , m_ringReadIndex(0)
+    , m_ringWriteIndex(0)
+    , m_writtenFrameCount(0)
+    , m_targetLatencyFrames(SAMPLE_RATE / 10)
+    , m_timeStretchEnabled(false)
+{
+	assert(m_soundHandler);
+	m_readBuffer.resize(READ_CHUNK_FRAMES * CHANNEL_COUNT);
+	m_thread = std::thread([this]() { ThreadProc(); });
+}
+
+CAudioStream::~CAudioStream()
+{
+	m_threadDone = true;
+	m_thread.join();
+	delete m_soundHandler;
+}
+
+void CAudioStream::SetTargetLatency(uint32 latencyMs)
+{
+	uint32 latencyFrames = (latencyMs * SAMPLE_RATE) / 1000;
+	latencyFrames = std::max<uint32>(latencyFrames, OUTPUT_FRAMES);
+	latencyFrames = std::min<uint32>(latencyFrames, RING_FRAMES / 2);
+	m_targetLatencyFrames = latencyFrames;
+}
+
+void CAudioStream::SetTimeStretchEnabled(bool enabled)
+{
+	m_timeStretchEnabled = enabled;
+}
+
+void CAudioStream::Write(const int16* samples, uint32 frameCount)
+{
+	m_writtenFrameCount += frameCount;
+
+	uint32 writeIndex = m_ringWriteIndex.load(std::memory_order_relaxed);
+	uint32 readIndex = m_ringReadIndex.load(std::memory_order_acquire);
+	uint32 freeFrames = RING_FRAMES - (writeIndex - readIndex);
+
+	//If the output thread can't keep up, newest samples are dropped
+	frameCount = std::min(frameCount, freeFrames);
+	for(uint32 i = 0; i < frameCount; i++)
+	{
+		uint32 ringIndex = (writeIndex + i) & (RING_FRAMES - 1);
+		m_ring[(ringIndex * CHANNEL_COUNT) + 0] = samples[(i * CHANNEL_COUNT) + 0];
+		m_ring[(ringIndex * CHANNEL_COUNT) + 1] = samples[(i * CHANNEL_COUNT) + 1];
+	}
+
+	m_ringWriteIndex.store(writeIndex + frameCount, std::memory_order_release);
+}
+
+void CAudioStream::ThreadProc()
+{
+	static const auto speedUpdateInterval = std::chrono::milliseconds(SPEED_UPDATE_INTERVAL_MS);
+
+	std::vector<int16> output(OUTPUT_FRAMES * CHANNEL_COUNT);
+	auto lastSpeedUpdateTime = std::chrono::steady_clock::now();
+
+	while(!m_threadDone)
+	{
+		//The device sets the pace, a block is only produced once it has room for it
+		m_soundHandler->RecycleBuffers();
+		uint32 deviceFrameCount = m_soundHandler->GetQueuedBufferCount() * OUTPUT_FRAMES;
+		if(!m_soundHandler->HasFreeBuffers() || (deviceFrameCount >= GetDeviceQueueLimit()))
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+			continue;
+		}
+
+		auto currentTime = std::chrono::steady_clock::now();
+		if((currentTime - lastSpeedUpdateTime) >= speedUpdateInterval)
+		{
+			UpdateTempo(std::chrono::duration<double>(currentTime - lastSpeedUpdateTime).count());
+			lastSpeedUpdateTime = currentTime;
+		}
+
+		RenderOutput(output.data(), deviceFrameCount);
+		m_soundHandler->Write(output.data(), OUTPUT_FRAMES * CHANNEL_COUNT, SAMPLE_RATE);
+	}
+}
+
+uint32 CAudioStream::GetRingFrameCount() const
+{
+	uint32 writeIndex = m_ringWriteIndex.load(std::memory_order_acquire);
+	uint32 readIndex = m_ringReadIndex.load(std::memory_order_relaxed);
+	return writeIndex - readIndex;
+}
+
+uint32 CAudioStream::GetDeviceQueueLimit() const
+{
+	//Keep part of the latency in the ring, otherwise the device queue would drain it
+	return std::max<uint32>(m_targetLatencyFrames / 2, OUTPUT_FRAMES * 2);
+}
+
+uint32 CAudioStream::ReadRing(float* samples, uint32 frameCount)
+{
+	uint32 readIndex = m_ringReadIndex.load(std::memory_order_relaxed);
+	uint32 writeIndex = m_ringWriteIndex.load(std::memory_order_acquire);
+	frameCount = std::min(frameCount, writeIndex - readIndex);
+	for(uint32 i = 0; i < frameCount; i++)
+	{
+		uint32 ringIndex = (readIndex + i) & (RING_FRAMES - 1);
+		samples[(i * CHANNEL_COUNT) + 0] = static_cast<float>(m_ring[(ringIndex * CHANNEL_COUNT) + 0]);
+		samples[(i * CHANNEL_COUNT) + 1] = static_cast<float>(m_ring[(ringIndex * CHANNEL_COUNT) + 1]);
+	}
+	m_ringReadIndex.store(readIndex + frameCount, std::memory_order_release);
+	return frameCount;
+}
+
+void CAudioStream::FillStage(uint32 frameCount)
+{
+	while((m_stage.size() / CHANNEL_COUNT) < frameCount)
+	{
+		uint32 stageFrameCount = static_cast<uint32>(m_stage.size() / CHANNEL_COUNT);
+		uint32 missingFrameCount = frameCount - stageFrameCount;
+		if(m_timeStretchActive)
+		{
+			if(m_timeStretcher.GetOutputFrameCount() == 0)
+			{
+				uint32 readFrameCount = ReadRing(m_readBuffer.data(), READ_CHUNK_FRAMES);
+				if(readFrameCount == 0) break;
+				m_timeStretcher.PutSamples(m_readBuffer.data(), readFrameCount);
+				continue;
+			}
+			missingFrameCount = std::min(missingFrameCount, m_timeStretcher.GetOutputFrameCount());
+			m_stage.resize((stageFrameCount + missingFrameCount) * CHANNEL_COUNT);
+			m_timeStretcher.ReceiveSamples(m_stage.data() + (stageFrameCount * CHANNEL_COUNT), missingFrameCount);
+		}
+		else
+		{
+			m_stage.resize((stageFrameCount + missingFrameCount) * CHANNEL_COUNT);
+			uint32 readFrameCount = ReadRing(m_stage.data() + (stageFrameCount * CHANNEL_COUNT), missingFrameCount);
+			m_stage.resize((stageFrameCount + readFrameCount) * CHANNEL_COUNT);
+			if(readFrameCount == 0) break;
+		}
+	}
+}
+
+void CAudioStream::UpdateTempo(double elapsedTime)
+{
+	uint64 writtenFrameCount = m_writtenFrameCount;
+	double speed = static_cast<double>(writtenFrameCount - m_lastWrittenFrameCount) /
+	               (static_cast<double>(SAMPLE_RATE) * elapsedTime);
+	m_lastWrittenFrameCount = writtenFrameCount;
+	m_emulationSpeed = (m_emulationSpeed * 0.7) + (speed * 0.3);
+
+	//Speeds close to 1 are handled by rate control, a stopped VM just goes silent
+	bool timeStretchActive = m_timeStretchEnabled &&
+	                         (m_emulationSpeed > 0.05) && (m_emulationSpeed < 4.0) &&
+	                         (std::abs(m_emulationSpeed - 1.0) > 0.05);
+	if(timeStretchActive != m_timeStretchActive)
+	{
+		m_timeStretcher.Clear();
+		m_timeStretchActive = timeStretchActive;
+	}
+	if(m_timeStretchActive)
+	{
+		m_timeStretcher.SetTempo(m_emulationSpeed);
+	}
+}
+
+void CAudioStream::RenderOutput(int16* output, uint32 deviceFrameCount)
+{
+	//Samples already queued on the device count towards latency as well
+	uint32 targetFrameCount = std::max<uint32>(m_targetLatencyFrames, GetDeviceQueueLimit() + OUTPUT_FRAMES);
+	uint32 fillFrameCount = GetRingFrameCount() + static_cast<uint32>(m_stage.size() / CHANNEL_COUNT) + deviceFrameCount;
+	if(m_timeStretchActive)
+	{
+		fillFrameCount += m_timeStretcher.GetOutputFrameCount();
+	}
+
+	//Wait until enough samples are buffered before starting (or restarting after an underrun)
+	if(m_priming)
+	{
+		if(fillFrameCount < targetFrameCount)
+		{
+			std::fill(output, output + (OUTPUT_FRAMES * CHANNEL_COUNT), 0);
+			return;
+		}
+		m_priming = false;
+	}
+
+	double fillError = (static_cast<double>(fillFrameCount) - static_cast<double>(targetFrameCount)) / static_cast<double>(targetFrameCount);
+	fillError = std::max(std::min(fillError, 1.0), -1.0);
+	double ratio = 1.0 + (fillError * MAX_RATE_ADJUST);
+
+	uint32 neededFrameCount = static_cast<uint32>(std::ceil(m_resamplePosition + (OUTPUT_FRAMES * ratio))) + 1;
+	FillStage(neededFrameCount);
+	uint32 stageFrameCount = static_cast<uint32>(m_stage.size() / CHANNEL_COUNT);
+
+	//Linear interpolation, good enough for the small ratio deviations used here
+	for(uint32 i = 0; i < OUTPUT_FRAMES; i++)
+	{
+		uint32 index = static_cast<uint32>(m_resamplePosition);
+		if((index + 1) >= stageFrameCount)
+		{
+			std::fill(output + (i * CHANNEL_COUNT), output + (OUTPUT_FRAMES * CHANNEL_COUNT), 0);
+			m_stage.clear();
+			m_resamplePosition = 0;
+			m_priming = true;
+			return;
+		}
+		float alpha = static_cast<float>(m_resamplePosition - static_cast<double>(index));
+		for(uint32 channel = 0; channel < CHANNEL_COUNT; channel++)
+		{
+			float sample0 = m_stage[(index * CHANNEL_COUNT) + channel];
+			float sample1 = m_stage[((index + 1) * CHANNEL_COUNT) + channel];
+			float sample = sample0 + ((sample1 - sample0) * alpha);
+			sample = std::max(std::min(sample, 32767.0f), -32768.0f);
+			output[(i * CHANNEL_COUNT) + channel] = static_cast<int16>(sample);
+		}
+		m_resamplePosition += ratio;
+	}
+
+	uint32 consumedFrameCount = static_cast<uint32>(m_resamplePosition);
+	m_stage.erase(m_stage.begin(), m_stage.begin() + (consumedFrameCount * CHANNEL_COUNT));
+	m_resamplePosition -= static_cast<double>(consumedFrameCount);
+}
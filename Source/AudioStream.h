@@ -0,0 +1,67 @@
+#pragma once
+
+#include <atomic>
+#include <thread>
+#include <vector>
+#include <memory>
+#include "Types.h"
+#include "AudioTimeStretcher.h"
+#include "../tools/PsfPlayer/Source/SoundHandler.h"
+
+//Moves samples from the emulator to the sound handler on a dedicated thread.
+//Emulator writes go to a single producer/single consumer ring buffer. The output
+//thread produces a block whenever the device has room for one and resamples slightly
+//to keep the samples buffered in the ring and in the device queue at the target
+//level, which absorbs emulation jitter without needing a large buffer. When enabled, time-stretching
+//keeps audio at the correct pitch when emulation runs slower than real time.
+class CAudioStream
+{
+public:
+	enum
+	{
+		SAMPLE_RATE = 44100,
+		CHANNEL_COUNT = 2,
+		RING_FRAMES = 0x8000,
+		OUTPUT_FRAMES = 256,
+	};
+
+	//Takes ownership of the sound handler
+	CAudioStream(CSoundHandler*);
+	virtual ~CAudioStream();
+
+	void SetTargetLatency(uint32);
+	void SetTimeStretchEnabled(bool);
+
+	//Called by the emulator thread only
+	void Write(const int16*, uint32);
+
+private:
+	void ThreadProc();
+	uint32 GetRingFrameCount() const;
+	uint32 GetDeviceQueueLimit() const;
+	uint32 ReadRing(float*, uint32);
+	void FillStage(uint32);
+	void UpdateTempo(double);
+	void RenderOutput(int16*, uint32);
+
+	CSoundHandler* m_soundHandler = nullptr;
+	std::thread m_thread;
+	std::atomic<bool> m_threadDone;
+
+	std::unique_ptr<int16[]> m_ring;
+	std::atomic<uint32> m_ringReadIndex;
+	std::atomic<uint32> m_ringWriteIndex;
+	std::atomic<uint64> m_writtenFrameCount;
+	std::atomic<uint32> m_targetLatencyFrames;
+	std::atomic<bool> m_timeStretchEnabled;
+
+	//Only accessed by the output thread
+	std::vector<float> m_stage;
+	std::vector<float> m_readBuffer;
+	double m_resamplePosition = 0;
+	bool m_priming = true;
+	CAudioTimeStretcher m_timeStretcher;
+	bool m_timeStretchActive = false;
+	double m_emulationSpeed = 1.0;
+	uint64 m_lastWrittenFrameCount = 0;
+};
@@ -0,0 +1,102 @@
+#include <cassert>
+#include <cmath>
+#include <algorithm>
+#include "AudioTimeStretcher.h"
+
+void CAudioTimeStretcher::SetTempo(double tempo)
+{
+	m_tempo = std::max(tempo, 0.1);
+}
+
+void CAudioTimeStretcher::Clear()
+{
+	m_input.clear();
+	m_output.clear();
+	m_overlap.clear();
+	m_skipFraction = 0;
+}
+
+void CAudioTimeStretcher::PutSamples(const float* samples, uint32 frameCount)
+{
+	m_input.insert(m_input.end(), samples, samples + (frameCount * CHANNEL_COUNT));
+	Process();
+}
+
+uint32 CAudioTimeStretcher::ReceiveSamples(float* samples, uint32 frameCount)
+{
+	frameCount = std::min(frameCount, GetOutputFrameCount());
+	uint32 sampleCount = frameCount * CHANNEL_COUNT;
+	std::copy(m_output.begin(), m_output.begin() + sampleCount, samples);
+	m_output.erase(m_output.begin(), m_output.begin() + sampleCount);
+	return frameCount;
+}
+
+uint32 CAudioTimeStretcher::GetOutputFrameCount() const
+{
+	return static_cast<uint32>(m_output.size() / CHANNEL_COUNT);
+}
+
+void CAudioTimeStretcher::Process()
+{
+	static const uint32 overlapSampleCount = OVERLAP_FRAMES * CHANNEL_COUNT;
+	static const uint32 outputFrameCount = SEQUENCE_FRAMES - OVERLAP_FRAMES;
+
+	while((m_input.size() / CHANNEL_COUNT) >= (SEEK_FRAMES + SEQUENCE_FRAMES))
+	{
+		uint32 offset = m_overlap.empty() ? 0 : FindBestOffset();
+		const float* sequence = m_input.data() + (offset * CHANNEL_COUNT);
+
+		if(m_overlap.empty())
+		{
+			m_output.insert(m_output.end(), sequence, sequence + overlapSampleCount);
+		}
+		else
+		{
+			for(uint32 i = 0; i < OVERLAP_FRAMES; i++)
+			{
+				float fadeIn = static_cast<float>(i) / static_cast<float>(OVERLAP_FRAMES);
+				for(uint32 channel = 0; channel < CHANNEL_COUNT; channel++)
+				{
+					uint32 index = (i * CHANNEL_COUNT) + channel;
+					m_output.push_back((m_overlap[index] * (1.0f - fadeIn)) + (sequence[index] * fadeIn));
+				}
+			}
+		}
+
+		m_output.insert(m_output.end(), sequence + overlapSampleCount, sequence + (outputFrameCount * CHANNEL_COUNT));
+		m_overlap.assign(sequence + (outputFrameCount * CHANNEL_COUNT), sequence + (SEQUENCE_FRAMES * CHANNEL_COUNT));
+
+		//Input is consumed faster or slower than output is produced depending on tempo
+		double skip = (static_cast<double>(outputFrameCount) * m_tempo) + m_skipFraction;
+		uint32 skipFrames = static_cast<uint32>(skip);
+		m_skipFraction = skip - static_cast<double>(skipFrames);
+		skipFrames = std::min<uint32>(skipFrames, static_cast<uint32>(m_input.size() / CHANNEL_COUNT));
+		m_input.erase(m_input.begin(), m_input.begin() + (skipFrames * CHANNEL_COUNT));
+	}
+}
+
+uint32 CAudioTimeStretcher::FindBestOffset() const
+{
+	assert(m_overlap.size() == (OVERLAP_FRAMES * CHANNEL_COUNT));
+
+	uint32 bestOffset = 0;
+	float bestCorrelation = -INFINITY;
+	for(uint32 offset = 0; offset < SEEK_FRAMES; offset++)
+	{
+		const float* candidate = m_input.data() + (offset * CHANNEL_COUNT);
+		float correlation = 0;
+		float norm = 0;
+		for(uint32 i = 0; i < (OVERLAP_FRAMES * CHANNEL_COUNT); i++)
+		{
+			correlation += m_overlap[i] * candidate[i];
+			norm += candidate[i] * candidate[i];
+		}
+		correlation /= std::sqrt(norm + 1e-9f);
+		if(correlation > bestCorrelation)
+		{
+			bestCorrelation = correlation;
+			bestOffset = offset;
+		}
+	}
+	return bestOffset;
+}
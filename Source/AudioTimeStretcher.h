@@ -0,0 +1,36 @@
+#pragma once
+
+#include <vector>
+#include "Types.h"
+
+//Tempo changer that preserves pitch (WSOLA). Input is split in overlapping sequences,
+//each sequence is placed where it best matches the tail of the previous one and both
+//are cross-faded. Works on interleaved stereo float samples.
+class CAudioTimeStretcher
+{
+public:
+	enum
+	{
+		CHANNEL_COUNT = 2,
+		SEQUENCE_FRAMES = 882, //20ms at 44100Hz
+		OVERLAP_FRAMES = 220,
+		SEEK_FRAMES = 330,
+	};
+
+	void SetTempo(double);
+	void Clear();
+
+	void PutSamples(const float*, uint32);
+	uint32 ReceiveSamples(float*, uint32);
+	uint32 GetOutputFrameCount() const;
+
+private:
+	void Process();
+	uint32 FindBestOffset() const;
+
+	std::vector<float> m_input;
+	std::vector<float> m_output;
+	std::vector<float> m_overlap;
+	double m_tempo = 1.0;
+	double m_skipFraction = 0;
+};
@@ -1,8 +1,10 @@
+#include <memory>
 #include "BasicBlock.h"
 #include "MemStream.h"
 #include "offsetof_def.h"
 #include "MipsJitter.h"
 #include "Jitter_CodeGenFactory.h"
+#include "BlockProfiler.h"
 
 #if defined(AOT_BUILD_CACHE) || defined(AOT_USE_CACHE)
 #define AOT_ENABLED
@@ -79,24 +81,23 @@ void CBasicBlock::Compile()
 
 	Framework::CMemStream stream;
 	{
-		static
-#ifdef AOT_BUILD_CACHE
-		    __declspec(thread)
-#endif
-		        CMipsJitter* jitter = nullptr;
-		if(jitter == nullptr)
+		//One jitter per thread, blocks can be compiled by more than one VM at a time.
+		//Jitter (and the code generator it owns) is released when the thread exits.
+		static thread_local std::unique_ptr<CMipsJitter> jitterPtr;
+		if(!jitterPtr)
 		{
 			Jitter::CCodeGen* codeGen = Jitter::CreateCodeGen();
-			jitter = new CMipsJitter(codeGen);
+			jitterPtr = std::make_unique<CMipsJitter>(codeGen);
 
 			for(unsigned int i = 0; i < 4; i++)
 			{
-				jitter->SetVariableAsConstant(
+				jitterPtr->SetVariableAsConstant(
 				    offsetof(CMIPS, m_State.nGPR[CMIPS::R0].nV[i]),
 				    0);
 			}
 		}
 
+		auto jitter = jitterPtr.get();
 		jitter->GetCodeGen()->SetExternalSymbolReferencedHandler([&](auto symbol, auto offset, auto refType) { this->HandleExternalFunctionReference(symbol, offset, refType); });
 		jitter->SetStream(&stream);
 		jitter->Begin();
@@ -106,6 +107,14 @@ void CBasicBlock::Compile()
 
 	m_function = CMemoryFunction(stream.GetBuffer(), stream.GetSize());
 
+	{
+		auto& blockProfiler = CBlockProfiler::GetInstance();
+		if(blockProfiler.IsEnabled() || blockProfiler.IsPerfMapEnabled())
+		{
+			blockProfiler.NotifyBlockCompiled(m_profilerSlot, m_begin, m_end, m_function.GetCode(), static_cast<uint32>(m_function.GetSize()));
+		}
+	}
+
 #ifdef VTUNE_ENABLED
 	if(iJIT_IsProfilingActive() == iJIT_SAMPLING_ON)
 	{
@@ -214,8 +223,27 @@ void CBasicBlock::CompileRange(CMipsJitter* jitter)
 	CompileEpilog(jitter);
 }
 
+uint32 CBasicBlock::GetInstructionSize() const
+{
+	return 4;
+}
+
 void CBasicBlock::CompileProlog(CMipsJitter* jitter)
 {
+#ifndef AOT_ENABLED
+	//Slot is embedded in the code, can't be used with AOT blocks
+	m_profilerSlot = CBlockProfiler::INVALID_SLOT;
+	if(CBlockProfiler::GetInstance().IsEnabled())
+	{
+		m_profilerSlot = CBlockProfiler::GetInstance().RegisterBlock(&m_context, m_begin, m_end, GetInstructionSize());
+	}
+	if(m_profilerSlot != CBlockProfiler::INVALID_SLOT)
+	{
+		jitter->PushCst(m_profilerSlot);
+		jitter->Call(reinterpret_cast<void*>(&CBlockProfiler::HitHandler), 1, Jitter::CJitter::RETURN_VALUE_NONE);
+	}
+#endif
+
 #ifdef DEBUGGER_INCLUDED
 	if(HasBreakpoint())
 	{
@@ -87,6 +87,8 @@ protected:
 	void CompileProlog(CMipsJitter*);
 	void CompileEpilog(CMipsJitter*);
 
+	virtual uint32 GetInstructionSize() const;
+
 private:
 	void HandleExternalFunctionReference(uintptr_t, uint32, Jitter::CCodeGen::SYMBOL_REF_TYPE);
 
@@ -107,6 +109,7 @@ private:
 	void (*m_function)(void*);
 #endif
 	uint32 m_recycleCount = 0;
+	uint32 m_profilerSlot = ~0U;
 	uint32 m_linkTargetAddress[LINK_SLOT_MAX];
 	uint32 m_linkBlockTrampolineOffset[LINK_SLOT_MAX];
 #ifdef _DEBUG
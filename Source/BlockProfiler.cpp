@@ -0,0 +1,223 @@
+#include <cassert>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include "BlockProfiler.h"
+#include "MIPS.h"
+#include "string_format.h"
+#ifndef _WIN32
+#include <unistd.h>
+#endif
+
+struct RANGE_STATS
+{
+	uint32 begin = 0;
+	uint32 end = 0;
+	uint32 codeSize = 0;
+	uint64 executionCount = 0;
+	uint64 cycles = 0;
+};
+
+static std::string GetFunctionName(const CMIPS& context, uint32 address, uint32& functionStart)
+{
+	functionStart = address;
+	if(context.m_analysis)
+	{
+		if(auto subroutine = context.m_analysis->FindSubroutine(address))
+		{
+			functionStart = subroutine->start;
+		}
+	}
+	if(auto functionName = context.m_Functions.Find(functionStart))
+	{
+		return functionName;
+	}
+	return string_format("sub_%08X", functionStart);
+}
+
+static void WriteLine(Framework::CStream& stream, const std::string& line)
+{
+	stream.Write(line.c_str(), line.size());
+	stream.Write("\r\n", 2);
+}
+
+CBlockProfiler::~CBlockProfiler()
+{
+	if(m_perfMapFile)
+	{
+		fclose(m_perfMapFile);
+	}
+}
+
+bool CBlockProfiler::IsEnabled() const
+{
+	return m_enabled;
+}
+
+void CBlockProfiler::SetEnabled(bool enabled)
+{
+	m_enabled = enabled;
+}
+
+bool CBlockProfiler::IsPerfMapEnabled() const
+{
+	return m_perfMapEnabled;
+}
+
+void CBlockProfiler::SetPerfMapEnabled(bool enabled)
+{
+	m_perfMapEnabled = enabled;
+}
+
+uint32 CBlockProfiler::RegisterBlock(const CMIPS* context, uint32 begin, uint32 end, uint32 instructionSize)
+{
+	std::lock_guard<std::mutex> profilerLock(m_mutex);
+
+	//Blocks compiled more than once (ie.: after code invalidation) keep their slot
+	auto key = std::make_tuple(context, begin, end);
+	auto slotIterator = m_blockSlots.find(key);
+	if(slotIterator != std::end(m_blockSlots))
+	{
+		return slotIterator->second;
+	}
+
+	if(!m_blocks)
+	{
+		m_blocks.reset(new BLOCK[MAX_BLOCKS]);
+	}
+	if(m_blockCount == MAX_BLOCKS)
+	{
+		return INVALID_SLOT;
+	}
+
+	uint32 slot = m_blockCount++;
+	auto& block = m_blocks[slot];
+	block.context = context;
+	block.begin = begin;
+	block.end = end;
+	block.instructionCount = ((end - begin) / instructionSize) + 1;
+	block.executionCount = 0;
+	m_blockSlots.insert(std::make_pair(key, slot));
+	return slot;
+}
+
+void CBlockProfiler::NotifyBlockCompiled(uint32 slot, uint32 begin, uint32 end, const void* code, uint32 codeSize)
+{
+	std::lock_guard<std::mutex> profilerLock(m_mutex);
+	if(slot != INVALID_SLOT)
+	{
+		assert(slot < m_blockCount);
+		m_blocks[slot].codeSize = codeSize;
+	}
+	if(m_perfMapEnabled)
+	{
+		WritePerfMapEntry(begin, end, code, codeSize);
+	}
+}
+
+void CBlockProfiler::HitHandler(uint32 slot)
+{
+	auto& block = GetInstance().m_blocks[slot];
+	block.executionCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void CBlockProfiler::ResetCounts()
+{
+	std::lock_guard<std::mutex> profilerLock(m_mutex);
+	for(uint32 i = 0; i < m_blockCount; i++)
+	{
+		m_blocks[i].executionCount = 0;
+	}
+}
+
+void CBlockProfiler::WriteReport(Framework::CStream& stream, const CMIPS* context) const
+{
+	std::vector<RANGE_STATS> sortedRanges;
+	uint64 totalCycles = 0;
+	{
+		std::lock_guard<std::mutex> profilerLock(m_mutex);
+		for(uint32 i = 0; i < m_blockCount; i++)
+		{
+			const auto& block = m_blocks[i];
+			if(block.context != context) continue;
+			uint64 executionCount = block.executionCount.load(std::memory_order_relaxed);
+			if(executionCount == 0) continue;
+			RANGE_STATS range;
+			range.begin = block.begin;
+			range.end = block.end;
+			range.codeSize = block.codeSize;
+			range.executionCount = executionCount;
+			range.cycles = executionCount * block.instructionCount;
+			sortedRanges.push_back(range);
+			totalCycles += range.cycles;
+		}
+	}
+
+	std::sort(sortedRanges.begin(), sortedRanges.end(),
+	          [](const RANGE_STATS& lhs, const RANGE_STATS& rhs) { return lhs.cycles > rhs.cycles; });
+
+	std::map<uint32, std::pair<std::string, uint64>> functions;
+	for(const auto& range : sortedRanges)
+	{
+		uint32 functionStart = 0;
+		auto functionName = GetFunctionName(*context, range.begin, functionStart);
+		auto& function = functions[functionStart];
+		function.first = functionName;
+		function.second += range.cycles;
+	}
+
+	std::vector<std::pair<std::string, uint64>> sortedFunctions;
+	for(const auto& functionPair : functions)
+	{
+		sortedFunctions.push_back(functionPair.second);
+	}
+	std::sort(sortedFunctions.begin(), sortedFunctions.end(),
+	          [](const auto& lhs, const auto& rhs) { return lhs.second > rhs.second; });
+
+	auto getRatio =
+	    [totalCycles](uint64 cycles) {
+		    return (totalCycles != 0) ? (static_cast<double>(cycles) * 100.0 / static_cast<double>(totalCycles)) : 0.0;
+	    };
+
+	WriteLine(stream, string_format("Blocks: %d, Total cycles: %llu",
+	                                static_cast<uint32>(sortedRanges.size()), static_cast<unsigned long long>(totalCycles)));
+	WriteLine(stream, "");
+	WriteLine(stream, string_format("%-32s %16s %8s", "Function", "Cycles", "%"));
+	for(const auto& function : sortedFunctions)
+	{
+		WriteLine(stream, string_format("%-32s %16llu %7.2f%%", function.first.c_str(),
+		                                static_cast<unsigned long long>(function.second), getRatio(function.second)));
+	}
+	WriteLine(stream, "");
+	WriteLine(stream, string_format("%-10s %-10s %-32s %16s %16s %8s %10s",
+	                                "Begin", "End", "Function", "Executions", "Cycles", "%", "Host Size"));
+	for(const auto& range : sortedRanges)
+	{
+		uint32 functionStart = 0;
+		auto functionName = GetFunctionName(*context, range.begin, functionStart);
+		WriteLine(stream, string_format("0x%08X 0x%08X %-32s %16llu %16llu %7.2f%% %10d",
+		                                range.begin, range.end, functionName.c_str(),
+		                                static_cast<unsigned long long>(range.executionCount),
+		                                static_cast<unsigned long long>(range.cycles),
+		                                getRatio(range.cycles), range.codeSize));
+	}
+}
+
+void CBlockProfiler::WritePerfMapEntry(uint32 begin, uint32 end, const void* code, uint32 codeSize)
+{
+#ifndef _WIN32
+	if(!m_perfMapFile)
+	{
+		auto perfMapPath = string_format("/tmp/perf-%d.map", getpid());
+		m_perfMapFile = fopen(perfMapPath.c_str(), "w");
+		if(!m_perfMapFile)
+		{
+			m_perfMapEnabled = false;
+			return;
+		}
+	}
+	fprintf(m_perfMapFile, "%llx %x BasicBlock_0x%08X_0x%08X\n",
+	        static_cast<unsigned long long>(reinterpret_cast<uintptr_t>(code)), codeSize, begin, end);
+	fflush(m_perfMapFile);
+#endif
+}
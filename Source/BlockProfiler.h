@@ -0,0 +1,69 @@
+#pragma once
+
+#include <cstdio>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <tuple>
+#include "Singleton.h"
+#include "Types.h"
+#include "Stream.h"
+
+class CMIPS;
+
+//Keeps execution counts for instrumented JIT blocks. Blocks compiled while the profiler
+//is enabled call HitHandler on entry. Can also emit a perf map (/tmp/perf-PID.map) to
+//allow Linux perf to symbolize JIT code.
+//Several VMs can compile blocks at the same time. Slots are allocated once per block
+//range and never move, so HitHandler doesn't need to lock.
+class CBlockProfiler : public CSingleton<CBlockProfiler>
+{
+public:
+	enum
+	{
+		INVALID_SLOT = ~0U,
+		MAX_BLOCKS = 0x40000,
+	};
+
+	CBlockProfiler() = default;
+	virtual ~CBlockProfiler();
+
+	bool IsEnabled() const;
+	void SetEnabled(bool);
+
+	bool IsPerfMapEnabled() const;
+	void SetPerfMapEnabled(bool);
+
+	uint32 RegisterBlock(const CMIPS*, uint32, uint32, uint32);
+	void NotifyBlockCompiled(uint32, uint32, uint32, const void*, uint32);
+
+	static void HitHandler(uint32);
+
+	void ResetCounts();
+	void WriteReport(Framework::CStream&, const CMIPS*) const;
+
+private:
+	struct BLOCK
+	{
+		const CMIPS* context = nullptr;
+		uint32 begin = 0;
+		uint32 end = 0;
+		uint32 instructionCount = 0;
+		uint32 codeSize = 0;
+		std::atomic<uint64> executionCount;
+	};
+	typedef std::tuple<const CMIPS*, uint32, uint32> BlockKey;
+	typedef std::map<BlockKey, uint32> BlockSlotMap;
+
+	void WritePerfMapEntry(uint32, uint32, const void*, uint32);
+
+	std::atomic<bool> m_enabled{false};
+	std::atomic<bool> m_perfMapEnabled{false};
+
+	mutable std::mutex m_mutex;
+	FILE* m_perfMapFile = nullptr;
+	std::unique_ptr<BLOCK[]> m_blocks;
+	uint32 m_blockCount = 0;
+	BlockSlotMap m_blockSlots;
+};
@@ -0,0 +1,229 @@
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include <utility>
+#include <zlib.h>
+#include "InputMovie.h"
+
+#define MOVIE_MAGIC 0x564F4D50 //'PMOV'
+#define MOVIE_VERSION 2
+
+//Frame encoding:
+//uint8: bits 0-1 are the pads the handler reported, bits 4-5 are the pads whose state changed
+//PAD_STATE (8 bytes) for every pad whose state changed
+//uint32: EE RAM hash
+#define FRAME_CHANGED_PADS_SHIFT 4
+
+bool CInputMovie::PAD_STATE::operator==(const PAD_STATE& rhs) const
+{
+	return (buttons == rhs.buttons) && !memcmp(axes, rhs.axes, sizeof(axes));
+}
+
+bool CInputMovie::PAD_STATE::operator!=(const PAD_STATE& rhs) const
+{
+	return !(*this == rhs);
+}
+
+void CInputMovie::Reset()
+{
+	m_executableName.clear();
+	m_clockTime = 0;
+	m_initialState.clear();
+	m_frames.clear();
+}
+
+const std::string& CInputMovie::GetExecutableName() const
+{
+	return m_executableName;
+}
+
+void CInputMovie::SetExecutableName(const std::string& executableName)
+{
+	m_executableName = executableName;
+}
+
+uint64 CInputMovie::GetClockTime() const
+{
+	return m_clockTime;
+}
+
+void CInputMovie::SetClockTime(uint64 clockTime)
+{
+	m_clockTime = clockTime;
+}
+
+const std::vector<uint8>& CInputMovie::GetInitialState() const
+{
+	return m_initialState;
+}
+
+void CInputMovie::SetInitialState(std::vector<uint8> initialState)
+{
+	m_initialState = std::move(initialState);
+}
+
+const CInputMovie::FrameArray& CInputMovie::GetFrames() const
+{
+	return m_frames;
+}
+
+void CInputMovie::AddFrame(const FRAME& frame)
+{
+	m_frames.push_back(frame);
+}
+
+void CInputMovie::Read(Framework::CStream& input)
+{
+	Reset();
+
+	uint32 magic = input.Read32();
+	uint32 version = input.Read32();
+	if(magic != MOVIE_MAGIC)
+	{
+		throw std::runtime_error("Invalid movie file.");
+	}
+	if(version != MOVIE_VERSION)
+	{
+		throw std::runtime_error("Unsupported movie file version.");
+	}
+
+	uint32 executableNameLength = input.Read32();
+	m_executableName.resize(executableNameLength);
+	input.Read(&m_executableName[0], executableNameLength);
+	m_clockTime = input.Read64();
+
+	uint32 initialStateSize = input.Read32();
+	m_initialState.resize(initialStateSize);
+	if(input.Read(m_initialState.data(), initialStateSize) != initialStateSize)
+	{
+		throw std::runtime_error("Invalid movie file.");
+	}
+
+	uint32 frameCount = input.Read32();
+	m_frames.reserve(frameCount);
+
+	FRAME frame;
+	for(uint32 i = 0; i < frameCount; i++)
+	{
+		uint8 flags = input.Read8();
+		frame.activePads = flags & ((1 << MAX_PADS) - 1);
+		for(unsigned int padIndex = 0; padIndex < MAX_PADS; padIndex++)
+		{
+			if(flags & (1 << (padIndex + FRAME_CHANGED_PADS_SHIFT)))
+			{
+				auto& padState = frame.pads[padIndex];
+				padState.buttons = input.Read32();
+				input.Read(padState.axes, AXIS_COUNT);
+			}
+		}
+		frame.ramHash = input.Read32();
+		m_frames.push_back(frame);
+	}
+}
+
+void CInputMovie::Write(Framework::CStream& output) const
+{
+	output.Write32(MOVIE_MAGIC);
+	output.Write32(MOVIE_VERSION);
+
+	output.Write32(static_cast<uint32>(m_executableName.size()));
+	output.Write(m_executableName.c_str(), m_executableName.size());
+	output.Write64(m_clockTime);
+
+	output.Write32(static_cast<uint32>(m_initialState.size()));
+	output.Write(m_initialState.data(), m_initialState.size());
+
+	output.Write32(static_cast<uint32>(m_frames.size()));
+
+	FRAME prevFrame;
+	for(const auto& frame : m_frames)
+	{
+		uint8 flags = frame.activePads;
+		for(unsigned int padIndex = 0; padIndex < MAX_PADS; padIndex++)
+		{
+			if(frame.pads[padIndex] != prevFrame.pads[padIndex])
+			{
+				flags |= (1 << (padIndex + FRAME_CHANGED_PADS_SHIFT));
+			}
+		}
+		output.Write8(flags);
+		for(unsigned int padIndex = 0; padIndex < MAX_PADS; padIndex++)
+		{
+			if(flags & (1 << (padIndex + FRAME_CHANGED_PADS_SHIFT)))
+			{
+				const auto& padState = frame.pads[padIndex];
+				output.Write32(padState.buttons);
+				output.Write(padState.axes, AXIS_COUNT);
+			}
+		}
+		output.Write32(frame.ramHash);
+		prevFrame = frame;
+	}
+}
+
+uint32 CInputMovie::HashMemory(const uint8* memory, uint32 size)
+{
+	return crc32(0, reinterpret_cast<const Bytef*>(memory), size);
+}
+
+void CInputMovieRecorder::SetButtonState(unsigned int padNumber, PS2::CControllerInfo::BUTTON button, bool pressed, uint8*)
+{
+	if(padNumber >= CInputMovie::MAX_PADS) return;
+	auto& padState = m_frame.pads[padNumber];
+	uint32 buttonMask = (1 << button);
+	padState.buttons &= ~buttonMask;
+	if(pressed)
+	{
+		padState.buttons |= buttonMask;
+	}
+	m_frame.activePads |= (1 << padNumber);
+}
+
+void CInputMovieRecorder::SetAxisState(unsigned int padNumber, PS2::CControllerInfo::BUTTON button, uint8 value, uint8*)
+{
+	if(padNumber >= CInputMovie::MAX_PADS) return;
+	assert(button < CInputMovie::AXIS_COUNT);
+	m_frame.pads[padNumber].axes[button] = value;
+	m_frame.activePads |= (1 << padNumber);
+}
+
+const CInputMovie::FRAME& CInputMovieRecorder::GetFrame() const
+{
+	return m_frame;
+}
+
+void CInputMovieRecorder::BeginFrame()
+{
+	//Pad states are kept from one frame to the next, only the set of reporting pads is reset
+	m_frame.activePads = 0;
+	m_frame.ramHash = 0;
+}
+
+void CInputMoviePlayer::SetFrame(const CInputMovie::FRAME& frame)
+{
+	m_frame = frame;
+}
+
+void CInputMoviePlayer::Update(uint8* ram)
+{
+	for(auto& listener : m_listeners)
+	{
+		for(unsigned int padIndex = 0; padIndex < CInputMovie::MAX_PADS; padIndex++)
+		{
+			if(!(m_frame.activePads & (1 << padIndex))) continue;
+			const auto& padState = m_frame.pads[padIndex];
+			for(unsigned int i = 0; i < PS2::CControllerInfo::MAX_BUTTONS; i++)
+			{
+				auto button = static_cast<PS2::CControllerInfo::BUTTON>(i);
+				if(PS2::CControllerInfo::IsAxis(button))
+				{
+					listener->SetAxisState(padIndex, button, padState.axes[i], ram);
+				}
+				else
+				{
+					listener->SetButtonState(padIndex, button, (padState.buttons & (1 << i)) != 0, ram);
+				}
+			}
+		}
+	}
+}
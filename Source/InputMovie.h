@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Types.h"
+#include "Stream.h"
+#include "PadHandler.h"
+
+//Pad input sampled once per vblank along with a hash of EE RAM for every frame, starting
+//from a saved machine state. Hashes allow finding the first frame where a replay diverges.
+class CInputMovie
+{
+public:
+	enum
+	{
+		MAX_PADS = 2,
+		AXIS_COUNT = 4,
+	};
+
+	struct PAD_STATE
+	{
+		bool operator==(const PAD_STATE&) const;
+		bool operator!=(const PAD_STATE&) const;
+
+		uint32 buttons = 0;
+		uint8 axes[AXIS_COUNT] = {0x7F, 0x7F, 0x7F, 0x7F};
+	};
+
+	struct FRAME
+	{
+		uint8 activePads = 0;
+		PAD_STATE pads[MAX_PADS];
+		uint32 ramHash = 0;
+	};
+	typedef std::vector<FRAME> FrameArray;
+
+	void Reset();
+
+	const std::string& GetExecutableName() const;
+	void SetExecutableName(const std::string&);
+
+	uint64 GetClockTime() const;
+	void SetClockTime(uint64);
+
+	//Save state archive of the machine when recording started
+	const std::vector<uint8>& GetInitialState() const;
+	void SetInitialState(std::vector<uint8>);
+
+	const FrameArray& GetFrames() const;
+	void AddFrame(const FRAME&);
+
+	void Read(Framework::CStream&);
+	void Write(Framework::CStream&) const;
+
+	static uint32 HashMemory(const uint8*, uint32);
+
+private:
+	std::string m_executableName;
+	uint64 m_clockTime = 0;
+	std::vector<uint8> m_initialState;
+	FrameArray m_frames;
+};
+
+//Collects pad states sent by a pad handler during a frame
+class CInputMovieRecorder : public CPadListener
+{
+public:
+	void SetButtonState(unsigned int, PS2::CControllerInfo::BUTTON, bool, uint8*) override;
+	void SetAxisState(unsigned int, PS2::CControllerInfo::BUTTON, uint8, uint8*) override;
+
+	const CInputMovie::FRAME& GetFrame() const;
+	void BeginFrame();
+
+private:
+	CInputMovie::FRAME m_frame;
+};
+
+//Sends recorded pad states to listeners in place of a live pad handler
+class CInputMoviePlayer : public CPadHandler
+{
+public:
+	void SetFrame(const CInputMovie::FRAME&);
+	void Update(uint8*) override;
+
+private:
+	CInputMovie::FRAME m_frame;
+};
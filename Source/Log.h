@@ -2,6 +2,7 @@
 
 #include <string>
 #include <map>
+#include <mutex>
 #include "filesystem_def.h"
 #include "StdStream.h"
 #include "Singleton.h"
@@ -21,6 +22,7 @@ private:
 	Framework::CStdStream& GetLog(const char*);
 
 	fs::path m_logBasePath;
+	std::mutex m_logsMutex;
 	LogMapType m_logs;
 	bool m_showPrints = false;
 };
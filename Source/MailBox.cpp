@@ -1,4 +1,5 @@
 #include "MailBox.h"
+#include "PerfCounters.h"
 #if defined(_WIN32)
 #include "win32/Win32Defs.h"
 #endif
@@ -44,6 +45,7 @@ void CMailBox::SendCall(const FunctionType& function, bool waitForCompletion)
 
 	if(waitForCompletion)
 	{
+		CPerfCounterTimer waitTimer(CPerfCounters::COUNTER_MAILBOX_WAIT_TIME);
 		m_callDone = false;
 		while(!m_callDone)
 		{
@@ -112,6 +112,25 @@ public:
 		}
 	}
 
+	//Inserts after the item with prevId, or at the front if prevId is 0
+	void InsertAfter(uint32 prevId, uint32 id)
+	{
+		auto item = m_items[id];
+		auto nextId = (prevId == 0) ? m_headIdPtr : &m_items[prevId]->nextId;
+		item->nextId = (*nextId);
+		(*nextId) = id;
+	}
+
+	//Unlinks an item when its predecessor is already known (prevId is 0 if item is at the front)
+	void UnlinkAfter(uint32 prevId, uint32 id)
+	{
+		auto item = m_items[id];
+		auto nextId = (prevId == 0) ? m_headIdPtr : &m_items[prevId]->nextId;
+		assert((*nextId) == id);
+		(*nextId) = item->nextId;
+		item->nextId = 0;
+	}
+
 	void Unlink(uint32 id)
 	{
 		auto nextId = m_headIdPtr;
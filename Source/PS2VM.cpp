@@ -1,6 +1,11 @@
 #include <stdio.h>
 #include <exception>
+#include <stdexcept>
+#include <ctime>
+#include <cstring>
+#include <algorithm>
 #include <memory>
+#include <climits>
 #include <fenv.h>
 #include "make_unique.h"
 #include "string_format.h"
@@ -13,7 +18,11 @@
 #include "StdStream.h"
 #include "StdStreamUtils.h"
 #include "GZipStream.h"
+#include "states/FastStateFile.h"
+#include "MemStream.h"
+#include "PtrStream.h"
 #include "states/MemoryStateFile.h"
+#include "states/RegisterStateFile.h"
 #include "zip/ZipArchiveWriter.h"
 #include "zip/ZipArchiveReader.h"
 #include "xml/Node.h"
@@ -22,11 +31,14 @@
 #include "AppConfig.h"
 #include "PathUtils.h"
 #include "iop/IopBios.h"
+#include "iop/Iop_McServ.h"
+#include "iop/CachedDirectoryDevice.h"
 #include "iop/DirectoryDevice.h"
 #include "iop/OpticalMediaDevice.h"
 #include "Log.h"
 #include "ISO9660/BlockProvider.h"
 #include "DiskUtils.h"
+#include "BlockProfiler.h"
 
 #define LOG_NAME ("ps2vm")
 
@@ -34,6 +46,13 @@
 #define PREF_PS2_MC0_DIRECTORY_DEFAULT ("vfs/mc0")
 #define PREF_PS2_MC1_DIRECTORY_DEFAULT ("vfs/mc1")
 
+#define STATE_FAST_ARCHIVE ("state")
+
+#define STATE_SPU ("ps2vm/spu.xml")
+#define STATE_SPU_UPDATE_TICKS ("UpdateTicks")
+#define STATE_SPU_RENDERED_FRAME_COUNT ("RenderedFrameCount")
+#define STATE_SPU_SAMPLES ("ps2vm/spu_samples")
+
 #define FRAME_TICKS (PS2::EE_CLOCK_FREQ / 60)
 #define ONSCREEN_TICKS (FRAME_TICKS * 9 / 10)
 #define VBLANK_TICKS (FRAME_TICKS / 10)
@@ -88,10 +107,32 @@ CPS2VM::CPS2VM()
 	auto iopOs = dynamic_cast<CIopBios*>(m_iop->m_bios.get());
 
 	m_ee = std::make_unique<Ee::CSubSystem>(m_iop->m_ram, *iopOs);
+
+	auto spuSyncHandler = [this]() { SyncSpu(); };
+	m_iop->m_spuCore0.SetSyncHandler(spuSyncHandler);
+	m_iop->m_spuCore1.SetSyncHandler(spuSyncHandler);
 	m_OnRequestLoadExecutableConnection = m_ee->m_os->OnRequestLoadExecutable.Connect(std::bind(&CPS2VM::ReloadExecutable, this, std::placeholders::_1, std::placeholders::_2));
 
 	CAppConfig::GetInstance().RegisterPreferenceInteger(PREF_AUDIO_SPUBLOCKCOUNT, 100);
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_AUDIO_TIMESTRETCH, false);
 	m_spuBlockCount = CAppConfig::GetInstance().GetPreferenceInteger(PREF_AUDIO_SPUBLOCKCOUNT);
+
+	CAppConfig::GetInstance().RegisterPreferenceInteger(PREF_PS2_STATE_COMPRESSIONLEVEL, 1);
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_PS2_STATE_FASTFORMAT, false);
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_PS2_STATE_KEEPCOMPILEDBLOCKS, false);
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_PS2_REWIND_ENABLED, false);
+	CAppConfig::GetInstance().RegisterPreferenceInteger(PREF_PS2_REWIND_INTERVAL, 30);
+	CAppConfig::GetInstance().RegisterPreferenceInteger(PREF_PS2_REWIND_MEMORYBUDGET, 256);
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_PS2_BLOCKPROFILER_ENABLED, false);
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_PS2_BLOCKPROFILER_PERFMAP, false);
+	CAppConfig::GetInstance().RegisterPreferenceInteger(PREF_PS2_CDVD_COMPLETIONMODE, static_cast<int>(CIopBios::IO_COMPLETION_MODE::VBLANK));
+	CAppConfig::GetInstance().RegisterPreferenceInteger(PREF_PS2_CDVD_READSPEED, 4);
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_PS2_PERFCOUNTERS_ENABLED, false);
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_PS2_LOCKSTEP_ENABLED, false);
+	LoadRewindSettings();
+	LoadCdvdSettings();
+	LoadPerfCountersSettings();
+	LoadLockstepSettings();
 }
 
 //////////////////////////////////////////////////
@@ -134,7 +175,7 @@ void CPS2VM::DestroyPadHandler()
 
 void CPS2VM::CreateSoundHandler(const CSoundHandler::FactoryFunction& factoryFunction)
 {
-	if(m_soundHandler != nullptr) return;
+	if(m_audioStream) return;
 	m_mailBox.SendCall([this, factoryFunction]() { CreateSoundHandlerImpl(factoryFunction); }, true);
 }
 
@@ -142,16 +183,18 @@ void CPS2VM::ReloadSpuBlockCount()
 {
 	m_mailBox.SendCall(
 	    [this]() {
-		    m_currentSpuBlock = 0;
-		    auto spuBlockCount = CAppConfig::GetInstance().GetPreferenceInteger(PREF_AUDIO_SPUBLOCKCOUNT);
-		    assert(spuBlockCount <= BLOCK_COUNT);
-		    m_spuBlockCount = spuBlockCount;
+		    m_spuBlockCount = CAppConfig::GetInstance().GetPreferenceInteger(PREF_AUDIO_SPUBLOCKCOUNT);
+		    if(m_audioStream)
+		    {
+			    m_audioStream->SetTargetLatency(m_spuBlockCount);
+		    }
+		    UpdateLockstep();
 	    });
 }
 
 void CPS2VM::DestroySoundHandler()
 {
-	if(m_soundHandler == nullptr) return;
+	if(!m_audioStream) return;
 	m_mailBox.SendCall([this]() { DestroySoundHandlerImpl(); }, true);
 }
 
@@ -234,6 +277,7 @@ void CPS2VM::Destroy()
 {
 	m_mailBox.SendCall(std::bind(&CPS2VM::DestroyImpl, this));
 	m_thread.join();
+	WaitForStateWriter();
 	DestroyVM();
 }
 
@@ -254,8 +298,7 @@ std::future<bool> CPS2VM::SaveState(const fs::path& statePath)
 	auto future = promise->get_future();
 	m_mailBox.SendCall(
 	    [this, promise, statePath]() {
-		    auto result = SaveVMState(statePath);
-		    promise->set_value(result);
+		    SaveVMState(statePath, promise);
 	    });
 	return future;
 }
@@ -272,6 +315,251 @@ std::future<bool> CPS2VM::LoadState(const fs::path& statePath)
 	return future;
 }
 
+std::future<StateSnapshotPtr> CPS2VM::TakeSnapshot()
+{
+	auto promise = std::make_shared<std::promise<StateSnapshotPtr>>();
+	auto future = promise->get_future();
+	m_mailBox.SendCall(
+	    [this, promise]() {
+		    auto result = TakeVMSnapshot();
+		    promise->set_value(result);
+	    });
+	return future;
+}
+
+std::future<bool> CPS2VM::RestoreSnapshot(const StateSnapshotPtr& snapshot)
+{
+	auto promise = std::make_shared<std::promise<bool>>();
+	auto future = promise->get_future();
+	m_mailBox.SendCall(
+	    [this, promise, snapshot]() {
+		    auto result = RestoreVMSnapshot(snapshot);
+		    promise->set_value(result);
+	    });
+	return future;
+}
+
+void CPS2VM::ReloadRewindSettings()
+{
+	m_mailBox.SendCall([this]() { LoadRewindSettings(); });
+}
+
+void CPS2VM::ReloadCdvdSettings()
+{
+	m_mailBox.SendCall([this]() { LoadCdvdSettings(); });
+}
+
+void CPS2VM::NotifyMemoryCardsChanged()
+{
+	m_mailBox.SendCall(
+	    [this]() {
+#ifdef _IOP_EMULATE_MODULES
+		    auto iopOs = dynamic_cast<CIopBios*>(m_iop->m_bios.get());
+		    if(iopOs)
+		    {
+			    iopOs->GetMcServ()->InvalidateCardIndices();
+		    }
+#endif
+	    });
+}
+
+void CPS2VM::ReloadPerfCountersSettings()
+{
+	m_mailBox.SendCall([this]() { LoadPerfCountersSettings(); });
+}
+
+void CPS2VM::ReloadLockstepSettings()
+{
+	m_mailBox.SendCall([this]() { LoadLockstepSettings(); });
+}
+
+CPerfCounters& CPS2VM::GetPerfCounters()
+{
+	return m_perfCounters;
+}
+
+std::future<bool> CPS2VM::Rewind()
+{
+	auto promise = std::make_shared<std::promise<bool>>();
+	auto future = promise->get_future();
+	m_mailBox.SendCall(
+	    [this, promise]() {
+		    bool result = false;
+		    try
+		    {
+			    auto snapshot = m_rewindBuffer.StepBack();
+			    result = RestoreVMSnapshot(snapshot);
+		    }
+		    catch(...)
+		    {
+		    }
+		    m_rewindFrameCounter = 0;
+		    promise->set_value(result);
+	    });
+	return future;
+}
+
+std::future<bool> CPS2VM::StartMovieRecording()
+{
+	auto promise = std::make_shared<std::promise<bool>>();
+	auto future = promise->get_future();
+	m_mailBox.SendCall(
+	    [this, promise]() {
+		    StopMovie();
+		    //Playback starts by loading the current state, frames are recorded from there
+		    try
+		    {
+			    auto snapshot = TakeVMSnapshot();
+			    if(!snapshot)
+			    {
+				    throw std::runtime_error("Failed to take snapshot.");
+			    }
+			    int compressionLevel = CAppConfig::GetInstance().GetPreferenceInteger(PREF_PS2_STATE_COMPRESSIONLEVEL);
+			    compressionLevel = std::max(std::min(compressionLevel, 9), 0);
+			    Framework::CMemStream stateStream;
+			    WriteVMStateArchive(stateStream, snapshot, GetSnapshotMemoryRegions(), compressionLevel);
+			    m_movie.SetInitialState(std::vector<uint8>(stateStream.GetBuffer(), stateStream.GetBuffer() + stateStream.GetSize()));
+		    }
+		    catch(...)
+		    {
+			    m_movie.Reset();
+			    promise->set_value(false);
+			    return;
+		    }
+		    m_movie.SetClockTime(time(nullptr));
+		    m_movieRecorder = CInputMovieRecorder();
+		    m_movieStatus.mode = MOVIE_MODE_RECORD;
+		    UpdateMovieClock();
+		    UpdateLockstep();
+		    RegisterModulesInPadHandler();
+		    promise->set_value(true);
+	    });
+	return future;
+}
+
+std::future<bool> CPS2VM::StopMovieRecording(const fs::path& moviePath)
+{
+	auto promise = std::make_shared<std::promise<bool>>();
+	auto future = promise->get_future();
+	m_mailBox.SendCall(
+	    [this, promise, moviePath]() {
+		    if(m_movieStatus.mode != MOVIE_MODE_RECORD)
+		    {
+			    promise->set_value(false);
+			    return;
+		    }
+		    bool result = true;
+		    try
+		    {
+			    m_movie.SetExecutableName(m_ee->m_os->GetExecutableName());
+			    auto movieStream = Framework::CreateOutputStdStream(moviePath.native());
+			    m_movie.Write(movieStream);
+		    }
+		    catch(...)
+		    {
+			    result = false;
+		    }
+		    StopMovie();
+		    promise->set_value(result);
+	    });
+	return future;
+}
+
+std::future<bool> CPS2VM::StartMoviePlayback(const fs::path& moviePath)
+{
+	auto promise = std::make_shared<std::promise<bool>>();
+	auto future = promise->get_future();
+	m_mailBox.SendCall(
+	    [this, promise, moviePath]() {
+		    StopMovie();
+		    try
+		    {
+			    if(m_ee->m_gs == NULL)
+			    {
+				    throw std::runtime_error("GS Handler was not instancied.");
+			    }
+			    auto movieStream = Framework::CreateInputStdStream(moviePath.native());
+			    m_movie.Read(movieStream);
+			    const auto& initialState = m_movie.GetInitialState();
+			    Framework::CPtrStream stateStream(initialState.data(), initialState.size());
+			    LoadVMStateArchive(stateStream);
+		    }
+		    catch(...)
+		    {
+			    m_movie.Reset();
+			    promise->set_value(false);
+			    return;
+		    }
+		    OnMachineStateChange();
+		    m_movieStatus.mode = MOVIE_MODE_PLAYBACK;
+		    m_movieStatus.frameCount = static_cast<uint32>(m_movie.GetFrames().size());
+		    UpdateMovieClock();
+		    UpdateLockstep();
+		    promise->set_value(true);
+	    });
+	return future;
+}
+
+void CPS2VM::StopMoviePlayback()
+{
+	m_mailBox.SendCall(
+	    [this]() {
+		    if(m_movieStatus.mode != MOVIE_MODE_PLAYBACK) return;
+		    StopMovie();
+	    });
+}
+
+CPS2VM::MOVIE_STATUS CPS2VM::GetMovieStatus()
+{
+	MOVIE_STATUS result;
+	m_mailBox.SendCall([this, &result]() { result = m_movieStatus; }, true);
+	return result;
+}
+
+std::future<bool> CPS2VM::SaveBlockProfile(const fs::path& reportPath)
+{
+	auto promise = std::make_shared<std::promise<bool>>();
+	auto future = promise->get_future();
+	m_mailBox.SendCall(
+	    [this, promise, reportPath]() {
+		    if(!CBlockProfiler::GetInstance().IsEnabled())
+		    {
+			    promise->set_value(false);
+			    return;
+		    }
+		    bool result = true;
+		    try
+		    {
+			    auto reportStream = Framework::CreateOutputStdStream(reportPath.native());
+			    std::pair<const char*, const CMIPS*> contexts[] =
+			        {
+			            {"EE", &m_ee->m_EE},
+			            {"VU0", &m_ee->m_VU0},
+			            {"VU1", &m_ee->m_VU1},
+			            {"IOP", &m_iop->m_cpu},
+			        };
+			    for(const auto& context : contexts)
+			    {
+				    auto header = string_format("[%s]\r\n", context.first);
+				    reportStream.Write(header.c_str(), header.size());
+				    CBlockProfiler::GetInstance().WriteReport(reportStream, context.second);
+				    reportStream.Write("\r\n", 2);
+			    }
+		    }
+		    catch(...)
+		    {
+			    result = false;
+		    }
+		    promise->set_value(result);
+	    });
+	return future;
+}
+
+void CPS2VM::ResetBlockProfile()
+{
+	m_mailBox.SendCall([]() { CBlockProfiler::GetInstance().ResetCounts(); });
+}
+
 void CPS2VM::TriggerFrameDump(const FrameDumpCallback& frameDumpCallback)
 {
 	m_mailBox.SendCall(
@@ -375,6 +663,10 @@ void CPS2VM::CreateVM()
 
 void CPS2VM::ResetVM()
 {
+	//Instrumentation is decided when blocks are compiled, apply settings before executors are cleared
+	CBlockProfiler::GetInstance().SetEnabled(CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_BLOCKPROFILER_ENABLED));
+	CBlockProfiler::GetInstance().SetPerfMapEnabled(CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_BLOCKPROFILER_PERFMAP));
+
 	m_ee->Reset();
 	m_iop->Reset();
 
@@ -391,7 +683,8 @@ void CPS2VM::ResetVM()
 
 		iopOs->Reset(std::make_shared<Iop::CSifManPs2>(m_ee->m_sif, m_ee->m_ram, m_iop->m_ram));
 
-		iopOs->GetIoman()->RegisterDevice("host", Iop::CIoman::DevicePtr(new Iop::Ioman::CDirectoryDevice(PREF_PS2_HOST_DIRECTORY)));
+		//Memory card directories are also modified by mcserv, only the host directory can be cached
+		iopOs->GetIoman()->RegisterDevice("host", Iop::CIoman::DevicePtr(new Iop::Ioman::CCachedDirectoryDevice(PREF_PS2_HOST_DIRECTORY)));
 		iopOs->GetIoman()->RegisterDevice("mc0", Iop::CIoman::DevicePtr(new Iop::Ioman::CDirectoryDevice(PREF_PS2_MC0_DIRECTORY)));
 		iopOs->GetIoman()->RegisterDevice("mc1", Iop::CIoman::DevicePtr(new Iop::Ioman::CDirectoryDevice(PREF_PS2_MC1_DIRECTORY)));
 		iopOs->GetIoman()->RegisterDevice("cdrom", Iop::CIoman::DevicePtr(new Iop::Ioman::COpticalMediaDevice(m_cdrom0)));
@@ -405,12 +698,23 @@ void CPS2VM::ResetVM()
 	m_vblankTicks = ONSCREEN_TICKS;
 	m_inVblank = false;
 
+	m_rewindBuffer.Clear();
+	m_rewindFrameCounter = 0;
+
 	m_eeExecutionTicks = 0;
 	m_iopExecutionTicks = 0;
 
 	m_spuUpdateTicks = SPU_UPDATE_TICKS;
-	m_currentSpuBlock = 0;
+	m_spuRenderedFrameCount = 0;
+	m_spuIrqEventTicks = INT_MIN;
+	m_spuIrqEventDirty = true;
 
+	//Movies start from their embedded state, a reset breaks that continuity
+	if(m_movieStatus.mode != MOVIE_MODE_NONE)
+	{
+		CLog::GetInstance().Warn(LOG_NAME, "VM was reset, stopping active movie.\r\n");
+		StopMovie();
+	}
 	RegisterModulesInPadHandler();
 }
 
@@ -419,24 +723,115 @@ void CPS2VM::DestroyVM()
 	CDROM0_Reset();
 }
 
-bool CPS2VM::SaveVMState(const fs::path& statePath)
+void CPS2VM::SaveVMState(const fs::path& statePath, const std::shared_ptr<std::promise<bool>>& promise)
 {
 	if(m_ee->m_gs == NULL)
 	{
 		printf("PS2VM: GS Handler was not instancied. Cannot save state.\r\n");
-		return false;
+		promise->set_value(false);
+		return;
 	}
 
+	//Only capturing the machine state happens on the emulation thread. Snapshot memory
+	//is immutable, so the writer can compress it while emulation goes on.
+	auto snapshot = TakeVMSnapshot();
+	if(!snapshot)
+	{
+		promise->set_value(false);
+		return;
+	}
+
+	auto regions = GetSnapshotMemoryRegions();
+	int compressionLevel = CAppConfig::GetInstance().GetPreferenceInteger(PREF_PS2_STATE_COMPRESSIONLEVEL);
+	compressionLevel = std::max(std::min(compressionLevel, 9), 0);
+	bool fastFormat = CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_STATE_FASTFORMAT);
+
+	WaitForStateWriter();
+	m_stateWriterFuture = std::async(std::launch::async,
+	                                 [promise, statePath, snapshot, regions, compressionLevel, fastFormat]() {
+		                                 auto result = fastFormat ? WriteVMFastState(statePath, snapshot, regions) : WriteVMState(statePath, snapshot, regions, compressionLevel);
+		                                 promise->set_value(result);
+	                                 });
+}
+
+CStateArchiveWriter::ChunkArray CPS2VM::GetSnapshotRegionChunks(const StateSnapshotPtr& snapshot, const CMemorySnapshot::RegionArray& regions, uint32 regionIndex)
+{
+	const auto& region = regions[regionIndex];
+	CStateArchiveWriter::ChunkArray chunks;
+	uint32 pageCount = snapshot->memory.GetRegionPageCount(regionIndex);
+	for(uint32 pageIndex = 0; pageIndex < pageCount; pageIndex++)
+	{
+		uint32 pageOffset = pageIndex * CMemorySnapshot::PAGE_SIZE;
+		CStateArchiveWriter::CHUNK chunk;
+		chunk.data = snapshot->memory.GetPageData(regionIndex, pageIndex);
+		chunk.size = std::min<uint32>(CMemorySnapshot::PAGE_SIZE, region.size - pageOffset);
+		chunks.push_back(chunk);
+	}
+	return chunks;
+}
+
+bool CPS2VM::WriteVMState(const fs::path& statePath, const StateSnapshotPtr& snapshot, const CMemorySnapshot::RegionArray& regions, int compressionLevel)
+{
 	try
 	{
 		auto stateStream = Framework::CreateOutputStdStream(statePath.native());
-		Framework::CZipArchiveWriter archive;
+		WriteVMStateArchive(stateStream, snapshot, regions, compressionLevel);
+	}
+	catch(...)
+	{
+		return false;
+	}
 
-		m_ee->SaveState(archive);
-		m_iop->SaveState(archive);
-		m_ee->m_gs->SaveState(archive);
+	return true;
+}
 
-		archive.Write(stateStream);
+void CPS2VM::WriteVMStateArchive(Framework::CStream& stateStream, const StateSnapshotPtr& snapshot, const CMemorySnapshot::RegionArray& regions, int compressionLevel)
+{
+	CStateArchiveWriter writer(compressionLevel);
+
+	{
+		Framework::CPtrStream stateArchiveStream(snapshot->stateArchive.data(), snapshot->stateArchive.size());
+		Framework::CZipArchiveReader stateArchive(stateArchiveStream);
+		for(const auto& fileHeader : stateArchive.GetFileHeaders())
+		{
+			const auto& fileName = fileHeader.first;
+			std::vector<uint8> fileData(stateArchive.GetFileHeader(fileName.c_str())->uncompressedSize);
+			stateArchive.BeginReadFile(fileName.c_str())->Read(fileData.data(), fileData.size());
+			writer.InsertFile(fileName.c_str(), std::move(fileData));
+		}
+	}
+
+	for(uint32 regionIndex = 0; regionIndex < regions.size(); regionIndex++)
+	{
+		writer.InsertFile(regions[regionIndex].name, GetSnapshotRegionChunks(snapshot, regions, regionIndex));
+	}
+
+	writer.Write(stateStream);
+}
+
+bool CPS2VM::WriteVMFastState(const fs::path& statePath, const StateSnapshotPtr& snapshot, const CMemorySnapshot::RegionArray& regions)
+{
+	try
+	{
+		CFastStateFile::SectionArray sections;
+
+		{
+			CFastStateFile::SECTION section;
+			section.name = STATE_FAST_ARCHIVE;
+			section.chunks.push_back({snapshot->stateArchive.data(), static_cast<uint32>(snapshot->stateArchive.size())});
+			sections.push_back(std::move(section));
+		}
+
+		for(uint32 regionIndex = 0; regionIndex < regions.size(); regionIndex++)
+		{
+			CFastStateFile::SECTION section;
+			section.name = regions[regionIndex].name;
+			section.chunks = GetSnapshotRegionChunks(snapshot, regions, regionIndex);
+			sections.push_back(std::move(section));
+		}
+
+		auto stateStream = Framework::CreateOutputStdStream(statePath.native());
+		CFastStateFile::Write(stateStream, sections);
 	}
 	catch(...)
 	{
@@ -446,6 +841,14 @@ bool CPS2VM::SaveVMState(const fs::path& statePath)
 	return true;
 }
 
+void CPS2VM::WaitForStateWriter()
+{
+	if(m_stateWriterFuture.valid())
+	{
+		m_stateWriterFuture.wait();
+	}
+}
+
 bool CPS2VM::LoadVMState(const fs::path& statePath)
 {
 	if(m_ee->m_gs == NULL)
@@ -454,16 +857,81 @@ bool CPS2VM::LoadVMState(const fs::path& statePath)
 		return false;
 	}
 
+	//Make sure we're not loading a state that is still being written
+	WaitForStateWriter();
+
+	if(CFastStateFile::IsFastStateFile(statePath))
+	{
+		return LoadVMFastState(statePath);
+	}
+
 	try
 	{
 		auto stateStream = Framework::CreateInputStdStream(statePath.native());
+		LoadVMStateArchive(stateStream);
+	}
+	catch(...)
+	{
+		return false;
+	}
+
+	OnMachineStateChange();
+
+	return true;
+}
+
+void CPS2VM::LoadVMStateArchive(Framework::CStream& stateStream)
+{
+	Framework::CZipArchiveReader archive(stateStream);
+
+	try
+	{
+		m_ee->ResetExecutor(CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_STATE_KEEPCOMPILEDBLOCKS));
+		m_ee->LoadState(archive, true);
+		m_iop->LoadState(archive, true);
+		m_ee->m_gs->LoadState(archive, true);
+		LoadSpuState(archive);
+	}
+	catch(...)
+	{
+		//Any error that occurs in the previous block is critical
+		PauseImpl();
+		throw;
+	}
+}
+
+bool CPS2VM::LoadVMFastState(const fs::path& statePath)
+{
+	try
+	{
+		CFastStateFile stateFile(statePath);
+
+		auto regions = GetSnapshotMemoryRegions();
+		for(const auto& region : regions)
+		{
+			if(stateFile.GetSectionSize(region.name) != region.size)
+			{
+				throw std::runtime_error("State file memory section size mismatch.");
+			}
+		}
+
+		Framework::CPtrStream stateStream(stateFile.GetSectionData(STATE_FAST_ARCHIVE), stateFile.GetSectionSize(STATE_FAST_ARCHIVE));
 		Framework::CZipArchiveReader archive(stateStream);
 
 		try
 		{
-			m_ee->LoadState(archive);
-			m_iop->LoadState(archive);
-			m_ee->m_gs->LoadState(archive);
+			//Memory sections are copied straight from the file mapping, they need to be
+			//restored before anything else since some modules rebuild their state from it.
+			m_ee->ResetExecutor(CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_STATE_KEEPCOMPILEDBLOCKS));
+			for(const auto& region : regions)
+			{
+				memcpy(region.memory, stateFile.GetSectionData(region.name), region.size);
+			}
+
+			m_ee->LoadState(archive, false);
+			m_iop->LoadState(archive, false);
+			m_ee->m_gs->LoadState(archive, false);
+			LoadSpuState(archive);
 		}
 		catch(...)
 		{
@@ -482,6 +950,250 @@ bool CPS2VM::LoadVMState(const fs::path& statePath)
 	return true;
 }
 
+StateSnapshotPtr CPS2VM::TakeVMSnapshot()
+{
+	if(m_ee->m_gs == NULL)
+	{
+		printf("PS2VM: GS Handler was not instancied. Cannot take snapshot.\r\n");
+		return StateSnapshotPtr();
+	}
+
+	auto snapshot = std::make_shared<CStateSnapshot>();
+
+	try
+	{
+		//Everything but bulk memory goes through the regular state archive
+		Framework::CMemStream stateStream;
+		Framework::CZipArchiveWriter archive;
+
+		m_ee->SaveState(archive, false);
+		m_iop->SaveState(archive, false);
+		m_ee->m_gs->SaveState(archive, false);
+		SaveSpuState(archive);
+
+		archive.Write(stateStream);
+		snapshot->stateArchive = std::vector<uint8>(stateStream.GetBuffer(), stateStream.GetBuffer() + stateStream.GetSize());
+	}
+	catch(...)
+	{
+		return StateSnapshotPtr();
+	}
+
+	auto lastSnapshot = m_lastSnapshot.lock();
+	snapshot->memory.Capture(GetSnapshotMemoryRegions(), lastSnapshot ? &lastSnapshot->memory : nullptr);
+	m_ee->ResetDirtyPages();
+
+	m_lastSnapshot = snapshot;
+	return snapshot;
+}
+
+bool CPS2VM::RestoreVMSnapshot(const StateSnapshotPtr& snapshot)
+{
+	if(m_ee->m_gs == NULL)
+	{
+		printf("PS2VM: GS Handler was not instancied. Cannot restore snapshot.\r\n");
+		return false;
+	}
+
+	if(!snapshot)
+	{
+		return false;
+	}
+
+	try
+	{
+		Framework::CPtrStream stateStream(snapshot->stateArchive.data(), snapshot->stateArchive.size());
+		Framework::CZipArchiveReader archive(stateStream);
+
+		try
+		{
+			//Memory needs to be restored first since some modules rebuild their state from it.
+			//Executor is reset beforehand to make sure EE RAM isn't write protected anymore.
+			m_ee->ResetExecutor(CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_STATE_KEEPCOMPILEDBLOCKS));
+			snapshot->memory.Restore(GetSnapshotMemoryRegions());
+			//Writes to EE RAM from here on are tracked relative to this snapshot
+			m_ee->ResetDirtyPages();
+			m_lastSnapshot = snapshot;
+
+			m_ee->LoadState(archive, false);
+			m_iop->LoadState(archive, false);
+			m_ee->m_gs->LoadState(archive, false);
+			LoadSpuState(archive);
+		}
+		catch(...)
+		{
+			//Any error that occurs in the previous block is critical
+			PauseImpl();
+			throw;
+		}
+	}
+	catch(...)
+	{
+		return false;
+	}
+
+	OnMachineStateChange();
+
+	return true;
+}
+
+void CPS2VM::LoadCdvdSettings()
+{
+	auto iopOs = dynamic_cast<CIopBios*>(m_iop->m_bios.get());
+	assert(iopOs);
+	int completionMode = CAppConfig::GetInstance().GetPreferenceInteger(PREF_PS2_CDVD_COMPLETIONMODE);
+	completionMode = std::min(std::max(completionMode, 0), static_cast<int>(CIopBios::IO_COMPLETION_MODE::INSTANT));
+	iopOs->SetIoCompletionMode(static_cast<CIopBios::IO_COMPLETION_MODE>(completionMode));
+	iopOs->SetCdvdReadSpeed(std::max(CAppConfig::GetInstance().GetPreferenceInteger(PREF_PS2_CDVD_READSPEED), 1));
+}
+
+void CPS2VM::LoadPerfCountersSettings()
+{
+	m_perfCounters.SetEnabled(CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_PERFCOUNTERS_ENABLED));
+}
+
+void CPS2VM::LoadLockstepSettings()
+{
+	m_lockstepEnabled = CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_LOCKSTEP_ENABLED);
+	UpdateLockstep();
+}
+
+void CPS2VM::UpdateLockstep()
+{
+	//Movies always run in lockstep
+	bool lockstepEnabled = m_lockstepEnabled || (m_movieStatus.mode != MOVIE_MODE_NONE);
+	if(m_ee->m_gs != nullptr)
+	{
+		m_ee->m_gs->SetLockstepEnabled(lockstepEnabled);
+	}
+	if(m_audioStream)
+	{
+		//Time stretching follows how fast the host runs emulation
+		m_audioStream->SetTimeStretchEnabled(!lockstepEnabled && CAppConfig::GetInstance().GetPreferenceBoolean(PREF_AUDIO_TIMESTRETCH));
+	}
+}
+
+void CPS2VM::LoadRewindSettings()
+{
+	m_rewindEnabled = CAppConfig::GetInstance().GetPreferenceBoolean(PREF_PS2_REWIND_ENABLED);
+	m_rewindInterval = std::max(CAppConfig::GetInstance().GetPreferenceInteger(PREF_PS2_REWIND_INTERVAL), 1);
+	m_rewindFrameCounter = 0;
+	size_t memoryBudget = CAppConfig::GetInstance().GetPreferenceInteger(PREF_PS2_REWIND_MEMORYBUDGET);
+	m_rewindBuffer.SetMemoryBudget(memoryBudget * 1024 * 1024);
+	if(!m_rewindEnabled)
+	{
+		m_rewindBuffer.Clear();
+	}
+}
+
+void CPS2VM::UpdateRewind()
+{
+	m_rewindFrameCounter++;
+	if(m_rewindFrameCounter < m_rewindInterval) return;
+	m_rewindFrameCounter = 0;
+
+	try
+	{
+		if(auto snapshot = TakeVMSnapshot())
+		{
+			m_rewindBuffer.Push(snapshot);
+		}
+	}
+	catch(...)
+	{
+		m_rewindBuffer.Clear();
+	}
+}
+
+void CPS2VM::UpdatePads()
+{
+	if((m_movieStatus.mode == MOVIE_MODE_PLAYBACK) && (m_movieStatus.frameIndex == m_movie.GetFrames().size()))
+	{
+		//Movie is over, give control back to the pad handler
+		StopMovie();
+	}
+
+	switch(m_movieStatus.mode)
+	{
+	case MOVIE_MODE_NONE:
+		if(m_pad != NULL)
+		{
+			m_pad->Update(m_ee->m_ram);
+		}
+		break;
+	case MOVIE_MODE_RECORD:
+	{
+		m_movieRecorder.BeginFrame();
+		if(m_pad != NULL)
+		{
+			m_pad->Update(m_ee->m_ram);
+		}
+		auto frame = m_movieRecorder.GetFrame();
+		frame.ramHash = CInputMovie::HashMemory(m_ee->m_ram, PS2::EE_RAM_SIZE);
+		m_movie.AddFrame(frame);
+		MovieFrameDone(m_movieStatus.frameIndex, frame.ramHash);
+		m_movieStatus.frameIndex++;
+		m_movieStatus.frameCount++;
+		UpdateMovieClock();
+	}
+	break;
+	case MOVIE_MODE_PLAYBACK:
+	{
+		const auto& frame = m_movie.GetFrames()[m_movieStatus.frameIndex];
+		m_moviePlayer.SetFrame(frame);
+		m_moviePlayer.Update(m_ee->m_ram);
+		uint32 ramHash = CInputMovie::HashMemory(m_ee->m_ram, PS2::EE_RAM_SIZE);
+		if((ramHash != frame.ramHash) && (m_movieStatus.desyncFrameIndex == MOVIE_FRAME_INDEX_NONE))
+		{
+			CLog::GetInstance().Warn(LOG_NAME, "Movie playback desynced at frame %u.\r\n", m_movieStatus.frameIndex);
+			m_movieStatus.desyncFrameIndex = m_movieStatus.frameIndex;
+		}
+		MovieFrameDone(m_movieStatus.frameIndex, ramHash);
+		m_movieStatus.frameIndex++;
+		UpdateMovieClock();
+	}
+	break;
+	}
+}
+
+void CPS2VM::UpdateMovieClock()
+{
+	static const uint32 framesPerSecond = 60;
+	auto iopOs = dynamic_cast<CIopBios*>(m_iop->m_bios.get());
+	assert(iopOs);
+	if(m_movieStatus.mode == MOVIE_MODE_NONE)
+	{
+		iopOs->GetCdvdman()->SetClockOverride(false);
+	}
+	else
+	{
+		auto clockTime = m_movie.GetClockTime() + (m_movieStatus.frameIndex / framesPerSecond);
+		iopOs->GetCdvdman()->SetClockOverride(true, static_cast<time_t>(clockTime));
+	}
+}
+
+void CPS2VM::StopMovie()
+{
+	bool wasRecording = (m_movieStatus.mode == MOVIE_MODE_RECORD);
+	m_movieStatus = MOVIE_STATUS();
+	m_movie.Reset();
+	UpdateMovieClock();
+	UpdateLockstep();
+	if(wasRecording)
+	{
+		RegisterModulesInPadHandler();
+	}
+}
+
+CMemorySnapshot::RegionArray CPS2VM::GetSnapshotMemoryRegions() const
+{
+	CMemorySnapshot::RegionArray regions;
+	m_ee->GetStateMemoryRegions(regions);
+	m_iop->GetStateMemoryRegions(regions);
+	m_ee->m_gs->GetStateMemoryRegions(regions);
+	return regions;
+}
+
 void CPS2VM::PauseImpl()
 {
 	m_nStatus = PAUSED;
@@ -510,6 +1222,7 @@ void CPS2VM::CreateGsHandlerImpl(const CGSHandler::FactoryFunction& factoryFunct
 	m_ee->m_gs = factoryFunction();
 	m_ee->m_gs->SetIntc(&m_ee->m_intc);
 	m_ee->m_gs->Initialize();
+	UpdateLockstep();
 	m_OnNewFrameConnection = m_ee->m_gs->OnNewFrame.Connect(std::bind(&CPS2VM::OnGsNewFrame, this));
 }
 
@@ -536,14 +1249,15 @@ void CPS2VM::DestroyPadHandlerImpl()
 
 void CPS2VM::CreateSoundHandlerImpl(const CSoundHandler::FactoryFunction& factoryFunction)
 {
-	m_soundHandler = factoryFunction();
+	//Each SPU block is 1ms long, block count is used as the output latency
+	m_audioStream = std::make_unique<CAudioStream>(factoryFunction());
+	m_audioStream->SetTargetLatency(m_spuBlockCount);
+	UpdateLockstep();
 }
 
 void CPS2VM::DestroySoundHandlerImpl()
 {
-	if(m_soundHandler == nullptr) return;
-	delete m_soundHandler;
-	m_soundHandler = nullptr;
+	m_audioStream.reset();
 }
 
 void CPS2VM::OnGsNewFrame()
@@ -569,6 +1283,27 @@ void CPS2VM::OnGsNewFrame()
 #endif
 }
 
+void CPS2VM::UpdatePerfCounters()
+{
+	if(!m_perfCounters.IsEnabled()) return;
+
+	uint32 activeVoices = 0;
+	for(auto spuCore : {&m_iop->m_spuCore0, &m_iop->m_spuCore1})
+	{
+		for(unsigned int i = 0; i < Iop::CSpuBase::MAX_CHANNEL; i++)
+		{
+			if(spuCore->GetChannel(i).status != Iop::CSpuBase::STOPPED)
+			{
+				activeVoices++;
+			}
+		}
+	}
+	m_perfCounters.Set(CPerfCounters::COUNTER_SPU_ACTIVE_VOICES, activeVoices);
+
+	auto values = m_perfCounters.EndFrame();
+	PerfCountersFrameDone(values);
+}
+
 void CPS2VM::UpdateEe()
 {
 #ifdef PROFILE
@@ -611,7 +1346,9 @@ void CPS2VM::UpdateIop()
 
 	while(m_iopExecutionTicks > 0)
 	{
-		int executed = m_iop->ExecuteCpu(m_singleStepIop ? 1 : m_iopExecutionTicks);
+		m_iopExecutionQuota = m_singleStepIop ? 1 : m_iopExecutionTicks;
+		int executed = m_iop->ExecuteCpu(m_iopExecutionQuota);
+		m_iopExecutionQuota = 0;
 		if(m_iop->IsCpuIdle())
 		{
 #ifdef PROFILE
@@ -625,6 +1362,18 @@ void CPS2VM::UpdateIop()
 
 		m_iopExecutionTicks -= executed;
 		m_spuUpdateTicks -= executed;
+
+		//Catch up SPU when a voice is expected to hit the IRQ address, before interrupt lines are updated
+		if(m_spuIrqEventDirty)
+		{
+			UpdateSpuIrqEvent();
+		}
+		if(m_spuUpdateTicks <= m_spuIrqEventTicks)
+		{
+			SyncSpu();
+			UpdateSpuIrqEvent();
+		}
+
 		m_iop->CountTicks(executed);
 
 #ifdef DEBUGGER_INCLUDED
@@ -636,21 +1385,57 @@ void CPS2VM::UpdateIop()
 
 void CPS2VM::UpdateSpu()
 {
+	//Render what's left of the block (parts might have been rendered by SyncSpu)
+	RenderSpu(m_spuRenderedFrameCount, SAMPLE_COUNT - m_spuRenderedFrameCount);
+	m_spuRenderedFrameCount = 0;
+	m_spuIrqEventDirty = true;
+
+	//Output thread takes care of buffering and pacing
+	if(m_audioStream)
+	{
+		m_audioStream->Write(m_samples, SAMPLE_COUNT);
+	}
+}
+
+void CPS2VM::SyncSpu()
+{
+	//Render the current block up to the current IOP time. Might be called
+	//while the IOP is executing, account for the part of the quota already used.
+	int elapsedTicks = SPU_UPDATE_TICKS - m_spuUpdateTicks;
+	if(m_iopExecutionQuota != 0)
+	{
+		elapsedTicks += m_iopExecutionQuota - m_iop->m_cpu.m_State.cycleQuota;
+	}
+	int frameCount = static_cast<int>((static_cast<int64>(std::max(elapsedTicks, 0)) * SAMPLE_COUNT) / SPU_UPDATE_TICKS);
+	frameCount = std::min<int>(frameCount, SAMPLE_COUNT);
+	if(frameCount > static_cast<int>(m_spuRenderedFrameCount))
+	{
+		RenderSpu(m_spuRenderedFrameCount, frameCount - m_spuRenderedFrameCount);
+		m_spuRenderedFrameCount = frameCount;
+	}
+	//Registers are about to be changed, prediction needs to be done again
+	m_spuIrqEventDirty = true;
+}
+
+void CPS2VM::RenderSpu(unsigned int frameOffset, unsigned int frameCount)
+{
+	if(frameCount == 0) return;
+
 #ifdef PROFILE
 	CProfilerZone profilerZone(m_spuProfilerZone);
 #endif
 
-	unsigned int blockOffset = (BLOCK_SIZE * m_currentSpuBlock);
-	int16* samplesSpu0 = m_samples + blockOffset;
+	unsigned int sampleCount = frameCount * 2;
+	int16* samplesSpu0 = m_samples + (frameOffset * 2);
 
-	m_iop->m_spuCore0.Render(samplesSpu0, BLOCK_SIZE, DST_SAMPLE_RATE);
+	m_iop->m_spuCore0.Render(samplesSpu0, sampleCount, DST_SAMPLE_RATE);
 
 	if(m_iop->m_spuCore1.IsEnabled())
 	{
 		int16 samplesSpu1[BLOCK_SIZE];
-		m_iop->m_spuCore1.Render(samplesSpu1, BLOCK_SIZE, DST_SAMPLE_RATE);
+		m_iop->m_spuCore1.Render(samplesSpu1, sampleCount, DST_SAMPLE_RATE);
 
-		for(unsigned int i = 0; i < BLOCK_SIZE; i++)
+		for(unsigned int i = 0; i < sampleCount; i++)
 		{
 			int32 resultSample = static_cast<int32>(samplesSpu0[i]) + static_cast<int32>(samplesSpu1[i]);
 			resultSample = std::max<int32>(resultSample, SHRT_MIN);
@@ -658,20 +1443,50 @@ void CPS2VM::UpdateSpu()
 			samplesSpu0[i] = static_cast<int16>(resultSample);
 		}
 	}
+}
+
+void CPS2VM::SaveSpuState(Framework::CZipArchiveWriter& archive)
+{
+	//Current block might have been partially rendered by SyncSpu
+	auto registerFile = new CRegisterStateFile(STATE_SPU);
+	registerFile->SetRegister32(STATE_SPU_UPDATE_TICKS, m_spuUpdateTicks);
+	registerFile->SetRegister32(STATE_SPU_RENDERED_FRAME_COUNT, m_spuRenderedFrameCount);
+	archive.InsertFile(registerFile);
+	archive.InsertFile(new CMemoryStateFile(STATE_SPU_SAMPLES, m_samples, sizeof(m_samples)));
+}
 
-	m_currentSpuBlock++;
-	if(m_currentSpuBlock == m_spuBlockCount)
+void CPS2VM::LoadSpuState(Framework::CZipArchiveReader& archive)
+{
+	m_spuIrqEventDirty = true;
+	if(archive.GetFileHeader(STATE_SPU) == nullptr)
 	{
-		if(m_soundHandler)
-		{
-			if(m_soundHandler->HasFreeBuffers())
-			{
-				m_soundHandler->RecycleBuffers();
-			}
-			m_soundHandler->Write(m_samples, BLOCK_SIZE * m_spuBlockCount, DST_SAMPLE_RATE);
-		}
-		m_currentSpuBlock = 0;
+		//Older states don't have this, start from the beginning of a block
+		m_spuUpdateTicks = SPU_UPDATE_TICKS;
+		m_spuRenderedFrameCount = 0;
+		return;
 	}
+	CRegisterStateFile registerFile(*archive.BeginReadFile(STATE_SPU));
+	m_spuUpdateTicks = static_cast<int>(registerFile.GetRegister32(STATE_SPU_UPDATE_TICKS));
+	m_spuRenderedFrameCount = std::min<uint32>(registerFile.GetRegister32(STATE_SPU_RENDERED_FRAME_COUNT), SAMPLE_COUNT);
+	archive.BeginReadFile(STATE_SPU_SAMPLES)->Read(m_samples, sizeof(m_samples));
+}
+
+void CPS2VM::UpdateSpuIrqEvent()
+{
+	m_spuIrqEventDirty = false;
+	m_spuIrqEventTicks = INT_MIN;
+
+	//Only look ahead until the end of the current block, it will be rendered anyway at that point
+	uint32 remainingFrameCount = SAMPLE_COUNT - m_spuRenderedFrameCount;
+	uint32 irqFrameCount = std::min(
+	    m_iop->m_spuCore0.GetNextIrqSampleCount(DST_SAMPLE_RATE, remainingFrameCount),
+	    m_iop->m_spuCore1.GetNextIrqSampleCount(DST_SAMPLE_RATE, remainingFrameCount));
+	if(irqFrameCount > remainingFrameCount) return;
+
+	//SyncSpu needs to be called once enough ticks have elapsed for this frame to be rendered
+	uint32 irqFrame = m_spuRenderedFrameCount + std::max<uint32>(irqFrameCount, 1);
+	int irqTicks = static_cast<int>(((static_cast<int64>(irqFrame) * SPU_UPDATE_TICKS) + SAMPLE_COUNT - 1) / SAMPLE_COUNT);
+	m_spuIrqEventTicks = SPU_UPDATE_TICKS - irqTicks;
 }
 
 void CPS2VM::CDROM0_SyncPath()
@@ -713,14 +1528,22 @@ void CPS2VM::SetIopOpticalMedia(COpticalMedia* opticalMedia)
 
 void CPS2VM::RegisterModulesInPadHandler()
 {
-	if(m_pad == nullptr) return;
-
 	auto iopOs = dynamic_cast<CIopBios*>(m_iop->m_bios.get());
 	assert(iopOs);
 
+	m_moviePlayer.RemoveAllListeners();
+	m_moviePlayer.InsertListener(iopOs->GetPadman());
+	m_moviePlayer.InsertListener(&m_iop->m_sio2);
+
+	if(m_pad == nullptr) return;
+
 	m_pad->RemoveAllListeners();
 	m_pad->InsertListener(iopOs->GetPadman());
 	m_pad->InsertListener(&m_iop->m_sio2);
+	if(m_movieStatus.mode == MOVIE_MODE_RECORD)
+	{
+		m_pad->InsertListener(&m_movieRecorder);
+	}
 }
 
 void CPS2VM::ReloadExecutable(const char* executablePath, const CPS2OS::ArgumentList& arguments)
@@ -732,7 +1555,8 @@ void CPS2VM::ReloadExecutable(const char* executablePath, const CPS2OS::Argument
 void CPS2VM::EmuThread()
 {
 	fesetround(FE_TOWARDZERO);
-	CProfiler::GetInstance().SetWorkThread();
+	CProfiler::GetInstance().SetThreadName("EE");
+	CPerfCounters::SetCurrent(&m_perfCounters);
 #ifdef PROFILE
 	CProfilerZone profilerZone(m_otherProfilerZone);
 #endif
@@ -776,16 +1600,21 @@ void CPS2VM::EmuThread()
 							m_ee->m_gs->SetVBlank();
 						}
 
-						if(m_pad != NULL)
+						UpdatePads();
+
+						if(m_rewindEnabled)
 						{
-							m_pad->Update(m_ee->m_ram);
+							UpdateRewind();
 						}
+
+						UpdatePerfCounters();
 #ifdef PROFILE
 						{
 							CProfiler::GetInstance().CountCurrentZone();
 							auto stats = CProfiler::GetInstance().GetStats();
 							ProfileFrameDone(stats);
 							CProfiler::GetInstance().Reset();
+							CProfiler::GetInstance().CollectEvents();
 						}
 
 						m_cpuUtilisation = CPU_UTILISATION_INFO();
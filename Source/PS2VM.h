@@ -2,6 +2,7 @@
 
 #include <thread>
 #include <future>
+#include <climits>
 #include "filesystem_def.h"
 #include "AppDef.h"
 #include "Types.h"
@@ -13,8 +14,14 @@
 #include "ee/Ee_SubSystem.h"
 #include "iop/Iop_SubSystem.h"
 #include "../tools/PsfPlayer/Source/SoundHandler.h"
+#include "AudioStream.h"
 #include "FrameDump.h"
+#include "states/StateSnapshot.h"
+#include "states/StateArchiveWriter.h"
+#include "states/RewindBuffer.h"
+#include "InputMovie.h"
 #include "Profiler.h"
+#include "PerfCounters.h"
 
 class CPS2VM : public CVirtualMachine
 {
@@ -28,10 +35,32 @@ public:
 		int32 iopIdleTicks = 0;
 	};
 
+	enum MOVIE_MODE
+	{
+		MOVIE_MODE_NONE,
+		MOVIE_MODE_RECORD,
+		MOVIE_MODE_PLAYBACK,
+	};
+
+	enum : uint32
+	{
+		MOVIE_FRAME_INDEX_NONE = ~0U,
+	};
+
+	struct MOVIE_STATUS
+	{
+		MOVIE_MODE mode = MOVIE_MODE_NONE;
+		uint32 frameIndex = 0;
+		uint32 frameCount = 0;
+		uint32 desyncFrameIndex = MOVIE_FRAME_INDEX_NONE;
+	};
+
 	typedef std::unique_ptr<Ee::CSubSystem> EeSubSystemPtr;
 	typedef std::unique_ptr<Iop::CSubSystem> IopSubSystemPtr;
 	typedef std::function<void(const CFrameDump&)> FrameDumpCallback;
 	typedef Framework::CSignal<void(const CProfiler::ZoneArray&)> ProfileFrameDoneSignal;
+	typedef Framework::CSignal<void(const CPerfCounters::CounterArray&)> PerfCountersFrameDoneSignal;
+	typedef Framework::CSignal<void(uint32, uint32)> MovieFrameDoneSignal;
 
 	CPS2VM();
 	virtual ~CPS2VM() = default;
@@ -71,6 +100,41 @@ public:
 	std::future<bool> SaveState(const fs::path&);
 	std::future<bool> LoadState(const fs::path&);
 
+	std::future<StateSnapshotPtr> TakeSnapshot();
+	std::future<bool> RestoreSnapshot(const StateSnapshotPtr&);
+
+	void ReloadRewindSettings();
+	std::future<bool> Rewind();
+
+	void ReloadCdvdSettings();
+
+	//Must be called after memory card directories were modified from outside the VM (ie.: save import)
+	void NotifyMemoryCardsChanged();
+
+	//Counters are reported through PerfCountersFrameDone at every vblank while enabled
+	void ReloadPerfCountersSettings();
+	CPerfCounters& GetPerfCounters();
+
+	//In lockstep mode, the emulator thread waits for the GS thread at every call it makes
+	//and audio output isn't time stretched. Emulation then only depends on emulated time:
+	//SPU rendering and pad updates already are driven by IOP ticks and vblanks.
+	void ReloadLockstepSettings();
+
+	//While a movie is active, pad input and the CDVD clock are driven by the movie,
+	//emulation runs in lockstep mode and EE RAM is hashed every frame. Movies embed the
+	//machine state they were recorded from, which is loaded when playback starts. Hashes
+	//are reported through MovieFrameDone and compared with the recorded ones during playback.
+	//Resetting the VM stops the active movie.
+	std::future<bool> StartMovieRecording();
+	std::future<bool> StopMovieRecording(const fs::path&);
+	std::future<bool> StartMoviePlayback(const fs::path&);
+	void StopMoviePlayback();
+	MOVIE_STATUS GetMovieStatus();
+
+	//Requires blocks to be compiled with PREF_PS2_BLOCKPROFILER_ENABLED set (applied on reset)
+	std::future<bool> SaveBlockProfile(const fs::path&);
+	void ResetBlockProfile();
+
 	void TriggerFrameDump(const FrameDumpCallback&);
 
 	CPU_UTILISATION_INFO GetCpuUtilisationInfo() const;
@@ -87,6 +151,9 @@ public:
 	IopSubSystemPtr m_iop;
 
 	ProfileFrameDoneSignal ProfileFrameDone;
+	PerfCountersFrameDoneSignal PerfCountersFrameDone;
+	//Raised at every vblank while a movie is active, with the frame index and EE RAM hash
+	MovieFrameDoneSignal MovieFrameDone;
 
 private:
 	typedef std::unique_ptr<COpticalMedia> OpticalMediaPtr;
@@ -94,8 +161,29 @@ private:
 	void CreateVM();
 	void ResetVM();
 	void DestroyVM();
-	bool SaveVMState(const fs::path&);
+	void SaveVMState(const fs::path&, const std::shared_ptr<std::promise<bool>>&);
+	static bool WriteVMState(const fs::path&, const StateSnapshotPtr&, const CMemorySnapshot::RegionArray&, int);
+	static void WriteVMStateArchive(Framework::CStream&, const StateSnapshotPtr&, const CMemorySnapshot::RegionArray&, int);
+	static bool WriteVMFastState(const fs::path&, const StateSnapshotPtr&, const CMemorySnapshot::RegionArray&);
+	static CStateArchiveWriter::ChunkArray GetSnapshotRegionChunks(const StateSnapshotPtr&, const CMemorySnapshot::RegionArray&, uint32);
+	void WaitForStateWriter();
 	bool LoadVMState(const fs::path&);
+	void LoadVMStateArchive(Framework::CStream&);
+	bool LoadVMFastState(const fs::path&);
+	StateSnapshotPtr TakeVMSnapshot();
+	bool RestoreVMSnapshot(const StateSnapshotPtr&);
+	CMemorySnapshot::RegionArray GetSnapshotMemoryRegions() const;
+	void LoadRewindSettings();
+	void UpdateRewind();
+
+	void LoadCdvdSettings();
+	void LoadPerfCountersSettings();
+	void LoadLockstepSettings();
+	void UpdateLockstep();
+
+	void UpdatePads();
+	void UpdateMovieClock();
+	void StopMovie();
 
 	void ReloadExecutable(const char*, const CPS2OS::ArgumentList&);
 
@@ -115,8 +203,14 @@ private:
 	void UpdateEe();
 	void UpdateIop();
 	void UpdateSpu();
+	void SyncSpu();
+	void RenderSpu(unsigned int, unsigned int);
+	void UpdateSpuIrqEvent();
+	void SaveSpuState(Framework::CZipArchiveWriter&);
+	void LoadSpuState(Framework::CZipArchiveReader&);
 
 	void OnGsNewFrame();
+	void UpdatePerfCounters();
 
 	void CDROM0_SyncPath();
 	void CDROM0_Reset();
@@ -136,8 +230,16 @@ private:
 	int m_spuUpdateTicks = 0;
 	int m_eeExecutionTicks = 0;
 	int m_iopExecutionTicks = 0;
+	int m_iopExecutionQuota = 0;
+
+	//SPU catch-up state: frames of the current block already rendered and
+	//value of m_spuUpdateTicks at which the next SPU IRQ is expected
+	unsigned int m_spuRenderedFrameCount = 0;
+	int m_spuIrqEventTicks = INT_MIN;
+	bool m_spuIrqEventDirty = true;
 
 	CPU_UTILISATION_INFO m_cpuUtilisation;
+	CPerfCounters m_perfCounters;
 
 	bool m_singleStepEe;
 	bool m_singleStepIop;
@@ -151,6 +253,24 @@ private:
 
 	OpticalMediaPtr m_cdrom0;
 
+	//Last snapshot taken or restored, used as a base for the next one
+	std::weak_ptr<const CStateSnapshot> m_lastSnapshot;
+
+	//Compression and writing of save states happens in the background
+	std::future<void> m_stateWriterFuture;
+
+	CRewindBuffer m_rewindBuffer;
+	bool m_rewindEnabled = false;
+	uint32 m_rewindInterval = 0;
+	uint32 m_rewindFrameCounter = 0;
+
+	CInputMovie m_movie;
+	CInputMovieRecorder m_movieRecorder;
+	CInputMoviePlayer m_moviePlayer;
+	MOVIE_STATUS m_movieStatus;
+
+	bool m_lockstepEnabled = false;
+
 	//SPU update parameters
 	enum
 	{
@@ -159,13 +279,11 @@ private:
 		SPU_UPDATE_TICKS = PS2::IOP_CLOCK_OVER_FREQ / UPDATE_RATE,
 		SAMPLE_COUNT = DST_SAMPLE_RATE / UPDATE_RATE,
 		BLOCK_SIZE = SAMPLE_COUNT * 2,
-		BLOCK_COUNT = 400,
 	};
 
-	int16 m_samples[BLOCK_SIZE * BLOCK_COUNT];
-	int m_currentSpuBlock = 0;
+	int16 m_samples[BLOCK_SIZE];
 	int m_spuBlockCount;
-	CSoundHandler* m_soundHandler = nullptr;
+	std::unique_ptr<CAudioStream> m_audioStream;
 
 	CProfiler::ZoneHandle m_eeProfilerZone = 0;
 	CProfiler::ZoneHandle m_iopProfilerZone = 0;
@@ -6,4 +6,24 @@
 #define PREF_PS2_MC0_DIRECTORY ("ps2.mc0.directory.v2")
 #define PREF_PS2_MC1_DIRECTORY ("ps2.mc1.directory.v2")
 
+//0 = complete on vblank, 1 = drive speed, 2 = instant (see CIopBios::IO_COMPLETION_MODE)
+#define PREF_PS2_CDVD_COMPLETIONMODE ("ps2.cdvd.completionmode")
+#define PREF_PS2_CDVD_READSPEED ("ps2.cdvd.readspeed")
+
 #define PREF_AUDIO_SPUBLOCKCOUNT ("audio.spublockcount")
+#define PREF_AUDIO_TIMESTRETCH ("audio.timestretch")
+
+#define PREF_PS2_STATE_COMPRESSIONLEVEL ("ps2.state.compressionlevel")
+#define PREF_PS2_STATE_FASTFORMAT ("ps2.state.fastformat")
+#define PREF_PS2_STATE_KEEPCOMPILEDBLOCKS ("ps2.state.keepcompiledblocks")
+
+#define PREF_PS2_REWIND_ENABLED ("ps2.rewind.enabled")
+#define PREF_PS2_REWIND_INTERVAL ("ps2.rewind.interval")
+#define PREF_PS2_REWIND_MEMORYBUDGET ("ps2.rewind.memorybudget")
+
+#define PREF_PS2_BLOCKPROFILER_ENABLED ("ps2.blockprofiler.enabled")
+#define PREF_PS2_BLOCKPROFILER_PERFMAP ("ps2.blockprofiler.perfmap")
+
+#define PREF_PS2_PERFCOUNTERS_ENABLED ("ps2.perfcounters.enabled")
+
+#define PREF_PS2_LOCKSTEP_ENABLED ("ps2.lockstep.enabled")
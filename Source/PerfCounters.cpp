@@ -0,0 +1,82 @@
+#include <cassert>
+#include "PerfCounters.h"
+
+static const char* g_counterNames[CPerfCounters::COUNTER_MAX] =
+    {
+        "ee.blocks_compiled",
+        "ee.compile_time",
+        "ee.code_invalidations",
+        "ee.protection_faults",
+        "gs.packets",
+        "gs.register_writes",
+        "gs.transfer_bytes",
+        "vif.unpack_qwords",
+        "dma.ch0.bytes",
+        "dma.ch1.bytes",
+        "dma.ch2.bytes",
+        "dma.ch3.bytes",
+        "dma.ch4.bytes",
+        "dma.ch5.bytes",
+        "dma.ch6.bytes",
+        "dma.ch7.bytes",
+        "dma.ch8.bytes",
+        "dma.ch9.bytes",
+        "ipu.macroblocks",
+        "spu.active_voices",
+        "mailbox.wait_time",
+};
+
+thread_local CPerfCounters* CPerfCounters::m_current = nullptr;
+CPerfCounters CPerfCounters::m_disabled;
+
+CPerfCounters::CPerfCounters()
+    : m_enabled(false)
+{
+	for(auto& counter : m_counters)
+	{
+		counter = 0;
+	}
+	m_lastFrameValues.fill(0);
+}
+
+const char* CPerfCounters::GetCounterName(COUNTER counter)
+{
+	assert(counter < COUNTER_MAX);
+	return g_counterNames[counter];
+}
+
+void CPerfCounters::SetCurrent(CPerfCounters* counters)
+{
+	m_current = counters;
+}
+
+void CPerfCounters::SetEnabled(bool enabled)
+{
+	m_enabled = enabled;
+}
+
+CPerfCounters::CounterArray CPerfCounters::EndFrame()
+{
+	CounterArray values;
+	for(unsigned int i = 0; i < COUNTER_MAX; i++)
+	{
+		values[i] = m_counters[i].exchange(0, std::memory_order_relaxed);
+	}
+
+	std::lock_guard<std::mutex> lastFrameLock(m_lastFrameMutex);
+	m_lastFrameValues = values;
+	m_frameCount++;
+	return values;
+}
+
+CPerfCounters::CounterArray CPerfCounters::GetLastFrameValues() const
+{
+	std::lock_guard<std::mutex> lastFrameLock(m_lastFrameMutex);
+	return m_lastFrameValues;
+}
+
+uint64 CPerfCounters::GetFrameCount() const
+{
+	std::lock_guard<std::mutex> lastFrameLock(m_lastFrameMutex);
+	return m_frameCount;
+}
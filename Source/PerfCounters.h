@@ -0,0 +1,124 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include "Types.h"
+
+//Counters accumulated over a frame. Unlike profiler zones, counters are always compiled in
+//and only cost a relaxed atomic load when they are disabled.
+//Every VM owns its counters and binds them to its emulation thread, modules update the
+//counters bound to the thread they run on (see GetCurrent).
+class CPerfCounters
+{
+public:
+	enum COUNTER
+	{
+		COUNTER_EE_BLOCKS_COMPILED,
+		COUNTER_EE_COMPILE_TIME,
+		COUNTER_EE_CODE_INVALIDATIONS,
+		COUNTER_EE_PROTECTION_FAULTS,
+		COUNTER_GS_PACKETS,
+		COUNTER_GS_REGISTER_WRITES,
+		COUNTER_GS_TRANSFER_BYTES,
+		COUNTER_VIF_UNPACK_QWORDS,
+		COUNTER_DMA_BYTES_CH0,
+		COUNTER_DMA_BYTES_CH1,
+		COUNTER_DMA_BYTES_CH2,
+		COUNTER_DMA_BYTES_CH3,
+		COUNTER_DMA_BYTES_CH4,
+		COUNTER_DMA_BYTES_CH5,
+		COUNTER_DMA_BYTES_CH6,
+		COUNTER_DMA_BYTES_CH7,
+		COUNTER_DMA_BYTES_CH8,
+		COUNTER_DMA_BYTES_CH9,
+		COUNTER_IPU_MACROBLOCKS,
+		COUNTER_SPU_ACTIVE_VOICES,
+		COUNTER_MAILBOX_WAIT_TIME,
+		COUNTER_MAX,
+	};
+
+	//Times are in nanoseconds
+	typedef std::array<uint64, COUNTER_MAX> CounterArray;
+
+	CPerfCounters();
+	CPerfCounters(const CPerfCounters&) = delete;
+	virtual ~CPerfCounters() = default;
+
+	CPerfCounters& operator=(const CPerfCounters&) = delete;
+
+	static const char* GetCounterName(COUNTER);
+
+	//Returns the counters bound to the calling thread, or a set that is always disabled
+	static CPerfCounters& GetCurrent()
+	{
+		return m_current ? *m_current : m_disabled;
+	}
+	static void SetCurrent(CPerfCounters*);
+
+	void SetEnabled(bool);
+	bool IsEnabled() const
+	{
+		return m_enabled.load(std::memory_order_relaxed);
+	}
+
+	void Add(COUNTER counter, uint64 value)
+	{
+		if(!IsEnabled()) return;
+		m_counters[counter].fetch_add(value, std::memory_order_relaxed);
+	}
+
+	void Set(COUNTER counter, uint64 value)
+	{
+		if(!IsEnabled()) return;
+		m_counters[counter].store(value, std::memory_order_relaxed);
+	}
+
+	//Latches current values as the last frame's values and starts a new frame
+	CounterArray EndFrame();
+	CounterArray GetLastFrameValues() const;
+	uint64 GetFrameCount() const;
+
+private:
+	static thread_local CPerfCounters* m_current;
+	static CPerfCounters m_disabled;
+
+	std::atomic<bool> m_enabled;
+	std::array<std::atomic<uint64>, COUNTER_MAX> m_counters;
+
+	mutable std::mutex m_lastFrameMutex;
+	CounterArray m_lastFrameValues;
+	uint64 m_frameCount = 0;
+};
+
+//Adds the time spent in its scope to a counter
+class CPerfCounterTimer
+{
+public:
+	CPerfCounterTimer(CPerfCounters::COUNTER counter)
+	    : m_counter(counter)
+	    , m_counters(CPerfCounters::GetCurrent())
+	    , m_enabled(m_counters.IsEnabled())
+	{
+		if(m_enabled)
+		{
+			m_startTime = std::chrono::steady_clock::now();
+		}
+	}
+
+	~CPerfCounterTimer()
+	{
+		if(m_enabled)
+		{
+			auto elapsed = std::chrono::steady_clock::now() - m_startTime;
+			m_counters.Add(m_counter, std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count());
+		}
+	}
+
+private:
+	CPerfCounters::COUNTER m_counter;
+	CPerfCounters& m_counters;
+	bool m_enabled = false;
+	std::chrono::steady_clock::time_point m_startTime;
+};
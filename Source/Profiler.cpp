@@ -1,8 +1,41 @@
 #include "Profiler.h"
 
 #include <cassert>
+#include <cstring>
+#include <algorithm>
+#include "make_unique.h"
+#include "string_format.h"
+
+static std::string EscapeJsonString(const std::string& input)
+{
+	std::string result;
+	result.reserve(input.size());
+	for(auto character : input)
+	{
+		if((character == '"') || (character == '\\'))
+		{
+			result += '\\';
+		}
+		result += character;
+	}
+	return result;
+}
+
+CProfiler::THREAD_STATE::THREAD_STATE(uint32 id)
+    : id(id)
+    , eventWriteIndex(0)
+    , eventReadIndex(0)
+    , droppedEventCount(0)
+{
+	for(auto& zoneTime : zoneTimes)
+	{
+		zoneTime = 0;
+	}
+}
 
 CProfiler::CProfiler()
+    : m_traceCaptureEnabled(false)
+    , m_startTime(std::chrono::high_resolution_clock::now())
 {
 }
 
@@ -13,88 +46,340 @@ CProfiler::~CProfiler()
 CProfiler::ZoneHandle CProfiler::RegisterZone(const char* name)
 {
 #ifdef PROFILE
-	for(unsigned int i = 0; i < m_zones.size(); i++)
+	std::lock_guard<std::mutex> zonesLock(m_zonesMutex);
+	for(unsigned int i = 0; i < m_zoneNames.size(); i++)
+	{
+		if(m_zoneNames[i] == name) return i;
+	}
+	assert(m_zoneNames.size() < MAX_ZONES);
+	if(m_zoneNames.size() == MAX_ZONES)
 	{
-		const auto& zone(m_zones[i]);
-		if(zone.name == name) return i;
+		return MAX_ZONES - 1;
 	}
-	auto newZone = ZONE();
-	newZone.name = name;
-	newZone.totalTime = 0;
-	m_zones.push_back(newZone);
-	return static_cast<CProfiler::ZoneHandle>(m_zones.size() - 1);
+	m_zoneNames.push_back(name);
+	return static_cast<CProfiler::ZoneHandle>(m_zoneNames.size() - 1);
 #else
 	return 0;
 #endif
 }
 
+void CProfiler::SetThreadName(const char* name)
+{
+	auto& threadState = GetThreadState();
+	std::lock_guard<std::mutex> threadsLock(m_threadsMutex);
+	threadState.name = name;
+}
+
 void CProfiler::CountCurrentZone()
 {
-	assert(std::this_thread::get_id() == m_workThreadId);
-	assert(!m_zoneStack.empty());
+	auto& threadState = GetThreadState();
+	if(threadState.zoneStackSize == 0) return;
 
 	auto thisTime = std::chrono::high_resolution_clock::now();
 
 	{
-		auto topZoneHandle = m_zoneStack.top();
-		auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(thisTime - m_currentTime);
-		AddTimeToZone(topZoneHandle, duration.count());
+		auto topZoneHandle = threadState.zoneStack[threadState.zoneStackSize - 1];
+		auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(thisTime - threadState.currentTime);
+		AddTimeToZone(threadState, topZoneHandle, duration.count());
 	}
 
-	m_currentTime = thisTime;
+	threadState.currentTime = thisTime;
 }
 
 void CProfiler::EnterZone(ZoneHandle zoneHandle)
 {
-	assert(std::this_thread::get_id() == m_workThreadId);
+	assert(zoneHandle < MAX_ZONES);
 
+	auto& threadState = GetThreadState();
 	auto thisTime = std::chrono::high_resolution_clock::now();
 
-	if(!m_zoneStack.empty())
+	if(threadState.zoneStackSize != 0)
 	{
-		auto topZoneHandle = m_zoneStack.top();
-		auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(thisTime - m_currentTime);
-		AddTimeToZone(topZoneHandle, duration.count());
+		auto topZoneHandle = threadState.zoneStack[threadState.zoneStackSize - 1];
+		auto duration = std::chrono::duration_cast<std::chrono::nanoseconds>(thisTime - threadState.currentTime);
+		AddTimeToZone(threadState, topZoneHandle, duration.count());
 	}
 
-	m_zoneStack.push(zoneHandle);
+	assert(threadState.zoneStackSize < MAX_ZONE_DEPTH);
+	threadState.zoneStack[threadState.zoneStackSize++] = zoneHandle;
+	PushEvent(threadState, thisTime, zoneHandle, EVENT_ENTER);
 
-	m_currentTime = thisTime;
+	threadState.currentTime = thisTime;
 }
 
 void CProfiler::ExitZone()
 {
+	auto& threadState = GetThreadState();
+	assert(threadState.zoneStackSize != 0);
+
 	CountCurrentZone();
-	m_zoneStack.pop();
+	auto zoneHandle = threadState.zoneStack[--threadState.zoneStackSize];
+	PushEvent(threadState, threadState.currentTime, zoneHandle, EVENT_EXIT);
 }
 
 CProfiler::ZoneArray CProfiler::GetStats() const
 {
-	assert(std::this_thread::get_id() == m_workThreadId);
-	return m_zones;
+	std::vector<std::string> zoneNames;
+	{
+		std::lock_guard<std::mutex> zonesLock(m_zonesMutex);
+		zoneNames = m_zoneNames;
+	}
+
+	ZoneArray zones;
+	std::lock_guard<std::mutex> threadsLock(m_threadsMutex);
+	for(const auto& threadState : m_threads)
+	{
+		auto threadName = GetThreadName(*threadState);
+		for(unsigned int i = 0; i < zoneNames.size(); i++)
+		{
+			uint64 totalTime = threadState->zoneTimes[i].load(std::memory_order_relaxed);
+			if(totalTime == 0) continue;
+			ZONE zone;
+			zone.threadName = threadName;
+			zone.name = zoneNames[i];
+			zone.totalTime = totalTime;
+			zones.push_back(std::move(zone));
+		}
+	}
+	return zones;
 }
 
 void CProfiler::Reset()
 {
-	assert(std::this_thread::get_id() == m_workThreadId);
-	for(auto& zone : m_zones)
+	std::lock_guard<std::mutex> threadsLock(m_threadsMutex);
+	for(const auto& threadState : m_threads)
 	{
-		zone.totalTime = 0;
+		for(auto& zoneTime : threadState->zoneTimes)
+		{
+			zoneTime.store(0, std::memory_order_relaxed);
+		}
 	}
 }
 
-void CProfiler::SetWorkThread()
+void CProfiler::SetTraceCaptureEnabled(bool enabled)
 {
-#ifdef _DEBUG
-	m_workThreadId = std::this_thread::get_id();
-#endif
+	m_traceCaptureEnabled = enabled;
 }
 
-void CProfiler::AddTimeToZone(ZoneHandle zoneHandle, uint64 timeNs)
+bool CProfiler::IsTraceCaptureEnabled() const
 {
-	assert(m_zones.size() > zoneHandle);
-	auto& zone = m_zones[zoneHandle];
-	zone.totalTime += timeNs;
+	return m_traceCaptureEnabled;
+}
+
+uint32 CProfiler::GetDroppedEventCount() const
+{
+	uint32 droppedEventCount = 0;
+	std::lock_guard<std::mutex> threadsLock(m_threadsMutex);
+	for(const auto& threadState : m_threads)
+	{
+		droppedEventCount += threadState->droppedEventCount.load(std::memory_order_relaxed);
+	}
+	return droppedEventCount;
+}
+
+void CProfiler::CollectEvents()
+{
+	std::lock_guard<std::mutex> collectLock(m_collectMutex);
+
+	std::vector<THREAD_STATE*> threads;
+	{
+		std::lock_guard<std::mutex> threadsLock(m_threadsMutex);
+		for(const auto& threadState : m_threads)
+		{
+			threads.push_back(threadState.get());
+		}
+	}
+
+	for(auto threadState : threads)
+	{
+		CollectThreadEvents(*threadState);
+	}
+}
+
+void CProfiler::ClearCollectedEvents()
+{
+	std::lock_guard<std::mutex> collectLock(m_collectMutex);
+	std::lock_guard<std::mutex> threadsLock(m_threadsMutex);
+	m_threads.erase(
+	    std::remove_if(m_threads.begin(), m_threads.end(),
+	                   [](const ThreadStatePtr& threadState) { return threadState->exited; }),
+	    m_threads.end());
+	for(const auto& threadState : m_threads)
+	{
+		threadState->collectedEvents.clear();
+		threadState->collectedDepth = 0;
+	}
+}
+
+void CProfiler::WriteChromeTrace(Framework::CStream& stream)
+{
+	std::vector<std::string> zoneNames;
+	{
+		std::lock_guard<std::mutex> zonesLock(m_zonesMutex);
+		zoneNames = m_zoneNames;
+	}
+
+	std::lock_guard<std::mutex> collectLock(m_collectMutex);
+	std::lock_guard<std::mutex> threadsLock(m_threadsMutex);
+
+	bool firstEvent = true;
+	auto writeEvent =
+	    [&](const std::string& event) {
+		    std::string line = firstEvent ? "\n" : ",\n";
+		    line += event;
+		    stream.Write(line.c_str(), line.size());
+		    firstEvent = false;
+	    };
+
+	static const char* header = "{\"traceEvents\":[";
+	stream.Write(header, strlen(header));
+	for(const auto& threadState : m_threads)
+	{
+		auto threadName = GetThreadName(*threadState);
+		writeEvent(string_format("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":%d,\"args\":{\"name\":\"%s\"}}",
+		                         threadState->id, EscapeJsonString(threadName).c_str()));
+		for(const auto& event : threadState->collectedEvents)
+		{
+			auto zoneName = (event.zone < zoneNames.size()) ? EscapeJsonString(zoneNames[event.zone]) : std::string("?");
+			writeEvent(string_format("{\"name\":\"%s\",\"ph\":\"%s\",\"ts\":%0.3f,\"pid\":1,\"tid\":%d}",
+			                         zoneName.c_str(), (event.type == EVENT_ENTER) ? "B" : "E",
+			                         static_cast<double>(event.time) / 1000.0, threadState->id));
+		}
+	}
+	static const char* footer = "\n],\"displayTimeUnit\":\"ms\"}\n";
+	stream.Write(footer, strlen(footer));
+}
+
+CProfiler::THREAD_STATE_OWNER::~THREAD_STATE_OWNER()
+{
+	if(threadState)
+	{
+		CProfiler::GetInstance().ReleaseThreadState(threadState);
+	}
+}
+
+CProfiler::THREAD_STATE& CProfiler::GetThreadState()
+{
+	static thread_local THREAD_STATE_OWNER threadStateOwner;
+	if(!threadStateOwner.threadState)
+	{
+		std::lock_guard<std::mutex> threadsLock(m_threadsMutex);
+		auto newThreadState = std::make_unique<THREAD_STATE>(m_nextThreadId++);
+		threadStateOwner.threadState = newThreadState.get();
+		m_threads.push_back(std::move(newThreadState));
+	}
+	return *threadStateOwner.threadState;
+}
+
+void CProfiler::ReleaseThreadState(THREAD_STATE* threadState)
+{
+	//Pending events are collected now, the collector might still need them after the thread exits
+	std::lock_guard<std::mutex> collectLock(m_collectMutex);
+	CollectThreadEvents(*threadState);
+
+	std::lock_guard<std::mutex> threadsLock(m_threadsMutex);
+	threadState->events.reset();
+	if(!threadState->collectedEvents.empty())
+	{
+		threadState->exited = true;
+		return;
+	}
+	auto threadStateIterator = std::find_if(m_threads.begin(), m_threads.end(),
+	                                        [threadState](const ThreadStatePtr& item) { return item.get() == threadState; });
+	assert(threadStateIterator != m_threads.end());
+	m_threads.erase(threadStateIterator);
+}
+
+std::string CProfiler::GetThreadName(const THREAD_STATE& threadState)
+{
+	return threadState.name.empty() ? string_format("Thread %d", threadState.id) : threadState.name;
+}
+
+void CProfiler::AddTimeToZone(THREAD_STATE& threadState, ZoneHandle zoneHandle, uint64 timeNs)
+{
+	assert(zoneHandle < MAX_ZONES);
+	threadState.zoneTimes[zoneHandle].fetch_add(timeNs, std::memory_order_relaxed);
+}
+
+void CProfiler::PushEvent(THREAD_STATE& threadState, const TimePoint& time, ZoneHandle zoneHandle, EVENT_TYPE type)
+{
+	if(!m_traceCaptureEnabled.load(std::memory_order_relaxed)) return;
+
+	if(!threadState.events)
+	{
+		//Published to the collector by the eventWriteIndex store below
+		threadState.events = std::make_unique<EVENT[]>(EVENT_BUFFER_SIZE);
+	}
+
+	uint32 writeIndex = threadState.eventWriteIndex.load(std::memory_order_relaxed);
+	uint32 readIndex = threadState.eventReadIndex.load(std::memory_order_acquire);
+	if((writeIndex - readIndex) >= EVENT_BUFFER_SIZE)
+	{
+		threadState.droppedEventCount.fetch_add(1, std::memory_order_relaxed);
+		threadState.eventGap = true;
+		return;
+	}
+
+	auto& event = threadState.events[writeIndex & (EVENT_BUFFER_SIZE - 1)];
+	event.time = std::chrono::duration_cast<std::chrono::nanoseconds>(time - m_startTime).count();
+	event.zone = zoneHandle;
+	event.type = type;
+	event.afterGap = threadState.eventGap;
+	threadState.eventGap = false;
+	threadState.eventWriteIndex.store(writeIndex + 1, std::memory_order_release);
+}
+
+void CProfiler::CollectThreadEvents(THREAD_STATE& threadState)
+{
+	uint32 readIndex = threadState.eventReadIndex.load(std::memory_order_relaxed);
+	uint32 writeIndex = threadState.eventWriteIndex.load(std::memory_order_acquire);
+	for(; readIndex != writeIndex; readIndex++)
+	{
+		const auto& event = threadState.events[readIndex & (EVENT_BUFFER_SIZE - 1)];
+		if(event.afterGap)
+		{
+			//Enters or exits might be missing, zones still open can't be matched anymore
+			CloseCollectedZones(threadState);
+		}
+		if(event.type == EVENT_EXIT)
+		{
+			//Drop exits of zones entered before the capture started (or before a gap)
+			if(threadState.collectedDepth == 0) continue;
+		}
+		if(threadState.collectedEvents.size() >= MAX_COLLECTED_EVENTS)
+		{
+			threadState.droppedEventCount.fetch_add(1, std::memory_order_relaxed);
+			CloseCollectedZones(threadState);
+			continue;
+		}
+		if(event.type == EVENT_ENTER)
+		{
+			assert(threadState.collectedDepth < MAX_ZONE_DEPTH);
+			threadState.collectedZoneStack[threadState.collectedDepth++] = event.zone;
+		}
+		else
+		{
+			threadState.collectedDepth--;
+		}
+		threadState.collectedEvents.push_back(event);
+	}
+	threadState.eventReadIndex.store(writeIndex, std::memory_order_release);
+}
+
+//Adds exits for the zones that are still open, at the time of the last collected event,
+//keeping enters and exits balanced in the trace.
+void CProfiler::CloseCollectedZones(THREAD_STATE& threadState)
+{
+	if(threadState.collectedDepth == 0) return;
+	uint64 time = threadState.collectedEvents.back().time;
+	while(threadState.collectedDepth != 0)
+	{
+		EVENT event = {};
+		event.time = time;
+		event.zone = threadState.collectedZoneStack[--threadState.collectedDepth];
+		event.type = EVENT_EXIT;
+		threadState.collectedEvents.push_back(event);
+	}
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -1,31 +1,65 @@
 #pragma once
 
 #include <string>
-#include <stack>
-#include <thread>
+#include <array>
 #include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
 #include <chrono>
 #include "Singleton.h"
 #include "Types.h"
+#include "Stream.h"
 
+//Zones can be entered from any thread. Every thread keeps its own zone stack and
+//its own ring buffer of enter/exit events, so recording never takes a lock.
+//Ring buffers are only allocated once a thread records events while trace capture is on.
+//Events are drained by CollectEvents and can be exported as a Chrome trace.
+//Thread states are released when their thread exits.
 class CProfiler : public CSingleton<CProfiler>
 {
 public:
 	typedef uint32 ZoneHandle;
 
+	enum
+	{
+		MAX_ZONES = 64,
+		MAX_ZONE_DEPTH = 32,
+		EVENT_BUFFER_SIZE = 0x10000,
+		MAX_COLLECTED_EVENTS = 0x100000,
+	};
+
+	//Zone times are reported per thread, time spent on different threads overlaps
 	struct ZONE
 	{
+		std::string threadName;
 		std::string name;
 		uint64 totalTime = 0;
 	};
 
+	enum EVENT_TYPE : uint16
+	{
+		EVENT_ENTER,
+		EVENT_EXIT,
+	};
+
+	struct EVENT
+	{
+		uint64 time; //Nanoseconds since profiler creation
+		ZoneHandle zone;
+		EVENT_TYPE type;
+		bool afterGap; //Events were dropped right before this one
+	};
+
 	typedef std::vector<ZONE> ZoneArray;
+	typedef std::vector<EVENT> EventArray;
 	typedef std::chrono::high_resolution_clock::time_point TimePoint;
 
 	CProfiler();
 	virtual ~CProfiler();
 
 	ZoneHandle RegisterZone(const char*);
+	void SetThreadName(const char*);
 
 	void CountCurrentZone();
 
@@ -35,20 +69,69 @@ public:
 	ZoneArray GetStats() const;
 	void Reset();
 
-	void SetWorkThread();
+	void SetTraceCaptureEnabled(bool);
+	bool IsTraceCaptureEnabled() const;
+	uint32 GetDroppedEventCount() const;
+	void CollectEvents();
+	void ClearCollectedEvents();
+	void WriteChromeTrace(Framework::CStream&);
 
 private:
-	typedef std::stack<ZoneHandle> ZoneStack;
+	struct THREAD_STATE
+	{
+		THREAD_STATE(uint32);
+
+		uint32 id = 0;
+		std::string name;
+
+		//Only accessed by the owning thread
+		std::array<ZoneHandle, MAX_ZONE_DEPTH> zoneStack;
+		uint32 zoneStackSize = 0;
+		TimePoint currentTime;
+		bool eventGap = false;
+
+		//Written by the owning thread, read by the collector
+		std::array<std::atomic<uint64>, MAX_ZONES> zoneTimes;
+		std::unique_ptr<EVENT[]> events;
+		std::atomic<uint32> eventWriteIndex;
+		std::atomic<uint32> eventReadIndex;
+		std::atomic<uint32> droppedEventCount;
+
+		//Only accessed by the collector, events past MAX_COLLECTED_EVENTS are dropped
+		std::array<ZoneHandle, MAX_ZONE_DEPTH> collectedZoneStack;
+		uint32 collectedDepth = 0;
+		EventArray collectedEvents;
+		//Owning thread exited, state is only kept until its collected events are cleared
+		bool exited = false;
+	};
+	typedef std::unique_ptr<THREAD_STATE> ThreadStatePtr;
+	typedef std::vector<ThreadStatePtr> ThreadStateArray;
+
+	struct THREAD_STATE_OWNER
+	{
+		~THREAD_STATE_OWNER();
+
+		THREAD_STATE* threadState = nullptr;
+	};
+
+	THREAD_STATE& GetThreadState();
+	void ReleaseThreadState(THREAD_STATE*);
+	static std::string GetThreadName(const THREAD_STATE&);
+	void AddTimeToZone(THREAD_STATE&, ZoneHandle, uint64);
+	void PushEvent(THREAD_STATE&, const TimePoint&, ZoneHandle, EVENT_TYPE);
+	void CollectThreadEvents(THREAD_STATE&);
+	static void CloseCollectedZones(THREAD_STATE&);
 
-	void AddTimeToZone(ZoneHandle, uint64);
+	mutable std::mutex m_zonesMutex;
+	std::vector<std::string> m_zoneNames;
 
-	ZoneArray m_zones;
-	ZoneStack m_zoneStack;
-	TimePoint m_currentTime;
+	mutable std::mutex m_threadsMutex;
+	ThreadStateArray m_threads;
+	uint32 m_nextThreadId = 1;
 
-#ifdef _DEBUG
-	std::thread::id m_workThreadId;
-#endif
+	std::mutex m_collectMutex;
+	std::atomic<bool> m_traceCaptureEnabled;
+	TimePoint m_startTime;
 };
 
 class CProfilerZone
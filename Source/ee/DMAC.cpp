@@ -6,6 +6,7 @@
 #include "../states/RegisterStateFile.h"
 #include "../MIPS.h"
 #include "../COP_SCU.h"
+#include "../PerfCounters.h"
 #include "placeholder_def.h"
 
 #define LOG_NAME ("ee_dmac")
@@ -188,6 +189,7 @@ uint32 CDMAC::ResumeDMA3(const void* pBuffer, uint32 nSize)
 	}
 
 	memcpy(pDst, pBuffer, nSize * 0x10);
+	CPerfCounters::GetCurrent().Add(CPerfCounters::COUNTER_DMA_BYTES_CH3, nSize * 0x10);
 
 	m_D3_MADR += (nSize * 0x10);
 	m_D3_QWC -= nSize;
@@ -652,6 +654,7 @@ void CDMAC::SetRegister(uint32 nAddress, uint32 nData)
 		if(m_D5_CHCR & CHCR_STR)
 		{
 			m_receiveDma5(m_D5_MADR, m_D5_QWC * 0x10, 0, false);
+			CPerfCounters::GetCurrent().Add(CPerfCounters::COUNTER_DMA_BYTES_CH5, m_D5_QWC * 0x10);
 			m_D5_CHCR &= ~CHCR_STR;
 			m_D_STAT |= (1 << CHANNEL_ID_SIF0);
 		}
@@ -685,6 +688,7 @@ void CDMAC::SetRegister(uint32 nAddress, uint32 nData)
 		if(m_D6_CHCR & 0x100)
 		{
 			m_receiveDma6(m_D6_MADR, m_D6_QWC * 0x10, m_D6_TADR, false);
+			CPerfCounters::GetCurrent().Add(CPerfCounters::COUNTER_DMA_BYTES_CH6, m_D6_QWC * 0x10);
 			m_D6_CHCR &= ~0x100;
 		}
 		break;
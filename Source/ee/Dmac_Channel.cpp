@@ -3,6 +3,7 @@
 #include "string_format.h"
 #include "../states/RegisterStateFile.h"
 #include "../Log.h"
+#include "../PerfCounters.h"
 #include "Dmac_Channel.h"
 #include "DMAC.h"
 
@@ -179,7 +180,7 @@ void CChannel::ExecuteNormal()
 		qwc = std::min<int32>(m_nQWC, (ringBufferSize - ringBufferAddr) / 0x10);
 	}
 
-	uint32 nRecv = m_receive(m_nMADR, qwc, m_CHCR.nDIR, false);
+	uint32 nRecv = Receive(m_nMADR, qwc, m_CHCR.nDIR, false);
 
 	m_nMADR += nRecv * 0x10;
 	m_nQWC -= nRecv;
@@ -208,7 +209,7 @@ void CChannel::ExecuteInterleave()
 		//Transfer
 		{
 			uint32 qwc = m_dmac.m_D_SQWC.tqwc;
-			uint32 recv = m_receive(m_nMADR, qwc, CHCR_DIR_FROM, false);
+			uint32 recv = Receive(m_nMADR, qwc, CHCR_DIR_FROM, false);
 			assert(recv == qwc);
 
 			m_nMADR += recv * 0x10;
@@ -272,7 +273,7 @@ void CChannel::ExecuteSourceChain()
 	//Execute current
 	if(m_nQWC != 0)
 	{
-		uint32 nRecv = m_receive(m_nMADR, m_nQWC, CHCR_DIR_FROM, false);
+		uint32 nRecv = Receive(m_nMADR, m_nQWC, CHCR_DIR_FROM, false);
 
 		m_nMADR += nRecv * 0x10;
 		m_nQWC -= nRecv;
@@ -301,7 +302,7 @@ void CChannel::ExecuteSourceChain()
 		{
 			assert(m_CHCR.nTTE);
 			m_CHCR.nReserved0 = 0;
-			if(m_receive(m_nTADR, 1, CHCR_DIR_FROM, true) != 1)
+			if(Receive(m_nTADR, 1, CHCR_DIR_FROM, true) != 1)
 			{
 				//Device didn't receive DmaTag, break for now
 				m_CHCR.nReserved0 = 1;
@@ -350,7 +351,7 @@ void CChannel::ExecuteSourceChain()
 			if(m_CHCR.nTTE == 1)
 			{
 				m_CHCR.nReserved0 = 0;
-				if(m_receive(m_nTADR, 1, CHCR_DIR_FROM, true) != 1)
+				if(Receive(m_nTADR, 1, CHCR_DIR_FROM, true) != 1)
 				{
 					//Device didn't receive DmaTag, break for now
 					m_CHCR.nReserved0 = 1;
@@ -453,7 +454,7 @@ void CChannel::ExecuteSourceChain()
 
 		if(qwc != 0)
 		{
-			uint32 nRecv = m_receive(m_nMADR, qwc, CHCR_DIR_FROM, false);
+			uint32 nRecv = Receive(m_nMADR, qwc, CHCR_DIR_FROM, false);
 
 			m_nMADR += nRecv * 0x10;
 			m_nQWC -= nRecv;
@@ -503,7 +504,7 @@ void CChannel::ExecuteDestinationChain()
 			break;
 		}
 
-		uint32 recv = m_receive(m_nMADR, m_nQWC, m_CHCR.nDIR, false);
+		uint32 recv = Receive(m_nMADR, m_nQWC, m_CHCR.nDIR, false);
 		assert(recv == m_nQWC);
 
 		m_nMADR += recv * 0x10;
@@ -521,6 +522,14 @@ void CChannel::SetReceiveHandler(const DmaReceiveHandler& handler)
 	m_receive = handler;
 }
 
+uint32 CChannel::Receive(uint32 address, uint32 qwc, uint32 direction, bool tagIncluded)
+{
+	uint32 result = m_receive(address, qwc, direction, tagIncluded);
+	auto counter = static_cast<CPerfCounters::COUNTER>(CPerfCounters::COUNTER_DMA_BYTES_CH0 + m_number);
+	CPerfCounters::GetCurrent().Add(counter, result * 0x10);
+	return result;
+}
+
 void CChannel::ClearSTR()
 {
 	m_CHCR.nSTR = ~m_CHCR.nSTR;
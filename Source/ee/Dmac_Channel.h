@@ -94,6 +94,7 @@ namespace Dmac
 		};
 
 		void ClearSTR();
+		uint32 Receive(uint32, uint32, uint32, bool);
 
 		unsigned int m_number = 0;
 		uint32 m_nSCCTRL;
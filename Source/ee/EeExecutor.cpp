@@ -1,7 +1,11 @@
 #include "EeExecutor.h"
 #include "../Ps2Const.h"
+#include "../PerfCounters.h"
 #include "AlignedAlloc.h"
 #include <zlib.h>
+#include <algorithm>
+#include <atomic>
+#include <mutex>
 
 #if defined(__unix__) || defined(__ANDROID__) || defined(__APPLE__)
 #include <sys/mman.h>
@@ -31,28 +35,61 @@
 
 #endif
 
-static CEeExecutor* g_eeExecutor = nullptr;
+#if defined(_WIN32) || defined(__unix__) || defined(__ANDROID__)
+#define USE_EXCEPTION_DISPATCH
+#endif
+
+#ifdef USE_EXCEPTION_DISPATCH
+
+//Exception handlers are process wide, faults are dispatched to every registered executor
+//(more than one VM can run in the same process). Slots are atomic since they are read
+//from the exception handler.
+#define MAX_EXECUTORS 64
+
+static std::atomic<CEeExecutor*> g_eeExecutors[MAX_EXECUTORS];
+static std::mutex g_eeExecutorsMutex;
+static unsigned int g_eeExecutorCount = 0;
+#if defined(_WIN32)
+static LPVOID g_exceptionHandler = NULL;
+#endif
+
+#endif
 
 CEeExecutor::CEeExecutor(CMIPS& context, uint8* ram)
     : CGenericMipsExecutor(context, 0x20000000)
     , m_ram(ram)
 {
 	m_pageSize = framework_getpagesize();
+	uint32 pageCount = static_cast<uint32>(PS2::EE_RAM_SIZE / m_pageSize);
+	m_codePages.resize(pageCount, 0);
+	m_dirtyPages.resize(pageCount, 1);
 }
 
 void CEeExecutor::AddExceptionHandler()
 {
-	assert(g_eeExecutor == nullptr);
-	g_eeExecutor = this;
-
 #ifdef DISABLE_PROTECTION
 	return;
 #endif
 
+#if defined(USE_EXCEPTION_DISPATCH)
+	std::lock_guard<std::mutex> executorsLock(g_eeExecutorsMutex);
+	bool registered = false;
+	for(auto& executor : g_eeExecutors)
+	{
+		if(executor.load() == nullptr)
+		{
+			executor = this;
+			registered = true;
+			break;
+		}
+	}
+	assert(registered);
+	if(g_eeExecutorCount++ != 0) return;
+
 #if defined(_WIN32)
-	m_handler = AddVectoredExceptionHandler(TRUE, &CEeExecutor::HandleException);
-	assert(m_handler != NULL);
-#elif defined(__unix__) || defined(__ANDROID__)
+	g_exceptionHandler = AddVectoredExceptionHandler(TRUE, &CEeExecutor::HandleException);
+	assert(g_exceptionHandler != NULL);
+#else
 	struct sigaction sigAction;
 	sigAction.sa_handler = nullptr;
 	sigAction.sa_sigaction = &HandleException;
@@ -60,6 +97,7 @@ void CEeExecutor::AddExceptionHandler()
 	sigemptyset(&sigAction.sa_mask);
 	int result = sigaction(SIGSEGV, &sigAction, nullptr);
 	assert(result >= 0);
+#endif
 #elif defined(__APPLE__)
 	kern_return_t result = mach_port_allocate(mach_task_self(), MACH_PORT_RIGHT_RECEIVE, &m_port);
 	assert(result == KERN_SUCCESS);
@@ -82,32 +120,108 @@ void CEeExecutor::RemoveExceptionHandler()
 {
 #ifndef DISABLE_PROTECTION
 
+#if defined(USE_EXCEPTION_DISPATCH)
+	std::lock_guard<std::mutex> executorsLock(g_eeExecutorsMutex);
+	for(auto& executor : g_eeExecutors)
+	{
+		if(executor.load() == this)
+		{
+			executor = nullptr;
+			break;
+		}
+	}
+	assert(g_eeExecutorCount != 0);
+	g_eeExecutorCount--;
 #if defined(_WIN32)
-	RemoveVectoredExceptionHandler(m_handler);
+	if(g_eeExecutorCount == 0)
+	{
+		RemoveVectoredExceptionHandler(g_exceptionHandler);
+		g_exceptionHandler = NULL;
+	}
+#endif
 #elif defined(__APPLE__)
 	m_running = false;
 	m_handlerThread.join();
 #endif
 
 #endif //!DISABLE_PROTECTION
-
-	g_eeExecutor = nullptr;
 }
 
 void CEeExecutor::Reset()
 {
-	SetMemoryProtected(m_ram, PS2::EE_RAM_SIZE, false);
+	std::fill(m_codePages.begin(), m_codePages.end(), 0);
+	MarkAllPagesDirty();
 	m_cachedBlocks.clear();
 	CGenericMipsExecutor::Reset();
 }
 
+//Clears all active blocks but keeps compiled code around. Blocks will be picked up
+//again by BlockFactory if the code they were compiled from didn't change.
+//RAM is about to be overwritten, dirty page tracking stops until the next reset.
+void CEeExecutor::ClearActiveBlocks()
+{
+	std::fill(m_codePages.begin(), m_codePages.end(), 0);
+	MarkAllPagesDirty();
+
+	//Cached blocks must not keep links to blocks that might not be valid anymore
+	for(const auto& blockLink : m_blockLinks)
+	{
+		auto referringBlock = m_blockLookup.FindBlockAt(blockLink.second.address);
+		if(referringBlock->IsEmpty()) continue;
+		referringBlock->UnlinkBlock(blockLink.second.slot);
+	}
+	for(const auto& block : m_blocks)
+	{
+		block->SetLinkTargetAddress(CBasicBlock::LINK_SLOT_NEXT, MIPS_INVALID_PC);
+		block->SetLinkTargetAddress(CBasicBlock::LINK_SLOT_BRANCH, MIPS_INVALID_PC);
+	}
+
+	//Blocks picked up again after this aren't being recycled because code changed, start counting
+	//over like freshly compiled blocks would. Otherwise, clearing repeatedly (ie.: restoring the same
+	//state over and over) would get all of them past RECYCLE_NOLINK_THRESHOLD and they would stop linking.
+	for(const auto& cachedBlockPair : m_cachedBlocks)
+	{
+		cachedBlockPair.second->SetRecycleCount(0);
+	}
+
+	CGenericMipsExecutor::Reset();
+}
+
 void CEeExecutor::ClearActiveBlocksInRange(uint32 start, uint32 end, bool executing)
 {
-	uint32 rangeSize = end - start;
-	SetMemoryProtected(m_ram + start, rangeSize, false);
+	CPerfCounters::GetCurrent().Add(CPerfCounters::COUNTER_EE_CODE_INVALIDATIONS, 1);
+	uint32 pageStart = std::min<uint32>(start / m_pageSize, m_codePages.size());
+	uint32 pageEnd = std::min<uint32>((end + m_pageSize - 1) / m_pageSize, m_codePages.size());
+	if(pageStart < pageEnd)
+	{
+		std::fill(m_codePages.begin() + pageStart, m_codePages.begin() + pageEnd, 0);
+		UpdatePageProtection(pageStart, pageEnd);
+	}
 	CGenericMipsExecutor::ClearActiveBlocksInRange(start, end, executing);
 }
 
+void CEeExecutor::ResetDirtyPages()
+{
+#ifdef DISABLE_PROTECTION
+	return;
+#endif
+
+#if defined(USE_EXCEPTION_DISPATCH)
+	std::fill(m_dirtyPages.begin(), m_dirtyPages.end(), 0);
+	m_dirtyPageFaultCount = 0;
+	SetMemoryProtected(m_ram, PS2::EE_RAM_SIZE, true);
+#else
+	//Faults are only caught on the emulation thread here, but other threads can write
+	//to EE RAM (ie.: GS readbacks), pages are left dirty.
+#endif
+}
+
+bool CEeExecutor::IsPageDirty(uint32 address) const
+{
+	assert(address < PS2::EE_RAM_SIZE);
+	return m_dirtyPages[address / m_pageSize] != 0;
+}
+
 BasicBlockPtr CEeExecutor::BlockFactory(CMIPS& context, uint32 start, uint32 end)
 {
 	uint32 blockSize = (end - start) + 4;
@@ -117,6 +231,9 @@ BasicBlockPtr CEeExecutor::BlockFactory(CMIPS& context, uint32 start, uint32 end
 	//so it keeps generating exceptions, making the game slower)
 	if(start >= 0x100000 && start < PS2::EE_RAM_SIZE)
 	{
+		uint32 pageStart = start / m_pageSize;
+		uint32 pageEnd = std::min<uint32>((start + blockSize + m_pageSize - 1) / m_pageSize, m_codePages.size());
+		std::fill(m_codePages.begin() + pageStart, m_codePages.begin() + pageEnd, 1);
 		SetMemoryProtected(m_ram + start, blockSize, true);
 	}
 
@@ -146,7 +263,11 @@ BasicBlockPtr CEeExecutor::BlockFactory(CMIPS& context, uint32 start, uint32 end
 	}
 
 	auto result = std::make_shared<CBasicBlock>(context, start, end);
-	result->Compile();
+	{
+		CPerfCounterTimer compileTimer(CPerfCounters::COUNTER_EE_COMPILE_TIME);
+		result->Compile();
+	}
+	CPerfCounters::GetCurrent().Add(CPerfCounters::COUNTER_EE_BLOCKS_COMPILED, 1);
 	m_cachedBlocks.insert(std::make_pair(checksum, result));
 	return result;
 }
@@ -157,12 +278,54 @@ bool CEeExecutor::HandleAccessFault(intptr_t ptr)
 	if(addr >= 0 && addr < PS2::EE_RAM_SIZE)
 	{
 		addr &= ~(m_pageSize - 1);
-		ClearActiveBlocksInRange(addr, addr + m_pageSize, true);
+		uint32 pageIndex = static_cast<uint32>(addr / m_pageSize);
+		m_dirtyPages[pageIndex] = 1;
+		if(m_codePages[pageIndex])
+		{
+			CPerfCounters::GetCurrent().Add(CPerfCounters::COUNTER_EE_PROTECTION_FAULTS, 1);
+			ClearActiveBlocksInRange(addr, addr + m_pageSize, true);
+		}
+		else if(++m_dirtyPageFaultCount > (m_dirtyPages.size() / DIRTY_TRACKING_MAX_FAULT_RATIO))
+		{
+			//Too many pages are being written to, stop tracking until the next reset
+			MarkAllPagesDirty();
+		}
+		else
+		{
+			UpdatePageProtection(pageIndex, pageIndex + 1);
+		}
 		return true;
 	}
 	return false;
 }
 
+void CEeExecutor::MarkAllPagesDirty()
+{
+	std::fill(m_dirtyPages.begin(), m_dirtyPages.end(), 1);
+	UpdatePageProtection(0, static_cast<uint32>(m_dirtyPages.size()));
+}
+
+//Pages stay write protected while they contain compiled code or while they're clean
+void CEeExecutor::UpdatePageProtection(uint32 pageStart, uint32 pageEnd)
+{
+	auto isPageProtected = [this](uint32 pageIndex) {
+		return m_codePages[pageIndex] || !m_dirtyPages[pageIndex];
+	};
+	//Change protection of consecutive pages in the same state at once
+	uint32 runStart = pageStart;
+	while(runStart < pageEnd)
+	{
+		bool protect = isPageProtected(runStart);
+		uint32 runEnd = runStart + 1;
+		while((runEnd < pageEnd) && (isPageProtected(runEnd) == protect))
+		{
+			runEnd++;
+		}
+		SetMemoryProtected(m_ram + (runStart * m_pageSize), (runEnd - runStart) * m_pageSize, protect);
+		runStart = runEnd;
+	}
+}
+
 void CEeExecutor::SetMemoryProtected(void* addr, size_t size, bool protect)
 {
 #ifdef DISABLE_PROTECTION
@@ -184,19 +347,31 @@ void CEeExecutor::SetMemoryProtected(void* addr, size_t size, bool protect)
 #endif
 }
 
-#if defined(_WIN32)
+#if defined(USE_EXCEPTION_DISPATCH)
 
-LONG WINAPI CEeExecutor::HandleException(_EXCEPTION_POINTERS* exceptionInfo)
+bool CEeExecutor::DispatchAccessFault(intptr_t ptr)
 {
-	return g_eeExecutor->HandleExceptionInternal(exceptionInfo);
+	for(const auto& executorSlot : g_eeExecutors)
+	{
+		auto executor = executorSlot.load();
+		if(executor && executor->HandleAccessFault(ptr))
+		{
+			return true;
+		}
+	}
+	return false;
 }
 
-LONG CEeExecutor::HandleExceptionInternal(_EXCEPTION_POINTERS* exceptionInfo)
+#endif
+
+#if defined(_WIN32)
+
+LONG WINAPI CEeExecutor::HandleException(_EXCEPTION_POINTERS* exceptionInfo)
 {
 	auto exceptionRecord = exceptionInfo->ExceptionRecord;
 	if(exceptionRecord->ExceptionCode == EXCEPTION_ACCESS_VIOLATION)
 	{
-		if(HandleAccessFault(exceptionRecord->ExceptionInformation[1]))
+		if(DispatchAccessFault(exceptionRecord->ExceptionInformation[1]))
 		{
 			return EXCEPTION_CONTINUE_EXECUTION;
 		}
@@ -207,14 +382,9 @@ LONG CEeExecutor::HandleExceptionInternal(_EXCEPTION_POINTERS* exceptionInfo)
 #elif defined(__unix__) || defined(__ANDROID__)
 
 void CEeExecutor::HandleException(int sigId, siginfo_t* sigInfo, void* baseContext)
-{
-	g_eeExecutor->HandleExceptionInternal(sigId, sigInfo, baseContext);
-}
-
-void CEeExecutor::HandleExceptionInternal(int sigId, siginfo_t* sigInfo, void* baseContext)
 {
 	if(sigId != SIGSEGV) return;
-	if(HandleAccessFault(reinterpret_cast<intptr_t>(sigInfo->si_addr)))
+	if(DispatchAccessFault(reinterpret_cast<intptr_t>(sigInfo->si_addr)))
 	{
 		return;
 	}
@@ -9,6 +9,7 @@
 #include <signal.h>
 #endif
 
+#include <vector>
 #include "../GenericMipsExecutor.h"
 
 class CEeExecutor : public CGenericMipsExecutor<BlockLookupTwoWay>
@@ -21,28 +22,48 @@ public:
 	void RemoveExceptionHandler();
 
 	void Reset() override;
+	void ClearActiveBlocks();
 	void ClearActiveBlocksInRange(uint32, uint32, bool) override;
 
+	//Dirty page tracking: pages are write protected after a reset and marked as dirty
+	//when they get written to. Every page is reported dirty while tracking isn't active.
+	void ResetDirtyPages();
+	bool IsPageDirty(uint32) const;
+
 	BasicBlockPtr BlockFactory(CMIPS&, uint32, uint32) override;
 
 private:
+	enum
+	{
+		//Tracking is given up on when more than this fraction of pages is written to between
+		//two resets. Comparing memory is cheaper than handling a fault for every page past that.
+		DIRTY_TRACKING_MAX_FAULT_RATIO = 8,
+	};
+
 	typedef std::unordered_multimap<uint32, BasicBlockPtr> CachedBlockMap;
 	CachedBlockMap m_cachedBlocks;
 
 	uint8* m_ram = nullptr;
 	size_t m_pageSize = 0;
 
+	//One entry per host page, bytes instead of bits since they can be written from fault handlers
+	std::vector<uint8> m_codePages;
+	std::vector<uint8> m_dirtyPages;
+	uint32 m_dirtyPageFaultCount = 0;
+
 	bool HandleAccessFault(intptr_t);
+	void MarkAllPagesDirty();
+	void UpdatePageProtection(uint32, uint32);
 	void SetMemoryProtected(void*, size_t, bool);
 
+#if defined(_WIN32) || defined(__unix__) || defined(__ANDROID__)
+	static bool DispatchAccessFault(intptr_t);
+#endif
+
 #if defined(_WIN32)
 	static LONG CALLBACK HandleException(_EXCEPTION_POINTERS*);
-	LONG HandleExceptionInternal(_EXCEPTION_POINTERS*);
-
-	LPVOID m_handler = NULL;
 #elif defined(__unix__) || defined(__ANDROID__)
 	static void HandleException(int, siginfo_t*, void*);
-	void HandleExceptionInternal(int, siginfo_t*, void*);
 #elif defined(__APPLE__)
 	void HandlerThreadProc();
 
@@ -350,17 +350,20 @@ void CSubSystem::NotifyVBlankEnd()
 	m_intc.AssertLine(CINTC::INTC_LINE_VBLANK_END);
 }
 
-void CSubSystem::SaveState(Framework::CZipArchiveWriter& archive)
+void CSubSystem::SaveState(Framework::CZipArchiveWriter& archive, bool includeMemory)
 {
 	archive.InsertFile(new CMemoryStateFile(STATE_EE, &m_EE.m_State, sizeof(MIPSSTATE)));
 	archive.InsertFile(new CMemoryStateFile(STATE_VU0, &m_VU0.m_State, sizeof(MIPSSTATE)));
 	archive.InsertFile(new CMemoryStateFile(STATE_VU1, &m_VU1.m_State, sizeof(MIPSSTATE)));
-	archive.InsertFile(new CMemoryStateFile(STATE_RAM, m_ram, PS2::EE_RAM_SIZE));
-	archive.InsertFile(new CMemoryStateFile(STATE_SPR, m_spr, PS2::EE_SPR_SIZE));
-	archive.InsertFile(new CMemoryStateFile(STATE_VUMEM0, m_vuMem0, PS2::VUMEM0SIZE));
-	archive.InsertFile(new CMemoryStateFile(STATE_MICROMEM0, m_microMem0, PS2::MICROMEM0SIZE));
-	archive.InsertFile(new CMemoryStateFile(STATE_VUMEM1, m_vuMem1, PS2::VUMEM1SIZE));
-	archive.InsertFile(new CMemoryStateFile(STATE_MICROMEM1, m_microMem1, PS2::MICROMEM1SIZE));
+	if(includeMemory)
+	{
+		CMemorySnapshot::RegionArray regions;
+		GetStateMemoryRegions(regions);
+		for(const auto& region : regions)
+		{
+			archive.InsertFile(new CMemoryStateFile(region.name, region.memory, region.size));
+		}
+	}
 
 	m_dmac.SaveState(archive);
 	m_intc.SaveState(archive);
@@ -371,19 +374,20 @@ void CSubSystem::SaveState(Framework::CZipArchiveWriter& archive)
 	m_gif.SaveState(archive);
 }
 
-void CSubSystem::LoadState(Framework::CZipArchiveReader& archive)
+void CSubSystem::LoadState(Framework::CZipArchiveReader& archive, bool includeMemory)
 {
-	m_EE.m_executor->Reset();
-
 	archive.BeginReadFile(STATE_EE)->Read(&m_EE.m_State, sizeof(MIPSSTATE));
 	archive.BeginReadFile(STATE_VU0)->Read(&m_VU0.m_State, sizeof(MIPSSTATE));
 	archive.BeginReadFile(STATE_VU1)->Read(&m_VU1.m_State, sizeof(MIPSSTATE));
-	archive.BeginReadFile(STATE_RAM)->Read(m_ram, PS2::EE_RAM_SIZE);
-	archive.BeginReadFile(STATE_SPR)->Read(m_spr, PS2::EE_SPR_SIZE);
-	archive.BeginReadFile(STATE_VUMEM0)->Read(m_vuMem0, PS2::VUMEM0SIZE);
-	archive.BeginReadFile(STATE_MICROMEM0)->Read(m_microMem0, PS2::MICROMEM0SIZE);
-	archive.BeginReadFile(STATE_VUMEM1)->Read(m_vuMem1, PS2::VUMEM1SIZE);
-	archive.BeginReadFile(STATE_MICROMEM1)->Read(m_microMem1, PS2::MICROMEM1SIZE);
+	if(includeMemory)
+	{
+		CMemorySnapshot::RegionArray regions;
+		GetStateMemoryRegions(regions);
+		for(const auto& region : regions)
+		{
+			archive.BeginReadFile(region.name)->Read(region.memory, region.size);
+		}
+	}
 
 	m_dmac.LoadState(archive);
 	m_intc.LoadState(archive);
@@ -392,6 +396,42 @@ void CSubSystem::LoadState(Framework::CZipArchiveReader& archive)
 	m_vpu1->LoadState(archive);
 	m_timer.LoadState(archive);
 	m_gif.LoadState(archive);
+
+	//Memory might have been restored by the caller (snapshots), always resync with the guest thread list
+	m_os->RebuildThreadScheduleIndex();
+}
+
+void CSubSystem::GetStateMemoryRegions(CMemorySnapshot::RegionArray& regions)
+{
+	auto executor = static_cast<CEeExecutor*>(m_EE.m_executor.get());
+	CMemorySnapshot::AddRegion(regions, STATE_RAM, m_ram, PS2::EE_RAM_SIZE,
+	                           [executor](uint32 address) { return executor->IsPageDirty(address); });
+	CMemorySnapshot::AddRegion(regions, STATE_SPR, m_spr, PS2::EE_SPR_SIZE);
+	CMemorySnapshot::AddRegion(regions, STATE_VUMEM0, m_vuMem0, PS2::VUMEM0SIZE);
+	CMemorySnapshot::AddRegion(regions, STATE_MICROMEM0, m_microMem0, PS2::MICROMEM0SIZE);
+	CMemorySnapshot::AddRegion(regions, STATE_VUMEM1, m_vuMem1, PS2::VUMEM1SIZE);
+	CMemorySnapshot::AddRegion(regions, STATE_MICROMEM1, m_microMem1, PS2::MICROMEM1SIZE);
+}
+
+//Needs to be called before restoring EE RAM since code pages might be write protected
+void CSubSystem::ResetExecutor(bool keepCompiledBlocks)
+{
+	auto executor = static_cast<CEeExecutor*>(m_EE.m_executor.get());
+	if(keepCompiledBlocks)
+	{
+		executor->ClearActiveBlocks();
+	}
+	else
+	{
+		executor->Reset();
+	}
+}
+
+//Starts tracking writes to EE RAM, needs to be called when EE RAM matches the last snapshot
+void CSubSystem::ResetDirtyPages()
+{
+	auto executor = static_cast<CEeExecutor*>(m_EE.m_executor.get());
+	executor->ResetDirtyPages();
 }
 
 void CSubSystem::SetupEePageTable()
@@ -16,6 +16,7 @@
 #include "COP_VU.h"
 #include "PS2OS.h"
 #include "../gs/GSHandler.h"
+#include "../states/MemorySnapshot.h"
 
 #include "signal/Signal.h"
 
@@ -35,8 +36,12 @@ namespace Ee
 		void NotifyVBlankStart();
 		void NotifyVBlankEnd();
 
-		void SaveState(Framework::CZipArchiveWriter&);
-		void LoadState(Framework::CZipArchiveReader&);
+		void SaveState(Framework::CZipArchiveWriter&, bool);
+		void LoadState(Framework::CZipArchiveReader&, bool);
+		void GetStateMemoryRegions(CMemorySnapshot::RegionArray&);
+
+		void ResetExecutor(bool);
+		void ResetDirtyPages();
 
 		void SetVpu0(std::shared_ptr<CVpu>);
 		void SetVpu1(std::shared_ptr<CVpu>);
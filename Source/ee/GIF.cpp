@@ -258,7 +258,7 @@ uint32 CGIF::ProcessImage(const uint8* memory, uint32 address, uint32 end)
 
 uint32 CGIF::ProcessSinglePacket(const uint8* memory, uint32 address, uint32 end, const CGsPacketMetadata& packetMetadata)
 {
-	static CGSHandler::RegisterWriteList writeList;
+	static thread_local CGSHandler::RegisterWriteList writeList;
 	static const auto flushWriteList =
 	    [](CGSHandler* gs, const CGsPacketMetadata& packetMetadata) {
 		    if(!writeList.empty())
@@ -4,6 +4,7 @@
 #include <exception>
 #include <functional>
 #include "IPU.h"
+#include "../PerfCounters.h"
 #include "IPU_MacroblockAddressIncrementTable.h"
 #include "IPU_MacroblockTypeITable.h"
 #include "IPU_MacroblockTypePTable.h"
@@ -1335,6 +1336,7 @@ bool CIPU::CBDECCommand::Execute()
 			m_currentBlockIndex++;
 			if(m_currentBlockIndex == 6)
 			{
+				CPerfCounters::GetCurrent().Add(CPerfCounters::COUNTER_IPU_MACROBLOCKS, 1);
 				m_state = STATE_DONE;
 			}
 			else
@@ -2,6 +2,10 @@
 #include <stddef.h>
 #include <stdlib.h>
 #include <exception>
+#include <algorithm>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
 #include "string_format.h"
 #include "PS2OS.h"
 #include "StdStream.h"
@@ -86,6 +90,9 @@
 #define PATCHESFILENAME "patches.xml"
 #define LOG_NAME ("ps2os")
 
+//Cross-checks the thread schedule index against the thread schedule in guest memory
+//#define _THREAD_SCHEDULE_VALIDATION
+
 #define SYSCALL_CUSTOM_RESCHEDULE 0x666
 #define SYSCALL_CUSTOM_EXITINTERRUPT 0x667
 
@@ -272,6 +279,7 @@ void CPS2OS::Initialize()
 	AssembleIdleThreadProc();
 	AssembleAlarmHandler();
 	CreateIdleThread();
+	RebuildThreadScheduleIndex();
 
 	m_ee.m_State.nPC = BIOS_ADDRESS_IDLETHREADPROC;
 	m_ee.m_State.nCOP0[CCOP_SCU::STATUS] |= (CMIPS::STATUS_IE | CMIPS::STATUS_EIE);
@@ -1048,26 +1056,163 @@ uint32* CPS2OS::GetCustomSyscallTable()
 	return (uint32*)&m_ram[BIOS_ADDRESS_CUSTOMSYSCALL_BASE];
 }
 
-void CPS2OS::LinkThread(uint32 threadId)
+static uint32 GetHighestBitIndex(uint64 value)
 {
-	auto thread = m_threads[threadId];
+	assert(value != 0);
+#ifdef _MSC_VER
+	unsigned long index = 0;
+	_BitScanReverse64(&index, value);
+	return index;
+#else
+	return 63 - __builtin_clzll(value);
+#endif
+}
 
+void CPS2OS::RebuildThreadScheduleIndex()
+{
+	std::fill(std::begin(m_threadScheduleHeads), std::end(m_threadScheduleHeads), 0);
+	std::fill(std::begin(m_threadScheduleTails), std::end(m_threadScheduleTails), 0);
+	std::fill(std::begin(m_threadSchedulePriorityMask), std::end(m_threadSchedulePriorityMask), 0);
+	std::fill(std::begin(m_threadSchedulePrevIds), std::end(m_threadSchedulePrevIds), 0);
+	std::fill(std::begin(m_threadSchedulePriorities), std::end(m_threadSchedulePriorities), ~0U);
+
+	uint32 prevId = 0;
 	for(auto threadSchedulePair : m_threadSchedule)
 	{
-		auto scheduledThread = threadSchedulePair.second;
-		if(scheduledThread->currPriority > thread->currPriority)
+		uint32 threadId = threadSchedulePair.first;
+		uint32 priority = std::min<uint32>(threadSchedulePair.second->currPriority, MAX_THREAD_PRIORITY - 1);
+		m_threadSchedulePrevIds[threadId] = prevId;
+		m_threadSchedulePriorities[threadId] = priority;
+		if(m_threadScheduleHeads[priority] == 0)
 		{
-			m_threadSchedule.AddBefore(threadSchedulePair.first, threadId);
-			return;
+			m_threadScheduleHeads[priority] = threadId;
+			m_threadSchedulePriorityMask[priority / 64] |= (1ULL << (priority % 64));
+		}
+		m_threadScheduleTails[priority] = threadId;
+		prevId = threadId;
+	}
+}
+
+int32 CPS2OS::FindThreadSchedulePriorityBefore(uint32 priority) const
+{
+	for(int32 word = priority / 64; word >= 0; word--)
+	{
+		uint64 mask = m_threadSchedulePriorityMask[word];
+		if(word == static_cast<int32>(priority / 64))
+		{
+			mask &= (1ULL << (priority % 64)) - 1;
+		}
+		if(mask != 0)
+		{
+			return (word * 64) + GetHighestBitIndex(mask);
 		}
 	}
+	return -1;
+}
 
-	m_threadSchedule.PushBack(threadId);
+void CPS2OS::CheckThreadScheduleIndex() const
+{
+	uint32 prevId = 0;
+	uint32 prevPriority = 0;
+	unsigned int linkedCount = 0;
+	for(auto threadSchedulePair : m_threadSchedule)
+	{
+		uint32 threadId = threadSchedulePair.first;
+		uint32 nextId = threadSchedulePair.second->nextId;
+		uint32 priority = m_threadSchedulePriorities[threadId];
+		assert(priority == std::min<uint32>(threadSchedulePair.second->currPriority, MAX_THREAD_PRIORITY - 1));
+		assert(m_threadSchedulePrevIds[threadId] == prevId);
+		bool isLevelHead = (prevId == 0) || (prevPriority != priority);
+		bool isLevelTail = (nextId == 0) || (m_threadSchedulePriorities[nextId] != priority);
+		assert((prevId == 0) || (priority >= prevPriority));
+		assert(isLevelHead == (m_threadScheduleHeads[priority] == threadId));
+		assert(isLevelTail == (m_threadScheduleTails[priority] == threadId));
+		assert((m_threadSchedulePriorityMask[priority / 64] & (1ULL << (priority % 64))) != 0);
+		prevId = threadId;
+		prevPriority = priority;
+		linkedCount++;
+	}
+	unsigned int indexedCount = 0;
+	for(auto priority : m_threadSchedulePriorities)
+	{
+		if(priority != ~0U) indexedCount++;
+	}
+	assert(linkedCount == indexedCount);
+}
+
+void CPS2OS::LinkThread(uint32 threadId)
+{
+	auto thread = m_threads[threadId];
+	assert(m_threadSchedulePriorities[threadId] == ~0U);
+
+	//Threads with the same priority are scheduled in FIFO order, insert after the last one
+	//or after the last thread of the closest higher priority level
+	uint32 priority = std::min<uint32>(thread->currPriority, MAX_THREAD_PRIORITY - 1);
+	uint32 prevId = m_threadScheduleTails[priority];
+	if(prevId == 0)
+	{
+		int32 prevPriority = FindThreadSchedulePriorityBefore(priority);
+		prevId = (prevPriority == -1) ? 0 : m_threadScheduleTails[prevPriority];
+	}
+
+	m_threadSchedule.InsertAfter(prevId, threadId);
+	m_threadSchedulePrevIds[threadId] = prevId;
+	m_threadSchedulePriorities[threadId] = priority;
+	if(thread->nextId != 0)
+	{
+		m_threadSchedulePrevIds[thread->nextId] = threadId;
+	}
+	if(m_threadScheduleHeads[priority] == 0)
+	{
+		m_threadScheduleHeads[priority] = threadId;
+		m_threadSchedulePriorityMask[priority / 64] |= (1ULL << (priority % 64));
+	}
+	m_threadScheduleTails[priority] = threadId;
+
+#ifdef _THREAD_SCHEDULE_VALIDATION
+	CheckThreadScheduleIndex();
+#endif
 }
 
 void CPS2OS::UnlinkThread(uint32 threadId)
 {
-	m_threadSchedule.Unlink(threadId);
+	//Priority is the one the thread was linked with, currPriority might have changed since
+	uint32 priority = m_threadSchedulePriorities[threadId];
+	assert(priority != ~0U);
+	if(priority == ~0U)
+	{
+		return;
+	}
+
+	auto thread = m_threads[threadId];
+	uint32 prevId = m_threadSchedulePrevIds[threadId];
+	uint32 nextId = thread->nextId;
+
+	m_threadSchedule.UnlinkAfter(prevId, threadId);
+	m_threadSchedulePrevIds[threadId] = 0;
+	m_threadSchedulePriorities[threadId] = ~0U;
+	if(nextId != 0)
+	{
+		m_threadSchedulePrevIds[nextId] = prevId;
+	}
+	if(m_threadScheduleHeads[priority] == threadId)
+	{
+		bool nextInLevel = (nextId != 0) && (m_threadSchedulePriorities[nextId] == priority);
+		m_threadScheduleHeads[priority] = nextInLevel ? nextId : 0;
+	}
+	if(m_threadScheduleTails[priority] == threadId)
+	{
+		bool prevInLevel = (prevId != 0) && (m_threadSchedulePriorities[prevId] == priority);
+		m_threadScheduleTails[priority] = prevInLevel ? prevId : 0;
+	}
+	if(m_threadScheduleHeads[priority] == 0)
+	{
+		m_threadSchedulePriorityMask[priority / 64] &= ~(1ULL << (priority % 64));
+	}
+
+#ifdef _THREAD_SCHEDULE_VALIDATION
+	CheckThreadScheduleIndex();
+#endif
 }
 
 void CPS2OS::ThreadShakeAndBake()
@@ -1985,14 +2130,13 @@ void CPS2OS::sc_RotateThreadReadyQueue()
 
 	//Find first of this priority and reinsert if it's the same as the current thread
 	//If it's not the same, the schedule will be rotated when another thread is choosen
-	for(auto threadSchedulePair : m_threadSchedule)
+	if(prio < MAX_THREAD_PRIORITY)
 	{
-		auto scheduledThread = threadSchedulePair.second;
-		if(scheduledThread->currPriority == prio)
+		uint32 threadId = m_threadScheduleHeads[prio];
+		if((threadId != 0) && (m_threads[threadId]->currPriority == prio))
 		{
-			UnlinkThread(threadSchedulePair.first);
-			LinkThread(threadSchedulePair.first);
-			break;
+			UnlinkThread(threadId);
+			LinkThread(threadId);
 		}
 	}
 
@@ -29,6 +29,8 @@ public:
 	void Initialize();
 	void Release();
 
+	void RebuildThreadScheduleIndex();
+
 	bool IsIdle() const;
 
 	void DumpIntcHandlers();
@@ -200,6 +202,7 @@ private:
 		MAX_INTCHANDLER = 128,
 		MAX_DECI2HANDLER = 32,
 		MAX_ALARM = 4,
+		MAX_THREAD_PRIORITY = 128,
 	};
 
 	//TODO: Use "refer" status enum values
@@ -260,6 +263,8 @@ private:
 	void CreateIdleThread();
 	void LinkThread(uint32);
 	void UnlinkThread(uint32);
+	int32 FindThreadSchedulePriorityBefore(uint32) const;
+	void CheckThreadScheduleIndex() const;
 	void ThreadShakeAndBake();
 	void ThreadSwitchContext(uint32);
 	void ThreadSaveContext(THREAD*, bool);
@@ -356,6 +361,12 @@ private:
 	uint32* m_sifDmaTimes = nullptr;
 
 	ThreadQueue m_threadSchedule;
+	//Host side index of m_threadSchedule, each priority level is a contiguous run in the schedule
+	uint32 m_threadScheduleHeads[MAX_THREAD_PRIORITY];
+	uint32 m_threadScheduleTails[MAX_THREAD_PRIORITY];
+	uint64 m_threadSchedulePriorityMask[MAX_THREAD_PRIORITY / 64];
+	uint32 m_threadSchedulePrevIds[MAX_THREAD];
+	uint32 m_threadSchedulePriorities[MAX_THREAD];
 	IntcHandlerQueue m_intcHandlerQueue;
 	DmacHandlerQueue m_dmacHandlerQueue;
 
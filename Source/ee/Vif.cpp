@@ -5,6 +5,7 @@
 #include "string_format.h"
 #include "../Log.h"
 #include "../Ps2Const.h"
+#include "../PerfCounters.h"
 #include "../states/RegisterStateFile.h"
 #include "../states/MemoryStateFile.h"
 #include "Vpu.h"
@@ -636,6 +637,7 @@ void CVif::Cmd_UNPACK(StreamType& stream, CODE nCommand, uint32 nDstAddr)
 	assert(nDstAddr < vuMemSize);
 	nDstAddr &= (vuMemSize - 1);
 
+	uint32 startNum = currentNum;
 	while(currentNum != 0)
 	{
 		bool mustWrite = false;
@@ -733,6 +735,8 @@ void CVif::Cmd_UNPACK(StreamType& stream, CODE nCommand, uint32 nDstAddr)
 		nDstAddr &= (vuMemSize - 1);
 	}
 
+	CPerfCounters::GetCurrent().Add(CPerfCounters::COUNTER_VIF_UNPACK_QWORDS, startNum - currentNum);
+
 	if(currentNum != 0)
 	{
 		m_STAT.nVPS = 1;
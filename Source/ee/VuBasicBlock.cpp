@@ -9,6 +9,12 @@ CVuBasicBlock::CVuBasicBlock(CMIPS& context, uint32 begin, uint32 end)
 {
 }
 
+uint32 CVuBasicBlock::GetInstructionSize() const
+{
+	//Upper and lower instructions are executed together
+	return 8;
+}
+
 void CVuBasicBlock::CompileRange(CMipsJitter* jitter)
 {
 	CompileProlog(jitter);
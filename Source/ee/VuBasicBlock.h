@@ -10,6 +10,7 @@ public:
 
 protected:
 	void CompileRange(CMipsJitter*) override;
+	uint32 GetInstructionSize() const override;
 
 private:
 	struct INTEGER_BRANCH_DELAY_INFO
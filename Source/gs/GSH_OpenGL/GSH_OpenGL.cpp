@@ -2,6 +2,7 @@
 #include <assert.h>
 #include <cstring>
 #include <math.h>
+#include <algorithm>
 
 #include "../../Log.h"
 #include "../../AppConfig.h"
@@ -93,6 +94,7 @@ void CGSH_OpenGL::ReleaseImpl()
 	ResetImpl();
 
 	m_paletteCache.clear();
+	m_paletteHashIndex.clear();
 	m_shaders.clear();
 	m_presentProgram.reset();
 	m_presentVertexBuffer.Reset();
@@ -112,8 +114,7 @@ void CGSH_OpenGL::ResetImpl()
 	LoadPreferences();
 	m_textureCache.Flush();
 	PalCache_Flush();
-	m_framebuffers.clear();
-	m_depthbuffers.clear();
+	ClearRenderTargets();
 	m_vertexBuffer.clear();
 	m_renderState.isValid = false;
 	m_validGlState = 0;
@@ -151,24 +152,16 @@ void CGSH_OpenGL::FlipImpl()
 	bool halfHeight = GetCrtIsInterlaced() && GetCrtIsFrameMode();
 	if(halfHeight) dispHeight /= 2;
 
-	FramebufferPtr framebuffer;
-	for(const auto& candidateFramebuffer : m_framebuffers)
-	{
-		if(
-		    (candidateFramebuffer->m_basePtr == fb.GetBufPtr()) &&
-		    (GetFramebufferBitDepth(candidateFramebuffer->m_psm) == GetFramebufferBitDepth(fb.nPSM)) &&
-		    (candidateFramebuffer->m_width == fb.GetBufWidth()))
-		{
-			//We have a winner
-			framebuffer = candidateFramebuffer;
-			break;
-		}
-	}
+	auto framebuffer = FindFramebuffer(fb.GetBufPtr(), fb.GetBufPtr(),
+	                                   [&](const FramebufferPtr& candidateFramebuffer) {
+		                                   return (GetFramebufferBitDepth(candidateFramebuffer->m_psm) == GetFramebufferBitDepth(fb.nPSM)) &&
+		                                          (candidateFramebuffer->m_width == fb.GetBufWidth());
+	                                   });
 
 	if(!framebuffer && (fb.GetBufWidth() != 0))
 	{
 		framebuffer = FramebufferPtr(new CFramebuffer(fb.GetBufPtr(), fb.GetBufWidth(), FRAMEBUFFER_HEIGHT, fb.nPSM, m_fbScale, m_multisampleEnabled));
-		m_framebuffers.push_back(framebuffer);
+		AddFramebuffer(framebuffer);
 		PopulateFramebuffer(framebuffer);
 	}
 
@@ -277,8 +270,9 @@ void CGSH_OpenGL::FlipImpl()
 	static bool g_dumpFramebuffers = false;
 	if(g_dumpFramebuffers)
 	{
-		for(const auto& framebuffer : m_framebuffers)
+		for(const auto& framebufferPair : m_framebuffers)
 		{
+			const auto& framebuffer = framebufferPair.second;
 			glBindTexture(GL_TEXTURE_2D, framebuffer->m_texture);
 			DumpTexture(framebuffer->m_width * m_fbScale, framebuffer->m_height * m_fbScale, framebuffer->m_basePtr);
 		}
@@ -289,9 +283,9 @@ void CGSH_OpenGL::FlipImpl()
 	CGSHandler::FlipImpl();
 }
 
-void CGSH_OpenGL::LoadState(Framework::CZipArchiveReader& archive)
+void CGSH_OpenGL::LoadState(Framework::CZipArchiveReader& archive, bool includeMemory)
 {
-	CGSHandler::LoadState(archive);
+	CGSHandler::LoadState(archive, includeMemory);
 	m_mailBox.SendCall(
 	    [this]() {
 		    m_textureCache.InvalidateRange(0, RAMSIZE);
@@ -310,8 +304,7 @@ void CGSH_OpenGL::NotifyPreferencesChangedImpl()
 	LoadPreferences();
 	m_textureCache.Flush();
 	PalCache_Flush();
-	m_framebuffers.clear();
-	m_depthbuffers.clear();
+	ClearRenderTargets();
 	CGSHandler::NotifyPreferencesChangedImpl();
 }
 
@@ -343,6 +336,9 @@ void CGSH_OpenGL::InitializeRC()
 	m_copyToFbSrcSizeUniform = glGetUniformLocation(*m_copyToFbProgram, "g_srcSize");
 
 	m_primBuffer = Framework::OpenGl::CBuffer::Create();
+	glBindBuffer(GL_ARRAY_BUFFER, m_primBuffer);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(PRIM_VERTEX) * PRIM_BUFFER_SIZE, nullptr, GL_STREAM_DRAW);
+	m_primBufferOffset = 0;
 	m_primVertexArray = GeneratePrimVertexArray();
 
 	m_vertexParamsBuffer = GenerateUniformBlockBuffer(sizeof(VERTEXPARAMS));
@@ -655,8 +651,13 @@ void CGSH_OpenGL::SetRenderingContext(uint64 primReg)
 	//Set render states
 	//--------------------------------------------------------
 
+	//Only bits that are relevant to a particular state are compared to
+	//avoid flushing the vertex buffer when nothing really changed
+	uint64 primDiff = m_renderState.primReg ^ primReg;
+	uint64 testDiff = m_renderState.testReg ^ testReg;
+
 	if(!m_renderState.isValid ||
-	   (m_renderState.primReg != primReg))
+	   ((primDiff & PRIM_BLEND_STATE_MASK) != 0))
 	{
 		FlushVertexBuffer();
 
@@ -683,7 +684,7 @@ void CGSH_OpenGL::SetRenderingContext(uint64 primReg)
 	}
 
 	if(!m_renderState.isValid ||
-	   (m_renderState.testReg != testReg))
+	   ((testDiff & TEST_FUNCTIONS_STATE_MASK) != 0))
 	{
 		FlushVertexBuffer();
 		SetupTestFunctions(testReg);
@@ -692,7 +693,7 @@ void CGSH_OpenGL::SetRenderingContext(uint64 primReg)
 
 	if(!m_renderState.isValid ||
 	   (m_renderState.zbufReg != zbufReg) ||
-	   (m_renderState.testReg != testReg))
+	   ((testDiff & TEST_ALPHAFAIL_STATE_MASK) != 0))
 	{
 		FlushVertexBuffer();
 		SetupDepthBuffer(zbufReg, testReg);
@@ -704,7 +705,7 @@ void CGSH_OpenGL::SetRenderingContext(uint64 primReg)
 	   (m_renderState.frameReg != frameReg) ||
 	   (m_renderState.zbufReg != zbufReg) ||
 	   (m_renderState.scissorReg != scissorReg) ||
-	   (m_renderState.testReg != testReg))
+	   ((testDiff & TEST_ALPHAFAIL_STATE_MASK) != 0))
 	{
 		FlushVertexBuffer();
 		SetupFramebuffer(frameReg, zbufReg, scissorReg, testReg);
@@ -717,7 +718,7 @@ void CGSH_OpenGL::SetRenderingContext(uint64 primReg)
 	   (m_renderState.tex1Reg != tex1Reg) ||
 	   (m_renderState.texAReg != texAReg) ||
 	   (m_renderState.clampReg != clampReg) ||
-	   (m_renderState.primReg != primReg))
+	   ((primDiff & PRIM_TEXTURE_STATE_MASK) != 0))
 	{
 		FlushVertexBuffer();
 		SetupTexture(primReg, tex0Reg, tex1Reg, texAReg, clampReg);
@@ -1023,7 +1024,7 @@ void CGSH_OpenGL::SetupFramebuffer(uint64 frameReg, uint64 zbufReg, uint64 sciss
 	if(!framebuffer)
 	{
 		framebuffer = FramebufferPtr(new CFramebuffer(frame.GetBasePtr(), frame.GetWidth(), FRAMEBUFFER_HEIGHT, frame.nPsm, m_fbScale, m_multisampleEnabled));
-		m_framebuffers.push_back(framebuffer);
+		AddFramebuffer(framebuffer);
 		PopulateFramebuffer(framebuffer);
 	}
 
@@ -1033,7 +1034,7 @@ void CGSH_OpenGL::SetupFramebuffer(uint64 frameReg, uint64 zbufReg, uint64 sciss
 	if(!depthbuffer)
 	{
 		depthbuffer = DepthbufferPtr(new CDepthbuffer(zbuf.GetBasePtr(), frame.GetWidth(), FRAMEBUFFER_HEIGHT, zbuf.nPsm, m_fbScale, m_multisampleEnabled));
-		m_depthbuffers.push_back(depthbuffer);
+		AddDepthbuffer(depthbuffer);
 	}
 
 	assert(framebuffer->m_width == depthbuffer->m_width);
@@ -1350,24 +1351,57 @@ void CGSH_OpenGL::SetupTexture(uint64 primReg, uint64 tex0Reg, uint64 tex1Reg, u
 
 CGSH_OpenGL::FramebufferPtr CGSH_OpenGL::FindFramebuffer(const FRAME& frame) const
 {
-	auto framebufferIterator = std::find_if(std::begin(m_framebuffers), std::end(m_framebuffers),
-	                                        [&](const FramebufferPtr& framebuffer) {
-		                                        return (framebuffer->m_basePtr == frame.GetBasePtr()) &&
-		                                               IsCompatibleFramebufferPSM(framebuffer->m_psm, frame.nPsm) &&
-		                                               (framebuffer->m_width == frame.GetWidth());
-	                                        });
-
-	return (framebufferIterator != std::end(m_framebuffers)) ? *(framebufferIterator) : FramebufferPtr();
+	return FindFramebuffer(frame.GetBasePtr(), frame.GetBasePtr(),
+	                       [&](const FramebufferPtr& framebuffer) {
+		                       return IsCompatibleFramebufferPSM(framebuffer->m_psm, frame.nPsm) &&
+		                              (framebuffer->m_width == frame.GetWidth());
+	                       });
 }
 
 CGSH_OpenGL::DepthbufferPtr CGSH_OpenGL::FindDepthbuffer(const ZBUF& zbuf, const FRAME& frame) const
 {
-	auto depthbufferIterator = std::find_if(std::begin(m_depthbuffers), std::end(m_depthbuffers),
-	                                        [&](const DepthbufferPtr& depthbuffer) {
-		                                        return (depthbuffer->m_basePtr == zbuf.GetBasePtr()) && (depthbuffer->m_width == frame.GetWidth());
-	                                        });
+	auto depthbufferRange = m_depthbuffers.equal_range(zbuf.GetBasePtr());
+	for(auto depthbufferIterator = depthbufferRange.first; depthbufferIterator != depthbufferRange.second; depthbufferIterator++)
+	{
+		const auto& depthbuffer = depthbufferIterator->second;
+		if(depthbuffer->m_width == frame.GetWidth())
+		{
+			return depthbuffer;
+		}
+	}
+	return DepthbufferPtr();
+}
+
+//Returns the first framebuffer with a base pointer in the [minBasePtr, maxBasePtr] range that satisfies the predicate
+CGSH_OpenGL::FramebufferPtr CGSH_OpenGL::FindFramebuffer(uint32 minBasePtr, uint32 maxBasePtr, const std::function<bool(const FramebufferPtr&)>& predicate) const
+{
+	auto framebufferIterator = m_framebuffers.lower_bound(minBasePtr);
+	auto framebufferEndIterator = m_framebuffers.upper_bound(maxBasePtr);
+	for(; framebufferIterator != framebufferEndIterator; framebufferIterator++)
+	{
+		const auto& framebuffer = framebufferIterator->second;
+		if(predicate(framebuffer))
+		{
+			return framebuffer;
+		}
+	}
+	return FramebufferPtr();
+}
 
-	return (depthbufferIterator != std::end(m_depthbuffers)) ? *(depthbufferIterator) : DepthbufferPtr();
+void CGSH_OpenGL::AddFramebuffer(const FramebufferPtr& framebuffer)
+{
+	m_framebuffers.insert(std::make_pair(framebuffer->m_basePtr, framebuffer));
+}
+
+void CGSH_OpenGL::AddDepthbuffer(const DepthbufferPtr& depthbuffer)
+{
+	m_depthbuffers.insert(std::make_pair(depthbuffer->m_basePtr, depthbuffer));
+}
+
+void CGSH_OpenGL::ClearRenderTargets()
+{
+	m_framebuffers.clear();
+	m_depthbuffers.clear();
 }
 
 /////////////////////////////////////////////////////////////
@@ -1659,6 +1693,8 @@ void CGSH_OpenGL::FlushVertexBuffer()
 
 	assert(m_renderState.isValid == true);
 
+	UploadVertexBuffer();
+
 	if(m_renderState.technique == TECHNIQUE::STANDARD)
 	{
 		auto shader = GetShaderFromCaps(m_renderState.shaderCaps);
@@ -1703,6 +1739,44 @@ void CGSH_OpenGL::FlushVertexBuffer()
 	m_vertexBuffer.clear();
 }
 
+void CGSH_OpenGL::UploadVertexBuffer()
+{
+	uint32 vertexCount = static_cast<uint32>(m_vertexBuffer.size());
+	assert(vertexCount != 0);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_primBuffer);
+
+	if(vertexCount > PRIM_BUFFER_SIZE)
+	{
+		//Too big to fit in the streaming buffer, upload it through a temporary storage
+		glBufferData(GL_ARRAY_BUFFER, sizeof(PRIM_VERTEX) * vertexCount, m_vertexBuffer.data(), GL_STREAM_DRAW);
+		//Make sure the streaming buffer gets reallocated on next upload
+		m_primBufferOffset = PRIM_BUFFER_SIZE;
+		m_primBufferDrawOffset = 0;
+		CHECKGLERROR();
+		return;
+	}
+
+	if((m_primBufferOffset + vertexCount) > PRIM_BUFFER_SIZE)
+	{
+		//Orphan the buffer, driver will give us fresh storage while
+		//draws referencing the previous one are still in flight
+		glBufferData(GL_ARRAY_BUFFER, sizeof(PRIM_VERTEX) * PRIM_BUFFER_SIZE, nullptr, GL_STREAM_DRAW);
+		m_primBufferOffset = 0;
+	}
+
+	//Region we're writing to hasn't been used since the buffer was last orphaned, no need to synchronize
+	void* bufferPtr = glMapBufferRange(GL_ARRAY_BUFFER, sizeof(PRIM_VERTEX) * m_primBufferOffset, sizeof(PRIM_VERTEX) * vertexCount,
+	                                   GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+	assert(bufferPtr);
+	memcpy(bufferPtr, m_vertexBuffer.data(), sizeof(PRIM_VERTEX) * vertexCount);
+	glUnmapBuffer(GL_ARRAY_BUFFER);
+	CHECKGLERROR();
+
+	m_primBufferDrawOffset = m_primBufferOffset;
+	m_primBufferOffset += vertexCount;
+}
+
 void CGSH_OpenGL::DoRenderPass()
 {
 	if((m_validGlState & GLSTATE_VERTEX_PARAMS) == 0)
@@ -1796,35 +1870,33 @@ void CGSH_OpenGL::DoRenderPass()
 	glBindBufferBase(GL_UNIFORM_BUFFER, 0, m_vertexParamsBuffer);
 	glBindBufferBase(GL_UNIFORM_BUFFER, 1, m_fragmentParamsBuffer);
 
-	glBindBuffer(GL_ARRAY_BUFFER, m_primBuffer);
-	glBufferData(GL_ARRAY_BUFFER, sizeof(PRIM_VERTEX) * m_vertexBuffer.size(), m_vertexBuffer.data(), GL_STREAM_DRAW);
-
 	glBindVertexArray(m_primVertexArray);
 
-	GLenum primitiveMode = GL_NONE;
-	switch(m_primitiveType)
+	GLenum primitiveMode = GetPrimitiveMode(m_primitiveType);
+	assert(primitiveMode != GL_NONE);
+
+	glDrawArrays(primitiveMode, m_primBufferDrawOffset, m_vertexBuffer.size());
+
+	m_drawCallCount++;
+}
+
+GLenum CGSH_OpenGL::GetPrimitiveMode(unsigned int primitiveType)
+{
+	switch(primitiveType)
 	{
 	case PRIM_POINT:
-		primitiveMode = GL_POINTS;
-		break;
+		return GL_POINTS;
 	case PRIM_LINE:
 	case PRIM_LINESTRIP:
-		primitiveMode = GL_LINES;
-		break;
+		return GL_LINES;
 	case PRIM_TRIANGLE:
 	case PRIM_TRIANGLESTRIP:
 	case PRIM_TRIANGLEFAN:
 	case PRIM_SPRITE:
-		primitiveMode = GL_TRIANGLES;
-		break;
+		return GL_TRIANGLES;
 	default:
-		assert(false);
-		break;
+		return GL_NONE;
 	}
-
-	glDrawArrays(primitiveMode, 0, m_vertexBuffer.size());
-
-	m_drawCallCount++;
 }
 
 void CGSH_OpenGL::DrawToDepth(unsigned int primitiveType, uint64 primReg)
@@ -1921,7 +1993,9 @@ void CGSH_OpenGL::WriteRegisterImpl(uint8 nRegister, uint64 nData)
 	case GS_REG_PRIM:
 	{
 		unsigned int newPrimitiveType = static_cast<unsigned int>(nData & 0x07);
-		if(newPrimitiveType != m_primitiveType)
+		//Primitives are all expanded to points, lines or triangles,
+		//batch can go on as long as the GL primitive mode is the same
+		if(GetPrimitiveMode(newPrimitiveType) != GetPrimitiveMode(m_primitiveType))
 		{
 			FlushVertexBuffer();
 		}
@@ -2070,8 +2144,9 @@ void CGSH_OpenGL::ProcessHostToLocalTransfer()
 		m_textureCache.InvalidateRange(transferAddress + transferOffset, transferSize);
 
 		bool isUpperByteTransfer = (bltBuf.nDstPsm == PSMT8H) || (bltBuf.nDstPsm == PSMT4HL) || (bltBuf.nDstPsm == PSMT4HH);
-		for(const auto& framebuffer : m_framebuffers)
+		for(const auto& framebufferPair : m_framebuffers)
 		{
+			const auto& framebuffer = framebufferPair.second;
 			if((framebuffer->m_psm == PSMCT24) && isUpperByteTransfer) continue;
 			framebuffer->m_cachedArea.Invalidate(transferAddress + transferOffset, transferSize);
 		}
@@ -2094,12 +2169,11 @@ void CGSH_OpenGL::ProcessLocalToHostTransfer()
 	if((trxReg.nRRW != 32) || (trxReg.nRRH != 32)) return;
 	if((trxPos.nSSAX != 0) || (trxPos.nSSAY != 0)) return;
 
-	auto framebufferIterator = std::find_if(m_framebuffers.begin(), m_framebuffers.end(),
-	                                        [](const FramebufferPtr& framebuffer) {
-		                                        return (framebuffer->m_psm == PSMCT32) && (framebuffer->m_basePtr == 0);
-	                                        });
-	if(framebufferIterator == std::end(m_framebuffers)) return;
-	const auto& framebuffer = (*framebufferIterator);
+	auto framebuffer = FindFramebuffer(0, 0,
+	                                   [](const FramebufferPtr& candidateFramebuffer) {
+		                                   return (candidateFramebuffer->m_psm == PSMCT32);
+	                                   });
+	if(!framebuffer) return;
 
 	FlushVertexBuffer();
 	m_renderState.isValid = false;
@@ -2129,26 +2203,19 @@ void CGSH_OpenGL::ProcessLocalToHostTransfer()
 void CGSH_OpenGL::ProcessLocalToLocalTransfer()
 {
 	auto bltBuf = make_convertible<BITBLTBUF>(m_nReg[GS_REG_BITBLTBUF]);
-	auto srcFramebufferIterator = std::find_if(m_framebuffers.begin(), m_framebuffers.end(),
-	                                           [&](const FramebufferPtr& framebuffer) {
-		                                           return (framebuffer->m_basePtr == bltBuf.GetSrcPtr()) &&
-		                                                  (framebuffer->m_width == bltBuf.GetSrcWidth());
-	                                           });
-	auto dstFramebufferIterator = std::find_if(m_framebuffers.begin(), m_framebuffers.end(),
-	                                           [&](const FramebufferPtr& framebuffer) {
-		                                           return (framebuffer->m_basePtr == bltBuf.GetDstPtr()) &&
-		                                                  (framebuffer->m_width == bltBuf.GetDstWidth());
-	                                           });
-	if(
-	    srcFramebufferIterator != std::end(m_framebuffers) &&
-	    dstFramebufferIterator != std::end(m_framebuffers))
+	auto srcFramebuffer = FindFramebuffer(bltBuf.GetSrcPtr(), bltBuf.GetSrcPtr(),
+	                                      [&](const FramebufferPtr& framebuffer) {
+		                                      return (framebuffer->m_width == bltBuf.GetSrcWidth());
+	                                      });
+	auto dstFramebuffer = FindFramebuffer(bltBuf.GetDstPtr(), bltBuf.GetDstPtr(),
+	                                      [&](const FramebufferPtr& framebuffer) {
+		                                      return (framebuffer->m_width == bltBuf.GetDstWidth());
+	                                      });
+	if(srcFramebuffer && dstFramebuffer)
 	{
 		FlushVertexBuffer();
 		m_renderState.isValid = false;
 
-		const auto& srcFramebuffer = (*srcFramebufferIterator);
-		const auto& dstFramebuffer = (*dstFramebufferIterator);
-
 		glBindFramebuffer(GL_FRAMEBUFFER, dstFramebuffer->m_framebuffer);
 		glBindFramebuffer(GL_READ_FRAMEBUFFER, srcFramebuffer->m_framebuffer);
 
@@ -1,6 +1,7 @@
 #pragma once
 
 #include <list>
+#include <map>
 #include <unordered_map>
 #include "../GSHandler.h"
 #include "../GsCachedArea.h"
@@ -27,7 +28,7 @@ public:
 
 	static void RegisterPreferences();
 
-	virtual void LoadState(Framework::CZipArchiveReader&) override;
+	virtual void LoadState(Framework::CZipArchiveReader&, bool) override;
 
 	void ProcessHostToLocalTransfer() override;
 	void ProcessLocalToHostTransfer() override;
@@ -205,10 +206,12 @@ private:
 		uint32 m_cpsm;
 		uint32 m_csa;
 		GLuint m_texture;
+		uint64 m_hash;
 		uint32 m_contents[256];
 	};
 	typedef std::shared_ptr<CPalette> PalettePtr;
 	typedef std::list<PalettePtr> PaletteList;
+	typedef std::unordered_multimap<uint64, PaletteList::iterator> PaletteHashIndex;
 
 	class CFramebuffer
 	{
@@ -231,7 +234,7 @@ private:
 		CGsCachedArea m_cachedArea;
 	};
 	typedef std::shared_ptr<CFramebuffer> FramebufferPtr;
-	typedef std::vector<FramebufferPtr> FramebufferList;
+	typedef std::multimap<uint32, FramebufferPtr> FramebufferMap;
 
 	class CDepthbuffer
 	{
@@ -246,7 +249,7 @@ private:
 		GLuint m_depthBuffer;
 	};
 	typedef std::shared_ptr<CDepthbuffer> DepthbufferPtr;
-	typedef std::vector<DepthbufferPtr> DepthbufferList;
+	typedef std::multimap<uint32, DepthbufferPtr> DepthbufferMap;
 
 	struct TEXTURE_INFO
 	{
@@ -287,6 +290,23 @@ private:
 		VERTEX_BUFFER_SIZE = 0x1000,
 	};
 
+	//Size (in vertices) of the GPU side streaming buffer used for primitives.
+	//Vertices are appended to it until it's full, then it's orphaned.
+	enum PRIM_BUFFER_SIZE
+	{
+		PRIM_BUFFER_SIZE = 0x20000,
+	};
+
+	//Register bits that affect derived render states. Changes outside of
+	//these bits don't require the vertex buffer to be flushed.
+	enum : uint64
+	{
+		PRIM_BLEND_STATE_MASK = 0x40,        //ABE
+		PRIM_TEXTURE_STATE_MASK = 0x10,      //TME
+		TEST_FUNCTIONS_STATE_MASK = 0x70FF0, //AREF, ZTE, ZTST
+		TEST_ALPHAFAIL_STATE_MASK = 0x300F,  //ATE, ATST, AFAIL
+	};
+
 	typedef std::vector<PRIM_VERTEX> VertexBuffer;
 
 	void WriteRegisterImpl(uint8, uint64) override;
@@ -325,7 +345,10 @@ private:
 	void Prim_Triangle();
 	void Prim_Sprite();
 
+	static GLenum GetPrimitiveMode(unsigned int);
+
 	void FlushVertexBuffer();
+	void UploadVertexBuffer();
 	void DoRenderPass();
 
 	void CopyToFb(int32, int32, int32, int32, int32, int32, int32, int32, int32, int32);
@@ -349,6 +372,11 @@ private:
 
 	FramebufferPtr FindFramebuffer(const FRAME&) const;
 	DepthbufferPtr FindDepthbuffer(const ZBUF&, const FRAME&) const;
+	FramebufferPtr FindFramebuffer(uint32, uint32, const std::function<bool(const FramebufferPtr&)>&) const;
+
+	void AddFramebuffer(const FramebufferPtr&);
+	void AddDepthbuffer(const DepthbufferPtr&);
+	void ClearRenderTargets();
 
 	void DumpTexture(unsigned int, unsigned int, uint32);
 
@@ -378,8 +406,8 @@ private:
 	uint8* m_pCvtBuffer;
 
 	GLuint PalCache_Search(const TEX0&);
-	GLuint PalCache_Search(unsigned int, const uint32*);
-	void PalCache_Insert(const TEX0&, const uint32*, GLuint);
+	GLuint PalCache_Search(uint64, unsigned int, const uint32*);
+	void PalCache_Insert(const TEX0&, uint64, const uint32*, GLuint);
 	void PalCache_Invalidate(uint32);
 
 	void PopulateFramebuffer(const FramebufferPtr&);
@@ -401,11 +429,14 @@ private:
 
 	TextureCache m_textureCache;
 	PaletteList m_paletteCache;
-	FramebufferList m_framebuffers;
-	DepthbufferList m_depthbuffers;
+	PaletteHashIndex m_paletteHashIndex;
+	FramebufferMap m_framebuffers;
+	DepthbufferMap m_depthbuffers;
 
 	Framework::OpenGl::CBuffer m_primBuffer;
 	Framework::OpenGl::CVertexArray m_primVertexArray;
+	uint32 m_primBufferOffset = 0;
+	uint32 m_primBufferDrawOffset = 0;
 
 	VERTEX m_VtxBuffer[3];
 	int m_nVtxCount;
@@ -81,8 +81,11 @@ CGSH_OpenGL::TEXTURE_INFO CGSH_OpenGL::SearchTextureFramebuffer(const TEX0& tex0
 	FramebufferPtr framebuffer;
 
 	//First pass, look for an exact match
-	for(const auto& candidateFramebuffer : m_framebuffers)
+	auto exactRange = m_framebuffers.equal_range(tex0.GetBufPtr());
+	for(auto framebufferIterator = exactRange.first; framebufferIterator != exactRange.second; framebufferIterator++)
 	{
+		const auto& candidateFramebuffer = framebufferIterator->second;
+
 		//Case: TEX0 points at the start of a frame buffer with the same width
 		if(candidateFramebuffer->m_basePtr == tex0.GetBufPtr() &&
 		   candidateFramebuffer->m_width == tex0.GetBufWidth() &&
@@ -108,8 +111,16 @@ CGSH_OpenGL::TEXTURE_INFO CGSH_OpenGL::SearchTextureFramebuffer(const TEX0& tex0
 	if(!framebuffer)
 	{
 		//Second pass, be a bit more flexible
-		for(const auto& candidateFramebuffer : m_framebuffers)
+		//Only framebuffers that start at most one line of pages before TEX0's pointer are candidates
+		auto texturePageSize = CGsPixelFormats::GetPsmPageSize(tex0.nPsm);
+		uint32 maxFramebufferOffset = (tex0.GetBufWidth() / texturePageSize.first) * CGsPixelFormats::PAGESIZE;
+		uint32 minBasePtr = (tex0.GetBufPtr() > maxFramebufferOffset) ? (tex0.GetBufPtr() - maxFramebufferOffset) : 0;
+		auto framebufferIterator = m_framebuffers.lower_bound(minBasePtr);
+		auto framebufferEndIterator = m_framebuffers.upper_bound(tex0.GetBufPtr());
+		for(; framebufferIterator != framebufferEndIterator; framebufferIterator++)
 		{
+			const auto& candidateFramebuffer = framebufferIterator->second;
+
 			//Another case: TEX0 is pointing to the start of a page within our framebuffer (BGDA does this)
 			if(candidateFramebuffer->m_basePtr <= tex0.GetBufPtr() &&
 			   candidateFramebuffer->m_width == tex0.GetBufWidth() &&
@@ -236,8 +247,9 @@ GLuint CGSH_OpenGL::PreparePalette(const TEX0& tex0)
 	std::array<uint32, 256> convertedClut;
 	MakeLinearCLUT(tex0, convertedClut);
 
+	uint64 clutHash = GetCLUTHash(tex0);
 	unsigned int entryCount = CGsPixelFormats::IsPsmIDTEX4(tex0.nPsm) ? 16 : 256;
-	textureHandle = PalCache_Search(entryCount, convertedClut.data());
+	textureHandle = PalCache_Search(clutHash, entryCount, convertedClut.data());
 	if(textureHandle != 0)
 	{
 		return textureHandle;
@@ -247,7 +259,7 @@ GLuint CGSH_OpenGL::PreparePalette(const TEX0& tex0)
 	glBindTexture(GL_TEXTURE_2D, textureHandle);
 	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA, entryCount, 1, 0, GL_RGBA, GL_UNSIGNED_BYTE, convertedClut.data());
 
-	PalCache_Insert(tex0, convertedClut.data(), textureHandle);
+	PalCache_Insert(tex0, clutHash, convertedClut.data(), textureHandle);
 
 	return textureHandle;
 }
@@ -375,6 +387,7 @@ CGSH_OpenGL::CPalette::CPalette()
     , m_cpsm(0)
     , m_csa(0)
     , m_texture(0)
+    , m_hash(0)
 {
 }
 
@@ -422,11 +435,13 @@ GLuint CGSH_OpenGL::PalCache_Search(const TEX0& tex0)
 	return 0;
 }
 
-GLuint CGSH_OpenGL::PalCache_Search(unsigned int entryCount, const uint32* contents)
+GLuint CGSH_OpenGL::PalCache_Search(uint64 hash, unsigned int entryCount, const uint32* contents)
 {
-	for(auto paletteIterator(m_paletteCache.begin());
-	    paletteIterator != m_paletteCache.end(); paletteIterator++)
+	//Only palettes with the same hash need to have their contents compared
+	auto hashRange = m_paletteHashIndex.equal_range(hash);
+	for(auto indexIterator = hashRange.first; indexIterator != hashRange.second; indexIterator++)
 	{
+		auto paletteIterator = indexIterator->second;
 		auto palette = *paletteIterator;
 
 		if(palette->m_texture == 0) continue;
@@ -438,17 +453,32 @@ GLuint CGSH_OpenGL::PalCache_Search(unsigned int entryCount, const uint32* conte
 
 		palette->m_live = true;
 
-		m_paletteCache.erase(paletteIterator);
-		m_paletteCache.push_front(palette);
+		m_paletteCache.splice(m_paletteCache.begin(), m_paletteCache, paletteIterator);
 		return palette->m_texture;
 	}
 
 	return 0;
 }
 
-void CGSH_OpenGL::PalCache_Insert(const TEX0& tex0, const uint32* contents, GLuint textureHandle)
+void CGSH_OpenGL::PalCache_Insert(const TEX0& tex0, uint64 hash, const uint32* contents, GLuint textureHandle)
 {
-	auto texture = *m_paletteCache.rbegin();
+	auto paletteIterator = std::prev(m_paletteCache.end());
+	auto texture = *paletteIterator;
+
+	if(texture->m_texture != 0)
+	{
+		//Remove the evicted palette from the hash index
+		auto hashRange = m_paletteHashIndex.equal_range(texture->m_hash);
+		for(auto indexIterator = hashRange.first; indexIterator != hashRange.second; indexIterator++)
+		{
+			if(indexIterator->second == paletteIterator)
+			{
+				m_paletteHashIndex.erase(indexIterator);
+				break;
+			}
+		}
+	}
+
 	texture->Free();
 
 	unsigned int entryCount = CGsPixelFormats::IsPsmIDTEX4(tex0.nPsm) ? 16 : 256;
@@ -457,11 +487,12 @@ void CGSH_OpenGL::PalCache_Insert(const TEX0& tex0, const uint32* contents, GLui
 	texture->m_cpsm = tex0.nCPSM;
 	texture->m_csa = tex0.nCSA;
 	texture->m_texture = textureHandle;
+	texture->m_hash = hash;
 	texture->m_live = true;
 	memcpy(texture->m_contents, contents, entryCount * sizeof(uint32));
 
-	m_paletteCache.pop_back();
-	m_paletteCache.push_front(texture);
+	m_paletteCache.splice(m_paletteCache.begin(), m_paletteCache, paletteIterator);
+	m_paletteHashIndex.insert(std::make_pair(hash, paletteIterator));
 }
 
 void CGSH_OpenGL::PalCache_Invalidate(uint32 csa)
@@ -474,4 +505,5 @@ void CGSH_OpenGL::PalCache_Flush()
 {
 	std::for_each(std::begin(m_paletteCache), std::end(m_paletteCache),
 	              [](PalettePtr& palette) { palette->Free(); });
+	m_paletteHashIndex.clear();
 }
@@ -1,11 +1,14 @@
 #include <stdio.h>
 #include <string.h>
 #include <functional>
+#include <algorithm>
+#include <chrono>
 #include "../AppConfig.h"
 #include "../Log.h"
 #include "../states/MemoryStateFile.h"
 #include "../states/RegisterStateFile.h"
 #include "../FrameDump.h"
+#include "../PerfCounters.h"
 #include "../ee/INTC.h"
 #include "GSHandler.h"
 #include "GsPixelFormats.h"
@@ -62,6 +65,12 @@ struct MASSIVEWRITE_INFO
 	CGSHandler::RegisterWriteList writes;
 };
 
+static uint64 GetElapsedTime(const std::chrono::steady_clock::time_point& startTime)
+{
+	auto elapsed = std::chrono::steady_clock::now() - startTime;
+	return std::chrono::duration_cast<std::chrono::nanoseconds>(elapsed).count();
+}
+
 CGSHandler::CGSHandler()
     : m_threadDone(false)
     , m_drawCallCount(0)
@@ -69,6 +78,9 @@ CGSHandler::CGSHandler()
     , m_pRAM(nullptr)
     , m_frameDump(nullptr)
     , m_loggingEnabled(true)
+    , m_readbackStallTime(0)
+    , m_lastFrameReadbackStallTime(0)
+    , m_gsProfilerZone(CProfiler::GetInstance().RegisterZone("GS"))
 {
 	RegisterPreferences();
 
@@ -114,6 +126,7 @@ CGSHandler::~CGSHandler()
 void CGSHandler::RegisterPreferences()
 {
 	CAppConfig::GetInstance().RegisterPreferenceInteger(PREF_CGSHANDLER_PRESENTATION_MODE, CGSHandler::PRESENTATION_MODE_FIT);
+	CAppConfig::GetInstance().RegisterPreferenceBoolean(PREF_CGSHANDLER_PIPELINED_READBACK, false);
 }
 
 void CGSHandler::NotifyPreferencesChanged()
@@ -155,6 +168,18 @@ void CGSHandler::ResetBase()
 	m_nCBP0 = 0;
 	m_nCBP1 = 0;
 	m_transferCount = 0;
+	UpdateCLUTHashes(0, CLUTENTRYCOUNT);
+	m_clutLoadCacheValid = false;
+	//Only sampled on reset, both threads need to agree on this setting
+	m_pipelinedReadbackEnabled = CAppConfig::GetInstance().GetPreferenceBoolean(PREF_CGSHANDLER_PIPELINED_READBACK);
+	{
+		std::lock_guard<std::mutex> readbackLock(m_readbackMutex);
+		m_readbackRequestCount = 0;
+		m_readbackCompleteCount = 0;
+		m_readbackBuffer.clear();
+	}
+	m_readbackStallTime = 0;
+	m_lastFrameReadbackStallTime = 0;
 }
 
 void CGSHandler::ResetImpl()
@@ -170,9 +195,12 @@ void CGSHandler::SetPresentationParams(const PRESENTATION_PARAMS& presentationPa
 	m_presentationParams = presentationParams;
 }
 
-void CGSHandler::SaveState(Framework::CZipArchiveWriter& archive)
+void CGSHandler::SaveState(Framework::CZipArchiveWriter& archive, bool includeMemory)
 {
-	archive.InsertFile(new CMemoryStateFile(STATE_RAM, m_pRAM, RAMSIZE));
+	if(includeMemory)
+	{
+		archive.InsertFile(new CMemoryStateFile(STATE_RAM, m_pRAM, RAMSIZE));
+	}
 	archive.InsertFile(new CMemoryStateFile(STATE_REGS, m_nReg, sizeof(uint64) * CGSHandler::REGISTER_MAX));
 	archive.InsertFile(new CMemoryStateFile(STATE_TRXCTX, &m_trxCtx, sizeof(TRXCONTEXT)));
 
@@ -194,11 +222,15 @@ void CGSHandler::SaveState(Framework::CZipArchiveWriter& archive)
 	}
 }
 
-void CGSHandler::LoadState(Framework::CZipArchiveReader& archive)
+void CGSHandler::LoadState(Framework::CZipArchiveReader& archive, bool includeMemory)
 {
-	archive.BeginReadFile(STATE_RAM)->Read(m_pRAM, RAMSIZE);
+	if(includeMemory)
+	{
+		archive.BeginReadFile(STATE_RAM)->Read(m_pRAM, RAMSIZE);
+	}
 	archive.BeginReadFile(STATE_REGS)->Read(m_nReg, sizeof(uint64) * CGSHandler::REGISTER_MAX);
 	archive.BeginReadFile(STATE_TRXCTX)->Read(&m_trxCtx, sizeof(TRXCONTEXT));
+	m_clutLoadCacheValid = false;
 
 	{
 		CRegisterStateFile registerFile(*archive.BeginReadFile(STATE_PRIVREGS));
@@ -215,6 +247,11 @@ void CGSHandler::LoadState(Framework::CZipArchiveReader& archive)
 	}
 }
 
+void CGSHandler::GetStateMemoryRegions(CMemorySnapshot::RegionArray& regions)
+{
+	CMemorySnapshot::AddRegion(regions, STATE_RAM, m_pRAM, RAMSIZE);
+}
+
 void CGSHandler::SetFrameDump(CFrameDump* frameDump)
 {
 	m_frameDump = frameDump;
@@ -230,6 +267,14 @@ void CGSHandler::SetDrawEnabled(bool drawEnabled)
 	m_drawEnabled = drawEnabled;
 }
 
+void CGSHandler::SetLockstepEnabled(bool lockstepEnabled)
+{
+	if(m_lockstepEnabled == lockstepEnabled) return;
+	m_lockstepEnabled = lockstepEnabled;
+	//Start from a point where the GS thread is done with everything
+	m_mailBox.FlushCalls();
+}
+
 void CGSHandler::SetVBlank()
 {
 	{
@@ -401,6 +446,7 @@ void CGSHandler::MarkNewFrame()
 {
 	OnNewFrame(m_drawCallCount);
 	m_drawCallCount = 0;
+	m_lastFrameReadbackStallTime = m_readbackStallTime.exchange(0);
 #ifdef _DEBUG
 	CLog::GetInstance().Print(LOG_NAME, "Frame Done.\r\n---------------------------------------------------------------------------------\r\n");
 #endif
@@ -428,13 +474,22 @@ void CGSHandler::SetSMODE2(uint64 value)
 
 void CGSHandler::WriteRegister(uint8 registerId, uint64 value)
 {
-	m_mailBox.SendCall(std::bind(&CGSHandler::WriteRegisterImpl, this, registerId, value));
+	if((registerId == GS_REG_TRXDIR) && ((value & 0x03) == 1))
+	{
+		m_readbackRequestCount++;
+	}
+	CPerfCounters::GetCurrent().Add(CPerfCounters::COUNTER_GS_REGISTER_WRITES, 1);
+	m_mailBox.SendCall(std::bind(&CGSHandler::WriteRegisterImpl, this, registerId, value), m_lockstepEnabled);
 }
 
 void CGSHandler::FeedImageData(const void* data, uint32 length)
 {
 	m_transferCount++;
 
+	auto& perfCounters = CPerfCounters::GetCurrent();
+	perfCounters.Add(CPerfCounters::COUNTER_GS_PACKETS, 1);
+	perfCounters.Add(CPerfCounters::COUNTER_GS_TRANSFER_BYTES, length);
+
 	//Allocate 0x10 more bytes to allow transfer handlers
 	//to read beyond the actual length of the buffer (ie.: PSMCT24)
 
@@ -444,11 +499,37 @@ void CGSHandler::FeedImageData(const void* data, uint32 length)
 	    [this, imageData = std::move(imageData), length]() {
 		    FeedImageDataImpl(imageData.data(), length);
 	    });
+	if(m_lockstepEnabled)
+	{
+		m_mailBox.FlushCalls();
+	}
 }
 
 void CGSHandler::ReadImageData(void* data, uint32 length)
 {
-	m_mailBox.SendCall([this, data, length]() { ReadImageDataImpl(data, length); }, true);
+	auto waitStart = std::chrono::steady_clock::now();
+	if(m_pipelinedReadbackEnabled && (m_readbackRequestCount != 0))
+	{
+		//Only wait for the GS thread to reach the last requested transfer, work queued
+		//after it can keep going while we copy the data.
+		std::unique_lock<std::mutex> readbackLock(m_readbackMutex);
+		m_readbackCondition.wait(readbackLock,
+		                         [this]() { return static_cast<int32>(m_readbackCompleteCount - m_readbackRequestCount) >= 0; });
+		assert(m_readbackBuffer.size() == length);
+		uint32 copySize = std::min<uint32>(length, static_cast<uint32>(m_readbackBuffer.size()));
+		memcpy(data, m_readbackBuffer.data(), copySize);
+	}
+	else
+	{
+		m_mailBox.SendCall([this, data, length]() { ReadImageDataImpl(data, length); }, true);
+	}
+	m_readbackStallTime += GetElapsedTime(waitStart);
+	CPerfCounters::GetCurrent().Add(CPerfCounters::COUNTER_GS_TRANSFER_BYTES, length);
+}
+
+uint64 CGSHandler::GetReadbackStallTime() const
+{
+	return m_lastFrameReadbackStallTime;
 }
 
 void CGSHandler::WriteRegisterMassively(RegisterWriteList registerWrites, const CGsPacketMetadata* metadata)
@@ -473,6 +554,12 @@ void CGSHandler::WriteRegisterMassively(RegisterWriteList registerWrites, const
 			m_nCSR |= CSR_FINISH_EVENT;
 			NotifyEvent(CSR_FINISH_EVENT);
 			break;
+		case GS_REG_TRXDIR:
+			if((write.second & 0x03) == 1)
+			{
+				m_readbackRequestCount++;
+			}
+			break;
 		case GS_REG_LABEL:
 		{
 			auto label = make_convertible<LABEL>(write.second);
@@ -487,6 +574,10 @@ void CGSHandler::WriteRegisterMassively(RegisterWriteList registerWrites, const
 
 	m_transferCount++;
 
+	auto& perfCounters = CPerfCounters::GetCurrent();
+	perfCounters.Add(CPerfCounters::COUNTER_GS_PACKETS, 1);
+	perfCounters.Add(CPerfCounters::COUNTER_GS_REGISTER_WRITES, registerWrites.size());
+
 	MASSIVEWRITE_INFO massiveWrite;
 	massiveWrite.writes = std::move(registerWrites);
 #ifdef DEBUGGER_INCLUDED
@@ -504,6 +595,10 @@ void CGSHandler::WriteRegisterMassively(RegisterWriteList registerWrites, const
 	    [this, massiveWrite = std::move(massiveWrite)]() {
 		    WriteRegisterMassivelyImpl(massiveWrite);
 	    });
+	if(m_lockstepEnabled)
+	{
+		m_mailBox.FlushCalls();
+	}
 }
 
 void CGSHandler::WriteRegisterImpl(uint8 nRegister, uint64 nData)
@@ -554,6 +649,8 @@ void CGSHandler::WriteRegisterImpl(uint8 nRegister, uint64 nData)
 
 void CGSHandler::FeedImageDataImpl(const uint8* imageData, uint32 length)
 {
+	auto packetStart = std::chrono::steady_clock::now();
+
 #ifdef DEBUGGER_INCLUDED
 	if(m_frameDump)
 	{
@@ -580,6 +677,12 @@ void CGSHandler::FeedImageDataImpl(const uint8* imageData, uint32 length)
 
 		m_trxCtx.nDirty |= ((this)->*(m_transferWriteHandlers[bltBuf.nDstPsm]))(imageData, length);
 
+		if(m_clutLoadCacheValid)
+		{
+			auto transferRange = GetTransferDstRange();
+			InvalidateCLUTLoadCache(transferRange.first, transferRange.second);
+		}
+
 		m_trxCtx.nSize -= length;
 
 		if(m_trxCtx.nSize == 0)
@@ -594,6 +697,13 @@ void CGSHandler::FeedImageDataImpl(const uint8* imageData, uint32 length)
 		}
 	}
 
+	if(m_packetProfilingEnabled)
+	{
+		m_packetProfile.imagePackets.count++;
+		m_packetProfile.imagePackets.time += GetElapsedTime(packetStart);
+		m_packetProfile.imageBytes += length;
+	}
+
 	assert(m_transferCount != 0);
 	m_transferCount--;
 }
@@ -609,6 +719,20 @@ void CGSHandler::ReadImageDataImpl(void* ptr, uint32 size)
 	((this)->*(m_transferReadHandlers[bltBuf.nSrcPsm]))(ptr, size);
 }
 
+void CGSHandler::PrepareReadback()
+{
+	auto bltBuf = make_convertible<BITBLTBUF>(m_nReg[GS_REG_BITBLTBUF]);
+
+	std::lock_guard<std::mutex> readbackLock(m_readbackMutex);
+	m_readbackBuffer.resize(m_trxCtx.nSize);
+	if(!m_readbackBuffer.empty())
+	{
+		((this)->*(m_transferReadHandlers[bltBuf.nSrcPsm]))(m_readbackBuffer.data(), m_trxCtx.nSize);
+	}
+	m_readbackCompleteCount++;
+	m_readbackCondition.notify_all();
+}
+
 void CGSHandler::WriteRegisterMassivelyImpl(const MASSIVEWRITE_INFO& massiveWrite)
 {
 #ifdef DEBUGGER_INCLUDED
@@ -618,9 +742,29 @@ void CGSHandler::WriteRegisterMassivelyImpl(const MASSIVEWRITE_INFO& massiveWrit
 	}
 #endif
 
-	for(const auto& write : massiveWrite.writes)
+	if(m_packetProfilingEnabled)
 	{
-		WriteRegisterImpl(write.first, write.second);
+		auto packetStart = std::chrono::steady_clock::now();
+		for(const auto& write : massiveWrite.writes)
+		{
+			auto writeStart = std::chrono::steady_clock::now();
+			WriteRegisterImpl(write.first, write.second);
+			if(write.first < REGISTER_MAX)
+			{
+				auto& registerProfile = m_packetProfile.registers[write.first];
+				registerProfile.count++;
+				registerProfile.time += GetElapsedTime(writeStart);
+			}
+		}
+		m_packetProfile.registerPackets.count++;
+		m_packetProfile.registerPackets.time += GetElapsedTime(packetStart);
+	}
+	else
+	{
+		for(const auto& write : massiveWrite.writes)
+		{
+			WriteRegisterImpl(write.first, write.second);
+		}
 	}
 
 	assert(m_transferCount != 0);
@@ -683,7 +827,14 @@ void CGSHandler::BeginTransfer()
 		}
 		else if(trxDir == 1)
 		{
+			//Handlers can write the source area back to RAM before it's read
+			auto transferRange = GetTransferSrcRange();
+			InvalidateCLUTLoadCache(transferRange.first, transferRange.second);
 			ProcessLocalToHostTransfer();
+			if(m_pipelinedReadbackEnabled)
+			{
+				PrepareReadback();
+			}
 			CLog::GetInstance().Print(LOG_NAME, "Starting transfer from 0x%08X, buffer size %d, psm: %d, size (%dx%d)\r\n",
 			                          bltBuf.GetSrcPtr(), bltBuf.GetSrcWidth(), bltBuf.nSrcPsm, trxReg.nRRW, trxReg.nRRH);
 		}
@@ -691,10 +842,40 @@ void CGSHandler::BeginTransfer()
 	else if(trxDir == 2)
 	{
 		//Local to Local
+		auto transferRange = GetTransferDstRange();
+		InvalidateCLUTLoadCache(transferRange.first, transferRange.second);
 		ProcessLocalToLocalTransfer();
 	}
 }
 
+//Returns a conservative range of GS RAM (address, size) that can be written by the current transfer
+std::pair<uint32, uint32> CGSHandler::GetTransferDstRange() const
+{
+	auto bltBuf = make_convertible<BITBLTBUF>(m_nReg[GS_REG_BITBLTBUF]);
+	auto trxReg = make_convertible<TRXREG>(m_nReg[GS_REG_TRXREG]);
+	auto trxPos = make_convertible<TRXPOS>(m_nReg[GS_REG_TRXPOS]);
+
+	auto pageSize = CGsPixelFormats::GetPsmPageSize(bltBuf.nDstPsm);
+	uint32 pageCountX = std::max<uint32>((bltBuf.GetDstWidth() + pageSize.first - 1) / pageSize.first, 1);
+	uint32 pageCountY = (trxPos.nDSAY + trxReg.nRRH + pageSize.second - 1) / pageSize.second;
+
+	return std::make_pair(bltBuf.GetDstPtr(), pageCountX * pageCountY * CGsPixelFormats::PAGESIZE);
+}
+
+//Returns a conservative range of GS RAM (address, size) that can be read by the current transfer
+std::pair<uint32, uint32> CGSHandler::GetTransferSrcRange() const
+{
+	auto bltBuf = make_convertible<BITBLTBUF>(m_nReg[GS_REG_BITBLTBUF]);
+	auto trxReg = make_convertible<TRXREG>(m_nReg[GS_REG_TRXREG]);
+	auto trxPos = make_convertible<TRXPOS>(m_nReg[GS_REG_TRXPOS]);
+
+	auto pageSize = CGsPixelFormats::GetPsmPageSize(bltBuf.nSrcPsm);
+	uint32 pageCountX = std::max<uint32>((bltBuf.GetSrcWidth() + pageSize.first - 1) / pageSize.first, 1);
+	uint32 pageCountY = (trxPos.nSSAY + trxReg.nRRH + pageSize.second - 1) / pageSize.second;
+
+	return std::make_pair(bltBuf.GetSrcPtr(), pageCountX * pageCountY * CGsPixelFormats::PAGESIZE);
+}
+
 bool CGSHandler::TransferWriteHandlerInvalid(const void* pData, uint32 nLength)
 {
 	assert(0);
@@ -1034,6 +1215,11 @@ bool CGSHandler::ReadCLUT4_16(const TEX0& tex0)
 		}
 	}
 
+	if(changed)
+	{
+		UpdateCLUTHashes(clutOffset, 0x10);
+	}
+
 	return changed;
 }
 
@@ -1062,6 +1248,11 @@ bool CGSHandler::ReadCLUT8_16(const TEX0& tex0)
 		}
 	}
 
+	if(changed)
+	{
+		UpdateCLUTHashes(0, 0x100);
+	}
+
 	return changed;
 }
 
@@ -1098,6 +1289,12 @@ void CGSHandler::ReadCLUT4(const TEX0& tex0)
 		assert(0);
 	}
 
+	if(updateNeeded && IsCLUTLoadCached(tex0))
+	{
+		//Same CLUT source was loaded last time and hasn't been written to since
+		updateNeeded = false;
+	}
+
 	if(updateNeeded)
 	{
 		bool changed = false;
@@ -1133,6 +1330,12 @@ void CGSHandler::ReadCLUT4(const TEX0& tex0)
 						pDst++;
 					}
 				}
+
+				if(changed)
+				{
+					UpdateCLUTHashes(clutOffset + 0x000, 0x10);
+					UpdateCLUTHashes(clutOffset + 0x100, 0x10);
+				}
 			}
 			else if(tex0.nCPSM == PSMCT16)
 			{
@@ -1146,11 +1349,14 @@ void CGSHandler::ReadCLUT4(const TEX0& tex0)
 			{
 				assert(0);
 			}
+
+			SetCLUTLoadCached(tex0);
 		}
 		else
 		{
 			//CSM2 mode
 			assert(tex0.nCPSM == PSMCT16);
+			m_clutLoadCacheValid = false;
 			assert(tex0.nCSA == 0);
 
 			auto texClut = make_convertible<TEXCLUT>(m_nReg[GS_REG_TEXCLUT]);
@@ -1171,6 +1377,11 @@ void CGSHandler::ReadCLUT4(const TEX0& tex0)
 
 				(*pDst++) = color;
 			}
+
+			if(changed)
+			{
+				UpdateCLUTHashes(0, 0x10);
+			}
 		}
 
 		if(changed)
@@ -1215,6 +1426,12 @@ void CGSHandler::ReadCLUT8(const TEX0& tex0)
 		assert(0);
 	}
 
+	if(updateNeeded && IsCLUTLoadCached(tex0))
+	{
+		//Same CLUT source was loaded last time and hasn't been written to since
+		updateNeeded = false;
+	}
+
 	if(updateNeeded)
 	{
 		bool changed = false;
@@ -1247,6 +1464,11 @@ void CGSHandler::ReadCLUT8(const TEX0& tex0)
 						m_pCLUT[index + 0x100] = colorHi;
 					}
 				}
+
+				if(changed)
+				{
+					UpdateCLUTHashes(0, CLUTENTRYCOUNT);
+				}
 			}
 			else if(tex0.nCPSM == PSMCT16)
 			{
@@ -1260,11 +1482,14 @@ void CGSHandler::ReadCLUT8(const TEX0& tex0)
 			{
 				assert(0);
 			}
+
+			SetCLUTLoadCached(tex0);
 		}
 		else
 		{
 			//CSM2 mode
 			assert(tex0.nCPSM == PSMCT16);
+			m_clutLoadCacheValid = false;
 
 			auto texClut = make_convertible<TEXCLUT>(m_nReg[GS_REG_TEXCLUT]);
 
@@ -1284,6 +1509,11 @@ void CGSHandler::ReadCLUT8(const TEX0& tex0)
 
 				(*dst++) = color;
 			}
+
+			if(changed)
+			{
+				UpdateCLUTHashes(0, 0x100);
+			}
 		}
 
 		if(changed)
@@ -1293,6 +1523,107 @@ void CGSHandler::ReadCLUT8(const TEX0& tex0)
 	}
 }
 
+void CGSHandler::UpdateCLUTHashes(uint32 firstEntry, uint32 entryCount)
+{
+	assert((firstEntry + entryCount) <= CLUTENTRYCOUNT);
+	uint32 firstBlock = firstEntry / CLUTBLOCKSIZE;
+	uint32 lastBlock = (firstEntry + entryCount - 1) / CLUTBLOCKSIZE;
+	for(uint32 blockIndex = firstBlock; blockIndex <= lastBlock; blockIndex++)
+	{
+		//FNV-1a
+		uint32 hash = 0x811C9DC5;
+		const uint16* block = m_pCLUT + (blockIndex * CLUTBLOCKSIZE);
+		for(uint32 i = 0; i < CLUTBLOCKSIZE; i++)
+		{
+			hash = (hash ^ block[i]) * 0x01000193;
+		}
+		m_clutBlockHashes[blockIndex] = hash;
+	}
+}
+
+//Only TEX0 fields that affect which data is read from GS RAM are kept in the key
+static uint64 MakeCLUTLoadCacheKey(const CGSHandler::TEX0& tex0)
+{
+	//CBP, CPSM, CSM and CSA
+	static const uint64 clutSourceMask = 0x1FFFFFE000000000ULL;
+	return (static_cast<uint64>(tex0) & clutSourceMask) | (CGsPixelFormats::IsPsmIDTEX4(tex0.nPsm) ? 1 : 0);
+}
+
+bool CGSHandler::IsCLUTLoadCached(const TEX0& tex0) const
+{
+	//CSM2 also depends on TEXCLUT, don't bother with it
+	if(tex0.nCSM != 0) return false;
+	return m_clutLoadCacheValid && (m_clutLoadCacheKey == MakeCLUTLoadCacheKey(tex0));
+}
+
+void CGSHandler::SetCLUTLoadCached(const TEX0& tex0)
+{
+	assert(tex0.nCSM == 0);
+	m_clutLoadCacheKey = MakeCLUTLoadCacheKey(tex0);
+	m_clutLoadCacheValid = true;
+}
+
+void CGSHandler::InvalidateCLUTLoadCache(uint32 address, uint32 size)
+{
+	if(!m_clutLoadCacheValid) return;
+
+	//CLUT source can't span more than two pages from its page aligned base
+	auto tex0 = make_convertible<TEX0>(m_clutLoadCacheKey);
+	uint32 clutStart = tex0.GetCLUTPtr() & ~(CGsPixelFormats::PAGESIZE - 1);
+	uint32 clutEnd = clutStart + (CGsPixelFormats::PAGESIZE * 2);
+	uint32 end = address + size;
+	if((address < clutEnd) && (end > clutStart))
+	{
+		m_clutLoadCacheValid = false;
+	}
+}
+
+uint64 CGSHandler::GetCLUTHash(const TEX0& tex0) const
+{
+	bool isIdTex4 = CGsPixelFormats::IsPsmIDTEX4(tex0.nPsm);
+	bool isClut32 = (tex0.nCPSM == PSMCT32) || (tex0.nCPSM == PSMCT24);
+
+	//Seed with format info since conversion to linear CLUT depends on it
+	uint64 hash = 0xCBF29CE484222325ULL ^ ((isIdTex4 ? 1 : 0) | (isClut32 ? 2 : 0));
+	auto mixBlock =
+	    [&](uint32 blockIndex) {
+		    hash = (hash ^ m_clutBlockHashes[blockIndex]) * 0x100000001B3ULL;
+	    };
+
+	//Follows the layout used by MakeLinearCLUT
+	if(isIdTex4)
+	{
+		if(isClut32)
+		{
+			uint32 blockIndex = tex0.nCSA & 0x0F;
+			mixBlock(blockIndex);
+			mixBlock(blockIndex + (CLUTBLOCKCOUNT / 2));
+		}
+		else
+		{
+			mixBlock(tex0.nCSA);
+		}
+	}
+	else
+	{
+		for(uint32 i = 0; i < (CLUTBLOCKCOUNT / 2); i++)
+		{
+			if(isClut32)
+			{
+				uint32 blockIndex = (tex0.nCSA + i) & 0x0F;
+				mixBlock(blockIndex);
+				mixBlock(blockIndex + (CLUTBLOCKCOUNT / 2));
+			}
+			else
+			{
+				mixBlock(i);
+			}
+		}
+	}
+
+	return hash;
+}
+
 bool CGSHandler::IsCompatibleFramebufferPSM(unsigned int psmFb, unsigned int psmTex)
 {
 	if((psmTex == CGSHandler::PSMCT32) || (psmTex == CGSHandler::PSMCT24))
@@ -1378,6 +1709,23 @@ void CGSHandler::SetLoggingEnabled(bool loggingEnabled)
 	m_loggingEnabled = loggingEnabled;
 }
 
+void CGSHandler::SetPacketProfilingEnabled(bool packetProfilingEnabled)
+{
+	m_mailBox.SendCall([this, packetProfilingEnabled]() { m_packetProfilingEnabled = packetProfilingEnabled; }, true);
+}
+
+CGSHandler::PACKET_PROFILE CGSHandler::GetPacketProfile()
+{
+	PACKET_PROFILE result;
+	m_mailBox.SendCall([this, &result]() { result = m_packetProfile; }, true);
+	return result;
+}
+
+void CGSHandler::ResetPacketProfile()
+{
+	m_mailBox.SendCall([this]() { m_packetProfile = PACKET_PROFILE(); }, true);
+}
+
 std::string CGSHandler::DisassembleWrite(uint8 registerId, uint64 data)
 {
 	std::string result;
@@ -1718,9 +2066,13 @@ void CGSHandler::WriteToDelayedRegister(uint32 address, uint32 value, DELAYED_RE
 
 void CGSHandler::ThreadProc()
 {
+	CProfiler::GetInstance().SetThreadName("GS");
 	while(!m_threadDone)
 	{
 		m_mailBox.WaitForCall();
+#ifdef PROFILE
+		CProfilerZone profilerZone(m_gsProfilerZone);
+#endif
 		while(m_mailBox.IsPending())
 		{
 			m_mailBox.ReceiveCall();
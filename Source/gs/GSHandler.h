@@ -4,6 +4,8 @@
 #include <vector>
 #include <functional>
 #include <atomic>
+#include <mutex>
+#include <condition_variable>
 #include <array>
 #include "signal/Signal.h"
 
@@ -11,9 +13,11 @@
 #include "Types.h"
 #include "Convertible.h"
 #include "../MailBox.h"
+#include "../Profiler.h"
 #include "../Integer64.h"
 #include "zip/ZipArchiveWriter.h"
 #include "zip/ZipArchiveReader.h"
+#include "../states/MemorySnapshot.h"
 
 class CFrameDump;
 class CGsPacketMetadata;
@@ -21,6 +25,7 @@ class CINTC;
 struct MASSIVEWRITE_INFO;
 
 #define PREF_CGSHANDLER_PRESENTATION_MODE "renderer.presentationmode"
+#define PREF_CGSHANDLER_PIPELINED_READBACK "renderer.pipelinedreadback"
 
 enum GS_REGS
 {
@@ -701,6 +706,20 @@ public:
 	typedef std::vector<RegisterWrite> RegisterWriteList;
 	typedef std::function<CGSHandler*(void)> FactoryFunction;
 
+	struct PROFILE_ENTRY
+	{
+		uint64 count = 0;
+		uint64 time = 0; //In nanoseconds
+	};
+
+	struct PACKET_PROFILE
+	{
+		PROFILE_ENTRY registerPackets;
+		PROFILE_ENTRY imagePackets;
+		uint64 imageBytes = 0;
+		PROFILE_ENTRY registers[REGISTER_MAX];
+	};
+
 	typedef Framework::CSignal<void()> FlipCompleteEvent;
 	typedef Framework::CSignal<void(uint32)> NewFrameEvent;
 
@@ -714,18 +733,28 @@ public:
 	void Reset();
 	void SetPresentationParams(const PRESENTATION_PARAMS&);
 
-	virtual void SaveState(Framework::CZipArchiveWriter&);
-	virtual void LoadState(Framework::CZipArchiveReader&);
+	virtual void SaveState(Framework::CZipArchiveWriter&, bool);
+	virtual void LoadState(Framework::CZipArchiveReader&, bool);
+	void GetStateMemoryRegions(CMemorySnapshot::RegionArray&);
 
 	void SetFrameDump(CFrameDump*);
 
 	bool GetDrawEnabled() const;
 	void SetDrawEnabled(bool);
 
+	//In lockstep mode, the caller waits for the GS thread to complete every call it sends,
+	//GS work then always happens at the same point of emulated time
+	void SetLockstepEnabled(bool);
+
 	void WritePrivRegister(uint32, uint32);
 	uint32 ReadPrivRegister(uint32);
 
 	void SetLoggingEnabled(bool);
+
+	//Packet profiling measures time spent processing packets on the GS thread
+	void SetPacketProfilingEnabled(bool);
+	PACKET_PROFILE GetPacketProfile();
+	void ResetPacketProfile();
 	static std::string DisassembleWrite(uint8, uint64);
 
 	void SetVBlank();
@@ -736,6 +765,9 @@ public:
 	void ReadImageData(void*, uint32);
 	void WriteRegisterMassively(RegisterWriteList, const CGsPacketMetadata*);
 
+	//Time (in nanoseconds) spent by the caller waiting on local to host transfers during last frame
+	uint64 GetReadbackStallTime() const;
+
 	virtual void SetCrt(bool, unsigned int, bool);
 	void Initialize();
 	void Release();
@@ -747,6 +779,7 @@ public:
 	virtual void ReadFramebuffer(uint32, uint32, void*) = 0;
 
 	void MakeLinearCLUT(const TEX0&, std::array<uint32, 256>&) const;
+	uint64 GetCLUTHash(const TEX0&) const;
 
 	uint8* GetRam();
 	uint64* GetRegisters();
@@ -780,6 +813,13 @@ protected:
 		CLUTENTRYCOUNT = (CLUTSIZE / 2)
 	};
 
+	//CLUT hashes are maintained for every block of 16 entries (the size of a CSA slice)
+	enum CLUTBLOCKSIZE
+	{
+		CLUTBLOCKSIZE = 0x10,
+		CLUTBLOCKCOUNT = (CLUTENTRYCOUNT / CLUTBLOCKSIZE)
+	};
+
 	enum CLAMP_MODE
 	{
 		CLAMP_MODE_REPEAT,
@@ -923,6 +963,7 @@ protected:
 	virtual void WriteRegisterImpl(uint8, uint64);
 	void FeedImageDataImpl(const uint8*, uint32);
 	void ReadImageDataImpl(void*, uint32);
+	void PrepareReadback();
 	void WriteRegisterMassivelyImpl(const MASSIVEWRITE_INFO&);
 
 	void BeginTransfer();
@@ -950,10 +991,18 @@ protected:
 	bool ReadCLUT8_16(const TEX0&);
 	void ReadCLUT4(const TEX0&);
 	void ReadCLUT8(const TEX0&);
+	void UpdateCLUTHashes(uint32, uint32);
+	bool IsCLUTLoadCached(const TEX0&) const;
+	void SetCLUTLoadCached(const TEX0&);
+	void InvalidateCLUTLoadCache(uint32, uint32);
+	std::pair<uint32, uint32> GetTransferDstRange() const;
+	std::pair<uint32, uint32> GetTransferSrcRange() const;
 
 	static bool IsCompatibleFramebufferPSM(unsigned int, unsigned int);
 
 	bool m_loggingEnabled;
+	bool m_packetProfilingEnabled = false;
+	PACKET_PROFILE m_packetProfile;
 
 	uint64 m_nPMODE;              //0x12000000
 	uint64 m_nSMODE2;             //0x12000020
@@ -977,8 +1026,24 @@ protected:
 	uint32 m_nCBP0;
 	uint32 m_nCBP1;
 
+	uint32 m_clutBlockHashes[CLUTBLOCKCOUNT];
+	uint64 m_clutLoadCacheKey = 0;
+	bool m_clutLoadCacheValid = false;
+
 	uint32 m_drawCallCount;
 
+	//Pipelined readback: local to host transfers are converted on the GS thread as soon as
+	//TRXDIR is processed and ReadImageData only waits for that specific transfer to complete.
+	//Written by the EE thread on reset and read from both threads
+	std::atomic<bool> m_pipelinedReadbackEnabled{false};
+	std::vector<uint8> m_readbackBuffer;
+	std::atomic<uint32> m_readbackRequestCount{0};
+	uint32 m_readbackCompleteCount = 0;
+	std::mutex m_readbackMutex;
+	std::condition_variable m_readbackCondition;
+	std::atomic<uint64> m_readbackStallTime;
+	std::atomic<uint64> m_lastFrameReadbackStallTime;
+
 	unsigned int m_nCrtMode;
 	std::thread m_thread;
 	std::recursive_mutex m_registerMutex;
@@ -987,5 +1052,7 @@ protected:
 	bool m_threadDone;
 	CFrameDump* m_frameDump;
 	bool m_drawEnabled = true;
+	bool m_lockstepEnabled = false;
 	CINTC* m_intc = nullptr;
+	CProfiler::ZoneHandle m_gsProfilerZone = 0;
 };
@@ -0,0 +1,109 @@
+#include <stdexcept>
+#include "CachedDirectoryDevice.h"
+#include "Ioman_ReadOnlyFileStream.h"
+#include "Iop_PathUtils.h"
+
+using namespace Iop::Ioman;
+
+CCachedDirectoryDevice::CCachedDirectoryDevice(const char* basePathPreferenceName)
+    : CDirectoryDevice(basePathPreferenceName)
+{
+}
+
+Framework::CStream* CCachedDirectoryDevice::GetFile(uint32 accessType, const char* devicePath)
+{
+	auto basePath = GetBasePath();
+
+	if((accessType != 0) && (accessType != OPEN_FLAG_RDONLY))
+	{
+		//File might be created or modified, stop caching information about it
+		m_entryInfos.erase(devicePath);
+		m_writablePaths.insert(devicePath);
+		return CDirectoryDevice::GetFile(accessType, devicePath);
+	}
+
+	auto entryInfo = GetEntryInfo(basePath, devicePath);
+	if(!entryInfo.exists || entryInfo.isDirectory)
+	{
+		return nullptr;
+	}
+
+	try
+	{
+		return new CReadOnlyFileStream(Iop::PathUtils::MakeHostPath(basePath, devicePath));
+	}
+	catch(...)
+	{
+		//Opening failed, let the regular stream try (and report) it
+		return CDirectoryDevice::GetFile(accessType, devicePath);
+	}
+}
+
+Directory CCachedDirectoryDevice::GetDirectory(const char* devicePath)
+{
+	auto basePath = GetBasePath();
+	auto entryInfo = GetEntryInfo(basePath, devicePath);
+	if(!entryInfo.isDirectory)
+	{
+		throw std::runtime_error("Not a directory.");
+	}
+	return fs::directory_iterator(Iop::PathUtils::MakeHostPath(basePath, devicePath));
+}
+
+CDevice::STAT_RESULT CCachedDirectoryDevice::GetStat(const char* devicePath, STAT& stat)
+{
+	auto entryInfo = GetEntryInfo(GetBasePath(), devicePath);
+	if(!entryInfo.exists)
+	{
+		return STAT_RESULT::NOT_FOUND;
+	}
+
+	if(entryInfo.isDirectory)
+	{
+		stat.mode = STAT_MODE_DIR;
+	}
+	else
+	{
+		stat.mode = STAT_MODE_FILE;
+		stat.loSize = static_cast<uint32>(entryInfo.size);
+		stat.hiSize = static_cast<uint32>(entryInfo.size >> 32);
+	}
+	return STAT_RESULT::FOUND;
+}
+
+CCachedDirectoryDevice::ENTRYINFO CCachedDirectoryDevice::GetEntryInfo(const fs::path& basePath, const char* devicePath)
+{
+	//Base directory can be changed by the user at any time
+	if(basePath != m_cacheBasePath)
+	{
+		m_entryInfos.clear();
+		m_writablePaths.clear();
+		m_cacheBasePath = basePath;
+	}
+
+	auto entryInfoIterator = m_entryInfos.find(devicePath);
+	if(entryInfoIterator != std::end(m_entryInfos))
+	{
+		return entryInfoIterator->second;
+	}
+
+	ENTRYINFO entryInfo;
+	std::error_code errorCode;
+	auto path = Iop::PathUtils::MakeHostPath(basePath, devicePath);
+	auto status = fs::status(path, errorCode);
+	if(!errorCode && fs::exists(status))
+	{
+		entryInfo.exists = true;
+		entryInfo.isDirectory = fs::is_directory(status);
+		if(!entryInfo.isDirectory)
+		{
+			auto size = fs::file_size(path, errorCode);
+			entryInfo.size = errorCode ? 0 : size;
+		}
+	}
+	if(m_writablePaths.count(devicePath) == 0)
+	{
+		m_entryInfos.emplace(devicePath, entryInfo);
+	}
+	return entryInfo;
+}
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <unordered_map>
+#include <unordered_set>
+#include "DirectoryDevice.h"
+
+namespace Iop
+{
+	namespace Ioman
+	{
+		//Directory device for host directories that are not expected to be modified by something
+		//else while the VM runs. File information is kept in memory once it has been obtained and
+		//read-only files are read at their position directly, which saves trips to the host filesystem.
+		class CCachedDirectoryDevice : public CDirectoryDevice
+		{
+		public:
+			CCachedDirectoryDevice(const char*);
+			virtual ~CCachedDirectoryDevice() = default;
+
+			Framework::CStream* GetFile(uint32, const char*) override;
+			Directory GetDirectory(const char*) override;
+			STAT_RESULT GetStat(const char*, STAT&) override;
+
+		private:
+			struct ENTRYINFO
+			{
+				bool exists = false;
+				bool isDirectory = false;
+				uint64 size = 0;
+			};
+			typedef std::unordered_map<std::string, ENTRYINFO> EntryInfoMap;
+			typedef std::unordered_set<std::string> PathSet;
+
+			ENTRYINFO GetEntryInfo(const fs::path&, const char*);
+
+			fs::path m_cacheBasePath;
+			EntryInfoMap m_entryInfos;
+			//Files opened for writing by the guest, these are never cached
+			PathSet m_writablePaths;
+		};
+	}
+}
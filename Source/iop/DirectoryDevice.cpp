@@ -28,9 +28,14 @@ Framework::CStdStream* CreateStdStream(const std::wstring& path, const char* mod
 	return new Framework::CStdStream(path.c_str(), cvtMode.c_str());
 }
 
+fs::path CDirectoryDevice::GetBasePath() const
+{
+	return CAppConfig::GetInstance().GetPreferencePath(m_basePathPreferenceName.c_str());
+}
+
 Framework::CStream* CDirectoryDevice::GetFile(uint32 accessType, const char* devicePath)
 {
-	auto basePath = CAppConfig::GetInstance().GetPreferencePath(m_basePathPreferenceName.c_str());
+	auto basePath = GetBasePath();
 	auto path = Iop::PathUtils::MakeHostPath(basePath, devicePath);
 
 	const char* mode = nullptr;
@@ -67,7 +72,7 @@ Framework::CStream* CDirectoryDevice::GetFile(uint32 accessType, const char* dev
 
 Directory CDirectoryDevice::GetDirectory(const char* devicePath)
 {
-	auto basePath = CAppConfig::GetInstance().GetPreferencePath(m_basePathPreferenceName.c_str());
+	auto basePath = GetBasePath();
 	auto path = Iop::PathUtils::MakeHostPath(basePath, devicePath);
 	if(!fs::is_directory(path))
 	{
@@ -16,6 +16,9 @@ namespace Iop
 			Framework::CStream* GetFile(uint32, const char*) override;
 			Directory GetDirectory(const char*) override;
 
+		protected:
+			fs::path GetBasePath() const;
+
 		private:
 			std::string m_basePathPreferenceName;
 		};
@@ -2,6 +2,10 @@
 
 #include "Types.h"
 
+//Directories have "group read" only permissions? This is required by PS2PSXe.
+#define STAT_MODE_DIR (0747 | (1 << 12))  //File mode + Dir type (1)
+#define STAT_MODE_FILE (0777 | (2 << 12)) //File mode + File type (2)
+
 namespace Iop
 {
 	namespace Ioman
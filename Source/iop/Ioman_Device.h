@@ -2,6 +2,7 @@
 
 #include "Stream.h"
 #include "filesystem_def.h"
+#include "Ioman_Defs.h"
 
 namespace Iop
 {
@@ -23,9 +24,22 @@ namespace Iop
 				OPEN_FLAG_NOWAIT = 0x00008000, //This is probably only used by EE's FIO library
 			};
 
+			enum class STAT_RESULT
+			{
+				UNSUPPORTED,
+				FOUND,
+				NOT_FOUND,
+			};
+
 			virtual ~CDevice() = default;
 			virtual Framework::CStream* GetFile(uint32, const char*) = 0;
 			virtual Directory GetDirectory(const char*) = 0;
+
+			//Allows devices to provide file information without having to open the file
+			virtual STAT_RESULT GetStat(const char*, STAT&)
+			{
+				return STAT_RESULT::UNSUPPORTED;
+			}
 		};
 	}
 }
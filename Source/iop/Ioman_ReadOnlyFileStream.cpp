@@ -0,0 +1,163 @@
+#include <stdexcept>
+#include <algorithm>
+#include "Ioman_ReadOnlyFileStream.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#endif
+
+using namespace Iop::Ioman;
+
+CReadOnlyFileStream::CReadOnlyFileStream(const fs::path& path)
+{
+	Open(path);
+}
+
+CReadOnlyFileStream::~CReadOnlyFileStream()
+{
+	Close();
+}
+
+void CReadOnlyFileStream::Seek(int64 position, Framework::STREAM_SEEK_DIRECTION whence)
+{
+	m_endReached = false;
+	switch(whence)
+	{
+	case Framework::STREAM_SEEK_SET:
+		m_position = position;
+		break;
+	case Framework::STREAM_SEEK_CUR:
+		m_position += position;
+		break;
+	case Framework::STREAM_SEEK_END:
+		m_position = m_size + position;
+		break;
+	}
+}
+
+uint64 CReadOnlyFileStream::Tell()
+{
+	return m_position;
+}
+
+uint64 CReadOnlyFileStream::Read(void* buffer, uint64 size)
+{
+	uint64 readSize = 0;
+	while(readSize < size)
+	{
+		uint64 chunkSize = ReadAt(reinterpret_cast<uint8*>(buffer) + readSize, size - readSize, m_position + readSize);
+		//End of file (or file was truncated since it was opened)
+		if(chunkSize == 0)
+		{
+			m_endReached = true;
+			break;
+		}
+		readSize += chunkSize;
+	}
+	m_position += readSize;
+	return readSize;
+}
+
+uint64 CReadOnlyFileStream::Write(const void*, uint64)
+{
+	throw std::runtime_error("Stream is read-only.");
+}
+
+bool CReadOnlyFileStream::IsEOF()
+{
+	return m_endReached || (m_position >= m_size);
+}
+
+#ifdef _WIN32
+
+void CReadOnlyFileStream::Open(const fs::path& path)
+{
+	//Share everything, other openers must still be able to rewrite or delete the file
+	HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_WRITE | FILE_SHARE_DELETE,
+	                          NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if(file == INVALID_HANDLE_VALUE)
+	{
+		throw std::runtime_error("Failed to open file.");
+	}
+
+	LARGE_INTEGER fileSize = {};
+	GetFileSizeEx(file, &fileSize);
+	m_size = fileSize.QuadPart;
+	m_file = file;
+}
+
+void CReadOnlyFileStream::Close()
+{
+	if(m_file)
+	{
+		CloseHandle(m_file);
+		m_file = nullptr;
+	}
+}
+
+uint64 CReadOnlyFileStream::ReadAt(void* buffer, uint64 size, uint64 position)
+{
+	//Offset in the OVERLAPPED structure makes the read positional on a synchronous handle
+	OVERLAPPED overlapped = {};
+	overlapped.Offset = static_cast<DWORD>(position);
+	overlapped.OffsetHigh = static_cast<DWORD>(position >> 32);
+	DWORD readSize = 0;
+	DWORD requestSize = static_cast<DWORD>(std::min<uint64>(size, 0x40000000));
+	if(!ReadFile(m_file, buffer, requestSize, &readSize, &overlapped))
+	{
+		return 0;
+	}
+	return readSize;
+}
+
+#else
+
+void CReadOnlyFileStream::Open(const fs::path& path)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd == -1)
+	{
+		throw std::runtime_error("Failed to open file.");
+	}
+
+	struct stat fileStat = {};
+	if(fstat(fd, &fileStat) == -1)
+	{
+		close(fd);
+		throw std::runtime_error("Failed to open file.");
+	}
+	m_size = fileStat.st_size;
+	m_fd = fd;
+}
+
+void CReadOnlyFileStream::Close()
+{
+	if(m_fd != -1)
+	{
+		close(m_fd);
+		m_fd = -1;
+	}
+}
+
+uint64 CReadOnlyFileStream::ReadAt(void* buffer, uint64 size, uint64 position)
+{
+	while(true)
+	{
+		ssize_t readSize = pread(m_fd, buffer, static_cast<size_t>(std::min<uint64>(size, 0x40000000)), static_cast<off_t>(position));
+		if(readSize >= 0)
+		{
+			return static_cast<uint64>(readSize);
+		}
+		if(errno != EINTR)
+		{
+			return 0;
+		}
+	}
+}
+
+#endif
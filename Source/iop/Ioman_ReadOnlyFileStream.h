@@ -0,0 +1,44 @@
+#pragma once
+
+#include "Stream.h"
+#include "filesystem_def.h"
+
+namespace Iop
+{
+	namespace Ioman
+	{
+		//Read-only stream over a host file. Reads are done at the stream's position directly
+		//(no separate seek or buffering). The file isn't mapped or locked, it can be truncated
+		//or rewritten by something else while open, reads will then just return less data.
+		class CReadOnlyFileStream : public Framework::CStream
+		{
+		public:
+			CReadOnlyFileStream(const fs::path&);
+			CReadOnlyFileStream(const CReadOnlyFileStream&) = delete;
+			virtual ~CReadOnlyFileStream();
+
+			CReadOnlyFileStream& operator=(const CReadOnlyFileStream&) = delete;
+
+			void Seek(int64, Framework::STREAM_SEEK_DIRECTION) override;
+			uint64 Tell() override;
+			uint64 Read(void*, uint64) override;
+			uint64 Write(const void*, uint64) override;
+			bool IsEOF() override;
+
+		private:
+			void Open(const fs::path&);
+			void Close();
+			uint64 ReadAt(void*, uint64, uint64);
+
+#ifdef _WIN32
+			void* m_file = nullptr;
+#else
+			int m_fd = -1;
+#endif
+			uint64 m_size = 0;
+			uint64 m_position = 0;
+			//Set when a read came up short, the file might have shrunk below m_size
+			bool m_endReached = false;
+		};
+	}
+}
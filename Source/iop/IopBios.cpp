@@ -1,4 +1,5 @@
 #include <vector>
+#include <algorithm>
 
 #include "string_format.h"
 #include "PtrStream.h"
@@ -149,6 +150,11 @@ void CIopBios::Reset(const Iop::SifManPtr& sifMan)
 	m_threads.FreeAll();
 	m_semaphores.FreeAll();
 	m_intrHandlers.FreeAll();
+	RebuildThreadQueues();
+
+	m_cdvdfsvCompletionTime = ~0ULL;
+	m_cdvdmanCompletionTime = ~0ULL;
+	m_fileIoCompletionTime = ~0ULL;
 #ifdef DEBUGGER_INCLUDED
 	m_moduleTags.clear();
 #endif
@@ -329,6 +335,9 @@ void CIopBios::SaveState(Framework::CZipArchiveWriter& archive)
 	m_fileIo->SaveState(archive);
 	m_padman->SaveState(archive);
 	m_cdvdfsv->SaveState(archive);
+
+	//Memory card files are not part of the state, but make sure they match it
+	GetMcServ()->FlushPendingWrites();
 #endif
 }
 
@@ -389,6 +398,13 @@ void CIopBios::LoadState(Framework::CZipArchiveReader& archive)
 	}
 #endif
 
+	RebuildThreadQueues();
+
+	//Pending commands will be timed again from the current time
+	m_cdvdfsvCompletionTime = ~0ULL;
+	m_cdvdmanCompletionTime = ~0ULL;
+	m_fileIoCompletionTime = ~0ULL;
+
 #ifdef DEBUGGER_INCLUDED
 	m_cpu.m_analysis->Clear();
 	for(const auto& moduleTag : m_moduleTags)
@@ -1119,8 +1135,10 @@ uint32 CIopBios::TerminateThread(uint32 threadId)
 			assert(semaphore->waitCount > 0);
 			semaphore->waitCount--;
 		}
+		RemoveFromWaitList(m_semaphoreWaitLists[thread->waitSemaphore], thread->id);
 		thread->waitSemaphore = 0;
 	}
+	CancelThreadDelay(thread->id);
 	thread->status = THREAD_STATUS_DORMANT;
 	UnlinkThread(thread->id);
 	return KERNEL_RESULT_OK;
@@ -1133,12 +1151,7 @@ int32 CIopBios::DelayThread(uint32 delay)
 	                          m_currentThreadId.Get(), delay);
 #endif
 
-	THREAD* thread = GetThread(m_currentThreadId);
-	thread->nextActivateTime = GetCurrentTime() + MicroSecToClock(delay);
-	//TODO: Add a proper wait state to allow thread to be relinked
-	//at the end of the queue at the right moment
-	UnlinkThread(thread->id);
-	LinkThread(thread->id);
+	DelayThreadUntil(m_currentThreadId, GetCurrentTime() + MicroSecToClock(delay));
 	m_rescheduleNeeded = true;
 
 	return KERNEL_RESULT_OK;
@@ -1146,12 +1159,7 @@ int32 CIopBios::DelayThread(uint32 delay)
 
 void CIopBios::DelayThreadTicks(uint32 delay)
 {
-	auto thread = GetThread(m_currentThreadId);
-	thread->nextActivateTime = GetCurrentTime() + delay;
-	//TODO: Add a proper wait state to allow thread to be relinked
-	//at the end of the queue at the right moment
-	UnlinkThread(thread->id);
-	LinkThread(thread->id);
+	DelayThreadUntil(m_currentThreadId, GetCurrentTime() + delay);
 	m_rescheduleNeeded = true;
 }
 
@@ -1244,7 +1252,8 @@ int32 CIopBios::ChangeThreadPriority(uint32 threadId, uint32 newPrio)
 	}
 
 	thread->priority = newPrio;
-	if(thread->status == THREAD_STATUS_RUNNING)
+	//Delayed threads will be linked with their new priority when they wake up
+	if((thread->status == THREAD_STATUS_RUNNING) && !IsThreadDelayed(threadId))
 	{
 		UnlinkThread(threadId);
 		LinkThread(threadId);
@@ -1293,6 +1302,10 @@ uint32 CIopBios::ReferThreadStatus(uint32 threadId, uint32 statusPtr, bool inInt
 		{
 			threadStatus = 0x01;
 		}
+		else if(IsThreadDelayed(threadId))
+		{
+			threadStatus = 0x04;
+		}
 		else
 		{
 			threadStatus = 0x02;
@@ -1309,6 +1322,9 @@ uint32 CIopBios::ReferThreadStatus(uint32 threadId, uint32 statusPtr, bool inInt
 	case THREAD_STATUS_SLEEPING:
 		waitType = 1;
 		break;
+	case THREAD_STATUS_RUNNING:
+		waitType = IsThreadDelayed(threadId) ? 2 : 0;
+		break;
 	case THREAD_STATUS_WAITING_SEMAPHORE:
 		waitType = 3;
 		break;
@@ -1465,8 +1481,9 @@ int32 CIopBios::ReleaseWaitThread(uint32 threadId, bool inInterrupt)
 		return KERNEL_RESULT_ERROR_UNKNOWN_THID;
 	}
 
+	//Delayed threads are waiting as well, even if their status is running
 	if(
-	    (thread->status == THREAD_STATUS_RUNNING) ||
+	    ((thread->status == THREAD_STATUS_RUNNING) && !IsThreadDelayed(threadId)) ||
 	    (thread->status == THREAD_STATUS_DORMANT))
 	{
 		return KERNEL_RESULT_ERROR_NOT_WAIT;
@@ -1474,6 +1491,9 @@ int32 CIopBios::ReleaseWaitThread(uint32 threadId, bool inInterrupt)
 
 	switch(thread->status)
 	{
+	case THREAD_STATUS_RUNNING:
+		CancelThreadDelay(threadId);
+		break;
 	case THREAD_STATUS_SLEEPING:
 		//Nothing special to do
 		break;
@@ -1483,6 +1503,7 @@ int32 CIopBios::ReleaseWaitThread(uint32 threadId, bool inInterrupt)
 		assert(semaphore);
 		assert(semaphore->waitCount != 0);
 		semaphore->waitCount--;
+		RemoveFromWaitList(m_semaphoreWaitLists[thread->waitSemaphore], threadId);
 		thread->waitSemaphore = 0;
 	}
 	break;
@@ -1543,6 +1564,7 @@ void CIopBios::SleepThreadTillVBlankStart()
 	THREAD* thread = GetThread(m_currentThreadId);
 	thread->status = THREAD_STATUS_WAIT_VBLANK_START;
 	UnlinkThread(thread->id);
+	AddToWaitList(m_vblankStartWaitList, thread->id);
 	m_rescheduleNeeded = true;
 }
 
@@ -1551,6 +1573,7 @@ void CIopBios::SleepThreadTillVBlankEnd()
 	THREAD* thread = GetThread(m_currentThreadId);
 	thread->status = THREAD_STATUS_WAIT_VBLANK_END;
 	UnlinkThread(thread->id);
+	AddToWaitList(m_vblankEndWaitList, thread->id);
 	m_rescheduleNeeded = true;
 }
 
@@ -1627,6 +1650,101 @@ void CIopBios::UnlinkThread(uint32 threadId)
 	}
 }
 
+void CIopBios::DelayThreadUntil(uint32 threadId, uint64 activateTime)
+{
+	auto thread = m_threads[threadId];
+	assert(thread->status == THREAD_STATUS_RUNNING);
+	CancelThreadDelay(threadId);
+	//Thread stays out of the ready list until it wakes up, it is then linked
+	//at the end of its priority level
+	thread->nextActivateTime = activateTime;
+	UnlinkThread(threadId);
+	m_threadWakeupQueue.insert(std::make_pair(activateTime, threadId));
+}
+
+void CIopBios::CancelThreadDelay(uint32 threadId)
+{
+	auto thread = m_threads[threadId];
+	m_threadWakeupQueue.erase(std::make_pair(thread->nextActivateTime, threadId));
+}
+
+bool CIopBios::IsThreadDelayed(uint32 threadId) const
+{
+	auto thread = m_threads[threadId];
+	return m_threadWakeupQueue.find(std::make_pair(thread->nextActivateTime, threadId)) != std::end(m_threadWakeupQueue);
+}
+
+void CIopBios::ProcessThreadWakeups()
+{
+	uint64 currentTime = GetCurrentTime();
+	while(!m_threadWakeupQueue.empty())
+	{
+		auto wakeupIterator = m_threadWakeupQueue.begin();
+		if(currentTime <= wakeupIterator->first) break;
+		uint32 threadId = wakeupIterator->second;
+		m_threadWakeupQueue.erase(wakeupIterator);
+		assert(m_threads[threadId]->status == THREAD_STATUS_RUNNING);
+		LinkThread(threadId);
+	}
+}
+
+void CIopBios::RebuildThreadQueues()
+{
+	m_threadWakeupQueue.clear();
+	m_vblankStartWaitList.clear();
+	m_vblankEndWaitList.clear();
+	m_semaphoreWaitLists.clear();
+	m_eventFlagWaitLists.clear();
+
+	std::vector<bool> linkedThreads(MAX_THREAD, false);
+	for(uint32 threadId = ThreadLinkHead(); threadId != 0; threadId = m_threads[threadId]->nextThreadId)
+	{
+		linkedThreads[threadId] = true;
+	}
+
+	uint64 currentTime = GetCurrentTime();
+	for(auto thread : m_threads)
+	{
+		if(!thread) continue;
+		switch(thread->status)
+		{
+		case THREAD_STATUS_RUNNING:
+			//Running threads missing from the ready list are delayed. States saved before
+			//delayed threads were unlinked still have them in the list with a pending activation time.
+			if(!linkedThreads[thread->id] || (currentTime <= thread->nextActivateTime))
+			{
+				UnlinkThread(thread->id);
+				m_threadWakeupQueue.insert(std::make_pair(thread->nextActivateTime, thread->id));
+			}
+			break;
+		case THREAD_STATUS_WAIT_VBLANK_START:
+			m_vblankStartWaitList.push_back(thread->id);
+			break;
+		case THREAD_STATUS_WAIT_VBLANK_END:
+			m_vblankEndWaitList.push_back(thread->id);
+			break;
+		case THREAD_STATUS_WAITING_SEMAPHORE:
+			m_semaphoreWaitLists[thread->waitSemaphore].push_back(thread->id);
+			break;
+		case THREAD_STATUS_WAITING_EVENTFLAG:
+			m_eventFlagWaitLists[thread->waitEventFlag].push_back(thread->id);
+			break;
+		}
+	}
+}
+
+void CIopBios::AddToWaitList(ThreadWaitList& waitList, uint32 threadId)
+{
+	//Wait lists are pruned lazily, thread might still be there if it stopped waiting in another way
+	if(std::find(std::begin(waitList), std::end(waitList), threadId) != std::end(waitList)) return;
+	waitList.push_back(threadId);
+}
+
+void CIopBios::RemoveFromWaitList(ThreadWaitList& waitList, uint32 threadId)
+{
+	waitList.erase(std::remove(std::begin(waitList), std::end(waitList), threadId), std::end(waitList));
+}
+
 void CIopBios::Reschedule()
 {
 	if((m_cpu.m_State.nCOP0[CCOP_SCU::STATUS] & CMIPS::STATUS_EXL) != 0)
@@ -1645,6 +1763,8 @@ void CIopBios::Reschedule()
 		SaveThreadContext(m_currentThreadId);
 	}
 
+	ProcessThreadWakeups();
+
 	uint32 nextThreadId = GetNextReadyThread();
 	if(nextThreadId == -1)
 	{
@@ -1665,16 +1785,14 @@ void CIopBios::Reschedule()
 
 uint32 CIopBios::GetNextReadyThread()
 {
+	//Ready list only holds threads that can run and is sorted by priority
 	uint32 nextThreadId = ThreadLinkHead();
-	while(nextThreadId != 0)
+	if(nextThreadId == 0)
 	{
-		THREAD* nextThread = m_threads[nextThreadId];
-		nextThreadId = nextThread->nextThreadId;
-		if(GetCurrentTime() <= nextThread->nextActivateTime) continue;
-		assert(nextThread->status == THREAD_STATUS_RUNNING);
-		return nextThread->id;
+		return -1;
 	}
-	return -1;
+	assert(m_threads[nextThreadId]->status == THREAD_STATUS_RUNNING);
+	return nextThreadId;
 }
 
 uint64 CIopBios::GetCurrentTime() const
@@ -1700,12 +1818,77 @@ uint64 CIopBios::ClockToMicroSec(uint64 clock)
 void CIopBios::CountTicks(uint32 ticks)
 {
 	CurrentTime() += ticks;
+	if(m_ioCompletionMode != IO_COMPLETION_MODE::VBLANK)
+	{
+		ProcessIoCompletions();
+	}
+}
+
+void CIopBios::SetIoCompletionMode(IO_COMPLETION_MODE ioCompletionMode)
+{
+	m_ioCompletionMode = ioCompletionMode;
+}
+
+void CIopBios::SetCdvdReadSpeed(uint32 cdvdReadSpeed)
+{
+	m_cdvdReadSpeed = std::max<uint32>(cdvdReadSpeed, 1);
+}
+
+uint64 CIopBios::GetIoCompletionDelay(uint32 transferSize) const
+{
+	//DVD 1x transfer rate, in bytes per second
+	static const uint64 dvdBaseTransferRate = 1385000;
+	if(m_ioCompletionMode == IO_COMPLETION_MODE::INSTANT)
+	{
+		return 0;
+	}
+	uint64 transferRate = dvdBaseTransferRate * m_cdvdReadSpeed;
+	return (static_cast<uint64>(transferSize) * static_cast<uint64>(PS2::IOP_CLOCK_OVER_FREQ)) / transferRate;
+}
+
+bool CIopBios::IsIoCommandComplete(uint64& completionTime, bool hasPendingCommand, uint32 transferSize)
+{
+	if(!hasPendingCommand)
+	{
+		completionTime = ~0ULL;
+		return false;
+	}
+	//Command is noticed the first time ticks are counted after it was queued
+	if(completionTime == ~0ULL)
+	{
+		completionTime = GetCurrentTime() + GetIoCompletionDelay(transferSize);
+	}
+	if(GetCurrentTime() < completionTime)
+	{
+		return false;
+	}
+	completionTime = ~0ULL;
+	return true;
+}
+
+void CIopBios::ProcessIoCompletions()
+{
+#ifdef _IOP_EMULATE_MODULES
+	if(IsIoCommandComplete(m_cdvdfsvCompletionTime, m_cdvdfsv->HasPendingCommand(), m_cdvdfsv->GetPendingCommandSize()))
+	{
+		m_cdvdfsv->ProcessCommands(m_sifMan.get());
+	}
+	if(IsIoCommandComplete(m_cdvdmanCompletionTime, m_cdvdman->HasPendingCommand(), m_cdvdman->GetPendingCommandSize()))
+	{
+		m_cdvdman->ProcessCommands();
+	}
+	if(IsIoCommandComplete(m_fileIoCompletionTime, m_fileIo->HasPendingCommand(), m_fileIo->GetPendingCommandSize()))
+	{
+		m_fileIo->ProcessCommands(m_sifMan.get());
+	}
+#endif
 }
 
 void CIopBios::NotifyVBlankStart()
 {
-	for(auto thread : m_threads)
+	for(auto threadId : m_vblankStartWaitList)
 	{
+		auto thread = m_threads[threadId];
 		if(!thread) continue;
 		if(thread->status == THREAD_STATUS_WAIT_VBLANK_START)
 		{
@@ -1713,12 +1896,14 @@ void CIopBios::NotifyVBlankStart()
 			LinkThread(thread->id);
 		}
 	}
+	m_vblankStartWaitList.clear();
 }
 
 void CIopBios::NotifyVBlankEnd()
 {
-	for(auto thread : m_threads)
+	for(auto threadId : m_vblankEndWaitList)
 	{
+		auto thread = m_threads[threadId];
 		if(!thread) continue;
 		if(thread->status == THREAD_STATUS_WAIT_VBLANK_END)
 		{
@@ -1726,18 +1911,22 @@ void CIopBios::NotifyVBlankEnd()
 			LinkThread(thread->id);
 		}
 	}
+	m_vblankEndWaitList.clear();
 #ifdef _IOP_EMULATE_MODULES
-	m_cdvdfsv->ProcessCommands(m_sifMan.get());
-	m_cdvdman->ProcessCommands();
-	m_fileIo->ProcessCommands(m_sifMan.get());
+	if(m_ioCompletionMode == IO_COMPLETION_MODE::VBLANK)
+	{
+		m_cdvdfsv->ProcessCommands(m_sifMan.get());
+		m_cdvdman->ProcessCommands();
+		m_fileIo->ProcessCommands(m_sifMan.get());
+	}
 #endif
 }
 
-uint32 CIopBios::CreateSemaphore(uint32 initialCount, uint32 maxCount)
+uint32 CIopBios::CreateSemaphore(uint32 initialCount, uint32 maxCount, uint32 attr)
 {
 #ifdef _DEBUG
-	CLog::GetInstance().Print(LOGNAME, "%i: CreateSemaphore(initialCount = %i, maxCount = %i);\r\n",
-	                          m_currentThreadId.Get(), initialCount, maxCount);
+	CLog::GetInstance().Print(LOGNAME, "%i: CreateSemaphore(initialCount = %i, maxCount = %i, attr = 0x%08X);\r\n",
+	                          m_currentThreadId.Get(), initialCount, maxCount, attr);
 #endif
 
 	uint32 semaphoreId = m_semaphores.Allocate();
@@ -1753,6 +1942,7 @@ uint32 CIopBios::CreateSemaphore(uint32 initialCount, uint32 maxCount)
 	semaphore->maxCount = maxCount;
 	semaphore->id = semaphoreId;
 	semaphore->waitCount = 0;
+	semaphore->attr = static_cast<uint16>(attr & SEMA_ATTR_THMODE_MASK);
 
 	return semaphore->id;
 }
@@ -1846,6 +2036,7 @@ uint32 CIopBios::WaitSemaphore(uint32 semaphoreId)
 		thread->status = THREAD_STATUS_WAITING_SEMAPHORE;
 		thread->waitSemaphore = semaphoreId;
 		UnlinkThread(threadId);
+		AddToWaitList(m_semaphoreWaitLists[semaphoreId], threadId);
 		semaphore->waitCount++;
 		m_rescheduleNeeded = true;
 	}
@@ -1889,7 +2080,7 @@ uint32 CIopBios::ReferSemaphoreStatus(uint32 semaphoreId, uint32 statusPtr)
 	}
 
 	auto status = reinterpret_cast<SEMAPHORE_STATUS*>(m_ram + statusPtr);
-	status->attrib = 0;
+	status->attrib = semaphore->attr;
 	status->option = 0;
 	status->initCount = 0;
 	status->maxCount = semaphore->maxCount;
@@ -1905,26 +2096,42 @@ bool CIopBios::SemaReleaseSingleThread(uint32 semaphoreId, bool deleted)
 	assert(semaphore);
 	assert(semaphore->waitCount != 0);
 
-	bool changed = false;
-	for(auto thread : m_threads)
+	//Drop threads that stopped waiting in another way
+	auto& waitList = m_semaphoreWaitLists[semaphoreId];
+	waitList.erase(std::remove_if(std::begin(waitList), std::end(waitList),
+	                              [&](uint32 threadId) {
+		                              auto thread = m_threads[threadId];
+		                              return !thread || (thread->waitSemaphore != semaphoreId);
+	                              }),
+	               std::end(waitList));
+
+	//Something went wrong if nothing is waiting
+	assert(!waitList.empty());
+	if(waitList.empty())
 	{
-		if(!thread) continue;
-		if(thread->waitSemaphore == semaphoreId)
-		{
-			assert(thread->status == THREAD_STATUS_WAITING_SEMAPHORE);
-			thread->context.gpr[CMIPS::V0] = deleted ? KERNEL_RESULT_ERROR_WAIT_DELETE : KERNEL_RESULT_OK;
-			thread->status = THREAD_STATUS_RUNNING;
-			LinkThread(thread->id);
-			thread->waitSemaphore = 0;
-			semaphore->waitCount--;
-			changed = true;
-			break;
-		}
+		return false;
 	}
 
-	//Something went wrong if nothing changed
-	assert(changed);
-	return changed;
+	//Threads are released in the order they started waiting, or by priority if
+	//requested (lowest value first, threads of equal priority still in wait order)
+	auto waitIterator = std::begin(waitList);
+	if((semaphore->attr & SEMA_ATTR_THMODE_MASK) == SEMA_ATTR_THPRI)
+	{
+		waitIterator = std::min_element(std::begin(waitList), std::end(waitList),
+		                                [&](uint32 threadId1, uint32 threadId2) {
+			                                return m_threads[threadId1]->priority < m_threads[threadId2]->priority;
+		                                });
+	}
+
+	auto thread = m_threads[*waitIterator];
+	waitList.erase(waitIterator);
+	assert(thread->status == THREAD_STATUS_WAITING_SEMAPHORE);
+	thread->context.gpr[CMIPS::V0] = deleted ? KERNEL_RESULT_ERROR_WAIT_DELETE : KERNEL_RESULT_OK;
+	thread->status = THREAD_STATUS_RUNNING;
+	LinkThread(thread->id);
+	thread->waitSemaphore = 0;
+	semaphore->waitCount--;
+	return true;
 }
 
 uint32 CIopBios::CreateEventFlag(uint32 attributes, uint32 options, uint32 initValue)
@@ -1987,27 +2194,34 @@ uint32 CIopBios::SetEventFlag(uint32 eventId, uint32 value, bool inInterrupt)
 	eventFlag->value |= value;
 
 	//Check all threads waiting for this event
-	for(auto thread : m_threads)
+	auto& waitList = m_eventFlagWaitLists[eventId];
+	for(auto waitIterator = waitList.begin(); waitIterator != waitList.end();)
 	{
-		if(!thread) continue;
-		if(thread->status != THREAD_STATUS_WAITING_EVENTFLAG) continue;
-		if(thread->waitEventFlag == eventId)
+		auto thread = m_threads[*waitIterator];
+		if(!thread || (thread->status != THREAD_STATUS_WAITING_EVENTFLAG) || (thread->waitEventFlag != eventId))
 		{
-			bool success = ProcessEventFlag(thread->waitEventFlagMode, eventFlag->value, thread->waitEventFlagMask,
-			                                (thread->waitEventFlagResultPtr != 0) ? reinterpret_cast<uint32*>(m_ram + thread->waitEventFlagResultPtr) : nullptr);
-			if(success)
-			{
-				thread->waitEventFlag = 0;
-				thread->waitEventFlagResultPtr = 0;
+			waitIterator = waitList.erase(waitIterator);
+			continue;
+		}
+		bool success = ProcessEventFlag(thread->waitEventFlagMode, eventFlag->value, thread->waitEventFlagMask,
+		                                (thread->waitEventFlagResultPtr != 0) ? reinterpret_cast<uint32*>(m_ram + thread->waitEventFlagResultPtr) : nullptr);
+		if(success)
+		{
+			thread->waitEventFlag = 0;
+			thread->waitEventFlagResultPtr = 0;
 
-				thread->status = THREAD_STATUS_RUNNING;
-				LinkThread(thread->id);
+			thread->status = THREAD_STATUS_RUNNING;
+			LinkThread(thread->id);
 
-				if(!inInterrupt)
-				{
-					m_rescheduleNeeded = true;
-				}
+			if(!inInterrupt)
+			{
+				m_rescheduleNeeded = true;
 			}
+			waitIterator = waitList.erase(waitIterator);
+		}
+		else
+		{
+			waitIterator++;
 		}
 	}
 
@@ -2053,6 +2267,7 @@ uint32 CIopBios::WaitEventFlag(uint32 eventId, uint32 value, uint32 mode, uint32
 		thread->status = THREAD_STATUS_WAITING_EVENTFLAG;
 		UnlinkThread(thread->id);
 		thread->waitEventFlag = eventId;
+		AddToWaitList(m_eventFlagWaitLists[eventId], thread->id);
 		thread->waitEventFlagMode = mode;
 		thread->waitEventFlagMask = value;
 		thread->waitEventFlagResultPtr = resultPtr;
@@ -3,6 +3,9 @@
 #include <memory>
 #include <list>
 #include <map>
+#include <set>
+#include <vector>
+#include <unordered_map>
 #include "../MIPSAssembler.h"
 #include "../MIPS.h"
 #include "../ELF.h"
@@ -167,6 +170,18 @@ public:
 	void NotifyVBlankStart() override;
 	void NotifyVBlankEnd() override;
 
+	//Controls when pending CDVD and FileIO commands complete
+	enum class IO_COMPLETION_MODE
+	{
+		VBLANK,      //At the end of the next vblank
+		DRIVE_SPEED, //After the time the drive needs to transfer the data
+		INSTANT,     //As soon as the IOP counts ticks
+	};
+
+	//Speed is a multiple of the DVD 1x transfer rate
+	void SetIoCompletionMode(IO_COMPLETION_MODE);
+	void SetCdvdReadSpeed(uint32);
+
 	void Reset(const Iop::SifManPtr&);
 
 	void SaveState(Framework::CZipArchiveWriter&) override;
@@ -210,7 +225,7 @@ public:
 	void SleepThreadTillVBlankStart();
 	void SleepThreadTillVBlankEnd();
 
-	uint32 CreateSemaphore(uint32, uint32);
+	uint32 CreateSemaphore(uint32, uint32, uint32 attr = SEMA_ATTR_THFIFO);
 	uint32 DeleteSemaphore(uint32);
 	uint32 SignalSemaphore(uint32, bool);
 	uint32 WaitSemaphore(uint32);
@@ -315,13 +330,22 @@ private:
 		WEF_CLEAR = 0x10,
 	};
 
+	enum SEMA_ATTR
+	{
+		SEMA_ATTR_THFIFO = 0x000,
+		SEMA_ATTR_THPRI = 0x001,
+		SEMA_ATTR_THMODE_MASK = 0x001,
+	};
+
 	struct SEMAPHORE
 	{
 		uint32 isValid;
 		uint32 id;
 		uint32 count;
 		uint32 maxCount;
-		uint32 waitCount;
+		//Attributes share a word with the wait count, control block has no room left to grow the structure
+		uint16 waitCount;
+		uint16 attr;
 	};
 
 	struct SEMAPHORE_STATUS
@@ -540,6 +564,10 @@ private:
 	typedef COsStructManager<LOADEDMODULE> LoadedModuleList;
 	typedef std::map<std::string, Iop::ModulePtr> IopModuleMapType;
 	typedef std::pair<uint32, uint32> ExecutableRange;
+	//Delayed threads, ordered by activation time (first) and thread id (second)
+	typedef std::set<std::pair<uint64, uint32>> ThreadWakeupQueue;
+	typedef std::vector<uint32> ThreadWaitList;
+	typedef std::unordered_map<uint32, ThreadWaitList> ThreadWaitListMap;
 
 	void LoadThreadContext(uint32);
 	void SaveThreadContext(uint32);
@@ -551,6 +579,14 @@ private:
 	void LinkThread(uint32);
 	void UnlinkThread(uint32);
 
+	void DelayThreadUntil(uint32, uint64);
+	void CancelThreadDelay(uint32);
+	bool IsThreadDelayed(uint32) const;
+	void ProcessThreadWakeups();
+	void RebuildThreadQueues();
+	static void AddToWaitList(ThreadWaitList&, uint32);
+	static void RemoveFromWaitList(ThreadWaitList&, uint32);
+
 	uint32& ThreadLinkHead() const;
 	uint64& CurrentTime() const;
 	uint32& ModuleStartRequestHead() const;
@@ -580,6 +616,10 @@ private:
 
 	void PopulateSystemIntcHandlers();
 
+	uint64 GetIoCompletionDelay(uint32) const;
+	bool IsIoCommandComplete(uint64&, bool, uint32);
+	void ProcessIoCompletions();
+
 #ifdef DEBUGGER_INCLUDED
 	void PrepareModuleDebugInfo(CELF&, const ExecutableRange&, const std::string&, const std::string&);
 	BiosDebugModuleInfoIterator FindModuleDebugInfo(const std::string&);
@@ -615,6 +655,19 @@ private:
 
 	OsVariableWrapper<uint32> m_currentThreadId;
 
+	//Host side indices over thread state kept in IOP RAM, rebuilt on reset and state load
+	ThreadWakeupQueue m_threadWakeupQueue;
+	ThreadWaitList m_vblankStartWaitList;
+	ThreadWaitList m_vblankEndWaitList;
+	ThreadWaitListMap m_semaphoreWaitLists;
+	ThreadWaitListMap m_eventFlagWaitLists;
+
+	IO_COMPLETION_MODE m_ioCompletionMode = IO_COMPLETION_MODE::VBLANK;
+	uint32 m_cdvdReadSpeed = 4;
+	uint64 m_cdvdfsvCompletionTime = ~0ULL;
+	uint64 m_cdvdmanCompletionTime = ~0ULL;
+	uint64 m_fileIoCompletionTime = ~0ULL;
+
 #ifdef DEBUGGER_INCLUDED
 	BiosDebugModuleInfoArray m_moduleTags;
 #endif
@@ -3,7 +3,7 @@
 #include "../Ps2Const.h"
 #include "Iop_Cdvdfsv.h"
 #include "Iop_Cdvdman.h"
-#include "Iop_SifManPs2.h"
+#include "Iop_SifMan.h"
 
 using namespace Iop;
 
@@ -64,20 +64,16 @@ void CCdvdfsv::ProcessCommands(CSifMan* sifMan)
 	{
 		static const uint32 sectorSize = 0x800;
 
-		uint8* eeRam = nullptr;
-		if(auto sifManPs2 = dynamic_cast<CSifManPs2*>(sifMan))
-		{
-			eeRam = sifManPs2->GetEeRam();
-		}
-
 		if(m_pendingCommand == COMMAND_READ)
 		{
-			if(m_opticalMedia != nullptr)
+			//Sectors are read straight into the EE buffer
+			auto dst = sifMan->GetEeMemory(m_pendingReadAddr, m_pendingReadCount * sectorSize);
+			if((m_opticalMedia != nullptr) && (dst != nullptr))
 			{
 				auto fileSystem = m_opticalMedia->GetFileSystem();
 				for(unsigned int i = 0; i < m_pendingReadCount; i++)
 				{
-					fileSystem->ReadBlock(m_pendingReadSector + i, eeRam + (m_pendingReadAddr + (i * sectorSize)));
+					fileSystem->ReadBlock(m_pendingReadSector + i, dst + (i * sectorSize));
 				}
 			}
 		}
@@ -94,12 +90,13 @@ void CCdvdfsv::ProcessCommands(CSifMan* sifMan)
 		}
 		else if(m_pendingCommand == COMMAND_STREAM_READ)
 		{
-			if(m_opticalMedia != nullptr)
+			auto dst = sifMan->GetEeMemory(m_pendingReadAddr, m_pendingReadCount * sectorSize);
+			if((m_opticalMedia != nullptr) && (dst != nullptr))
 			{
 				auto fileSystem = m_opticalMedia->GetFileSystem();
 				for(unsigned int i = 0; i < m_pendingReadCount; i++)
 				{
-					fileSystem->ReadBlock(m_streamPos, eeRam + (m_pendingReadAddr + (i * sectorSize)));
+					fileSystem->ReadBlock(m_streamPos, dst + (i * sectorSize));
 					m_streamPos++;
 				}
 			}
@@ -110,6 +107,17 @@ void CCdvdfsv::ProcessCommands(CSifMan* sifMan)
 	}
 }
 
+bool CCdvdfsv::HasPendingCommand() const
+{
+	return (m_pendingCommand != COMMAND_NONE);
+}
+
+uint32 CCdvdfsv::GetPendingCommandSize() const
+{
+	static const uint32 sectorSize = 0x800;
+	return (m_pendingCommand != COMMAND_NONE) ? (m_pendingReadCount * sectorSize) : 0;
+}
+
 void CCdvdfsv::SetOpticalMedia(COpticalMedia* opticalMedia)
 {
 	m_opticalMedia = opticalMedia;
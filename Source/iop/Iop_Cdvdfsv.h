@@ -22,6 +22,8 @@ namespace Iop
 		void Invoke(CMIPS&, unsigned int) override;
 
 		void ProcessCommands(CSifMan*);
+		bool HasPendingCommand() const;
+		uint32 GetPendingCommandSize() const;
 		void SetOpticalMedia(COpticalMedia*);
 
 		void LoadState(Framework::CZipArchiveReader&);
@@ -10,6 +10,7 @@
 #define STATE_CALLBACK_ADDRESS ("CallbackAddress")
 #define STATE_STATUS ("Status")
 #define STATE_PENDING_COMMAND ("PendingCommand")
+#define STATE_PENDING_COMMAND_SIZE ("PendingCommandSize")
 
 #define FUNCTION_CDINIT "CdInit"
 #define FUNCTION_CDREAD "CdRead"
@@ -47,6 +48,7 @@ void CCdvdman::LoadState(Framework::CZipArchiveReader& archive)
 	m_callbackPtr = registerFile.GetRegister32(STATE_CALLBACK_ADDRESS);
 	m_status = registerFile.GetRegister32(STATE_STATUS);
 	m_pendingCommand = static_cast<COMMAND>(registerFile.GetRegister32(STATE_PENDING_COMMAND));
+	m_pendingCommandSize = registerFile.GetRegister32(STATE_PENDING_COMMAND_SIZE);
 }
 
 void CCdvdman::SaveState(Framework::CZipArchiveWriter& archive)
@@ -55,6 +57,7 @@ void CCdvdman::SaveState(Framework::CZipArchiveWriter& archive)
 	registerFile->SetRegister32(STATE_CALLBACK_ADDRESS, m_callbackPtr);
 	registerFile->SetRegister32(STATE_STATUS, m_status);
 	registerFile->SetRegister32(STATE_PENDING_COMMAND, m_pendingCommand);
+	registerFile->SetRegister32(STATE_PENDING_COMMAND_SIZE, m_pendingCommandSize);
 	archive.InsertFile(registerFile);
 }
 
@@ -67,7 +70,7 @@ static uint8 Uint8ToBcd(uint8 input)
 
 uint32 CCdvdman::CdReadClockDirect(uint8* clockBuffer)
 {
-	auto currentTime = time(0);
+	auto currentTime = m_clockOverrideEnabled ? m_clockOverrideTime : time(0);
 	auto localTime = localtime(&currentTime);
 	clockBuffer[0] = 0;                                                        //Status (0 = ok, anything else = error)
 	clockBuffer[1] = Uint8ToBcd(static_cast<uint8>(localTime->tm_sec));        //Seconds
@@ -81,6 +84,12 @@ uint32 CCdvdman::CdReadClockDirect(uint8* clockBuffer)
 	return 1;
 }
 
+void CCdvdman::SetClockOverride(bool enabled, time_t clockTime)
+{
+	m_clockOverrideEnabled = enabled;
+	m_clockOverrideTime = clockTime;
+}
+
 uint32 CCdvdman::CdGetDiskTypeDirect(COpticalMedia* opticalMedia)
 {
 	//Assert just to make sure that we're not handling different optical medias
@@ -300,6 +309,16 @@ void CCdvdman::ProcessCommands()
 	}
 }
 
+bool CCdvdman::HasPendingCommand() const
+{
+	return (m_pendingCommand != COMMAND_NONE);
+}
+
+uint32 CCdvdman::GetPendingCommandSize() const
+{
+	return (m_pendingCommand != COMMAND_NONE) ? m_pendingCommandSize : 0;
+}
+
 void CCdvdman::SetOpticalMedia(COpticalMedia* opticalMedia)
 {
 	m_opticalMedia = opticalMedia;
@@ -338,6 +357,7 @@ uint32 CCdvdman::CdRead(uint32 startSector, uint32 sectorCount, uint32 bufferPtr
 	}
 	assert(m_pendingCommand == COMMAND_NONE);
 	m_pendingCommand = COMMAND_READ;
+	m_pendingCommandSize = sectorCount * 2048;
 	m_status = CDVD_STATUS_READING;
 	return 1;
 }
@@ -348,6 +368,7 @@ uint32 CCdvdman::CdSeek(uint32 sector)
 	                          sector);
 	assert(m_pendingCommand == COMMAND_NONE);
 	m_pendingCommand = COMMAND_SEEK;
+	m_pendingCommandSize = 0;
 	return 1;
 }
 
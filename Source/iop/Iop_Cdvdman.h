@@ -1,5 +1,6 @@
 #pragma once
 
+#include <ctime>
 #include "Iop_Module.h"
 #include "../OpticalMedia.h"
 #include "zip/ZipArchiveWriter.h"
@@ -35,12 +36,17 @@ namespace Iop
 		virtual void Invoke(CMIPS&, unsigned int) override;
 
 		void ProcessCommands();
+		bool HasPendingCommand() const;
+		uint32 GetPendingCommandSize() const;
 		void SetOpticalMedia(COpticalMedia*);
 
 		void LoadState(Framework::CZipArchiveReader&);
 		void SaveState(Framework::CZipArchiveWriter&);
 
 		uint32 CdReadClockDirect(uint8*);
+
+		//Makes the clock report the specified time instead of the host's current time
+		void SetClockOverride(bool, time_t = 0);
 		uint32 CdGetDiskTypeDirect(COpticalMedia*);
 
 	private:
@@ -88,6 +94,10 @@ namespace Iop
 		uint32 m_streamPos = 0;
 		uint32 m_streamBufferSize = 0;
 		COMMAND m_pendingCommand = COMMAND_NONE;
+		uint32 m_pendingCommandSize = 0;
+
+		bool m_clockOverrideEnabled = false;
+		time_t m_clockOverrideTime = 0;
 	};
 
 	typedef std::shared_ptr<CCdvdman> CdvdmanPtr;
@@ -85,6 +85,16 @@ void CFileIo::ProcessCommands(Iop::CSifMan* sifMan)
 	m_handler->ProcessCommands(sifMan);
 }
 
+bool CFileIo::HasPendingCommand() const
+{
+	return m_handler->HasPendingCommand();
+}
+
+uint32 CFileIo::GetPendingCommandSize() const
+{
+	return m_handler->GetPendingCommandSize();
+}
+
 //--------------------------------------------------
 // CHandler
 //--------------------------------------------------
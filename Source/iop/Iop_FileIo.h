@@ -27,6 +27,8 @@ namespace Iop
 			virtual void SaveState(Framework::CZipArchiveWriter&) const {};
 
 			virtual void ProcessCommands(CSifMan*){};
+			virtual bool HasPendingCommand() const { return false; };
+			virtual uint32 GetPendingCommandSize() const { return 0; };
 
 		protected:
 			CIoman* m_ioman = nullptr;
@@ -50,6 +52,8 @@ namespace Iop
 		void SaveState(Framework::CZipArchiveWriter&) const;
 
 		void ProcessCommands(Iop::CSifMan*);
+		bool HasPendingCommand() const;
+		uint32 GetPendingCommandSize() const;
 
 		static const char* g_moduleId;
 
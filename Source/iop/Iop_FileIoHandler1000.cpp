@@ -1,7 +1,7 @@
 #include <cstring>
 #include "Iop_FileIoHandler1000.h"
 #include "Iop_Ioman.h"
-#include "Iop_SifManPs2.h"
+#include "Iop_SifMan.h"
 #include "IopBios.h"
 #include "../Log.h"
 
@@ -208,11 +208,7 @@ void CFileIoHandler1000::FinishRequest(CMIPS& context)
 	int32 result = context.m_State.nGPR[CMIPS::A0].nV0;
 	auto moduleData = reinterpret_cast<MODULEDATA*>(m_iopRam + m_moduleDataAddr);
 
-	uint8* eeRam = nullptr;
-	if(auto sifManPs2 = dynamic_cast<CSifManPs2*>(&m_sifMan))
-	{
-		eeRam = sifManPs2->GetEeRam();
-	}
+	uint8* eeRam = m_sifMan.GetEeRam();
 
 	bool done = false;
 	switch(moduleData->method)
@@ -1,8 +1,9 @@
 #include <cassert>
 #include <cstring>
+#include <algorithm>
 #include "Iop_FileIoHandler2240.h"
 #include "Iop_Ioman.h"
-#include "Iop_SifManPs2.h"
+#include "Iop_SifMan.h"
 #include "../states/RegisterStateFile.h"
 #include "../states/MemoryStateFile.h"
 #include "../Log.h"
@@ -113,15 +114,24 @@ void CFileIoHandler2240::ProcessCommands(CSifMan* sifMan)
 {
 	if(m_pendingReply.valid)
 	{
-		uint8* eeRam = nullptr;
-		if(auto sifManPs2 = dynamic_cast<CSifManPs2*>(sifMan))
-		{
-			eeRam = sifManPs2->GetEeRam();
-		}
-		SendPendingReply(eeRam);
+		SendPendingReply(sifMan->GetEeRam());
 	}
 }
 
+bool CFileIoHandler2240::HasPendingCommand() const
+{
+	return m_pendingReply.valid;
+}
+
+uint32 CFileIoHandler2240::GetPendingCommandSize() const
+{
+	if(!m_pendingReply.valid) return 0;
+	auto header = reinterpret_cast<const REPLYHEADER*>(m_pendingReply.buffer.data());
+	if(header->commandId != COMMANDID_READ) return 0;
+	auto reply = reinterpret_cast<const READREPLY*>(m_pendingReply.buffer.data());
+	return std::max<int32>(reply->result, 0);
+}
+
 uint32 CFileIoHandler2240::InvokeOpen(uint32* args, uint32 argsSize, uint32* ret, uint32 retSize, uint8* ram)
 {
 	assert(retSize == 4);
@@ -200,7 +210,7 @@ uint32 CFileIoHandler2240::InvokeRead(uint32* args, uint32 argsSize, uint32* ret
 	reply.unknown3 = 0;
 	reply.unknown4 = 0;
 
-	//Delay read reply to next frame.
+	//Delay read reply until the BIOS decides the transfer is complete.
 	//Some games, like Shadow of the Colossus, seem to rely on the delay to
 	//work properly (probably because it causes EE threads to be rescheduled).
 	m_pendingReply.SetReply(reply);
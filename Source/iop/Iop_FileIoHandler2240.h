@@ -18,6 +18,8 @@ namespace Iop
 		void SaveState(Framework::CZipArchiveWriter&) const override;
 
 		void ProcessCommands(CSifMan*) override;
+		bool HasPendingCommand() const override;
+		uint32 GetPendingCommandSize() const override;
 
 	private:
 		struct PENDINGREPLY
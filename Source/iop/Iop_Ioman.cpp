@@ -35,10 +35,6 @@ using namespace Iop;
 #define FUNCTION_ADDDRV "AddDrv"
 #define FUNCTION_DELDRV "DelDrv"
 
-//Directories have "group read" only permissions? This is required by PS2PSXe.
-#define STAT_MODE_DIR (0747 | (1 << 12))  //File mode + Dir type (1)
-#define STAT_MODE_FILE (0777 | (2 << 12)) //File mode + File type (2)
-
 static std::string RightTrim(std::string inputString)
 {
 	auto nonSpaceEnd = std::find_if(inputString.rbegin(), inputString.rend(), [](int ch) { return !std::isspace(ch); });
@@ -374,14 +370,15 @@ int32 CIoman::Dread(uint32 handle, Ioman::DIRENTRY* dirEntry)
 		return 0;
 	}
 
-	auto itemPath = directory->path();
-	auto name = itemPath.filename().string();
+	//Use the entry's own queries since they can reuse what was obtained while enumerating the directory
+	const auto& item = *directory;
+	auto name = item.path().filename().string();
 	strncpy(dirEntry->name, name.c_str(), Ioman::DIRENTRY::NAME_SIZE);
 	dirEntry->name[Ioman::DIRENTRY::NAME_SIZE - 1] = 0;
 
 	auto& stat = dirEntry->stat;
 	memset(&stat, 0, sizeof(Ioman::STAT));
-	if(fs::is_directory(itemPath))
+	if(item.is_directory())
 	{
 		stat.mode = STAT_MODE_DIR;
 		stat.attr = 0x8427;
@@ -389,7 +386,7 @@ int32 CIoman::Dread(uint32 handle, Ioman::DIRENTRY* dirEntry)
 	else
 	{
 		stat.mode = STAT_MODE_FILE;
-		stat.loSize = fs::file_size(itemPath);
+		stat.loSize = item.file_size();
 		stat.attr = 0x8497;
 	}
 
@@ -402,6 +399,30 @@ uint32 CIoman::GetStat(const char* path, Ioman::STAT* stat)
 {
 	CLog::GetInstance().Print(LOG_NAME, "GetStat(path = '%s', stat = ptr);\r\n", path);
 
+	//Check if device can answer directly
+	try
+	{
+		auto pathInfo = SplitPath(path);
+		auto deviceIterator = m_devices.find(pathInfo.deviceName);
+		if(deviceIterator != m_devices.end())
+		{
+			memset(stat, 0, sizeof(Ioman::STAT));
+			switch(deviceIterator->second->GetStat(pathInfo.devicePath.c_str(), *stat))
+			{
+			case Ioman::CDevice::STAT_RESULT::FOUND:
+				return 0;
+			case Ioman::CDevice::STAT_RESULT::NOT_FOUND:
+				return -1;
+			default:
+				break;
+			}
+		}
+	}
+	catch(...)
+	{
+		//Errors will be reported by the fallback below
+	}
+
 	//Try with a file
 	{
 		int32 fd = Open(Ioman::CDevice::OPEN_FLAG_RDONLY, path);
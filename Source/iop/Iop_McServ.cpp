@@ -1,5 +1,6 @@
 #include <assert.h>
 #include <stdio.h>
+#include <cctype>
 #include <algorithm>
 #include "../AppConfig.h"
 #include "../PS2VM_Preferences.h"
@@ -8,7 +9,7 @@
 #include "Iop_PathUtils.h"
 #include "Iop_Sysmem.h"
 #include "Iop_SifCmd.h"
-#include "Iop_SifManPs2.h"
+#include "Iop_SifMan.h"
 #include "IopBios.h"
 #include "StdStreamUtils.h"
 #include "StringUtils.h"
@@ -18,6 +19,8 @@
 using namespace Iop;
 
 #define CLUSTER_SIZE 0x400
+//Amount of buffered write data that forces a write to the host file
+#define WRITE_BUFFER_SIZE 0x40000
 
 #define LOG_NAME ("iop_mcserv")
 
@@ -30,8 +33,13 @@ using namespace Iop;
 
 #define SEPARATOR_CHAR '/'
 
+//Default filesystems on these hosts match file names regardless of case
+#if defined(_WIN32) || defined(__APPLE__)
+#define CARD_INDEX_FOLD_CASE
+#endif
+
 // clang-format off
-const char* CMcServ::m_mcPathPreference[2] =
+const char* CMcServ::m_mcPathPreference[MAX_PORTS] =
 {
 	PREF_PS2_MC0_DIRECTORY,
 	PREF_PS2_MC1_DIRECTORY,
@@ -50,11 +58,33 @@ CMcServ::CMcServ(CIopBios& bios, CSifMan& sifMan, CSifCmd& sifCmd, CSysmem& sysM
 	BuildCustomCode();
 }
 
+CMcServ::~CMcServ()
+{
+	FlushPendingWrites();
+}
+
 const char* CMcServ::GetMcPathPreference(unsigned int port)
 {
 	return m_mcPathPreference[port];
 }
 
+void CMcServ::FlushPendingWrites()
+{
+	for(auto& file : m_files)
+	{
+		FlushWriteBuffer(file);
+	}
+	WaitPendingWrites();
+}
+
+void CMcServ::InvalidateCardIndices()
+{
+	for(auto& cardIndex : m_cardIndices)
+	{
+		cardIndex.Invalidate();
+	}
+}
+
 std::string CMcServ::GetId() const
 {
 	return MODULE_NAME;
@@ -272,7 +302,11 @@ void CMcServ::Open(uint32* args, uint32 argsSize, uint32* ret, uint32 retSize, u
 		return;
 	}
 
+	//Host file might still be written by a previous close
+	WaitPendingWrites();
+
 	fs::path filePath;
+	std::string cardPath = MakeCardPath(m_currentDirectory, cmd->name);
 
 	try
 	{
@@ -285,6 +319,8 @@ void CMcServ::Open(uint32* args, uint32 argsSize, uint32* ret, uint32 retSize, u
 		return;
 	}
 
+	auto& cardIndex = GetCardIndex(cmd->port);
+
 	if(cmd->flags == 0x40)
 	{
 		//Directory only?
@@ -292,6 +328,7 @@ void CMcServ::Open(uint32* args, uint32 argsSize, uint32* ret, uint32 retSize, u
 		try
 		{
 			fs::create_directory(filePath);
+			cardIndex.AddDirectory(cardPath);
 			result = 0;
 		}
 		catch(...)
@@ -302,40 +339,51 @@ void CMcServ::Open(uint32* args, uint32 argsSize, uint32* ret, uint32 retSize, u
 	}
 	else
 	{
-		if(cmd->flags & OPEN_FLAG_CREAT)
+		auto indexEntry = cardIndex.FindEntry(cardPath);
+		if((indexEntry == nullptr) || indexEntry->isDirectory)
 		{
-			if(!fs::exists(filePath))
+			if(!(cmd->flags & OPEN_FLAG_CREAT) || (indexEntry != nullptr))
 			{
-				//Create file if it doesn't exist
-				Framework::CreateOutputStdStream(filePath.native());
+				//Not existing file
+				ret[0] = RET_NO_ENTRY;
+				return;
 			}
 		}
 
-		if(cmd->flags & OPEN_FLAG_TRUNC)
+		try
 		{
-			if(fs::exists(filePath))
+			//Create file if it doesn't exist or discard its contents if requested.
+			//Index might not know about a file that exists on the host (ie.: name differs in case
+			//on a case insensitive filesystem), check before discarding anything.
+			bool truncate = (cmd->flags & OPEN_FLAG_TRUNC) || !fs::exists(filePath);
+			if(truncate)
 			{
-				//Create file (discard contents) if it exists
 				Framework::CreateOutputStdStream(filePath.native());
 			}
-		}
+			uint32 fileSize = truncate ? 0 : static_cast<uint32>(fs::file_size(filePath));
+			if(truncate || (indexEntry == nullptr))
+			{
+				cardIndex.UpdateFile(cardPath, fileSize);
+			}
 
-		//At this point, we assume that the file has been created or truncated
-		try
-		{
-			auto file = Framework::CreateUpdateExistingStdStream(filePath.native());
+			auto stream = Framework::CreateUpdateExistingStdStream(filePath.native());
 			uint32 handle = GenerateHandle();
 			if(handle == -1)
 			{
 				//Exhausted all file handles
 				throw std::exception();
 			}
-			m_files[handle] = std::move(file);
+
+			auto& file = m_files[handle];
+			file.stream = std::move(stream);
+			file.port = cmd->port;
+			file.cardPath = cardPath;
+			file.size = fileSize;
+			file.writeBuffer.clear();
 			ret[0] = handle;
 		}
 		catch(...)
 		{
-			//Not existing file?
 			ret[0] = RET_NO_ENTRY;
 			return;
 		}
@@ -356,7 +404,44 @@ void CMcServ::Close(uint32* args, uint32 argsSize, uint32* ret, uint32 retSize,
 		return;
 	}
 
-	file->Clear();
+	if(file->writeBuffer.empty())
+	{
+		file->stream.Clear();
+	}
+	else
+	{
+		//Forget about writes that are already done
+		for(auto pendingWriteIterator = m_pendingWrites.begin();
+		    pendingWriteIterator != m_pendingWrites.end();)
+		{
+			if(pendingWriteIterator->wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+			{
+				pendingWriteIterator = m_pendingWrites.erase(pendingWriteIterator);
+			}
+			else
+			{
+				pendingWriteIterator++;
+			}
+		}
+
+		//Let the host write the remaining data and close the file in the background
+		auto writeTask =
+		    [stream = std::move(file->stream), writeBuffer = std::move(file->writeBuffer)]() mutable {
+			    try
+			    {
+				    stream.Write(writeBuffer.data(), writeBuffer.size());
+				    stream.Clear();
+			    }
+			    catch(const std::exception& exception)
+			    {
+				    CLog::GetInstance().Warn(LOG_NAME, "Error while writing memory card file: %s.\r\n", exception.what());
+			    }
+		    };
+		m_pendingWrites.push_back(std::async(std::launch::async, std::move(writeTask)));
+		file->stream = Framework::CStdStream();
+		file->writeBuffer.clear();
+	}
+	file->cardPath.clear();
 
 	ret[0] = 0;
 }
@@ -393,8 +478,9 @@ void CMcServ::Seek(uint32* args, uint32 argsSize, uint32* ret, uint32 retSize, u
 		break;
 	}
 
-	file->Seek(cmd->offset, origin);
-	ret[0] = static_cast<uint32>(file->Tell());
+	FlushWriteBuffer(*file);
+	file->stream.Seek(cmd->offset, origin);
+	ret[0] = static_cast<uint32>(file->stream.Tell());
 }
 
 void CMcServ::Read(uint32* args, uint32 argsSize, uint32* ret, uint32 retSize, uint8* ram)
@@ -422,7 +508,8 @@ void CMcServ::Read(uint32* args, uint32 argsSize, uint32* ret, uint32 retSize, u
 		reinterpret_cast<uint32*>(&ram[cmd->paramAddress])[1] = 0;
 	}
 
-	ret[0] = static_cast<uint32>(file->Read(dst, cmd->size));
+	FlushWriteBuffer(*file);
+	ret[0] = static_cast<uint32>(file->stream.Read(dst, cmd->size));
 }
 
 void CMcServ::Write(uint32* args, uint32 argsSize, uint32* ret, uint32 retSize, uint8* ram)
@@ -440,17 +527,34 @@ void CMcServ::Write(uint32* args, uint32 argsSize, uint32* ret, uint32 retSize,
 		return;
 	}
 
-	const void* dst = &ram[cmd->bufferAddress];
+	const uint8* src = &ram[cmd->bufferAddress];
 	uint32 result = 0;
 
+	//Data is accumulated in the write buffer and reaches the host file when something else accesses it
+	auto& writeBuffer = file->writeBuffer;
+	if(writeBuffer.empty())
+	{
+		file->writeBufferPosition = file->stream.Tell();
+	}
+
 	//Write "origin" bytes from "data" field first
 	if(cmd->origin != 0)
 	{
-		file->Write(cmd->data, cmd->origin);
+		writeBuffer.insert(writeBuffer.end(), cmd->data, cmd->data + cmd->origin);
 		result += cmd->origin;
 	}
 
-	result += static_cast<uint32>(file->Write(dst, cmd->size));
+	writeBuffer.insert(writeBuffer.end(), src, src + cmd->size);
+	result += cmd->size;
+
+	file->size = std::max<uint32>(file->size, static_cast<uint32>(file->writeBufferPosition + writeBuffer.size()));
+	GetCardIndex(file->port).UpdateFile(file->cardPath, file->size);
+
+	if(writeBuffer.size() >= WRITE_BUFFER_SIZE)
+	{
+		FlushWriteBuffer(*file);
+	}
+
 	ret[0] = result;
 }
 
@@ -468,7 +572,8 @@ void CMcServ::Flush(uint32* args, uint32 argsSize, uint32* ret, uint32 retSize,
 		return;
 	}
 
-	file->Flush();
+	FlushWriteBuffer(*file);
+	file->stream.Flush();
 
 	ret[0] = 0;
 }
@@ -485,30 +590,9 @@ void CMcServ::ChDir(uint32* args, uint32 argsSize, uint32* ret, uint32 retSize,
 
 	try
 	{
-		std::string newCurrentDirectory;
-		std::string requestedDirectory(cmd->name);
-
-		if(!requestedDirectory.empty() && (requestedDirectory[0] == SEPARATOR_CHAR))
-		{
-			if(requestedDirectory.length() != 1)
-			{
-				newCurrentDirectory = requestedDirectory;
-			}
-			else
-			{
-				//Clear if only separator char
-				newCurrentDirectory.clear();
-			}
-		}
-		else
-		{
-			newCurrentDirectory = m_currentDirectory + SEPARATOR_CHAR + requestedDirectory;
-		}
+		auto newCurrentDirectory = MakeCardPath(m_currentDirectory, cmd->name);
 
-		auto mcPath = CAppConfig::GetInstance().GetPreferencePath(m_mcPathPreference[cmd->port]);
-		auto hostPath = Iop::PathUtils::MakeHostPath(mcPath, newCurrentDirectory.c_str());
-
-		if(fs::exists(hostPath) && fs::is_directory(hostPath))
+		if(GetCardIndex(cmd->port).FindDirectory(newCurrentDirectory) != nullptr)
 		{
 			m_currentDirectory = newCurrentDirectory;
 			result = 0;
@@ -551,31 +635,27 @@ void CMcServ::GetDir(uint32* args, uint32 argsSize, uint32* ret, uint32 retSize,
 		{
 			m_pathFinder.Reset();
 
-			auto mcPath = CAppConfig::GetInstance().GetPreferencePath(m_mcPathPreference[cmd->port]);
-			if(cmd->name[0] != SEPARATOR_CHAR)
-			{
-				mcPath = Iop::PathUtils::MakeHostPath(mcPath, m_currentDirectory.c_str());
-			}
-			mcPath = fs::absolute(mcPath);
+			const auto& cardIndex = GetCardIndex(cmd->port);
+			auto basePath = (cmd->name[0] != SEPARATOR_CHAR) ? m_currentDirectory : std::string();
 
-			if(!fs::exists(mcPath))
+			if(cardIndex.FindDirectory(basePath) == nullptr)
 			{
 				//Directory doesn't exist
 				ret[0] = RET_NO_ENTRY;
 				return;
 			}
 
-			auto searchPath = Iop::PathUtils::MakeHostPath(mcPath, cmd->name);
-			searchPath.remove_filename();
-			if(!fs::exists(searchPath))
+			std::string name(cmd->name);
+			auto separatorPosition = name.find_last_of(SEPARATOR_CHAR);
+			auto searchPath = (separatorPosition != std::string::npos) ? MakeCardPath(basePath, name.substr(0, separatorPosition + 1).c_str()) : basePath;
+			if(cardIndex.FindDirectory(searchPath) == nullptr)
 			{
 				//Specified directory doesn't exist, this is an error
 				ret[0] = RET_NO_ENTRY;
 				return;
 			}
 
-			assert(*mcPath.string().rbegin() != '/');
-			m_pathFinder.Search(mcPath, cmd->name);
+			m_pathFinder.Search(cardIndex, basePath, cmd->name);
 		}
 
 		auto entries = (cmd->maxEntries > 0) ? reinterpret_cast<ENTRY*>(&ram[cmd->tableAddress]) : nullptr;
@@ -595,12 +675,18 @@ void CMcServ::Delete(uint32* args, uint32 argsSize, uint32* ret, uint32 retSize,
 
 	CLog::GetInstance().Print(LOG_NAME, "Delete(port = %d, slot = %d, name = '%s');\r\n", cmd->port, cmd->slot, cmd->name);
 
+	//Host file might still be written by a previous close
+	WaitPendingWrites();
+
 	try
 	{
 		auto filePath = GetAbsoluteFilePath(cmd->port, cmd->slot, cmd->name);
-		if(fs::exists(filePath))
+		auto cardPath = MakeCardPath(m_currentDirectory, cmd->name);
+		auto& cardIndex = GetCardIndex(cmd->port);
+		if(cardIndex.FindEntry(cardPath) != nullptr)
 		{
 			fs::remove(filePath);
+			cardIndex.RemoveEntry(cardPath);
 			ret[0] = 0;
 		}
 		else
@@ -624,10 +710,9 @@ void CMcServ::GetEntSpace(uint32* args, uint32 argsSize, uint32* ret, uint32 ret
 	CLog::GetInstance().Print(LOG_NAME, "GetEntSpace(port = %i, slot = %i, flags = %i, name = %s);\r\n",
 	                          cmd->port, cmd->slot, cmd->flags, cmd->name);
 
-	auto mcPath = CAppConfig::GetInstance().GetPreferencePath(m_mcPathPreference[cmd->port]);
-	auto savePath = Iop::PathUtils::MakeHostPath(mcPath, cmd->name);
+	auto savePath = MakeCardPath(std::string(), cmd->name);
 
-	if(fs::exists(savePath) && fs::is_directory(savePath))
+	if(GetCardIndex(cmd->port).FindDirectory(savePath) != nullptr)
 	{
 		// Arbitrarity number, allows Drakengard to detect MC
 		ret[0] = 0xFE;
@@ -662,6 +747,8 @@ bool CMcServ::ReadFast(uint32* args, uint32 argsSize, uint32* ret, uint32 retSiz
 
 	ret[0] = 1;
 
+	FlushWriteBuffer(*file);
+
 	auto moduleData = reinterpret_cast<MODULEDATA*>(m_ram + m_moduleDataAddr);
 	moduleData->readFastHandle = cmd->handle;
 	moduleData->readFastSize = cmd->size;
@@ -706,17 +793,13 @@ void CMcServ::ProceedReadFast(CMIPS& context)
 
 	uint32 readSize = std::min<uint32>(moduleData->readFastSize, CLUSTER_SIZE);
 
+	//Read straight into the EE buffer, scratch cluster is only used to keep file position in sync if EE memory isn't available
 	uint8 cluster[CLUSTER_SIZE];
-	uint32 amountRead = file->Read(cluster, readSize);
+	uint8* dst = m_sifMan.GetEeMemory(moduleData->readFastBufferAddress, readSize);
+	uint32 amountRead = file->stream.Read(dst ? dst : cluster, readSize);
 	assert(amountRead == readSize);
 	moduleData->readFastSize -= readSize;
 
-	if(auto sifManPs2 = dynamic_cast<CSifManPs2*>(&m_sifMan))
-	{
-		auto eeRam = sifManPs2->GetEeRam();
-		memcpy(eeRam + moduleData->readFastBufferAddress, cluster, readSize);
-	}
-
 	reinterpret_cast<uint32*>(moduleData->rpcBuffer)[3] = readSize;
 
 	context.m_State.nGPR[CMIPS::A0].nV0 = m_moduleDataAddr + offsetof(MODULEDATA, rpcClientData);
@@ -741,12 +824,12 @@ uint32 CMcServ::GenerateHandle()
 {
 	for(unsigned int i = 0; i < MAX_FILES; i++)
 	{
-		if(m_files[i].IsEmpty()) return i;
+		if(m_files[i].stream.IsEmpty()) return i;
 	}
 	return -1;
 }
 
-Framework::CStdStream* CMcServ::GetFileFromHandle(uint32 handle)
+CMcServ::OPENFILE* CMcServ::GetFileFromHandle(uint32 handle)
 {
 	assert(handle < MAX_FILES);
 	if(handle >= MAX_FILES)
@@ -754,7 +837,7 @@ Framework::CStdStream* CMcServ::GetFileFromHandle(uint32 handle)
 		return nullptr;
 	}
 	auto& file = m_files[handle];
-	if(file.IsEmpty())
+	if(file.stream.IsEmpty())
 	{
 		return nullptr;
 	}
@@ -778,6 +861,234 @@ fs::path CMcServ::GetAbsoluteFilePath(unsigned int port, unsigned int slot, cons
 	}
 }
 
+std::string CMcServ::MakeCardPath(const std::string& basePath, const char* name)
+{
+	//Resolves a guest path (absolute or relative to basePath) into a card path used by the index
+	std::vector<std::string> components;
+	auto appendComponents =
+	    [&components](const std::string& path) {
+		    size_t position = 0;
+		    while(position <= path.size())
+		    {
+			    auto separatorPosition = path.find(SEPARATOR_CHAR, position);
+			    if(separatorPosition == std::string::npos) separatorPosition = path.size();
+			    auto component = path.substr(position, separatorPosition - position);
+			    if(component == "..")
+			    {
+				    if(!components.empty()) components.pop_back();
+			    }
+			    else if(!component.empty() && (component != "."))
+			    {
+				    components.push_back(component);
+			    }
+			    position = separatorPosition + 1;
+		    }
+	    };
+
+	if(name[0] != SEPARATOR_CHAR)
+	{
+		appendComponents(basePath);
+	}
+	appendComponents(name);
+
+	std::string result;
+	for(const auto& component : components)
+	{
+		result += SEPARATOR_CHAR;
+		result += component;
+	}
+	return result;
+}
+
+CMcServ::CCardIndex& CMcServ::GetCardIndex(unsigned int port)
+{
+	assert(port < MAX_PORTS);
+	auto mcPath = CAppConfig::GetInstance().GetPreferencePath(m_mcPathPreference[port]);
+	auto& cardIndex = m_cardIndices[port];
+	if(!cardIndex.IsBuiltFor(mcPath))
+	{
+		cardIndex.Build(mcPath);
+	}
+	return cardIndex;
+}
+
+void CMcServ::FlushWriteBuffer(OPENFILE& file)
+{
+	if(file.writeBuffer.empty()) return;
+	try
+	{
+		file.stream.Write(file.writeBuffer.data(), file.writeBuffer.size());
+	}
+	catch(const std::exception& exception)
+	{
+		CLog::GetInstance().Warn(LOG_NAME, "Error while writing memory card file: %s.\r\n", exception.what());
+	}
+	file.writeBuffer.clear();
+}
+
+void CMcServ::WaitPendingWrites()
+{
+	for(auto& pendingWrite : m_pendingWrites)
+	{
+		pendingWrite.wait();
+	}
+	m_pendingWrites.clear();
+}
+
+static CMcServ::ENTRY::TIME MakeEntryTime(std::time_t systemTime)
+{
+	auto localTime = std::localtime(&systemTime);
+
+	CMcServ::ENTRY::TIME result = {};
+	result.second = localTime->tm_sec;
+	result.minute = localTime->tm_min;
+	result.hour = localTime->tm_hour;
+	result.day = localTime->tm_mday;
+	result.month = localTime->tm_mon;
+	result.year = localTime->tm_year + 1900;
+	return result;
+}
+
+/////////////////////////////////////////////
+//CCardIndex Implementation
+/////////////////////////////////////////////
+
+bool CMcServ::CCardIndex::IsBuiltFor(const fs::path& basePath) const
+{
+	return m_built && (m_basePath == basePath);
+}
+
+void CMcServ::CCardIndex::Invalidate()
+{
+	m_built = false;
+}
+
+void CMcServ::CCardIndex::Build(const fs::path& basePath)
+{
+	m_basePath = basePath;
+	m_directories.clear();
+	m_built = false;
+
+	try
+	{
+		//Index is only kept if card directory exists, otherwise it will be attempted again on next access
+		if(fs::is_directory(basePath))
+		{
+			BuildRecurse(basePath, std::string());
+			m_built = true;
+		}
+	}
+	catch(const std::exception& exception)
+	{
+		CLog::GetInstance().Warn(LOG_NAME, "Failed to index memory card directory: %s.\r\n", exception.what());
+		m_directories.clear();
+	}
+}
+
+std::string CMcServ::CCardIndex::MakeKey(std::string path)
+{
+#ifdef CARD_INDEX_FOLD_CASE
+	std::transform(path.begin(), path.end(), path.begin(),
+	               [](char character) { return static_cast<char>(tolower(static_cast<unsigned char>(character))); });
+#endif
+	return path;
+}
+
+void CMcServ::CCardIndex::BuildRecurse(const fs::path& hostPath, const std::string& cardPath)
+{
+	auto& directory = m_directories[MakeKey(cardPath)];
+	for(const auto& element : fs::directory_iterator(hostPath))
+	{
+		auto name = element.path().filename().string();
+
+		INDEXENTRY entry;
+		entry.name = name;
+		entry.isDirectory = fs::is_directory(element);
+		entry.size = entry.isDirectory ? 0 : static_cast<uint32>(fs::file_size(element));
+		entry.modificationTime = MakeEntryTime(Framework::ConvertFsTimeToSystemTime(fs::last_write_time(element)));
+		directory[MakeKey(name)] = entry;
+
+		if(entry.isDirectory)
+		{
+			BuildRecurse(element.path(), cardPath + SEPARATOR_CHAR + name);
+		}
+	}
+}
+
+const CMcServ::CCardIndex::Directory* CMcServ::CCardIndex::FindDirectory(const std::string& cardPath) const
+{
+	auto directoryIterator = m_directories.find(MakeKey(cardPath));
+	return (directoryIterator != m_directories.end()) ? &directoryIterator->second : nullptr;
+}
+
+const CMcServ::INDEXENTRY* CMcServ::CCardIndex::FindEntry(const std::string& cardPath) const
+{
+	auto separatorPosition = cardPath.find_last_of(SEPARATOR_CHAR);
+	if(separatorPosition == std::string::npos) return nullptr;
+	auto directory = FindDirectory(cardPath.substr(0, separatorPosition));
+	if(directory == nullptr) return nullptr;
+	auto entryIterator = directory->find(MakeKey(cardPath.substr(separatorPosition + 1)));
+	return (entryIterator != directory->end()) ? &entryIterator->second : nullptr;
+}
+
+//Returns the directory containing the entry at cardPath, name receives the entry's name
+CMcServ::CCardIndex::Directory* CMcServ::CCardIndex::FindParentDirectory(const std::string& cardPath, std::string& name)
+{
+	auto separatorPosition = cardPath.find_last_of(SEPARATOR_CHAR);
+	if(separatorPosition == std::string::npos) return nullptr;
+	auto directoryIterator = m_directories.find(MakeKey(cardPath.substr(0, separatorPosition)));
+	if(directoryIterator == m_directories.end()) return nullptr;
+	name = cardPath.substr(separatorPosition + 1);
+	return &directoryIterator->second;
+}
+
+void CMcServ::CCardIndex::AddDirectory(const std::string& cardPath)
+{
+	std::string name;
+	auto parentDirectory = FindParentDirectory(cardPath, name);
+	if(parentDirectory == nullptr) return;
+
+	//Existing entries keep their name, the host keeps the existing file's case too
+	auto& entry = (*parentDirectory)[MakeKey(name)];
+	if(entry.name.empty()) entry.name = name;
+	entry.isDirectory = true;
+	entry.size = 0;
+	entry.modificationTime = MakeEntryTime(std::time(nullptr));
+	m_directories[MakeKey(cardPath)];
+}
+
+void CMcServ::CCardIndex::UpdateFile(const std::string& cardPath, uint32 size)
+{
+	std::string name;
+	auto parentDirectory = FindParentDirectory(cardPath, name);
+	if(parentDirectory == nullptr) return;
+
+	auto& entry = (*parentDirectory)[MakeKey(name)];
+	if(entry.name.empty()) entry.name = name;
+	entry.isDirectory = false;
+	entry.size = size;
+	entry.modificationTime = MakeEntryTime(std::time(nullptr));
+}
+
+void CMcServ::CCardIndex::RemoveEntry(const std::string& cardPath)
+{
+	std::string name;
+	auto parentDirectory = FindParentDirectory(cardPath, name);
+	if(parentDirectory == nullptr) return;
+	parentDirectory->erase(MakeKey(name));
+
+	//Also remove directory (and anything it contained) if entry was one
+	auto directoryKey = MakeKey(cardPath);
+	m_directories.erase(directoryKey);
+	auto childPathPrefix = directoryKey + SEPARATOR_CHAR;
+	auto directoryIterator = m_directories.lower_bound(childPathPrefix);
+	while((directoryIterator != m_directories.end()) &&
+	      (directoryIterator->first.compare(0, childPathPrefix.size(), childPathPrefix) == 0))
+	{
+		directoryIterator = m_directories.erase(directoryIterator);
+	}
+}
+
 /////////////////////////////////////////////
 //CPathFinder Implementation
 /////////////////////////////////////////////
@@ -797,10 +1108,8 @@ void CMcServ::CPathFinder::Reset()
 	m_index = 0;
 }
 
-void CMcServ::CPathFinder::Search(const fs::path& basePath, const char* filter)
+void CMcServ::CPathFinder::Search(const CCardIndex& cardIndex, const std::string& basePath, const char* filter)
 {
-	m_basePath = basePath;
-
 	std::string filterPathString = filter;
 	if(filterPathString[0] != '/')
 	{
@@ -844,7 +1153,7 @@ void CMcServ::CPathFinder::Search(const fs::path& basePath, const char* filter)
 		m_entries.push_back(entry);
 	}
 
-	SearchRecurse(m_basePath);
+	SearchRecurse(cardIndex, basePath, std::string());
 }
 
 unsigned int CMcServ::CPathFinder::Read(ENTRY* entry, unsigned int size)
@@ -863,19 +1172,19 @@ unsigned int CMcServ::CPathFinder::Read(ENTRY* entry, unsigned int size)
 	return readCount;
 }
 
-void CMcServ::CPathFinder::SearchRecurse(const fs::path& path)
+void CMcServ::CPathFinder::SearchRecurse(const CCardIndex& cardIndex, const std::string& cardPath, const std::string& relativePath)
 {
-	bool found = false;
-	fs::directory_iterator endIterator;
+	auto directory = cardIndex.FindDirectory(cardPath);
+	if(directory == nullptr) return;
 
-	for(fs::directory_iterator elementIterator(path);
-	    elementIterator != endIterator; elementIterator++)
+	bool found = false;
+	for(const auto& entryPair : *directory)
 	{
-		fs::path relativePath(*elementIterator);
-		std::string relativePathString(relativePath.generic_string());
+		const auto& indexEntry = entryPair.second;
+		const auto& name = indexEntry.name;
 
-		//"Extract" a more appropriate relative path from the memory card point of view
-		relativePathString.erase(0, m_basePath.string().size());
+		//Path relative to the search's base directory
+		std::string relativePathString = relativePath + SEPARATOR_CHAR + name;
 
 		//Attempt to match this against the filter
 		if(std::regex_match(relativePathString, m_filterExp))
@@ -884,32 +1193,21 @@ void CMcServ::CPathFinder::SearchRecurse(const fs::path& path)
 			ENTRY entry;
 			memset(&entry, 0, sizeof(entry));
 
-			strncpy(reinterpret_cast<char*>(entry.name), relativePath.filename().string().c_str(), 0x1F);
+			strncpy(reinterpret_cast<char*>(entry.name), name.c_str(), 0x1F);
 			entry.name[0x1F] = 0;
 
-			if(fs::is_directory(*elementIterator))
+			if(indexEntry.isDirectory)
 			{
 				entry.size = 0;
 				entry.attributes = 0x8427;
 			}
 			else
 			{
-				entry.size = static_cast<uint32>(fs::file_size(*elementIterator));
+				entry.size = indexEntry.size;
 				entry.attributes = 0x8497;
 			}
 
-			//Fill in modification date info
-			{
-				auto changeSystemTime = Framework::ConvertFsTimeToSystemTime(fs::last_write_time(*elementIterator));
-				auto localChangeDate = std::localtime(&changeSystemTime);
-
-				entry.modificationTime.second = localChangeDate->tm_sec;
-				entry.modificationTime.minute = localChangeDate->tm_min;
-				entry.modificationTime.hour = localChangeDate->tm_hour;
-				entry.modificationTime.day = localChangeDate->tm_mday;
-				entry.modificationTime.month = localChangeDate->tm_mon;
-				entry.modificationTime.year = localChangeDate->tm_year + 1900;
-			}
+			entry.modificationTime = indexEntry.modificationTime;
 
 			//std::filesystem doesn't provide a way to get creation time, so just make it the same as modification date
 			entry.creationTime = entry.modificationTime;
@@ -918,9 +1216,9 @@ void CMcServ::CPathFinder::SearchRecurse(const fs::path& path)
 			found = true;
 		}
 
-		if(fs::is_directory(*elementIterator) && !found)
+		if(indexEntry.isDirectory && !found)
 		{
-			SearchRecurse(*elementIterator);
+			SearchRecurse(cardIndex, cardPath + SEPARATOR_CHAR + name, relativePathString);
 		}
 	}
 }
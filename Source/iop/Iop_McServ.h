@@ -2,6 +2,8 @@
 
 #include <string>
 #include <map>
+#include <vector>
+#include <future>
 #include <regex>
 #include "filesystem_def.h"
 #include "StdStream.h"
@@ -52,11 +54,38 @@ namespace Iop
 			uint8 name[0x20];
 		};
 
+		struct FILECMD
+		{
+			uint32 handle;
+			uint32 pad[2];
+			uint32 size;
+			uint32 offset;
+			uint32 origin;
+			uint32 bufferAddress;
+			uint32 paramAddress;
+			char data[16];
+		};
+
+		enum OPEN_FLAGS
+		{
+			OPEN_FLAG_RDONLY = 0x00000001,
+			OPEN_FLAG_WRONLY = 0x00000002,
+			OPEN_FLAG_RDWR = 0x00000003,
+			OPEN_FLAG_CREAT = 0x00000200,
+			OPEN_FLAG_TRUNC = 0x00000400,
+		};
+
 		CMcServ(CIopBios&, CSifMan&, CSifCmd&, CSysmem&, uint8*);
-		virtual ~CMcServ() = default;
+		virtual ~CMcServ();
 
 		static const char* GetMcPathPreference(unsigned int);
 
+		//Makes sure all data written by the guest has reached the host files
+		void FlushPendingWrites();
+
+		//Card directories were modified by something else than the guest, indices are rebuilt on next access
+		void InvalidateCardIndices();
+
 		std::string GetId() const override;
 		std::string GetFunctionName(unsigned int) const override;
 		void Invoke(CMIPS&, unsigned int) override;
@@ -92,30 +121,51 @@ namespace Iop
 			RET_PERMISSION_DENIED = -5
 		};
 
-		enum OPEN_FLAGS
+		enum
 		{
-			OPEN_FLAG_RDONLY = 0x00000001,
-			OPEN_FLAG_WRONLY = 0x00000002,
-			OPEN_FLAG_RDWR = 0x00000003,
-			OPEN_FLAG_CREAT = 0x00000200,
-			OPEN_FLAG_TRUNC = 0x00000400,
+			MAX_FILES = 5,
+			MAX_PORTS = 2,
 		};
 
-		enum
+		struct INDEXENTRY
 		{
-			MAX_FILES = 5
+			std::string name;
+			bool isDirectory = false;
+			uint32 size = 0;
+			ENTRY::TIME modificationTime = {};
 		};
 
-		struct FILECMD
+		//In-memory copy of a memory card's directory tree, built when the card is first accessed and
+		//kept up to date by the server's own operations. Directories are keyed by their card path
+		//("" for the root, "/BASLUS-00000" for a save directory), entries by their name. On hosts with
+		//case insensitive filesystems, keys are folded to lower case so lookups match like the host would.
+		class CCardIndex
 		{
-			uint32 handle;
-			uint32 pad[2];
-			uint32 size;
-			uint32 offset;
-			uint32 origin;
-			uint32 bufferAddress;
-			uint32 paramAddress;
-			char data[16];
+		public:
+			typedef std::map<std::string, INDEXENTRY> Directory;
+
+			bool IsBuiltFor(const fs::path&) const;
+			void Build(const fs::path&);
+			void Invalidate();
+
+			const Directory* FindDirectory(const std::string&) const;
+			const INDEXENTRY* FindEntry(const std::string&) const;
+
+			void AddDirectory(const std::string&);
+			void UpdateFile(const std::string&, uint32);
+			void RemoveEntry(const std::string&);
+
+		private:
+			typedef std::map<std::string, Directory> DirectoryMap;
+
+			static std::string MakeKey(std::string);
+
+			void BuildRecurse(const fs::path&, const std::string&);
+			Directory* FindParentDirectory(const std::string&, std::string&);
+
+			fs::path m_basePath;
+			DirectoryMap m_directories;
+			bool m_built = false;
 		};
 
 		class CPathFinder
@@ -125,20 +175,31 @@ namespace Iop
 			virtual ~CPathFinder();
 
 			void Reset();
-			void Search(const fs::path&, const char*);
+			void Search(const CCardIndex&, const std::string&, const char*);
 			unsigned int Read(ENTRY*, unsigned int);
 
 		private:
 			typedef std::vector<ENTRY> EntryList;
 
-			void SearchRecurse(const fs::path&);
+			void SearchRecurse(const CCardIndex&, const std::string&, const std::string&);
 
 			EntryList m_entries;
-			fs::path m_basePath;
 			std::regex m_filterExp;
 			unsigned int m_index;
 		};
 
+		struct OPENFILE
+		{
+			Framework::CStdStream stream;
+			unsigned int port = 0;
+			std::string cardPath;
+			uint32 size = 0;
+
+			//Data written by the guest that hasn't been sent to the host file yet, starts at writeBufferPosition
+			std::vector<uint8> writeBuffer;
+			uint64 writeBufferPosition = 0;
+		};
+
 		void BuildCustomCode();
 		uint32 AssembleReadFast(CMIPSAssembler&);
 
@@ -162,8 +223,13 @@ namespace Iop
 		void FinishReadFast(CMIPS&);
 
 		uint32 GenerateHandle();
-		Framework::CStdStream* GetFileFromHandle(uint32);
+		OPENFILE* GetFileFromHandle(uint32);
 		fs::path GetAbsoluteFilePath(unsigned int, unsigned int, const char*) const;
+		static std::string MakeCardPath(const std::string&, const char*);
+		CCardIndex& GetCardIndex(unsigned int);
+
+		void FlushWriteBuffer(OPENFILE&);
+		void WaitPendingWrites();
 
 		CIopBios& m_bios;
 		CSifMan& m_sifMan;
@@ -175,9 +241,11 @@ namespace Iop
 		uint32 m_proceedReadFastAddr = 0;
 		uint32 m_finishReadFastAddr = 0;
 		uint32 m_readFastAddr = 0;
-		Framework::CStdStream m_files[MAX_FILES];
-		static const char* m_mcPathPreference[2];
+		OPENFILE m_files[MAX_FILES];
+		static const char* m_mcPathPreference[MAX_PORTS];
 		std::string m_currentDirectory;
 		CPathFinder m_pathFinder;
+		CCardIndex m_cardIndices[MAX_PORTS];
+		std::vector<std::future<void>> m_pendingWrites;
 	};
 }
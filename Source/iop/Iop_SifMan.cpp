@@ -1,6 +1,7 @@
 #include "Iop_SifMan.h"
 #include "Iop_Sysmem.h"
 #include "../MIPSAssembler.h"
+#include "../Ps2Const.h"
 #include "../Log.h"
 
 #define LOG_NAME ("iop_sifman")
@@ -109,6 +110,28 @@ uint32 CSifMan::SifSetDma(uint32 structAddr, uint32 count)
 	return count;
 }
 
+uint8* CSifMan::GetEeRam() const
+{
+	return nullptr;
+}
+
+uint8* CSifMan::GetEeMemory(uint32 address, uint32 size) const
+{
+	auto eeRam = GetEeRam();
+	if(eeRam == nullptr)
+	{
+		return nullptr;
+	}
+	address &= (PS2::EE_RAM_SIZE - 1);
+	if(size > (PS2::EE_RAM_SIZE - address))
+	{
+		CLog::GetInstance().Warn(LOG_NAME, "EE memory range (address = 0x%08X, size = 0x%08X) is out of bounds.\r\n",
+		                         address, size);
+		return nullptr;
+	}
+	return eeRam + address;
+}
+
 uint32 CSifMan::SifDmaStat(uint32 transferId)
 {
 	CLog::GetInstance().Print(LOG_NAME, FUNCTION_SIFDMASTAT "(transferId = %X);\r\n",
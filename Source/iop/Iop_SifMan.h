@@ -36,6 +36,11 @@ namespace Iop
 
 		virtual uint32 SifSetDma(uint32, uint32);
 
+		//Direct access to EE memory, allows HLE modules to transfer RPC data without intermediate copies.
+		//Returns nullptr if EE memory is not available or if range doesn't fit inside it.
+		virtual uint8* GetEeRam() const;
+		uint8* GetEeMemory(uint32, uint32) const;
+
 	protected:
 		virtual uint32 SifDmaStat(uint32);
 		uint32 SifCheckInit();
@@ -24,7 +24,7 @@ namespace Iop
 
 		uint32 SifSetDma(uint32, uint32) override;
 
-		uint8* GetEeRam() const;
+		uint8* GetEeRam() const override;
 
 	private:
 		CSIF& m_sif;
@@ -107,6 +107,7 @@ uint16 CSpu::ReadRegister(uint32 address)
 #ifdef _DEBUG
 	DisassembleRead(address);
 #endif
+	m_base.Sync();
 	if(address >= SPU_GENERAL_BASE)
 	{
 		switch(address)
@@ -154,6 +155,7 @@ void CSpu::WriteRegister(uint32 address, uint16 value)
 #ifdef _DEBUG
 	DisassembleWrite(address, value);
 #endif
+	m_base.Sync();
 	if(address >= REVERB_START && address < REVERB_END)
 	{
 		uint32 registerId = (address - REVERB_START) / 2;
@@ -82,6 +82,7 @@ uint32 CSpu2::ReadRegisterImpl(uint32 address, uint32 value)
 		for(unsigned int i = 0; i < CORE_NUM; i++)
 		{
 			auto& core = m_core[i];
+			core->GetSpuBase().Sync();
 			if(core->GetSpuBase().GetIrqPending())
 			{
 				result |= (1 << (i + 2));
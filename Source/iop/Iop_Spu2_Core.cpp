@@ -104,11 +104,13 @@ uint32 CCore::SetAddressHi(uint32 address, uint16 value)
 
 uint32 CCore::ReadRegister(uint32 address, uint32 value)
 {
+	m_spuBase.Sync();
 	return ProcessRegisterAccess(m_readDispatch, address, value);
 }
 
 uint32 CCore::WriteRegister(uint32 address, uint32 value)
 {
+	m_spuBase.Sync();
 	return ProcessRegisterAccess(m_writeDispatch, address, value);
 }
 
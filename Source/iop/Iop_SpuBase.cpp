@@ -185,6 +185,7 @@ void CSpuBase::Reset()
 
 	memset(m_channel, 0, sizeof(m_channel));
 	memset(m_reverb, 0, sizeof(m_reverb));
+	m_reverbCacheDirty = true;
 
 	for(unsigned int i = 0; i < MAX_CHANNEL; i++)
 	{
@@ -218,6 +219,7 @@ void CSpuBase::LoadState(Framework::CZipArchiveReader& archive)
 		auto reverbRegisterName = string_format(STATE_REGS_REVERB_FORMAT, i);
 		reinterpret_cast<uint128*>(m_reverb)[i] = registerFile.GetRegister128(reverbRegisterName.c_str());
 	}
+	m_reverbCacheDirty = true;
 
 	for(unsigned int i = 0; i < MAX_CHANNEL; i++)
 	{
@@ -314,6 +316,41 @@ void CSpuBase::SetControl(uint16 value)
 	}
 }
 
+void CSpuBase::SetSyncHandler(const SyncHandler& syncHandler)
+{
+	m_syncHandler = syncHandler;
+}
+
+void CSpuBase::Sync()
+{
+	if(m_syncHandler)
+	{
+		m_syncHandler();
+	}
+}
+
+uint32 CSpuBase::GetNextIrqSampleCount(unsigned int sampleRate, uint32 maxSampleCount) const
+{
+	if(!(m_ctrl & CONTROL_IRQ) || (m_irqAddr == INVALID_ADDRESS))
+	{
+		return ~0U;
+	}
+	uint32 result = ~0U;
+	for(unsigned int i = 0; i < MAX_CHANNEL; i++)
+	{
+		const auto& channel = m_channel[i];
+		if(channel.status == KEY_ON)
+		{
+			//Reader will be restarted on the next sample, can't predict further than that
+			return 1;
+		}
+		uint32 srcSamplingRate = m_baseSamplingRate * channel.pitch / 4096;
+		uint32 sampleCount = m_reader[i].GetSampleCountUntilAddress(m_irqAddr, channel.repeat, srcSamplingRate, sampleRate, std::min(result, maxSampleCount));
+		result = std::min(result, sampleCount);
+	}
+	return result;
+}
+
 void CSpuBase::SetBaseSamplingRate(uint32 samplingRate)
 {
 	m_baseSamplingRate = samplingRate;
@@ -399,6 +436,7 @@ void CSpuBase::SetReverbParam(unsigned int param, uint32 value)
 {
 	assert(param < REVERB_PARAM_COUNT);
 	m_reverb[param] = value;
+	m_reverbCacheDirty = true;
 }
 
 UNION32_16 CSpuBase::GetEndFlags() const
@@ -470,6 +508,7 @@ void CSpuBase::SetReverbWorkAddressStart(uint32 address)
 	assert(address <= m_ramSize);
 	m_reverbWorkAddrStart = address;
 	m_reverbCurrAddr = address;
+	m_reverbCacheDirty = true;
 }
 
 uint32 CSpuBase::GetReverbWorkAddressEnd() const
@@ -482,6 +521,7 @@ void CSpuBase::SetReverbWorkAddressEnd(uint32 address)
 	assert((address & 0xFFFF) == 0xFFFF);
 	assert(address <= m_ramSize);
 	m_reverbWorkAddrEnd = address + 1;
+	m_reverbCacheDirty = true;
 }
 
 void CSpuBase::SetReverbCurrentAddress(uint32 address)
@@ -491,6 +531,7 @@ void CSpuBase::SetReverbCurrentAddress(uint32 address)
 
 uint32 CSpuBase::ReceiveDma(uint8* buffer, uint32 blockSize, uint32 blockAmount)
 {
+	Sync();
 #ifdef _DEBUG
 	CLog::GetInstance().Print(LOG_NAME, "Receiving DMA transfer to 0x%08X. Size = 0x%08X bytes.\r\n",
 	                          m_transferAddr, blockSize * blockAmount);
@@ -602,6 +643,42 @@ void CSpuBase::Render(int16* samples, unsigned int sampleCount, unsigned int sam
 	unsigned int ticks = sampleCount / 2;
 	memset(samples, 0, sizeof(int16) * sampleCount);
 
+	//Silent stopped voices are only read for IRQ checks and can't be keyed on during this call
+	//(register writes sync before), advance them over the whole call without decoding samples
+	uint32 skippedChannels = 0;
+	if(checkIrqs)
+	{
+		for(unsigned int i = 0; i < MAX_CHANNEL; i++)
+		{
+			auto& channel(m_channel[i]);
+			if((channel.status != STOPPED) || (channel.adsrVolume != 0)) continue;
+			auto& reader(m_reader[i]);
+			reader.ClearIsDone();
+			if(reader.DidChangeRepeat())
+			{
+				channel.repeat = reader.GetRepeat();
+				reader.ClearDidChangeRepeat();
+			}
+			reader.SetRepeat(channel.repeat);
+			reader.SetIrqAddress(m_irqAddr);
+			reader.SetPitch(m_baseSamplingRate, channel.pitch);
+			reader.SkipSamples(ticks, sampleRate);
+			reader.ClearIsDone();
+			if(reader.DidChangeRepeat())
+			{
+				channel.repeat = reader.GetRepeat();
+				reader.ClearDidChangeRepeat();
+			}
+			channel.current = reader.GetCurrent();
+			if(reader.GetIrqPending())
+			{
+				m_irqPending = true;
+			}
+			reader.ClearIrqPending();
+			skippedChannels |= (1 << i);
+		}
+	}
+
 	for(unsigned int j = 0; j < ticks; j++)
 	{
 		int16 reverbSample[2] = {0, 0};
@@ -610,6 +687,12 @@ void CSpuBase::Render(int16* samples, unsigned int sampleCount, unsigned int sam
 		{
 			auto& channel(m_channel[i]);
 			if((channel.status == STOPPED) && !checkIrqs) continue;
+			if(skippedChannels & (1 << i))
+			{
+				channel.volumeLeftAbs = ComputeChannelVolume(channel.volumeLeft, channel.volumeLeftAbs);
+				channel.volumeRightAbs = ComputeChannelVolume(channel.volumeRight, channel.volumeRightAbs);
+				continue;
+			}
 			auto& reader(m_reader[i]);
 			if(channel.status == KEY_ON)
 			{
@@ -651,6 +734,14 @@ void CSpuBase::Render(int16* samples, unsigned int sampleCount, unsigned int sam
 
 			reader.ClearIrqPending();
 
+			//Silent stopped voices are only read for IRQ checks, they don't contribute to the output
+			if((channel.status == STOPPED) && (channel.adsrVolume == 0))
+			{
+				channel.volumeLeftAbs = ComputeChannelVolume(channel.volumeLeft, channel.volumeLeftAbs);
+				channel.volumeRightAbs = ComputeChannelVolume(channel.volumeRight, channel.volumeRightAbs);
+				continue;
+			}
+
 			//Mix samples
 			UpdateAdsr(channel);
 			int32 inputSample = static_cast<int32>(readSample);
@@ -694,47 +785,59 @@ void CSpuBase::Render(int16* samples, unsigned int sampleCount, unsigned int sam
 		//Update reverb
 		if(updateReverb)
 		{
+			if(m_reverbCacheDirty)
+			{
+				UpdateReverbCache();
+			}
+
+			const auto& cache = m_reverbCache;
+			uint8* workArea = m_ram + m_reverbWorkAddrStart;
+			uint32 position = m_reverbCurrAddr - m_reverbWorkAddrStart;
+			if(position >= cache.workAreaSize)
+			{
+				position = 0;
+				m_reverbCurrAddr = m_reverbWorkAddrStart;
+			}
+
 			//Feed samples to FIR filter
 			if(m_reverbTicks & 1)
 			{
+				//Lanes are A0, A1, B0, B1 (left, right, left, right)
+				int32 inputSamples[REVERB_LANE_COUNT];
+				int32 iirSamples[REVERB_LANE_COUNT];
+				int32 accSamples[REVERB_LANE_COUNT];
+				int32 fbSamples[REVERB_LANE_COUNT];
+				int32 mixSamples[REVERB_LANE_COUNT];
+
 				//IIR_INPUT_A0 = buffer[IIR_SRC_A0] * IIR_COEF + INPUT_SAMPLE_L * IN_COEF_L;
 				//IIR_INPUT_A1 = buffer[IIR_SRC_A1] * IIR_COEF + INPUT_SAMPLE_R * IN_COEF_R;
 				//IIR_INPUT_B0 = buffer[IIR_SRC_B0] * IIR_COEF + INPUT_SAMPLE_L * IN_COEF_L;
 				//IIR_INPUT_B1 = buffer[IIR_SRC_B1] * IIR_COEF + INPUT_SAMPLE_R * IN_COEF_R;
 
-				float input_sample_l = static_cast<float>(reverbSample[0]) * 0.5f;
-				float input_sample_r = static_cast<float>(reverbSample[1]) * 0.5f;
-
-				float irr_coef = GetReverbCoef(IIR_COEF);
-				float in_coef_l = GetReverbCoef(IN_COEF_L);
-				float in_coef_r = GetReverbCoef(IN_COEF_R);
-
-				float iir_input_a0 = GetReverbSample(GetReverbOffset(ACC_SRC_A0)) * irr_coef + input_sample_l * in_coef_l;
-				float iir_input_a1 = GetReverbSample(GetReverbOffset(ACC_SRC_A1)) * irr_coef + input_sample_r * in_coef_r;
-				float iir_input_b0 = GetReverbSample(GetReverbOffset(ACC_SRC_B0)) * irr_coef + input_sample_l * in_coef_l;
-				float iir_input_b1 = GetReverbSample(GetReverbOffset(ACC_SRC_B1)) * irr_coef + input_sample_r * in_coef_r;
-
 				//IIR_A0 = IIR_INPUT_A0 * IIR_ALPHA + buffer[IIR_DEST_A0] * (1.0 - IIR_ALPHA);
 				//IIR_A1 = IIR_INPUT_A1 * IIR_ALPHA + buffer[IIR_DEST_A1] * (1.0 - IIR_ALPHA);
 				//IIR_B0 = IIR_INPUT_B0 * IIR_ALPHA + buffer[IIR_DEST_B0] * (1.0 - IIR_ALPHA);
 				//IIR_B1 = IIR_INPUT_B1 * IIR_ALPHA + buffer[IIR_DEST_B1] * (1.0 - IIR_ALPHA);
 
-				float iir_alpha = GetReverbCoef(IIR_ALPHA);
-
-				float iir_a0 = iir_input_a0 * iir_alpha + GetReverbSample(GetReverbOffset(IIR_DEST_A0)) * (1.0f - iir_alpha);
-				float iir_a1 = iir_input_a1 * iir_alpha + GetReverbSample(GetReverbOffset(IIR_DEST_A1)) * (1.0f - iir_alpha);
-				float iir_b0 = iir_input_b0 * iir_alpha + GetReverbSample(GetReverbOffset(IIR_DEST_B0)) * (1.0f - iir_alpha);
-				float iir_b1 = iir_input_b1 * iir_alpha + GetReverbSample(GetReverbOffset(IIR_DEST_B1)) * (1.0f - iir_alpha);
+				for(unsigned int lane = 0; lane < REVERB_LANE_COUNT; lane++)
+				{
+					//Input sample is scaled by 0.5
+					int32 inputSample = MulReverbCoef(reverbSample[lane & 1], cache.inCoefs[lane & 1]) >> 1;
+					int32 iirSource = ReadReverbSample(workArea, position, cache.iirSrcOffsets[lane], cache.workAreaSize);
+					int32 iirDest = ReadReverbSample(workArea, position, cache.iirDestOffsets[lane], cache.workAreaSize);
+					inputSamples[lane] = MulReverbCoef(iirSource, cache.iirCoef) + inputSample;
+					iirSamples[lane] = MulReverbCoef(inputSamples[lane], cache.iirAlpha) + MulReverbCoef(iirDest, cache.iirAlphaComplement);
+				}
 
 				//buffer[IIR_DEST_A0 + 1sample] = IIR_A0;
 				//buffer[IIR_DEST_A1 + 1sample] = IIR_A1;
 				//buffer[IIR_DEST_B0 + 1sample] = IIR_B0;
 				//buffer[IIR_DEST_B1 + 1sample] = IIR_B1;
 
-				SetReverbSample(GetReverbOffset(IIR_DEST_A0) + 2, iir_a0);
-				SetReverbSample(GetReverbOffset(IIR_DEST_A1) + 2, iir_a1);
-				SetReverbSample(GetReverbOffset(IIR_DEST_B0) + 2, iir_b0);
-				SetReverbSample(GetReverbOffset(IIR_DEST_B1) + 2, iir_b1);
+				for(unsigned int lane = 0; lane < REVERB_LANE_COUNT; lane++)
+				{
+					WriteReverbSample(workArea, position, cache.iirDestNextOffsets[lane], cache.workAreaSize, iirSamples[lane]);
+				}
 
 				//ACC0 = buffer[ACC_SRC_A0] * ACC_COEF_A +
 				//	   buffer[ACC_SRC_B0] * ACC_COEF_B +
@@ -745,61 +848,67 @@ void CSpuBase::Render(int16* samples, unsigned int sampleCount, unsigned int sam
 				//	   buffer[ACC_SRC_C1] * ACC_COEF_C +
 				//	   buffer[ACC_SRC_D1] * ACC_COEF_D;
 
-				float acc_coef_a = GetReverbCoef(ACC_COEF_A);
-				float acc_coef_b = GetReverbCoef(ACC_COEF_B);
-				float acc_coef_c = GetReverbCoef(ACC_COEF_C);
-				float acc_coef_d = GetReverbCoef(ACC_COEF_D);
-
-				float acc0 =
-				    GetReverbSample(GetReverbOffset(ACC_SRC_A0)) * acc_coef_a +
-				    GetReverbSample(GetReverbOffset(ACC_SRC_B0)) * acc_coef_b +
-				    GetReverbSample(GetReverbOffset(ACC_SRC_C0)) * acc_coef_c +
-				    GetReverbSample(GetReverbOffset(ACC_SRC_D0)) * acc_coef_d;
-
-				float acc1 =
-				    GetReverbSample(GetReverbOffset(ACC_SRC_A1)) * acc_coef_a +
-				    GetReverbSample(GetReverbOffset(ACC_SRC_B1)) * acc_coef_b +
-				    GetReverbSample(GetReverbOffset(ACC_SRC_C1)) * acc_coef_c +
-				    GetReverbSample(GetReverbOffset(ACC_SRC_D1)) * acc_coef_d;
+				for(unsigned int channel = 0; channel < 2; channel++)
+				{
+					int32 acc = 0;
+					for(unsigned int tap = 0; tap < REVERB_ACC_TAP_COUNT; tap++)
+					{
+						int32 accSource = ReadReverbSample(workArea, position, cache.accSrcOffsets[channel][tap], cache.workAreaSize);
+						acc += MulReverbCoef(accSource, cache.accCoefs[tap]);
+					}
+					accSamples[channel + 0] = acc;
+					accSamples[channel + 2] = acc;
+				}
 
 				//FB_A0 = buffer[MIX_DEST_A0 - FB_SRC_A];
 				//FB_A1 = buffer[MIX_DEST_A1 - FB_SRC_A];
 				//FB_B0 = buffer[MIX_DEST_B0 - FB_SRC_B];
 				//FB_B1 = buffer[MIX_DEST_B1 - FB_SRC_B];
 
-				float fb_a0 = GetReverbSample(GetReverbOffset(MIX_DEST_A0) - GetReverbOffset(FB_SRC_A));
-				float fb_a1 = GetReverbSample(GetReverbOffset(MIX_DEST_A1) - GetReverbOffset(FB_SRC_A));
-				float fb_b0 = GetReverbSample(GetReverbOffset(MIX_DEST_B0) - GetReverbOffset(FB_SRC_B));
-				float fb_b1 = GetReverbSample(GetReverbOffset(MIX_DEST_B1) - GetReverbOffset(FB_SRC_B));
+				for(unsigned int lane = 0; lane < REVERB_LANE_COUNT; lane++)
+				{
+					fbSamples[lane] = ReadReverbSample(workArea, position, cache.fbSrcOffsets[lane], cache.workAreaSize);
+				}
 
 				//buffer[MIX_DEST_A0] = ACC0 - FB_A0 * FB_ALPHA;
 				//buffer[MIX_DEST_A1] = ACC1 - FB_A1 * FB_ALPHA;
 				//buffer[MIX_DEST_B0] = (FB_ALPHA * ACC0) - FB_A0 * (FB_ALPHA^0x8000) - FB_B0 * FB_X;
 				//buffer[MIX_DEST_B1] = (FB_ALPHA * ACC1) - FB_A1 * (FB_ALPHA^0x8000) - FB_B1 * FB_X;
 
-				float fb_alpha = GetReverbCoef(FB_ALPHA);
-				float fb_x = GetReverbCoef(FB_X);
+				for(unsigned int channel = 0; channel < 2; channel++)
+				{
+					int32 fbA = MulReverbCoef(fbSamples[channel + 0], cache.fbAlpha);
+					int32 fbB = MulReverbCoef(fbSamples[channel + 2], cache.fbX);
+					mixSamples[channel + 0] = accSamples[channel + 0] - fbA;
+					mixSamples[channel + 2] = MulReverbCoef(accSamples[channel + 2], cache.fbAlpha) + fbA - fbB;
+				}
 
-				SetReverbSample(GetReverbOffset(MIX_DEST_A0), acc0 - fb_a0 * fb_alpha);
-				SetReverbSample(GetReverbOffset(MIX_DEST_A1), acc1 - fb_a1 * fb_alpha);
-				SetReverbSample(GetReverbOffset(MIX_DEST_B0), (fb_alpha * acc0) - fb_a0 * -fb_alpha - fb_b0 * fb_x);
-				SetReverbSample(GetReverbOffset(MIX_DEST_B1), (fb_alpha * acc1) - fb_a1 * -fb_alpha - fb_b1 * fb_x);
+				for(unsigned int lane = 0; lane < REVERB_LANE_COUNT; lane++)
+				{
+					WriteReverbSample(workArea, position, cache.mixDestOffsets[lane], cache.workAreaSize, mixSamples[lane]);
+				}
 
 				m_reverbCurrAddr += 2;
+				position += 2;
 				if(m_reverbCurrAddr >= m_reverbWorkAddrEnd)
 				{
 					m_reverbCurrAddr = m_reverbWorkAddrStart;
+					position = 0;
 				}
 			}
 
 			if(m_reverbWorkAddrStart != 0)
 			{
-				float sampleL = 0.333f * (GetReverbSample(GetReverbOffset(MIX_DEST_A0)) + GetReverbSample(GetReverbOffset(MIX_DEST_B0)));
-				float sampleR = 0.333f * (GetReverbSample(GetReverbOffset(MIX_DEST_A1)) + GetReverbSample(GetReverbOffset(MIX_DEST_B1)));
+				int32 mixA0 = ReadReverbSample(workArea, position, cache.mixDestOffsets[0], cache.workAreaSize);
+				int32 mixA1 = ReadReverbSample(workArea, position, cache.mixDestOffsets[1], cache.workAreaSize);
+				int32 mixB0 = ReadReverbSample(workArea, position, cache.mixDestOffsets[2], cache.workAreaSize);
+				int32 mixB1 = ReadReverbSample(workArea, position, cache.mixDestOffsets[3], cache.workAreaSize);
+				int32 sampleL = MulReverbCoef(mixA0 + mixB0, REVERB_OUTPUT_COEF);
+				int32 sampleR = MulReverbCoef(mixA1 + mixB1, REVERB_OUTPUT_COEF);
 
 				{
 					int16* output = samples + 0;
-					int32 resultSample = static_cast<int32>(sampleL) + static_cast<int32>(*output);
+					int32 resultSample = sampleL + static_cast<int32>(*output);
 					resultSample = std::max<int32>(resultSample, SHRT_MIN);
 					resultSample = std::min<int32>(resultSample, SHRT_MAX);
 					*output = static_cast<int16>(resultSample);
@@ -807,7 +916,7 @@ void CSpuBase::Render(int16* samples, unsigned int sampleCount, unsigned int sam
 
 				{
 					int16* output = samples + 1;
-					int32 resultSample = static_cast<int32>(sampleR) + static_cast<int32>(*output);
+					int32 resultSample = sampleR + static_cast<int32>(*output);
 					resultSample = std::max<int32>(resultSample, SHRT_MIN);
 					resultSample = std::min<int32>(resultSample, SHRT_MAX);
 					*output = static_cast<int16>(resultSample);
@@ -825,40 +934,85 @@ uint32 CSpuBase::GetAdsrDelta(unsigned int index) const
 	return m_adsrLogTable[index + 32];
 }
 
-float CSpuBase::GetReverbSample(uint32 address) const
+int32 CSpuBase::MulReverbCoef(int32 value, int32 coef)
 {
-	uint32 absoluteAddress = m_reverbCurrAddr + address;
-	while(absoluteAddress >= m_reverbWorkAddrEnd)
-	{
-		absoluteAddress -= m_reverbWorkAddrEnd;
-		absoluteAddress += m_reverbWorkAddrStart;
-	}
-	return static_cast<float>(*reinterpret_cast<int16*>(m_ram + absoluteAddress));
+	return static_cast<int32>((static_cast<int64>(value) * static_cast<int64>(coef)) >> 15);
 }
 
-void CSpuBase::SetReverbSample(uint32 address, float value)
+uint32 CSpuBase::WrapReverbAddress(uint32 address, uint32 workAreaSize)
 {
-	uint32 absoluteAddress = m_reverbCurrAddr + address;
-	while(absoluteAddress >= m_reverbWorkAddrEnd)
-	{
-		absoluteAddress -= m_reverbWorkAddrEnd;
-		absoluteAddress += m_reverbWorkAddrStart;
-	}
-	value = std::max<float>(value, SHRT_MIN);
-	value = std::min<float>(value, SHRT_MAX);
-	int16 intValue = static_cast<int16>(value);
-	*reinterpret_cast<int16*>(m_ram + absoluteAddress) = intValue;
+	//Position and offsets are both within the work area, a single subtraction is enough to wrap
+	return address - (workAreaSize & (0U - static_cast<uint32>(address >= workAreaSize)));
 }
 
-uint32 CSpuBase::GetReverbOffset(unsigned int registerId) const
+int32 CSpuBase::ReadReverbSample(const uint8* workArea, uint32 position, uint32 offset, uint32 workAreaSize)
 {
-	return m_reverb[registerId];
+	return *reinterpret_cast<const int16*>(workArea + WrapReverbAddress(position + offset, workAreaSize));
 }
 
-float CSpuBase::GetReverbCoef(unsigned int registerId) const
+void CSpuBase::WriteReverbSample(uint8* workArea, uint32 position, uint32 offset, uint32 workAreaSize, int32 value)
 {
-	int16 value = static_cast<int16>(m_reverb[registerId]);
-	return static_cast<float>(value) / static_cast<float>(0x8000);
+	value = std::max<int32>(value, SHRT_MIN);
+	value = std::min<int32>(value, SHRT_MAX);
+	*reinterpret_cast<int16*>(workArea + WrapReverbAddress(position + offset, workAreaSize)) = static_cast<int16>(value);
+}
+
+void CSpuBase::UpdateReverbCache()
+{
+	auto& cache = m_reverbCache;
+	cache.workAreaSize = m_reverbWorkAddrEnd - m_reverbWorkAddrStart;
+	assert(cache.workAreaSize != 0);
+
+	//Reduce offsets to the work area's size, negative offsets wrap from the end
+	auto wrapOffset = [&](int64 offset) {
+		int64 workAreaSize = cache.workAreaSize;
+		offset %= workAreaSize;
+		if(offset < 0) offset += workAreaSize;
+		return static_cast<uint32>(offset);
+	};
+	auto getOffset = [&](unsigned int registerId) { return wrapOffset(m_reverb[registerId]); };
+	auto getCoef = [&](unsigned int registerId) { return static_cast<int32>(static_cast<int16>(m_reverb[registerId])); };
+
+	static const unsigned int iirSrcRegisters[REVERB_LANE_COUNT] = {ACC_SRC_A0, ACC_SRC_A1, ACC_SRC_B0, ACC_SRC_B1};
+	static const unsigned int iirDestRegisters[REVERB_LANE_COUNT] = {IIR_DEST_A0, IIR_DEST_A1, IIR_DEST_B0, IIR_DEST_B1};
+	static const unsigned int mixDestRegisters[REVERB_LANE_COUNT] = {MIX_DEST_A0, MIX_DEST_A1, MIX_DEST_B0, MIX_DEST_B1};
+	static const unsigned int fbSrcRegisters[REVERB_LANE_COUNT] = {FB_SRC_A, FB_SRC_A, FB_SRC_B, FB_SRC_B};
+	static const unsigned int accSrcRegisters[2][REVERB_ACC_TAP_COUNT] =
+	    {
+	        {ACC_SRC_A0, ACC_SRC_B0, ACC_SRC_C0, ACC_SRC_D0},
+	        {ACC_SRC_A1, ACC_SRC_B1, ACC_SRC_C1, ACC_SRC_D1},
+	    };
+
+	for(unsigned int lane = 0; lane < REVERB_LANE_COUNT; lane++)
+	{
+		cache.iirSrcOffsets[lane] = getOffset(iirSrcRegisters[lane]);
+		cache.iirDestOffsets[lane] = getOffset(iirDestRegisters[lane]);
+		cache.iirDestNextOffsets[lane] = wrapOffset(static_cast<int64>(m_reverb[iirDestRegisters[lane]]) + 2);
+		cache.mixDestOffsets[lane] = getOffset(mixDestRegisters[lane]);
+		cache.fbSrcOffsets[lane] = wrapOffset(static_cast<int64>(m_reverb[mixDestRegisters[lane]]) - static_cast<int64>(m_reverb[fbSrcRegisters[lane]]));
+	}
+
+	for(unsigned int channel = 0; channel < 2; channel++)
+	{
+		for(unsigned int tap = 0; tap < REVERB_ACC_TAP_COUNT; tap++)
+		{
+			cache.accSrcOffsets[channel][tap] = getOffset(accSrcRegisters[channel][tap]);
+		}
+	}
+
+	cache.iirCoef = getCoef(IIR_COEF);
+	cache.inCoefs[0] = getCoef(IN_COEF_L);
+	cache.inCoefs[1] = getCoef(IN_COEF_R);
+	cache.iirAlpha = getCoef(IIR_ALPHA);
+	cache.iirAlphaComplement = 0x8000 - cache.iirAlpha;
+	cache.accCoefs[0] = getCoef(ACC_COEF_A);
+	cache.accCoefs[1] = getCoef(ACC_COEF_B);
+	cache.accCoefs[2] = getCoef(ACC_COEF_C);
+	cache.accCoefs[3] = getCoef(ACC_COEF_D);
+	cache.fbAlpha = getCoef(FB_ALPHA);
+	cache.fbX = getCoef(FB_X);
+
+	m_reverbCacheDirty = false;
 }
 
 void CSpuBase::UpdateAdsr(CHANNEL& channel)
@@ -1076,6 +1230,23 @@ void CSpuBase::CSampleReader::GetSamples(int16* samples, unsigned int sampleCoun
 	}
 }
 
+//Advances the reader the same way GetSamples does, but only follows block headers
+//(loops, end flags and IRQ address hits) without decoding anything.
+void CSpuBase::CSampleReader::SkipSamples(unsigned int sampleCount, unsigned int dstSamplingRate)
+{
+	uint32 step = (m_srcSamplingRate * TIME_SCALE) / dstSamplingRate;
+	for(unsigned int i = 0; i < sampleCount; i++)
+	{
+		uint32 srcSampleIdx = m_srcSampleIdx / TIME_SCALE;
+		m_srcSampleIdx += step;
+		if(srcSampleIdx >= BUFFER_SAMPLES)
+		{
+			m_srcSampleIdx -= BUFFER_SAMPLES * TIME_SCALE;
+			SkipBuffer();
+		}
+	}
+}
+
 int16 CSpuBase::CSampleReader::GetSample(unsigned int dstSamplingRate)
 {
 	uint32 srcSampleIdx = m_srcSampleIdx / TIME_SCALE;
@@ -1108,21 +1279,26 @@ void CSpuBase::CSampleReader::AdvanceBuffer()
 	}
 }
 
+void CSpuBase::CSampleReader::SkipBuffer()
+{
+	//Buffer contents are left stale, SetParams will decode again when the voice is keyed on
+	if(!m_nextValid)
+	{
+		NextBlock();
+		m_nextValid = true;
+	}
+	NextBlock();
+}
+
 void CSpuBase::CSampleReader::UnpackSamples(int16* dst)
 {
 	int32 workBuffer[BUFFER_SAMPLES];
 
 	uint8* nextSample = m_ram + m_nextSampleAddr;
 
-	if(m_nextSampleAddr == m_irqAddr)
-	{
-		m_irqPending = true;
-	}
-
 	//Read header
 	uint8 shiftFactor = nextSample[0] & 0xF;
 	uint8 predictNumber = nextSample[0] >> 4;
-	uint8 flags = nextSample[1];
 	assert(predictNumber < 5);
 
 	//Get intermediate values
@@ -1165,6 +1341,18 @@ void CSpuBase::CSampleReader::UnpackSamples(int16* dst)
 		}
 	}
 
+	NextBlock();
+}
+
+void CSpuBase::CSampleReader::NextBlock()
+{
+	uint8 flags = m_ram[m_nextSampleAddr + 1];
+
+	if(m_nextSampleAddr == m_irqAddr)
+	{
+		m_irqPending = true;
+	}
+
 	if(flags & 0x04)
 	{
 		m_repeatAddr = m_nextSampleAddr;
@@ -1238,6 +1426,43 @@ void CSpuBase::CSampleReader::ClearIrqPending()
 	m_irqPending = false;
 }
 
+//Returns the number of samples to output before the block at the specified address is
+//unpacked (which raises the IRQ), or ~0 if it won't happen within maxSampleCount samples.
+//Walks the block headers to follow loops the same way UnpackSamples does.
+uint32 CSpuBase::CSampleReader::GetSampleCountUntilAddress(uint32 address, uint32 repeatAddr, uint32 srcSamplingRate, unsigned int dstSamplingRate, uint32 maxSampleCount) const
+{
+	uint32 step = (srcSamplingRate * TIME_SCALE) / dstSamplingRate;
+	if(step == 0)
+	{
+		return ~0U;
+	}
+	uint32 blockAddr = m_nextSampleAddr;
+	for(uint32 block = 1;; block++)
+	{
+		//Block is unpacked during the first GetSample call that starts at or past its boundary
+		int64 distance = static_cast<int64>(block) * BUFFER_SAMPLES * TIME_SCALE - static_cast<int64>(m_srcSampleIdx);
+		uint32 sampleCount = (distance <= 0) ? 1 : static_cast<uint32>((distance + step - 1) / step) + 1;
+		if(sampleCount > maxSampleCount)
+		{
+			return ~0U;
+		}
+		if(blockAddr == address)
+		{
+			return sampleCount;
+		}
+		uint8 flags = m_ram[blockAddr + 1];
+		if(flags & 0x04)
+		{
+			repeatAddr = blockAddr;
+		}
+		blockAddr = (blockAddr + 0x10) & (m_ramSize - 1);
+		if(flags & 0x01)
+		{
+			blockAddr = repeatAddr;
+		}
+	}
+}
+
 bool CSpuBase::CSampleReader::DidChangeRepeat() const
 {
 	return m_didChangeRepeat;
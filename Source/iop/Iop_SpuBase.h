@@ -1,5 +1,6 @@
 #pragma once
 
+#include <functional>
 #include "Types.h"
 #include "BasicUnion.h"
 #include "Convertible.h"
@@ -152,11 +153,20 @@ namespace Iop
 			uint32 current;
 		};
 
+		typedef std::function<void()> SyncHandler;
+
 		CSpuBase(uint8*, uint32, unsigned int);
 		virtual ~CSpuBase() = default;
 
 		void Reset();
 
+		//Sync handler is called before any register access or DMA transfer that could
+		//be affected by pending rendering, allowing the owner to render up to the current time
+		void SetSyncHandler(const SyncHandler&);
+		void Sync();
+
+		uint32 GetNextIrqSampleCount(unsigned int, uint32) const;
+
 		void LoadState(Framework::CZipArchiveReader&);
 		void SaveState(Framework::CZipArchiveWriter&);
 
@@ -242,6 +252,7 @@ namespace Iop
 			void SetParams(uint32, uint32);
 			void SetPitch(uint32, uint16);
 			void GetSamples(int16*, unsigned int, unsigned int);
+			void SkipSamples(unsigned int, unsigned int);
 			uint32 GetRepeat() const;
 			void SetRepeat(uint32);
 			uint32 GetCurrent() const;
@@ -252,6 +263,7 @@ namespace Iop
 			void ClearEndFlag();
 			bool GetIrqPending() const;
 			void ClearIrqPending();
+			uint32 GetSampleCountUntilAddress(uint32, uint32, uint32, unsigned int, uint32) const;
 
 			bool DidChangeRepeat() const;
 			void ClearDidChangeRepeat();
@@ -264,6 +276,8 @@ namespace Iop
 
 			void UnpackSamples(int16*);
 			void AdvanceBuffer();
+			void SkipBuffer();
+			void NextBlock();
 			int16 GetSample(unsigned int);
 
 			uint8* m_ram = nullptr;
@@ -311,12 +325,40 @@ namespace Iop
 			MAX_ADSR_VOLUME = 0x7FFFFFFF,
 		};
 
+		enum
+		{
+			REVERB_LANE_COUNT = 4,
+			REVERB_ACC_TAP_COUNT = 4,
+			REVERB_OUTPUT_COEF = 0x2AA0, //0.333 in 1.15 fixed point
+		};
+
+		//Reverb registers decoded into work area relative offsets and 1.15 fixed point
+		//coefficients. Only rebuilt when a reverb register or the work area changes.
+		struct REVERB_CACHE
+		{
+			uint32 workAreaSize = 0;
+			uint32 iirSrcOffsets[REVERB_LANE_COUNT];
+			uint32 iirDestOffsets[REVERB_LANE_COUNT];
+			uint32 iirDestNextOffsets[REVERB_LANE_COUNT];
+			uint32 mixDestOffsets[REVERB_LANE_COUNT];
+			uint32 fbSrcOffsets[REVERB_LANE_COUNT];
+			uint32 accSrcOffsets[2][REVERB_ACC_TAP_COUNT];
+			int32 iirCoef;
+			int32 inCoefs[2];
+			int32 iirAlpha;
+			int32 iirAlphaComplement;
+			int32 accCoefs[REVERB_ACC_TAP_COUNT];
+			int32 fbAlpha;
+			int32 fbX;
+		};
+
 		void UpdateAdsr(CHANNEL&);
 		uint32 GetAdsrDelta(unsigned int) const;
-		float GetReverbSample(uint32) const;
-		void SetReverbSample(uint32, float);
-		uint32 GetReverbOffset(unsigned int) const;
-		float GetReverbCoef(unsigned int) const;
+		void UpdateReverbCache();
+		static int32 MulReverbCoef(int32, int32);
+		static uint32 WrapReverbAddress(uint32, uint32);
+		static int32 ReadReverbSample(const uint8*, uint32, uint32, uint32);
+		static void WriteReverbSample(uint8*, uint32, uint32, uint32, int32);
 
 		static void MixSamples(int32, int32, int16*);
 		int32 ComputeChannelVolume(const CHANNEL_VOLUME&, int32);
@@ -341,6 +383,9 @@ namespace Iop
 		uint16 m_ctrl;
 		int m_reverbTicks;
 		uint32 m_reverb[REVERB_REG_COUNT];
+		REVERB_CACHE m_reverbCache;
+		bool m_reverbCacheDirty = true;
+		SyncHandler m_syncHandler;
 		CHANNEL m_channel[MAX_CHANNEL];
 		CSampleReader m_reader[MAX_CHANNEL];
 		uint32 m_adsrLogTable[160];
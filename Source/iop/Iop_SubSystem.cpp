@@ -98,12 +98,18 @@ void CSubSystem::NotifyVBlankEnd()
 	m_intc.AssertLine(Iop::CIntc::LINE_EVBLANK);
 }
 
-void CSubSystem::SaveState(Framework::CZipArchiveWriter& archive)
+void CSubSystem::SaveState(Framework::CZipArchiveWriter& archive, bool includeMemory)
 {
 	archive.InsertFile(new CMemoryStateFile(STATE_CPU, &m_cpu.m_State, sizeof(MIPSSTATE)));
-	archive.InsertFile(new CMemoryStateFile(STATE_RAM, m_ram, IOP_RAM_SIZE));
-	archive.InsertFile(new CMemoryStateFile(STATE_SCRATCH, m_scratchPad, IOP_SCRATCH_SIZE));
-	archive.InsertFile(new CMemoryStateFile(STATE_SPURAM, m_spuRam, SPU_RAM_SIZE));
+	if(includeMemory)
+	{
+		CMemorySnapshot::RegionArray regions;
+		GetStateMemoryRegions(regions);
+		for(const auto& region : regions)
+		{
+			archive.InsertFile(new CMemoryStateFile(region.name, region.memory, region.size));
+		}
+	}
 	m_intc.SaveState(archive);
 	m_dmac.SaveState(archive);
 	m_counters.SaveState(archive);
@@ -115,12 +121,18 @@ void CSubSystem::SaveState(Framework::CZipArchiveWriter& archive)
 	m_bios->SaveState(archive);
 }
 
-void CSubSystem::LoadState(Framework::CZipArchiveReader& archive)
+void CSubSystem::LoadState(Framework::CZipArchiveReader& archive, bool includeMemory)
 {
 	archive.BeginReadFile(STATE_CPU)->Read(&m_cpu.m_State, sizeof(MIPSSTATE));
-	archive.BeginReadFile(STATE_RAM)->Read(m_ram, IOP_RAM_SIZE);
-	archive.BeginReadFile(STATE_SCRATCH)->Read(m_scratchPad, IOP_SCRATCH_SIZE);
-	archive.BeginReadFile(STATE_SPURAM)->Read(m_spuRam, SPU_RAM_SIZE);
+	if(includeMemory)
+	{
+		CMemorySnapshot::RegionArray regions;
+		GetStateMemoryRegions(regions);
+		for(const auto& region : regions)
+		{
+			archive.BeginReadFile(region.name)->Read(region.memory, region.size);
+		}
+	}
 	m_intc.LoadState(archive);
 	m_dmac.LoadState(archive);
 	m_counters.LoadState(archive);
@@ -132,6 +144,13 @@ void CSubSystem::LoadState(Framework::CZipArchiveReader& archive)
 	m_bios->LoadState(archive);
 }
 
+void CSubSystem::GetStateMemoryRegions(CMemorySnapshot::RegionArray& regions)
+{
+	CMemorySnapshot::AddRegion(regions, STATE_RAM, m_ram, IOP_RAM_SIZE);
+	CMemorySnapshot::AddRegion(regions, STATE_SCRATCH, m_scratchPad, IOP_SCRATCH_SIZE);
+	CMemorySnapshot::AddRegion(regions, STATE_SPURAM, m_spuRam, SPU_RAM_SIZE);
+}
+
 void CSubSystem::Reset()
 {
 	memset(m_ram, 0, IOP_RAM_SIZE);
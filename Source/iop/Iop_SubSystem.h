@@ -13,6 +13,7 @@
 #include "Iop_BiosBase.h"
 #include "zip/ZipArchiveWriter.h"
 #include "zip/ZipArchiveReader.h"
+#include "../states/MemorySnapshot.h"
 
 namespace Iop
 {
@@ -30,8 +31,9 @@ namespace Iop
 		void NotifyVBlankStart();
 		void NotifyVBlankEnd();
 
-		void SaveState(Framework::CZipArchiveWriter&);
-		void LoadState(Framework::CZipArchiveReader&);
+		void SaveState(Framework::CZipArchiveWriter&, bool);
+		void LoadState(Framework::CZipArchiveReader&, bool);
+		void GetStateMemoryRegions(CMemorySnapshot::RegionArray&);
 
 		uint8* m_ram;
 		uint8* m_scratchPad;
@@ -0,0 +1,271 @@
+#include <cassert>
+#include <cstring>
+#include <stdexcept>
+#include "FastStateFile.h"
+#include "StdStreamUtils.h"
+
+#ifdef _WIN32
+#include <Windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+#define FAST_STATE_MAGIC 0x54534650 //'PFST'
+#define FAST_STATE_VERSION 1
+
+//Layout:
+//HEADER
+//SECTION_HEADER * sectionCount
+//Section data, each section aligned on SECTION_ALIGNMENT
+
+struct HEADER
+{
+	uint32 magic;
+	uint32 version;
+	uint32 sectionCount;
+	uint32 reserved;
+};
+static_assert(sizeof(HEADER) == 0x10, "Size of HEADER must be 16 bytes.");
+
+struct SECTION_HEADER
+{
+	char name[CFastStateFile::SECTION_NAME_SIZE];
+	uint64 offset;
+	uint64 size;
+};
+static_assert(sizeof(SECTION_HEADER) == 0x40, "Size of SECTION_HEADER must be 64 bytes.");
+
+static uint64 AlignSectionOffset(uint64 offset)
+{
+	return (offset + CFastStateFile::SECTION_ALIGNMENT - 1) & ~static_cast<uint64>(CFastStateFile::SECTION_ALIGNMENT - 1);
+}
+
+CFastStateFile::CFastStateFile(const fs::path& path)
+{
+	Map(path);
+	try
+	{
+		ReadSectionTable();
+	}
+	catch(...)
+	{
+		Unmap();
+		throw;
+	}
+}
+
+CFastStateFile::~CFastStateFile()
+{
+	Unmap();
+}
+
+bool CFastStateFile::IsFastStateFile(const fs::path& path)
+{
+	try
+	{
+		auto stream = Framework::CreateInputStdStream(path.native());
+		uint32 magic = 0;
+		stream.Read(&magic, sizeof(uint32));
+		return (magic == FAST_STATE_MAGIC);
+	}
+	catch(...)
+	{
+		return false;
+	}
+}
+
+void CFastStateFile::Write(Framework::CStream& stream, const SectionArray& sections)
+{
+	std::vector<SECTION_HEADER> sectionHeaders;
+	sectionHeaders.reserve(sections.size());
+
+	uint64 offset = sizeof(HEADER) + (sections.size() * sizeof(SECTION_HEADER));
+	for(const auto& section : sections)
+	{
+		if(section.name.size() >= SECTION_NAME_SIZE)
+		{
+			throw std::runtime_error("Section name is too long.");
+		}
+
+		SECTION_HEADER sectionHeader = {};
+		strncpy(sectionHeader.name, section.name.c_str(), SECTION_NAME_SIZE - 1);
+		sectionHeader.offset = AlignSectionOffset(offset);
+		sectionHeader.size = 0;
+		for(const auto& chunk : section.chunks)
+		{
+			sectionHeader.size += chunk.size;
+		}
+		sectionHeaders.push_back(sectionHeader);
+		offset = sectionHeader.offset + sectionHeader.size;
+	}
+
+	HEADER header = {};
+	header.magic = FAST_STATE_MAGIC;
+	header.version = FAST_STATE_VERSION;
+	header.sectionCount = static_cast<uint32>(sections.size());
+	stream.Write(&header, sizeof(HEADER));
+	stream.Write(sectionHeaders.data(), sectionHeaders.size() * sizeof(SECTION_HEADER));
+
+	static const uint8 padding[SECTION_ALIGNMENT] = {};
+	uint64 position = sizeof(HEADER) + (sections.size() * sizeof(SECTION_HEADER));
+	for(uint32 i = 0; i < sections.size(); i++)
+	{
+		const auto& sectionHeader = sectionHeaders[i];
+		assert(sectionHeader.offset >= position);
+		stream.Write(padding, sectionHeader.offset - position);
+		for(const auto& chunk : sections[i].chunks)
+		{
+			stream.Write(chunk.data, chunk.size);
+		}
+		position = sectionHeader.offset + sectionHeader.size;
+	}
+}
+
+bool CFastStateFile::HasSection(const char* name) const
+{
+	return m_sections.find(name) != std::end(m_sections);
+}
+
+const uint8* CFastStateFile::GetSectionData(const char* name) const
+{
+	return m_data + GetSectionInfo(name).offset;
+}
+
+uint32 CFastStateFile::GetSectionSize(const char* name) const
+{
+	return GetSectionInfo(name).size;
+}
+
+const CFastStateFile::SECTION_INFO& CFastStateFile::GetSectionInfo(const char* name) const
+{
+	auto sectionIterator = m_sections.find(name);
+	if(sectionIterator == std::end(m_sections))
+	{
+		throw std::runtime_error("Section not found in state file.");
+	}
+	return sectionIterator->second;
+}
+
+void CFastStateFile::ReadSectionTable()
+{
+	if(m_size < sizeof(HEADER))
+	{
+		throw std::runtime_error("State file is too small.");
+	}
+
+	HEADER header = {};
+	memcpy(&header, m_data, sizeof(HEADER));
+	if(header.magic != FAST_STATE_MAGIC)
+	{
+		throw std::runtime_error("Invalid state file.");
+	}
+	if(header.version != FAST_STATE_VERSION)
+	{
+		throw std::runtime_error("Unsupported state file version.");
+	}
+
+	uint64 sectionTableEnd = sizeof(HEADER) + (static_cast<uint64>(header.sectionCount) * sizeof(SECTION_HEADER));
+	if(sectionTableEnd > m_size)
+	{
+		throw std::runtime_error("Invalid state file section table.");
+	}
+
+	for(uint32 i = 0; i < header.sectionCount; i++)
+	{
+		SECTION_HEADER sectionHeader = {};
+		memcpy(&sectionHeader, m_data + sizeof(HEADER) + (i * sizeof(SECTION_HEADER)), sizeof(SECTION_HEADER));
+		sectionHeader.name[SECTION_NAME_SIZE - 1] = 0;
+		if((sectionHeader.offset > m_size) || (sectionHeader.size > (m_size - sectionHeader.offset)))
+		{
+			throw std::runtime_error("Invalid state file section.");
+		}
+		SECTION_INFO sectionInfo;
+		sectionInfo.offset = sectionHeader.offset;
+		sectionInfo.size = static_cast<uint32>(sectionHeader.size);
+		m_sections[sectionHeader.name] = sectionInfo;
+	}
+}
+
+#ifdef _WIN32
+
+void CFastStateFile::Map(const fs::path& path)
+{
+	HANDLE file = CreateFileW(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if(file == INVALID_HANDLE_VALUE)
+	{
+		throw std::runtime_error("Failed to open state file.");
+	}
+
+	LARGE_INTEGER fileSize = {};
+	GetFileSizeEx(file, &fileSize);
+	m_size = fileSize.QuadPart;
+
+	//The view keeps a reference on the mapping, handles can be closed right away
+	HANDLE mapping = (m_size != 0) ? CreateFileMappingW(file, NULL, PAGE_READONLY, 0, 0, NULL) : NULL;
+	CloseHandle(file);
+	if(mapping == NULL)
+	{
+		throw std::runtime_error("Failed to map state file.");
+	}
+
+	m_data = reinterpret_cast<const uint8*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+	CloseHandle(mapping);
+	if(m_data == nullptr)
+	{
+		throw std::runtime_error("Failed to map state file.");
+	}
+}
+
+void CFastStateFile::Unmap()
+{
+	if(m_data)
+	{
+		UnmapViewOfFile(m_data);
+		m_data = nullptr;
+	}
+}
+
+#else
+
+void CFastStateFile::Map(const fs::path& path)
+{
+	int fd = open(path.c_str(), O_RDONLY);
+	if(fd == -1)
+	{
+		throw std::runtime_error("Failed to open state file.");
+	}
+
+	struct stat fileStat = {};
+	if((fstat(fd, &fileStat) == -1) || (fileStat.st_size == 0))
+	{
+		close(fd);
+		throw std::runtime_error("Failed to map state file.");
+	}
+	m_size = fileStat.st_size;
+
+	//Mapping stays valid after the file descriptor is closed
+	void* data = mmap(nullptr, m_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if(data == MAP_FAILED)
+	{
+		throw std::runtime_error("Failed to map state file.");
+	}
+
+	//Sections are copied from start to end once
+	madvise(data, m_size, MADV_SEQUENTIAL);
+	m_data = reinterpret_cast<const uint8*>(data);
+}
+
+void CFastStateFile::Unmap()
+{
+	if(m_data)
+	{
+		munmap(const_cast<uint8*>(m_data), m_size);
+		m_data = nullptr;
+	}
+}
+
+#endif
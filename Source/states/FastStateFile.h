@@ -0,0 +1,60 @@
+#pragma once
+
+#include <map>
+#include <string>
+#include <vector>
+#include "Types.h"
+#include "Stream.h"
+#include "filesystem_def.h"
+#include "StateArchiveWriter.h"
+
+//Uncompressed state container. Every section starts on a page boundary, which allows
+//the file to be mapped in memory and sections to be copied straight to their destination.
+class CFastStateFile
+{
+public:
+	enum
+	{
+		SECTION_ALIGNMENT = 0x1000,
+		SECTION_NAME_SIZE = 48,
+	};
+
+	typedef CStateArchiveWriter::ChunkArray ChunkArray;
+
+	struct SECTION
+	{
+		std::string name;
+		ChunkArray chunks;
+	};
+	typedef std::vector<SECTION> SectionArray;
+
+	CFastStateFile(const fs::path&);
+	CFastStateFile(const CFastStateFile&) = delete;
+	virtual ~CFastStateFile();
+
+	CFastStateFile& operator=(const CFastStateFile&) = delete;
+
+	static bool IsFastStateFile(const fs::path&);
+	static void Write(Framework::CStream&, const SectionArray&);
+
+	bool HasSection(const char*) const;
+	const uint8* GetSectionData(const char*) const;
+	uint32 GetSectionSize(const char*) const;
+
+private:
+	struct SECTION_INFO
+	{
+		uint64 offset = 0;
+		uint32 size = 0;
+	};
+	typedef std::map<std::string, SECTION_INFO> SectionInfoMap;
+
+	void Map(const fs::path&);
+	void Unmap();
+	void ReadSectionTable();
+	const SECTION_INFO& GetSectionInfo(const char*) const;
+
+	const uint8* m_data = nullptr;
+	uint64 m_size = 0;
+	SectionInfoMap m_sections;
+};
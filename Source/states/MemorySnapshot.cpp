@@ -0,0 +1,211 @@
+#include <cassert>
+#include <cstring>
+#include <algorithm>
+#include <stdexcept>
+#include <zlib.h>
+#include "MemorySnapshot.h"
+
+void CMemorySnapshot::Capture(const RegionArray& regions, const CMemorySnapshot* previous)
+{
+	assert(previous != this);
+	if(previous && (previous->m_regionPages.size() != regions.size()))
+	{
+		previous = nullptr;
+	}
+
+	m_regionPages.clear();
+	m_regionPages.resize(regions.size());
+	m_copiedPageCount = 0;
+
+	for(uint32 regionIndex = 0; regionIndex < regions.size(); regionIndex++)
+	{
+		const auto& region = regions[regionIndex];
+		uint32 pageCount = (region.size + PAGE_SIZE - 1) / PAGE_SIZE;
+
+		const PageArray* previousPages = previous ? &previous->m_regionPages[regionIndex] : nullptr;
+		if(previousPages && (previousPages->size() != pageCount))
+		{
+			previousPages = nullptr;
+		}
+
+		auto& pages = m_regionPages[regionIndex];
+		pages.resize(pageCount);
+		for(uint32 pageIndex = 0; pageIndex < pageCount; pageIndex++)
+		{
+			uint32 pageOffset = pageIndex * PAGE_SIZE;
+			uint32 pageSize = std::min<uint32>(PAGE_SIZE, region.size - pageOffset);
+			const uint8* pageMemory = region.memory + pageOffset;
+
+			if(previousPages)
+			{
+				const auto& previousPage = (*previousPages)[pageIndex];
+				bool pageDirty = !region.isPageDirty || region.isPageDirty(pageOffset);
+				if(!pageDirty || (memcmp(previousPage->data, pageMemory, pageSize) == 0))
+				{
+					pages[pageIndex] = previousPage;
+					continue;
+				}
+			}
+
+			auto page = std::make_shared<PAGE>();
+			memcpy(page->data, pageMemory, pageSize);
+			pages[pageIndex] = std::move(page);
+			m_copiedPageCount++;
+		}
+	}
+}
+
+void CMemorySnapshot::Restore(const RegionArray& regions) const
+{
+	assert(m_regionPages.size() == regions.size());
+	for(uint32 regionIndex = 0; regionIndex < regions.size(); regionIndex++)
+	{
+		const auto& region = regions[regionIndex];
+		const auto& pages = m_regionPages[regionIndex];
+		assert(pages.size() == ((region.size + PAGE_SIZE - 1) / PAGE_SIZE));
+		for(uint32 pageIndex = 0; pageIndex < pages.size(); pageIndex++)
+		{
+			uint32 pageOffset = pageIndex * PAGE_SIZE;
+			uint32 pageSize = std::min<uint32>(PAGE_SIZE, region.size - pageOffset);
+			memcpy(region.memory + pageOffset, pages[pageIndex]->data, pageSize);
+		}
+	}
+}
+
+CMemorySnapshot::Delta CMemorySnapshot::MakeDelta(const CMemorySnapshot& from, const CMemorySnapshot& to)
+{
+	assert(from.m_regionPages.size() == to.m_regionPages.size());
+
+	std::vector<uint8> rawDelta;
+	for(uint32 regionIndex = 0; regionIndex < to.m_regionPages.size(); regionIndex++)
+	{
+		const auto& fromPages = from.m_regionPages[regionIndex];
+		const auto& toPages = to.m_regionPages[regionIndex];
+		assert(fromPages.size() == toPages.size());
+		for(uint32 pageIndex = 0; pageIndex < toPages.size(); pageIndex++)
+		{
+			const auto& fromPage = fromPages[pageIndex];
+			const auto& toPage = toPages[pageIndex];
+			//Shared pages are known to be identical
+			if(fromPage == toPage) continue;
+			if(memcmp(fromPage->data, toPage->data, PAGE_SIZE) == 0) continue;
+
+			DELTA_PAGE_HEADER header;
+			header.regionIndex = regionIndex;
+			header.pageIndex = pageIndex;
+
+			size_t offset = rawDelta.size();
+			rawDelta.resize(offset + sizeof(DELTA_PAGE_HEADER) + PAGE_SIZE);
+			memcpy(rawDelta.data() + offset, &header, sizeof(DELTA_PAGE_HEADER));
+			XorPage(rawDelta.data() + offset + sizeof(DELTA_PAGE_HEADER), fromPage->data, toPage->data);
+		}
+	}
+
+	Delta result;
+	if(rawDelta.empty())
+	{
+		return result;
+	}
+
+	//XOR of pages that only changed partially are mostly zeroes, which compress very well
+	uint32 rawSize = static_cast<uint32>(rawDelta.size());
+	uLongf compressedSize = compressBound(rawSize);
+	result.resize(sizeof(uint32) + compressedSize);
+	memcpy(result.data(), &rawSize, sizeof(uint32));
+	int status = compress2(result.data() + sizeof(uint32), &compressedSize, rawDelta.data(), rawSize, Z_BEST_SPEED);
+	if(status != Z_OK)
+	{
+		throw std::runtime_error("Failed to compress memory snapshot delta.");
+	}
+	result.resize(sizeof(uint32) + compressedSize);
+	result.shrink_to_fit();
+	return result;
+}
+
+void CMemorySnapshot::ApplyDelta(const CMemorySnapshot& to, const Delta& delta)
+{
+	assert(&to != this);
+	m_regionPages = to.m_regionPages;
+	m_copiedPageCount = 0;
+
+	if(delta.empty())
+	{
+		return;
+	}
+
+	uint32 rawSize = 0;
+	memcpy(&rawSize, delta.data(), sizeof(uint32));
+	std::vector<uint8> rawDelta(rawSize);
+	uLongf uncompressedSize = rawSize;
+	int status = uncompress(rawDelta.data(), &uncompressedSize, delta.data() + sizeof(uint32), static_cast<uLong>(delta.size() - sizeof(uint32)));
+	if((status != Z_OK) || (uncompressedSize != rawSize))
+	{
+		throw std::runtime_error("Failed to decompress memory snapshot delta.");
+	}
+
+	for(size_t offset = 0; (offset + sizeof(DELTA_PAGE_HEADER) + PAGE_SIZE) <= rawDelta.size();
+	    offset += sizeof(DELTA_PAGE_HEADER) + PAGE_SIZE)
+	{
+		DELTA_PAGE_HEADER header;
+		memcpy(&header, rawDelta.data() + offset, sizeof(DELTA_PAGE_HEADER));
+		assert(header.regionIndex < m_regionPages.size());
+		assert(header.pageIndex < m_regionPages[header.regionIndex].size());
+
+		auto& page = m_regionPages[header.regionIndex][header.pageIndex];
+		auto newPage = std::make_shared<PAGE>();
+		XorPage(newPage->data, page->data, rawDelta.data() + offset + sizeof(DELTA_PAGE_HEADER));
+		page = std::move(newPage);
+		m_copiedPageCount++;
+	}
+}
+
+void CMemorySnapshot::XorPage(uint8* dst, const uint8* src1, const uint8* src2)
+{
+	static_assert((PAGE_SIZE % sizeof(uint64)) == 0, "Page size must be a multiple of 8.");
+	for(uint32 i = 0; i < PAGE_SIZE; i += sizeof(uint64))
+	{
+		uint64 value1 = 0, value2 = 0;
+		memcpy(&value1, src1 + i, sizeof(uint64));
+		memcpy(&value2, src2 + i, sizeof(uint64));
+		value1 ^= value2;
+		memcpy(dst + i, &value1, sizeof(uint64));
+	}
+}
+
+uint32 CMemorySnapshot::GetPageCount() const
+{
+	uint32 pageCount = 0;
+	for(const auto& pages : m_regionPages)
+	{
+		pageCount += static_cast<uint32>(pages.size());
+	}
+	return pageCount;
+}
+
+uint32 CMemorySnapshot::GetCopiedPageCount() const
+{
+	return m_copiedPageCount;
+}
+
+uint32 CMemorySnapshot::GetRegionPageCount(uint32 regionIndex) const
+{
+	assert(regionIndex < m_regionPages.size());
+	return static_cast<uint32>(m_regionPages[regionIndex].size());
+}
+
+const uint8* CMemorySnapshot::GetPageData(uint32 regionIndex, uint32 pageIndex) const
+{
+	assert(regionIndex < m_regionPages.size());
+	assert(pageIndex < m_regionPages[regionIndex].size());
+	return m_regionPages[regionIndex][pageIndex]->data;
+}
+
+void CMemorySnapshot::AddRegion(RegionArray& regions, const char* name, uint8* memory, uint32 size, PageDirtyFunction isPageDirty)
+{
+	REGION region;
+	region.name = name;
+	region.memory = memory;
+	region.size = size;
+	region.isPageDirty = std::move(isPageDirty);
+	regions.push_back(region);
+}
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <functional>
+#include <memory>
+#include <vector>
+#include "Types.h"
+
+//Copy of a set of memory regions, split in pages. When a previous snapshot of the same
+//regions is provided, pages that didn't change since then are shared with it and only
+//modified pages are copied. Regions can tell which pages were written to since the
+//previous snapshot, only those are compared with it. Other regions are compared in full.
+class CMemorySnapshot
+{
+public:
+	enum
+	{
+		PAGE_SIZE = 0x1000,
+	};
+
+	//Tells if the page at the specified offset might have been written to since the previous snapshot
+	typedef std::function<bool(uint32)> PageDirtyFunction;
+
+	struct REGION
+	{
+		const char* name = nullptr;
+		uint8* memory = nullptr;
+		uint32 size = 0;
+		PageDirtyFunction isPageDirty;
+	};
+	typedef std::vector<REGION> RegionArray;
+
+	typedef std::vector<uint8> Delta;
+
+	void Capture(const RegionArray&, const CMemorySnapshot* = nullptr);
+	void Restore(const RegionArray&) const;
+
+	//Deltas are compressed XOR differences of the pages that differ between two snapshots.
+	//ApplyDelta rebuilds the 'from' snapshot out of the 'to' snapshot and a delta.
+	static Delta MakeDelta(const CMemorySnapshot& from, const CMemorySnapshot& to);
+	void ApplyDelta(const CMemorySnapshot& to, const Delta&);
+
+	uint32 GetPageCount() const;
+	uint32 GetCopiedPageCount() const;
+
+	uint32 GetRegionPageCount(uint32) const;
+	const uint8* GetPageData(uint32, uint32) const;
+
+	static void AddRegion(RegionArray&, const char*, uint8*, uint32, PageDirtyFunction = PageDirtyFunction());
+
+private:
+	struct PAGE
+	{
+		uint8 data[PAGE_SIZE];
+	};
+
+	struct DELTA_PAGE_HEADER
+	{
+		uint32 regionIndex;
+		uint32 pageIndex;
+	};
+
+	static void XorPage(uint8*, const uint8*, const uint8*);
+
+	typedef std::shared_ptr<const PAGE> PagePtr;
+	typedef std::vector<PagePtr> PageArray;
+
+	std::vector<PageArray> m_regionPages;
+	uint32 m_copiedPageCount = 0;
+};
@@ -0,0 +1,72 @@
+#include <cassert>
+#include "RewindBuffer.h"
+
+void CRewindBuffer::SetMemoryBudget(size_t memoryBudget)
+{
+	m_memoryBudget = memoryBudget;
+	EnforceMemoryBudget();
+}
+
+void CRewindBuffer::Clear()
+{
+	m_entries.clear();
+	m_head.reset();
+	m_memoryUsage = 0;
+}
+
+void CRewindBuffer::Push(const StateSnapshotPtr& snapshot)
+{
+	assert(snapshot);
+	if(m_head)
+	{
+		ENTRY entry;
+		entry.stateArchive = m_head->stateArchive;
+		entry.memoryDelta = CMemorySnapshot::MakeDelta(m_head->memory, snapshot->memory);
+		m_memoryUsage += GetEntrySize(entry);
+		m_entries.push_back(std::move(entry));
+	}
+	m_head = snapshot;
+	EnforceMemoryBudget();
+}
+
+StateSnapshotPtr CRewindBuffer::StepBack()
+{
+	auto result = std::move(m_head);
+	if(!m_entries.empty())
+	{
+		auto& entry = m_entries.back();
+		m_memoryUsage -= GetEntrySize(entry);
+		auto previous = std::make_shared<CStateSnapshot>();
+		previous->stateArchive = std::move(entry.stateArchive);
+		previous->memory.ApplyDelta(result->memory, entry.memoryDelta);
+		m_entries.pop_back();
+		m_head = std::move(previous);
+	}
+	return result;
+}
+
+size_t CRewindBuffer::GetSnapshotCount() const
+{
+	return m_head ? (m_entries.size() + 1) : 0;
+}
+
+size_t CRewindBuffer::GetMemoryUsage() const
+{
+	return m_memoryUsage;
+}
+
+size_t CRewindBuffer::GetEntrySize(const ENTRY& entry)
+{
+	return entry.stateArchive.size() + entry.memoryDelta.size();
+}
+
+void CRewindBuffer::EnforceMemoryBudget()
+{
+	//Head snapshot isn't accounted for, its pages are shared with the running machine's last snapshot
+	if(m_memoryBudget == 0) return;
+	while(!m_entries.empty() && (m_memoryUsage > m_memoryBudget))
+	{
+		m_memoryUsage -= GetEntrySize(m_entries.front());
+		m_entries.pop_front();
+	}
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <deque>
+#include "StateSnapshot.h"
+
+//Rolling history of machine snapshots. Only the most recent snapshot is kept whole,
+//older ones are stored as compressed deltas against the next one in the history.
+class CRewindBuffer
+{
+public:
+	void SetMemoryBudget(size_t);
+	void Clear();
+
+	void Push(const StateSnapshotPtr&);
+
+	//Returns the most recent snapshot and removes it from the history
+	StateSnapshotPtr StepBack();
+
+	size_t GetSnapshotCount() const;
+	size_t GetMemoryUsage() const;
+
+private:
+	struct ENTRY
+	{
+		std::vector<uint8> stateArchive;
+		CMemorySnapshot::Delta memoryDelta;
+	};
+
+	static size_t GetEntrySize(const ENTRY&);
+	void EnforceMemoryBudget();
+
+	std::deque<ENTRY> m_entries;
+	StateSnapshotPtr m_head;
+	size_t m_memoryBudget = 0;
+	size_t m_memoryUsage = 0;
+};
@@ -0,0 +1,220 @@
+#include <cassert>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <thread>
+#include <stdexcept>
+#include <algorithm>
+#include <zlib.h>
+#include "StateArchiveWriter.h"
+
+#define ZIP_LOCAL_FILE_HEADER_SIG 0x04034B50
+#define ZIP_CENTRAL_FILE_HEADER_SIG 0x02014B50
+#define ZIP_END_OF_CENTRAL_DIR_SIG 0x06054B50
+#define ZIP_VERSION 20
+#define ZIP_METHOD_DEFLATE 8
+#define ZIP_DOS_DATE_1980 0x21
+
+static void PushUInt16(std::vector<uint8>& buffer, uint16 value)
+{
+	buffer.push_back(static_cast<uint8>(value));
+	buffer.push_back(static_cast<uint8>(value >> 8));
+}
+
+static void PushUInt32(std::vector<uint8>& buffer, uint32 value)
+{
+	PushUInt16(buffer, static_cast<uint16>(value));
+	PushUInt16(buffer, static_cast<uint16>(value >> 16));
+}
+
+CStateArchiveWriter::CStateArchiveWriter(int compressionLevel)
+    : m_compressionLevel(compressionLevel)
+{
+}
+
+void CStateArchiveWriter::InsertFile(const char* name, ChunkArray chunks)
+{
+	FILE_ENTRY file;
+	file.name = name;
+	file.chunks = std::move(chunks);
+	m_files.push_back(std::move(file));
+}
+
+void CStateArchiveWriter::InsertFile(const char* name, std::vector<uint8> data)
+{
+	FILE_ENTRY file;
+	file.name = name;
+	file.data = std::move(data);
+	if(!file.data.empty())
+	{
+		CHUNK chunk;
+		chunk.data = file.data.data();
+		chunk.size = static_cast<uint32>(file.data.size());
+		file.chunks.push_back(chunk);
+	}
+	m_files.push_back(std::move(file));
+}
+
+void CStateArchiveWriter::Write(Framework::CStream& stream)
+{
+	std::vector<WRITTEN_FILE> writtenFiles;
+	std::mutex outputMutex;
+	std::atomic<size_t> nextFileIndex(0);
+	std::exception_ptr error;
+	uint32 currentOffset = 0;
+
+	auto worker =
+	    [&]() {
+		    std::vector<uint8> compressedData;
+		    while(1)
+		    {
+			    size_t fileIndex = nextFileIndex++;
+			    if(fileIndex >= m_files.size()) break;
+			    try
+			    {
+				    WRITTEN_FILE writtenFile;
+				    CompressFile(m_files[fileIndex], compressedData, writtenFile);
+
+				    std::lock_guard<std::mutex> outputLock(outputMutex);
+				    if(error) break;
+				    writtenFile.offset = currentOffset;
+				    WriteLocalFileHeader(stream, writtenFile);
+				    stream.Write(compressedData.data(), writtenFile.compressedSize);
+				    currentOffset += 30 + static_cast<uint32>(writtenFile.name.size()) + writtenFile.compressedSize;
+				    writtenFiles.push_back(std::move(writtenFile));
+			    }
+			    catch(...)
+			    {
+				    std::lock_guard<std::mutex> outputLock(outputMutex);
+				    if(!error)
+				    {
+					    error = std::current_exception();
+				    }
+				    break;
+			    }
+		    }
+	    };
+
+	unsigned int threadCount = std::max<unsigned int>(std::thread::hardware_concurrency(), 1);
+	threadCount = std::min<unsigned int>(threadCount, static_cast<unsigned int>(m_files.size()));
+
+	std::vector<std::thread> threads;
+	for(unsigned int i = 1; i < threadCount; i++)
+	{
+		threads.emplace_back(worker);
+	}
+	worker();
+	for(auto& thread : threads)
+	{
+		thread.join();
+	}
+
+	if(error)
+	{
+		std::rethrow_exception(error);
+	}
+
+	WriteCentralDirectory(stream, writtenFiles, currentOffset);
+}
+
+void CStateArchiveWriter::CompressFile(const FILE_ENTRY& file, std::vector<uint8>& output, WRITTEN_FILE& writtenFile) const
+{
+	uLong totalSize = 0;
+	for(const auto& chunk : file.chunks)
+	{
+		totalSize += chunk.size;
+	}
+
+	z_stream zStream = {};
+	//Negative window bits to get a raw deflate stream, as required by zip
+	if(deflateInit2(&zStream, m_compressionLevel, Z_DEFLATED, -MAX_WBITS, 8, Z_DEFAULT_STRATEGY) != Z_OK)
+	{
+		throw std::runtime_error("Failed to initialize deflate stream.");
+	}
+
+	output.resize(deflateBound(&zStream, totalSize));
+	zStream.next_out = output.data();
+	zStream.avail_out = static_cast<uInt>(output.size());
+
+	uLong crc = crc32(0, Z_NULL, 0);
+	int status = Z_OK;
+	for(const auto& chunk : file.chunks)
+	{
+		auto chunkData = reinterpret_cast<const Bytef*>(chunk.data);
+		crc = crc32(crc, chunkData, chunk.size);
+		zStream.next_in = const_cast<Bytef*>(chunkData);
+		zStream.avail_in = chunk.size;
+		status = deflate(&zStream, Z_NO_FLUSH);
+		if((status != Z_OK) || (zStream.avail_in != 0)) break;
+	}
+	if(status == Z_OK)
+	{
+		status = deflate(&zStream, Z_FINISH);
+	}
+	deflateEnd(&zStream);
+
+	if(status != Z_STREAM_END)
+	{
+		throw std::runtime_error("Failed to compress state file.");
+	}
+
+	writtenFile.name = file.name;
+	writtenFile.crc = static_cast<uint32>(crc);
+	writtenFile.compressedSize = static_cast<uint32>(zStream.total_out);
+	writtenFile.uncompressedSize = static_cast<uint32>(totalSize);
+}
+
+void CStateArchiveWriter::WriteLocalFileHeader(Framework::CStream& stream, const WRITTEN_FILE& file)
+{
+	std::vector<uint8> header;
+	PushUInt32(header, ZIP_LOCAL_FILE_HEADER_SIG);
+	PushUInt16(header, ZIP_VERSION);
+	PushUInt16(header, 0); //Flags
+	PushUInt16(header, ZIP_METHOD_DEFLATE);
+	PushUInt16(header, 0); //Time
+	PushUInt16(header, ZIP_DOS_DATE_1980);
+	PushUInt32(header, file.crc);
+	PushUInt32(header, file.compressedSize);
+	PushUInt32(header, file.uncompressedSize);
+	PushUInt16(header, static_cast<uint16>(file.name.size()));
+	PushUInt16(header, 0); //Extra field length
+	header.insert(header.end(), file.name.begin(), file.name.end());
+	stream.Write(header.data(), header.size());
+}
+
+void CStateArchiveWriter::WriteCentralDirectory(Framework::CStream& stream, const std::vector<WRITTEN_FILE>& files, uint32 directoryOffset)
+{
+	std::vector<uint8> directory;
+	for(const auto& file : files)
+	{
+		PushUInt32(directory, ZIP_CENTRAL_FILE_HEADER_SIG);
+		PushUInt16(directory, ZIP_VERSION); //Version made by
+		PushUInt16(directory, ZIP_VERSION); //Version needed
+		PushUInt16(directory, 0);           //Flags
+		PushUInt16(directory, ZIP_METHOD_DEFLATE);
+		PushUInt16(directory, 0); //Time
+		PushUInt16(directory, ZIP_DOS_DATE_1980);
+		PushUInt32(directory, file.crc);
+		PushUInt32(directory, file.compressedSize);
+		PushUInt32(directory, file.uncompressedSize);
+		PushUInt16(directory, static_cast<uint16>(file.name.size()));
+		PushUInt16(directory, 0); //Extra field length
+		PushUInt16(directory, 0); //Comment length
+		PushUInt16(directory, 0); //Disk number
+		PushUInt16(directory, 0); //Internal attributes
+		PushUInt32(directory, 0); //External attributes
+		PushUInt32(directory, file.offset);
+		directory.insert(directory.end(), file.name.begin(), file.name.end());
+	}
+
+	uint32 directorySize = static_cast<uint32>(directory.size());
+	PushUInt32(directory, ZIP_END_OF_CENTRAL_DIR_SIG);
+	PushUInt16(directory, 0); //Disk number
+	PushUInt16(directory, 0); //Disk with central directory
+	PushUInt16(directory, static_cast<uint16>(files.size()));
+	PushUInt16(directory, static_cast<uint16>(files.size()));
+	PushUInt32(directory, directorySize);
+	PushUInt32(directory, directoryOffset);
+	PushUInt16(directory, 0); //Comment length
+	stream.Write(directory.data(), directory.size());
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include <string>
+#include <vector>
+#include "Types.h"
+#include "Stream.h"
+
+//Writes a zip archive that can be read back with CZipArchiveReader. Files are
+//compressed concurrently on worker threads and are written to the output stream
+//as soon as they are ready.
+class CStateArchiveWriter
+{
+public:
+	struct CHUNK
+	{
+		const void* data = nullptr;
+		uint32 size = 0;
+	};
+	typedef std::vector<CHUNK> ChunkArray;
+
+	CStateArchiveWriter(int);
+
+	//Chunks are not copied and must remain valid until Write returns
+	void InsertFile(const char*, ChunkArray);
+	void InsertFile(const char*, std::vector<uint8>);
+
+	void Write(Framework::CStream&);
+
+private:
+	struct FILE_ENTRY
+	{
+		std::string name;
+		ChunkArray chunks;
+		std::vector<uint8> data;
+	};
+
+	struct WRITTEN_FILE
+	{
+		std::string name;
+		uint32 crc = 0;
+		uint32 compressedSize = 0;
+		uint32 uncompressedSize = 0;
+		uint32 offset = 0;
+	};
+
+	void CompressFile(const FILE_ENTRY&, std::vector<uint8>&, WRITTEN_FILE&) const;
+	static void WriteLocalFileHeader(Framework::CStream&, const WRITTEN_FILE&);
+	static void WriteCentralDirectory(Framework::CStream&, const std::vector<WRITTEN_FILE>&, uint32);
+
+	int m_compressionLevel = 0;
+	std::vector<FILE_ENTRY> m_files;
+};
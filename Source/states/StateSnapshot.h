@@ -0,0 +1,17 @@
+#pragma once
+
+#include <memory>
+#include <vector>
+#include "Types.h"
+#include "MemorySnapshot.h"
+
+//In-memory snapshot of the whole machine. Bulk memory is kept apart from the rest of
+//the state so that it can be shared between snapshots.
+class CStateSnapshot
+{
+public:
+	std::vector<uint8> stateArchive;
+	CMemorySnapshot memory;
+};
+
+typedef std::shared_ptr<const CStateSnapshot> StateSnapshotPtr;
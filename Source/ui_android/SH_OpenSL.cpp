@@ -119,25 +119,37 @@ void CSH_OpenSL::Reset()
 	assert(result == SL_RESULT_SUCCESS);
 
 	m_bufferCount = BUFFER_COUNT;
+	m_bufferIndex = 0;
 }
 
-void CSH_OpenSL::Write(int16* buffer, unsigned int sampleCount, unsigned int)
+void CSH_OpenSL::Write(int16* samples, unsigned int sampleCount, unsigned int)
 {
 	if(m_bufferCount == 0) return;
 
 	assert(m_playerQueue != nullptr);
 
+	//Buffers are played in order, so the slot after the last one written is always free
+	auto& buffer = m_buffers[m_bufferIndex];
+	buffer.assign(samples, samples + sampleCount);
+	m_bufferIndex = (m_bufferIndex + 1) % BUFFER_COUNT;
+
+	//Callback can fire as soon as the buffer is enqueued
+	m_bufferCount--;
+
 	SLresult result = SL_RESULT_SUCCESS;
 
-	result = (*m_playerQueue)->Enqueue(m_playerQueue, buffer, sampleCount * sizeof(int16));
+	result = (*m_playerQueue)->Enqueue(m_playerQueue, buffer.data(), sampleCount * sizeof(int16));
 	assert(result == SL_RESULT_SUCCESS);
-
-	m_bufferCount--;
 }
 
 bool CSH_OpenSL::HasFreeBuffers()
 {
-	return false;
+	return m_bufferCount != 0;
+}
+
+unsigned int CSH_OpenSL::GetQueuedBufferCount()
+{
+	return BUFFER_COUNT - m_bufferCount;
 }
 
 void CSH_OpenSL::RecycleBuffers()
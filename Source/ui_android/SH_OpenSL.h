@@ -1,5 +1,7 @@
 #pragma once
 
+#include <atomic>
+#include <vector>
 #include "../../tools/PsfPlayer/Source/SoundHandler.h"
 #include <SLES/OpenSLES.h>
 #include <SLES/OpenSLES_Android.h>
@@ -16,6 +18,7 @@ public:
 	void Write(int16*, unsigned int, unsigned int) override;
 	bool HasFreeBuffers() override;
 	void RecycleBuffers() override;
+	unsigned int GetQueuedBufferCount() override;
 
 private:
 	enum
@@ -38,5 +41,10 @@ private:
 	SLPlayItf m_playerPlay = nullptr;
 	SLAndroidSimpleBufferQueueItf m_playerQueue = nullptr;
 
-	uint32 m_bufferCount = BUFFER_COUNT;
+	//Updated by the queue callback, which runs on an OpenSL thread
+	std::atomic<uint32> m_bufferCount{BUFFER_COUNT};
+
+	//Enqueue doesn't copy the samples, each queued buffer needs storage of its own
+	std::vector<int16> m_buffers[BUFFER_COUNT];
+	uint32 m_bufferIndex = 0;
 };
@@ -445,6 +445,7 @@ void MainWindow::on_actionSettings_triggered()
 	if(m_virtualMachine != nullptr)
 	{
 		m_virtualMachine->ReloadSpuBlockCount();
+		m_virtualMachine->ReloadCdvdSettings();
 		openGLWindow_resized();
 		auto gsHandler = m_virtualMachine->GetGSHandler();
 		if(gsHandler)
@@ -754,6 +755,10 @@ void MainWindow::on_actionMemory_Card_Manager_triggered()
 {
 	MemoryCardManagerDialog mcm(this);
 	mcm.exec();
+	if(m_virtualMachine != nullptr)
+	{
+		m_virtualMachine->NotifyMemoryCardsChanged();
+	}
 }
 
 void MainWindow::on_actionVFS_Manager_triggered()
@@ -29,30 +29,34 @@ std::string CStatsManager::GetProfilingInfo()
 	std::lock_guard<std::mutex> profileZonesLock(m_profilerZonesMutex);
 
 	std::string result;
-	uint64 totalTime = 0;
-
-	for(const auto& zonePair : m_profilerZones)
-	{
-		const auto& zoneInfo = zonePair.second;
-		totalTime += zoneInfo.currentValue;
-	}
 
 	//Times are in nanoseconds (1m ns in a s)
 	static const uint64 timeScale = 1000000;
 
-	for(const auto& zonePair : m_profilerZones)
+	for(const auto& threadZonesPair : m_profilerZones)
 	{
-		const auto& zoneInfo = zonePair.second;
-		float avgRatioSpent = (totalTime != 0) ? static_cast<double>(zoneInfo.currentValue) / static_cast<double>(totalTime) : 0;
-		float avgMsSpent = (m_frames != 0) ? static_cast<double>(zoneInfo.currentValue) / static_cast<double>(m_frames * timeScale) : 0;
-		float minMsSpent = (zoneInfo.minValue != ~0ULL) ? static_cast<double>(zoneInfo.minValue) / static_cast<double>(timeScale) : 0;
-		float maxMsSpent = static_cast<double>(zoneInfo.maxValue) / static_cast<double>(timeScale);
-		result += string_format("%10s %6.2f%% %6.2fms %6.2fms %6.2fms\r\n",
-		                        zonePair.first.c_str(), avgRatioSpent * 100.f, avgMsSpent, minMsSpent, maxMsSpent);
-	}
+		const auto& zones = threadZonesPair.second;
+		uint64 totalTime = 0;
+
+		for(const auto& zonePair : zones)
+		{
+			const auto& zoneInfo = zonePair.second;
+			totalTime += zoneInfo.currentValue;
+		}
+
+		result += string_format("%s:\r\n", threadZonesPair.first.c_str());
+
+		for(const auto& zonePair : zones)
+		{
+			const auto& zoneInfo = zonePair.second;
+			float avgRatioSpent = (totalTime != 0) ? static_cast<double>(zoneInfo.currentValue) / static_cast<double>(totalTime) : 0;
+			float avgMsSpent = (m_frames != 0) ? static_cast<double>(zoneInfo.currentValue) / static_cast<double>(m_frames * timeScale) : 0;
+			float minMsSpent = (zoneInfo.minValue != ~0ULL) ? static_cast<double>(zoneInfo.minValue) / static_cast<double>(timeScale) : 0;
+			float maxMsSpent = static_cast<double>(zoneInfo.maxValue) / static_cast<double>(timeScale);
+			result += string_format("%10s %6.2f%% %6.2fms %6.2fms %6.2fms\r\n",
+			                        zonePair.first.c_str(), avgRatioSpent * 100.f, avgMsSpent, minMsSpent, maxMsSpent);
+		}
 
-	if(!m_profilerZones.empty())
-	{
 		float totalAvgMsSpent = (m_frames != 0) ? static_cast<double>(totalTime) / static_cast<double>(m_frames * timeScale) : 0;
 		result += string_format("                   %6.2fms\r\n\r\n", totalAvgMsSpent);
 	}
@@ -82,9 +86,12 @@ void CStatsManager::ClearStats()
 	m_frames = 0;
 	m_drawCalls = 0;
 #ifdef PROFILE
-	for(auto& zonePair : m_profilerZones)
+	for(auto& threadZonesPair : m_profilerZones)
 	{
-		zonePair.second.currentValue = 0;
+		for(auto& zonePair : threadZonesPair.second)
+		{
+			zonePair.second.currentValue = 0;
+		}
 	}
 	m_cpuUtilisation = CPS2VM::CPU_UTILISATION_INFO();
 #endif
@@ -98,7 +105,7 @@ void CStatsManager::OnProfileFrameDone(CPS2VM* virtualMachine, const CProfiler::
 
 	for(auto& zone : zones)
 	{
-		auto& zoneInfo = m_profilerZones[zone.name];
+		auto& zoneInfo = m_profilerZones[zone.threadName][zone.name];
 		zoneInfo.currentValue += zone.totalTime;
 		if(zone.totalTime != 0)
 		{
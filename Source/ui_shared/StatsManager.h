@@ -39,10 +39,12 @@ private:
 	};
 
 	typedef std::map<std::string, ZONEINFO> ZoneMap;
+	//Zones are kept per thread since time spent on different threads overlaps
+	typedef std::map<std::string, ZoneMap> ThreadZoneMap;
 
 	CPS2VM::CPU_UTILISATION_INFO m_cpuUtilisation;
 
 	std::mutex m_profilerZonesMutex;
-	ZoneMap m_profilerZones;
+	ThreadZoneMap m_profilerZones;
 #endif
 };
@@ -1,4 +1,11 @@
+#include <algorithm>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <condition_variable>
 #include "PS2VM.h"
+#include "AppConfig.h"
+#include "Log.h"
 #include "filesystem_def.h"
 #include "StdStream.h"
 #include "StdStreamUtils.h"
@@ -16,6 +23,42 @@
 
 #define DEFAULT_GS_HANDLER_NAME GS_HANDLER_NAME_NULL
 
+enum TEST_TYPE
+{
+	TEST_TYPE_EE,
+	TEST_TYPE_IOP,
+};
+
+struct TEST_ENTRY
+{
+	fs::path path;
+	TEST_TYPE type;
+};
+typedef std::vector<TEST_ENTRY> TestEntryArray;
+
+//Signaled by the emulator thread when a test is done
+class CExecutionEvent
+{
+public:
+	void Signal()
+	{
+		std::lock_guard<std::mutex> signalLock(m_mutex);
+		m_signaled = true;
+		m_condition.notify_all();
+	}
+
+	void Wait()
+	{
+		std::unique_lock<std::mutex> signalLock(m_mutex);
+		m_condition.wait(signalLock, [this]() { return m_signaled; });
+	}
+
+private:
+	std::mutex m_mutex;
+	std::condition_variable m_condition;
+	bool m_signaled = false;
+};
+
 static std::set<std::string> g_validGsHandlersNames =
     {
         GS_HANDLER_NAME_NULL,
@@ -116,7 +159,7 @@ void ExecuteEeTest(const fs::path& testFilePath, const std::string& gsHandlerNam
 	resultFilePath.replace_extension(".result");
 	auto resultStream = new Framework::CStdStream(resultFilePath.string().c_str(), "wb");
 
-	bool executionOver = false;
+	CExecutionEvent executionOverEvent;
 
 	//Setup virtual machine
 	CPS2VM virtualMachine;
@@ -124,8 +167,8 @@ void ExecuteEeTest(const fs::path& testFilePath, const std::string& gsHandlerNam
 	virtualMachine.Reset();
 	virtualMachine.CreateGSHandler(GetGsHandlerFactoryFunction(gsHandlerName));
 	auto connection = virtualMachine.m_ee->m_os->OnRequestExit.Connect(
-	    [&executionOver]() {
-		    executionOver = true;
+	    [&executionOverEvent]() {
+		    executionOverEvent.Signal();
 	    });
 	virtualMachine.m_ee->m_os->BootFromFile(testFilePath);
 	{
@@ -134,10 +177,7 @@ void ExecuteEeTest(const fs::path& testFilePath, const std::string& gsHandlerNam
 	}
 	virtualMachine.Resume();
 
-	while(!executionOver)
-	{
-		std::this_thread::sleep_for(std::chrono::milliseconds(100));
-	}
+	executionOverEvent.Wait();
 
 	virtualMachine.Pause();
 	virtualMachine.DestroyGSHandler();
@@ -159,7 +199,7 @@ void ExecuteIopTest(const fs::path& testFilePath)
 	resultFilePath.replace_extension(".result");
 	auto resultStream = new Framework::CStdStream(resultFilePath.string().c_str(), "wb");
 
-	bool executionOver = false;
+	CExecutionEvent executionOverEvent;
 	CIopBios::ModuleStartedEvent::Connection connection;
 	//Setup virtual machine
 	CPS2VM virtualMachine;
@@ -169,10 +209,10 @@ void ExecuteIopTest(const fs::path& testFilePath)
 		auto iopOs = dynamic_cast<CIopBios*>(virtualMachine.m_iop->m_bios.get());
 		int32 rootModuleId = iopOs->LoadModuleFromHost(moduleData.data());
 		connection = iopOs->OnModuleStarted.Connect(
-		    [&executionOver, rootModuleId](uint32 moduleId) {
+		    [&executionOverEvent, rootModuleId](uint32 moduleId) {
 			    if(rootModuleId == moduleId)
 			    {
-				    executionOver = true;
+				    executionOverEvent.Signal();
 			    }
 		    });
 		iopOs->StartModule(rootModuleId, "", nullptr, 0);
@@ -180,16 +220,13 @@ void ExecuteIopTest(const fs::path& testFilePath)
 	}
 	virtualMachine.Resume();
 
-	while(!executionOver)
-	{
-		std::this_thread::sleep_for(std::chrono::milliseconds(100));
-	}
+	executionOverEvent.Wait();
 
 	virtualMachine.Pause();
 	virtualMachine.Destroy();
 }
 
-void ScanAndExecuteTests(const fs::path& testDirPath, const TestReportWriterPtr& testReportWriter, const std::string& gsHandlerName)
+void ScanTests(const fs::path& testDirPath, TestEntryArray& tests)
 {
 	fs::directory_iterator endIterator;
 	for(auto testPathIterator = fs::directory_iterator(testDirPath);
@@ -198,30 +235,89 @@ void ScanAndExecuteTests(const fs::path& testDirPath, const TestReportWriterPtr&
 		auto testPath = testPathIterator->path();
 		if(fs::is_directory(testPath))
 		{
-			ScanAndExecuteTests(testPath, testReportWriter, gsHandlerName);
+			ScanTests(testPath, tests);
 			continue;
 		}
 		if(testPath.extension() == ".elf")
 		{
-			printf("Testing '%s': ", testPath.string().c_str());
-			ExecuteEeTest(testPath, gsHandlerName);
-			auto result = GetTestResult(testPath);
-			printf("%s.\r\n", result.succeeded ? "SUCCEEDED" : "FAILED");
-			if(testReportWriter)
-			{
-				testReportWriter->ReportTestEntry(testPath.string(), result);
-			}
+			tests.push_back({testPath, TEST_TYPE_EE});
 		}
 		else if(testPath.extension() == ".irx")
 		{
-			printf("Testing '%s': ", testPath.string().c_str());
-			ExecuteIopTest(testPath);
-			auto result = GetTestResult(testPath);
-			printf("%s.\r\n", result.succeeded ? "SUCCEEDED" : "FAILED");
-			if(testReportWriter)
-			{
-				testReportWriter->ReportTestEntry(testPath.string(), result);
-			}
+			tests.push_back({testPath, TEST_TYPE_IOP});
+		}
+	}
+}
+
+void ScanAndExecuteTests(const fs::path& testDirPath, const TestReportWriterPtr& testReportWriter, const std::string& gsHandlerName, unsigned int jobCount)
+{
+	TestEntryArray tests;
+	ScanTests(testDirPath, tests);
+
+	//Each worker runs its own virtual machine, results are reported in scan order
+	std::vector<TESTRESULT> results(tests.size());
+	std::atomic<size_t> nextTestIndex(0);
+	std::mutex printMutex;
+	std::exception_ptr workerException;
+
+	auto workerProc =
+	    [&]() {
+		    while(1)
+		    {
+			    size_t testIndex = nextTestIndex++;
+			    if(testIndex >= tests.size()) break;
+			    const auto& test = tests[testIndex];
+			    try
+			    {
+				    if(test.type == TEST_TYPE_EE)
+				    {
+					    ExecuteEeTest(test.path, gsHandlerName);
+				    }
+				    else
+				    {
+					    ExecuteIopTest(test.path);
+				    }
+			    }
+			    catch(...)
+			    {
+				    std::lock_guard<std::mutex> printLock(printMutex);
+				    workerException = std::current_exception();
+				    nextTestIndex = tests.size();
+				    break;
+			    }
+			    results[testIndex] = GetTestResult(test.path);
+			    std::lock_guard<std::mutex> printLock(printMutex);
+			    printf("Testing '%s': %s.\r\n", test.path.string().c_str(), results[testIndex].succeeded ? "SUCCEEDED" : "FAILED");
+		    }
+	    };
+
+	if(jobCount <= 1)
+	{
+		workerProc();
+	}
+	else
+	{
+		std::vector<std::thread> workers;
+		for(unsigned int i = 0; i < jobCount; i++)
+		{
+			workers.emplace_back(workerProc);
+		}
+		for(auto& worker : workers)
+		{
+			worker.join();
+		}
+	}
+
+	if(workerException)
+	{
+		std::rethrow_exception(workerException);
+	}
+
+	if(testReportWriter)
+	{
+		for(unsigned int i = 0; i < tests.size(); i++)
+		{
+			testReportWriter->ReportTestEntry(tests[i].path.string(), results[i]);
 		}
 	}
 }
@@ -248,6 +344,7 @@ int main(int argc, const char** argv)
 		printf("Usage: AutoTest [options] testDir\r\n");
 		printf("Options: \r\n");
 		printf("\t --junitreport <path>\t Writes JUnit format report at <path>.\r\n");
+		printf("\t --jobs <count>\t Number of tests executed concurrently (default is 1).\r\n");
 		printf("\t --gshandler <%s>\tSelects which GS handler to instantiate (default is '%s').\r\n",
 		       validGsHandlerNamesString.c_str(), DEFAULT_GS_HANDLER_NAME);
 		return -1;
@@ -257,6 +354,7 @@ int main(int argc, const char** argv)
 	fs::path autoTestRoot;
 	fs::path reportPath;
 	std::string gsHandlerName = DEFAULT_GS_HANDLER_NAME;
+	unsigned int jobCount = 1;
 	assert(g_validGsHandlersNames.find(gsHandlerName) != std::end(g_validGsHandlersNames));
 
 	for(int i = 1; i < argc; i++)
@@ -272,6 +370,16 @@ int main(int argc, const char** argv)
 			reportPath = fs::path(argv[i + 1]);
 			i++;
 		}
+		else if(!strcmp(argv[i], "--jobs"))
+		{
+			if((i + 1) >= argc)
+			{
+				printf("Error: Count must be specified for --jobs option.\r\n");
+				return -1;
+			}
+			jobCount = std::max(atoi(argv[i + 1]), 1);
+			i++;
+		}
 		else if(!strcmp(argv[i], "--gshandler"))
 		{
 			if((i + 1) >= argc)
@@ -300,9 +408,13 @@ int main(int argc, const char** argv)
 		return -1;
 	}
 
+	//Make sure shared singletons are created before workers start
+	CAppConfig::GetInstance();
+	CLog::GetInstance();
+
 	try
 	{
-		ScanAndExecuteTests(autoTestRoot, testReportWriter, gsHandlerName);
+		ScanAndExecuteTests(autoTestRoot, testReportWriter, gsHandlerName, jobCount);
 	}
 	catch(const std::exception& exception)
 	{
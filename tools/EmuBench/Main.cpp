@@ -0,0 +1,420 @@
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <map>
+#include <mutex>
+#include <condition_variable>
+#include <algorithm>
+#include <vector>
+#include "PS2VM.h"
+#include "PS2VM_Preferences.h"
+#include "AppConfig.h"
+#include "PerfCounters.h"
+#include "Profiler.h"
+#include "StdStreamUtils.h"
+#include "string_format.h"
+#include "ee/PS2OS.h"
+#include "gs/GSH_Null.h"
+#ifdef _WIN32
+#include <Windows.h>
+#include <Psapi.h>
+#else
+#include <sys/resource.h>
+#endif
+
+#define DEFAULT_FRAME_COUNT 600
+
+struct BENCH_RESULT
+{
+	uint32 frameCount = 0;
+	uint64 wallTime = 0;
+	CPerfCounters::CounterArray counters = {};
+#ifdef PROFILE
+	std::map<std::string, uint64> zones;
+#endif
+	bool moviePlayed = false;
+	std::vector<uint32> movieHashes;
+	uint32 movieDesyncFrameIndex = CPS2VM::MOVIE_FRAME_INDEX_NONE;
+};
+
+static uint64 GetPeakResidentSetSize()
+{
+#ifdef _WIN32
+	PROCESS_MEMORY_COUNTERS memoryCounters = {};
+	if(GetProcessMemoryInfo(GetCurrentProcess(), &memoryCounters, sizeof(memoryCounters)))
+	{
+		return memoryCounters.PeakWorkingSetSize;
+	}
+	return 0;
+#else
+	struct rusage usage = {};
+	getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+	return usage.ru_maxrss;
+#else
+	return static_cast<uint64>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+}
+
+static std::string EscapeJsonString(const std::string& input)
+{
+	std::string result;
+	for(auto character : input)
+	{
+		if((character == '"') || (character == '\\'))
+		{
+			result += '\\';
+		}
+		result += character;
+	}
+	return result;
+}
+
+static std::string MakeJsonReport(const std::string& target, const BENCH_RESULT& result)
+{
+	double wallSeconds = static_cast<double>(result.wallTime) / 1000000000.0;
+	double emulatedFps = (wallSeconds != 0) ? (static_cast<double>(result.frameCount) / wallSeconds) : 0;
+
+	std::string report;
+	report += "{\n";
+	report += string_format("\t\"target\": \"%s\",\n", EscapeJsonString(target).c_str());
+#ifdef PLAY_VERSION
+	report += string_format("\t\"version\": \"%s\",\n", PLAY_VERSION);
+#endif
+	report += string_format("\t\"frames\": %d,\n", result.frameCount);
+	report += string_format("\t\"wallTime\": %0.6f,\n", wallSeconds);
+	report += string_format("\t\"emulatedFps\": %0.3f,\n", emulatedFps);
+	report += string_format("\t\"peakRss\": %llu,\n", static_cast<unsigned long long>(GetPeakResidentSetSize()));
+	if(result.moviePlayed)
+	{
+		//Hashes of EE RAM for every frame, two runs of the same movie must produce the same list
+		report += "\t\"movie\": {\n";
+		if(result.movieDesyncFrameIndex == CPS2VM::MOVIE_FRAME_INDEX_NONE)
+		{
+			report += "\t\t\"desyncFrame\": null,\n";
+		}
+		else
+		{
+			report += string_format("\t\t\"desyncFrame\": %u,\n", result.movieDesyncFrameIndex);
+		}
+		report += "\t\t\"frameHashes\": [";
+		for(size_t i = 0; i < result.movieHashes.size(); i++)
+		{
+			report += string_format("%s%u", (i != 0) ? ", " : "", result.movieHashes[i]);
+		}
+		report += "]\n";
+		report += "\t},\n";
+	}
+	report += "\t\"counters\": {\n";
+	for(unsigned int i = 0; i < CPerfCounters::COUNTER_MAX; i++)
+	{
+		report += string_format("\t\t\"%s\": %llu%s\n", CPerfCounters::GetCounterName(static_cast<CPerfCounters::COUNTER>(i)),
+		                        static_cast<unsigned long long>(result.counters[i]), (i != (CPerfCounters::COUNTER_MAX - 1)) ? "," : "");
+	}
+	report += "\t}";
+#ifdef PROFILE
+	report += ",\n\t\"zones\": {\n";
+	for(auto zoneIterator = result.zones.begin(); zoneIterator != result.zones.end(); zoneIterator++)
+	{
+		report += string_format("\t\t\"%s\": %llu%s\n", EscapeJsonString(zoneIterator->first).c_str(),
+		                        static_cast<unsigned long long>(zoneIterator->second), (std::next(zoneIterator) != result.zones.end()) ? "," : "");
+	}
+	report += "\t}";
+#endif
+	report += "\n}\n";
+	return report;
+}
+
+int main(int argc, const char** argv)
+{
+	if(argc < 2)
+	{
+		printf("Usage: EmuBench [options] <elf|iso>\r\n");
+		printf("Options: \r\n");
+		printf("\t --frames <count>\t Number of emulated frames to run (default is %d).\r\n", DEFAULT_FRAME_COUNT);
+		printf("\t --state <path>\t Loads a save state after booting.\r\n");
+		printf("\t --movie <path>\t Plays back an input movie in lockstep mode after booting (frame count defaults to the movie's length).\r\n");
+		printf("\t\t\t Fails if EE RAM hashes diverge from the recorded ones.\r\n");
+		printf("\t --output <path>\t Writes JSON results at <path> instead of standard output.\r\n");
+#ifdef PROFILE
+		printf("\t --trace <path>\t Writes a Chrome trace of profiler zones at <path>.\r\n");
+#endif
+		return -1;
+	}
+
+	fs::path targetPath;
+	fs::path statePath;
+	fs::path moviePath;
+	fs::path outputPath;
+	fs::path tracePath;
+	uint32 frameCount = DEFAULT_FRAME_COUNT;
+	bool frameCountSpecified = false;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(!strcmp(argv[i], "--frames"))
+		{
+			if((i + 1) >= argc)
+			{
+				printf("Error: Count must be specified for --frames option.\r\n");
+				return -1;
+			}
+			frameCount = std::max(atoi(argv[i + 1]), 1);
+			frameCountSpecified = true;
+			i++;
+		}
+		else if(!strcmp(argv[i], "--state"))
+		{
+			if((i + 1) >= argc)
+			{
+				printf("Error: Path must be specified for --state option.\r\n");
+				return -1;
+			}
+			statePath = argv[i + 1];
+			i++;
+		}
+		else if(!strcmp(argv[i], "--movie"))
+		{
+			if((i + 1) >= argc)
+			{
+				printf("Error: Path must be specified for --movie option.\r\n");
+				return -1;
+			}
+			moviePath = argv[i + 1];
+			i++;
+		}
+		else if(!strcmp(argv[i], "--output"))
+		{
+			if((i + 1) >= argc)
+			{
+				printf("Error: Path must be specified for --output option.\r\n");
+				return -1;
+			}
+			outputPath = argv[i + 1];
+			i++;
+		}
+#ifdef PROFILE
+		else if(!strcmp(argv[i], "--trace"))
+		{
+			if((i + 1) >= argc)
+			{
+				printf("Error: Path must be specified for --trace option.\r\n");
+				return -1;
+			}
+			tracePath = argv[i + 1];
+			i++;
+		}
+#endif
+		else
+		{
+			targetPath = argv[i];
+			break;
+		}
+	}
+
+	if(targetPath.empty())
+	{
+		printf("Error: No executable or disk image specified.\r\n");
+		return -1;
+	}
+
+	CPS2VM virtualMachine;
+	virtualMachine.Initialize();
+	virtualMachine.CreateGSHandler(CGSH_Null::GetFactoryFunction());
+
+	//Disk image is passed through the cdrom0 preference, which is only read on reset.
+	//The user's last disk is put back right after so it doesn't get saved with the config.
+	auto previousCdrom0Path = CAppConfig::GetInstance().GetPreferencePath(PREF_PS2_CDROM0_PATH);
+
+	try
+	{
+		bool isExecutable = (targetPath.extension() == ".elf") || (targetPath.extension() == ".ELF");
+		if(!isExecutable)
+		{
+			CAppConfig::GetInstance().SetPreferencePath(PREF_PS2_CDROM0_PATH, targetPath);
+		}
+		virtualMachine.Reset();
+		CAppConfig::GetInstance().SetPreferencePath(PREF_PS2_CDROM0_PATH, previousCdrom0Path);
+		if(isExecutable)
+		{
+			virtualMachine.m_ee->m_os->BootFromFile(targetPath);
+		}
+		else
+		{
+			virtualMachine.m_ee->m_os->BootFromCDROM();
+		}
+	}
+	catch(const std::exception& exception)
+	{
+		CAppConfig::GetInstance().SetPreferencePath(PREF_PS2_CDROM0_PATH, previousCdrom0Path);
+		printf("Error: Failed to boot '%s': %s\r\n", targetPath.string().c_str(), exception.what());
+		virtualMachine.DestroyGSHandler();
+		virtualMachine.Destroy();
+		return -1;
+	}
+
+	if(!statePath.empty() && !virtualMachine.LoadState(statePath).get())
+	{
+		printf("Error: Failed to load state '%s'.\r\n", statePath.string().c_str());
+		virtualMachine.DestroyGSHandler();
+		virtualMachine.Destroy();
+		return -1;
+	}
+
+	//Movie is also read here to compare the hashes we get with the recorded ones
+	CInputMovie movie;
+	if(!moviePath.empty())
+	{
+		try
+		{
+			auto movieStream = Framework::CreateInputStdStream(moviePath.native());
+			movie.Read(movieStream);
+		}
+		catch(const std::exception& exception)
+		{
+			printf("Error: Failed to read movie '%s': %s\r\n", moviePath.string().c_str(), exception.what());
+			virtualMachine.DestroyGSHandler();
+			virtualMachine.Destroy();
+			return -1;
+		}
+		if(!virtualMachine.StartMoviePlayback(moviePath).get())
+		{
+			printf("Error: Failed to start playback of movie '%s'.\r\n", moviePath.string().c_str());
+			virtualMachine.DestroyGSHandler();
+			virtualMachine.Destroy();
+			return -1;
+		}
+		if(!frameCountSpecified)
+		{
+			frameCount = std::max<uint32>(static_cast<uint32>(movie.GetFrames().size()), 1);
+		}
+	}
+
+	BENCH_RESULT result;
+	result.moviePlayed = !moviePath.empty();
+	std::mutex resultMutex;
+	std::condition_variable resultCondition;
+	auto startTime = std::chrono::steady_clock::now();
+
+	//Signals are raised by the emulator thread at vblank, movie frames are done before perf counters
+	auto movieConnection = virtualMachine.MovieFrameDone.Connect(
+	    [&](uint32 frameIndex, uint32 ramHash) {
+		    std::unique_lock<std::mutex> resultLock(resultMutex);
+		    if(result.frameCount == frameCount) return;
+		    result.movieHashes.push_back(ramHash);
+		    const auto& movieFrames = movie.GetFrames();
+		    if((frameIndex < movieFrames.size()) && (movieFrames[frameIndex].ramHash != ramHash) &&
+		       (result.movieDesyncFrameIndex == CPS2VM::MOVIE_FRAME_INDEX_NONE))
+		    {
+			    result.movieDesyncFrameIndex = frameIndex;
+		    }
+	    });
+	auto perfCountersConnection = virtualMachine.PerfCountersFrameDone.Connect(
+	    [&](const CPerfCounters::CounterArray& counters) {
+		    std::unique_lock<std::mutex> resultLock(resultMutex);
+		    if(result.frameCount == frameCount) return;
+		    for(unsigned int i = 0; i < CPerfCounters::COUNTER_MAX; i++)
+		    {
+			    //Active voices is a gauge, keep the highest value
+			    if(i == CPerfCounters::COUNTER_SPU_ACTIVE_VOICES)
+			    {
+				    result.counters[i] = std::max(result.counters[i], counters[i]);
+			    }
+			    else
+			    {
+				    result.counters[i] += counters[i];
+			    }
+		    }
+		    result.frameCount++;
+		    if(result.frameCount == frameCount)
+		    {
+			    result.wallTime = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count();
+			    resultCondition.notify_all();
+		    }
+	    });
+#ifdef PROFILE
+	auto profileConnection = virtualMachine.ProfileFrameDone.Connect(
+	    [&](const CProfiler::ZoneArray& zones) {
+		    std::unique_lock<std::mutex> resultLock(resultMutex);
+		    if(result.frameCount == frameCount) return;
+		    for(const auto& zone : zones)
+		    {
+			    result.zones[zone.threadName + "/" + zone.name] += zone.totalTime;
+		    }
+	    });
+#endif
+
+	virtualMachine.GetPerfCounters().SetEnabled(true);
+	if(!tracePath.empty())
+	{
+		CProfiler::GetInstance().ClearCollectedEvents();
+		CProfiler::GetInstance().SetTraceCaptureEnabled(true);
+	}
+	startTime = std::chrono::steady_clock::now();
+	virtualMachine.Resume();
+
+	{
+		std::unique_lock<std::mutex> resultLock(resultMutex);
+		resultCondition.wait(resultLock, [&]() { return result.frameCount == frameCount; });
+	}
+
+	virtualMachine.Pause();
+	virtualMachine.GetPerfCounters().SetEnabled(false);
+	perfCountersConnection.reset();
+	movieConnection.reset();
+#ifdef PROFILE
+	profileConnection.reset();
+#endif
+
+	int exitCode = 0;
+	if(result.movieDesyncFrameIndex != CPS2VM::MOVIE_FRAME_INDEX_NONE)
+	{
+		printf("Error: Movie playback diverged from the recording at frame %u.\r\n", result.movieDesyncFrameIndex);
+		exitCode = -1;
+	}
+	if(!tracePath.empty())
+	{
+		CProfiler::GetInstance().SetTraceCaptureEnabled(false);
+		CProfiler::GetInstance().CollectEvents();
+		try
+		{
+			auto traceStream = Framework::CreateOutputStdStream(tracePath.native());
+			CProfiler::GetInstance().WriteChromeTrace(traceStream);
+		}
+		catch(const std::exception& exception)
+		{
+			printf("Error: Failed to write trace: %s\r\n", exception.what());
+			exitCode = -1;
+		}
+		uint32 droppedEventCount = CProfiler::GetInstance().GetDroppedEventCount();
+		if(droppedEventCount != 0)
+		{
+			printf("Warning: %u profiler events were dropped from the trace.\r\n", droppedEventCount);
+		}
+	}
+
+	auto report = MakeJsonReport(targetPath.string(), result);
+	if(outputPath.empty())
+	{
+		printf("%s", report.c_str());
+	}
+	else
+	{
+		try
+		{
+			auto outputStream = Framework::CreateOutputStdStream(outputPath.native());
+			outputStream.Write(report.c_str(), report.size());
+		}
+		catch(const std::exception& exception)
+		{
+			printf("Error: Failed to write results: %s\r\n", exception.what());
+			exitCode = -1;
+		}
+	}
+
+	virtualMachine.DestroyGSHandler();
+	virtualMachine.Destroy();
+
+	return exitCode;
+}
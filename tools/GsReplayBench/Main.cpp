@@ -0,0 +1,270 @@
+#include <cstdio>
+#include <cstring>
+#include <chrono>
+#include <memory>
+#include <set>
+#include <algorithm>
+#include "StdStreamUtils.h"
+#include "string_format.h"
+#include "FrameDump.h"
+#include "gs/GSH_Null.h"
+#ifdef _WIN32
+#include "gs/GSH_OpenGLWin32/GSH_OpenGLWin32.h"
+#include "gs/GSH_Direct3D9/GSH_Direct3D9.h"
+#endif
+
+#define GS_HANDLER_NAME_NULL "null"
+#define GS_HANDLER_NAME_OGL "ogl"
+#define GS_HANDLER_NAME_D3D9 "d3d9"
+
+#define DEFAULT_GS_HANDLER_NAME GS_HANDLER_NAME_NULL
+#define DEFAULT_ITERATION_COUNT 10
+
+static std::set<std::string> g_validGsHandlersNames =
+    {
+        GS_HANDLER_NAME_NULL,
+#ifdef _WIN32
+        GS_HANDLER_NAME_OGL,
+        GS_HANDLER_NAME_D3D9,
+#endif
+};
+
+#ifdef _WIN32
+
+class CBenchWindow : public Framework::Win32::CWindow, public CSingleton<CBenchWindow>
+{
+public:
+	CBenchWindow()
+	{
+		Create(0, Framework::Win32::CDefaultWndClass::GetName(), _T(""), WS_OVERLAPPED, Framework::Win32::CRect(0, 0, 640, 480), NULL, NULL);
+		SetClassPtr();
+	}
+};
+
+#endif
+
+CGSHandler::FactoryFunction GetGsHandlerFactoryFunction(const std::string& gsHandlerName)
+{
+	if(gsHandlerName == GS_HANDLER_NAME_NULL)
+	{
+		return CGSH_Null::GetFactoryFunction();
+	}
+#ifdef _WIN32
+	else if(gsHandlerName == GS_HANDLER_NAME_OGL)
+	{
+		return CGSH_OpenGLWin32::GetFactoryFunction(&CBenchWindow::GetInstance());
+	}
+	else if(gsHandlerName == GS_HANDLER_NAME_D3D9)
+	{
+		return CGSH_Direct3D9::GetFactoryFunction(&CBenchWindow::GetInstance());
+	}
+#endif
+	else
+	{
+		throw std::runtime_error("Unknown GS handler name.");
+	}
+}
+
+static double ToMilliseconds(uint64 time)
+{
+	return static_cast<double>(time) / 1000000.0;
+}
+
+static std::string GetRegisterName(uint8 registerId)
+{
+	//Disassembled writes look like 'NAME(FIELDS...)'
+	auto disassembly = CGSHandler::DisassembleWrite(registerId, 0);
+	auto parenPos = disassembly.find('(');
+	if((parenPos == std::string::npos) || (parenPos == 0))
+	{
+		return string_format("0x%02X", registerId);
+	}
+	return disassembly.substr(0, parenPos);
+}
+
+//Replays the whole dump once, packet per packet, like the GIF would have sent them
+static void ReplayFrameDump(CGSHandler* gs, CFrameDump& frameDump)
+{
+	gs->Reset();
+
+	memcpy(gs->GetRam(), frameDump.GetInitialGsRam(), CGSHandler::RAMSIZE);
+	memcpy(gs->GetRegisters(), frameDump.GetInitialGsRegisters(), CGSHandler::REGISTER_MAX * sizeof(uint64));
+	gs->SetSMODE2(frameDump.GetInitialSMODE2());
+
+	for(const auto& packet : frameDump.GetPackets())
+	{
+		if(packet.registerWrites.empty())
+		{
+			if(!packet.imageData.empty())
+			{
+				gs->FeedImageData(packet.imageData.data(), packet.imageData.size());
+			}
+		}
+		else
+		{
+			gs->WriteRegisterMassively(packet.registerWrites, nullptr);
+		}
+	}
+
+	gs->Flip();
+}
+
+static void PrintReport(const CFrameDump& frameDump, const CGSHandler::PACKET_PROFILE& profile,
+                        const std::vector<uint64>& frameTimes, const std::vector<uint32>& drawCallCounts)
+{
+	uint64 totalFrameTime = 0;
+	for(const auto& frameTime : frameTimes)
+	{
+		totalFrameTime += frameTime;
+	}
+	uint32 iterationCount = static_cast<uint32>(frameTimes.size());
+	auto minMaxFrameTime = std::minmax_element(frameTimes.begin(), frameTimes.end());
+	double avgFrameTime = ToMilliseconds(totalFrameTime) / static_cast<double>(iterationCount);
+
+	printf("Packets: %d, Iterations: %d, Draw calls per frame: %d\r\n",
+	       static_cast<uint32>(frameDump.GetPackets().size()), iterationCount, drawCallCounts.empty() ? 0 : drawCallCounts.back());
+	printf("Frame time (ms): avg %0.3f, min %0.3f, max %0.3f (%0.1f fps)\r\n",
+	       avgFrameTime, ToMilliseconds(*minMaxFrameTime.first), ToMilliseconds(*minMaxFrameTime.second),
+	       (avgFrameTime != 0) ? (1000.0 / avgFrameTime) : 0.0);
+
+	printf("\r\n");
+	printf("%-16s %12s %12s %12s\r\n", "Packet Type", "Count", "Total (ms)", "Avg (us)");
+	const auto printPacketEntry =
+	    [](const char* name, const CGSHandler::PROFILE_ENTRY& entry) {
+		    double avgTime = (entry.count != 0) ? (static_cast<double>(entry.time) / static_cast<double>(entry.count) / 1000.0) : 0;
+		    printf("%-16s %12llu %12.3f %12.3f\r\n", name, static_cast<unsigned long long>(entry.count), ToMilliseconds(entry.time), avgTime);
+	    };
+	printPacketEntry("Registers", profile.registerPackets);
+	printPacketEntry("Image", profile.imagePackets);
+
+	if(profile.imagePackets.time != 0)
+	{
+		double imageSeconds = static_cast<double>(profile.imagePackets.time) / 1000000000.0;
+		double imageMegabytes = static_cast<double>(profile.imageBytes) / (1024.0 * 1024.0);
+		printf("Image transfers: %0.3f MB, %0.1f MB/s\r\n", imageMegabytes, imageMegabytes / imageSeconds);
+	}
+
+	std::vector<uint8> registerIds;
+	uint64 totalRegisterTime = 0;
+	for(unsigned int i = 0; i < CGSHandler::REGISTER_MAX; i++)
+	{
+		if(profile.registers[i].count == 0) continue;
+		registerIds.push_back(static_cast<uint8>(i));
+		totalRegisterTime += profile.registers[i].time;
+	}
+	std::sort(registerIds.begin(), registerIds.end(),
+	          [&profile](uint8 lhs, uint8 rhs) { return profile.registers[lhs].time > profile.registers[rhs].time; });
+
+	printf("\r\n");
+	printf("%-16s %12s %12s %12s %8s\r\n", "Register", "Writes", "Total (ms)", "Avg (ns)", "%");
+	for(const auto& registerId : registerIds)
+	{
+		const auto& entry = profile.registers[registerId];
+		double avgTime = static_cast<double>(entry.time) / static_cast<double>(entry.count);
+		double ratio = (totalRegisterTime != 0) ? (static_cast<double>(entry.time) * 100.0 / static_cast<double>(totalRegisterTime)) : 0;
+		printf("%-16s %12llu %12.3f %12.1f %7.2f%%\r\n", GetRegisterName(registerId).c_str(),
+		       static_cast<unsigned long long>(entry.count), ToMilliseconds(entry.time), avgTime, ratio);
+	}
+}
+
+int main(int argc, const char** argv)
+{
+	if(argc < 2)
+	{
+		printf("Usage: GsReplayBench [options] dumpFile\r\n");
+		printf("Options: \r\n");
+		printf("\t --iterations <count>\t Number of times the dump is replayed (default is %d).\r\n", DEFAULT_ITERATION_COUNT);
+		printf("\t --gshandler <name>\t Selects which GS handler to instantiate (default is '%s').\r\n", DEFAULT_GS_HANDLER_NAME);
+		return -1;
+	}
+
+	std::string dumpPath;
+	std::string gsHandlerName = DEFAULT_GS_HANDLER_NAME;
+	uint32 iterationCount = DEFAULT_ITERATION_COUNT;
+
+	for(int i = 1; i < argc; i++)
+	{
+		if(!strcmp(argv[i], "--iterations"))
+		{
+			if((i + 1) >= argc)
+			{
+				printf("Error: Count must be specified for --iterations option.\r\n");
+				return -1;
+			}
+			iterationCount = std::max(atoi(argv[i + 1]), 1);
+			i++;
+		}
+		else if(!strcmp(argv[i], "--gshandler"))
+		{
+			if((i + 1) >= argc)
+			{
+				printf("Error: GS handler name must be specified for --gshandler option.\r\n");
+				return -1;
+			}
+			gsHandlerName = argv[i + 1];
+			if(g_validGsHandlersNames.find(gsHandlerName) == std::end(g_validGsHandlersNames))
+			{
+				printf("Error: Invalid GS handler name '%s'.\r\n", gsHandlerName.c_str());
+				return -1;
+			}
+			i++;
+		}
+		else
+		{
+			dumpPath = argv[i];
+			break;
+		}
+	}
+
+	if(dumpPath.empty())
+	{
+		printf("Error: No frame dump specified.\r\n");
+		return -1;
+	}
+
+	CFrameDump frameDump;
+	try
+	{
+		auto inputStream = Framework::CreateInputStdStream(dumpPath);
+		frameDump.Read(inputStream);
+	}
+	catch(const std::exception& exception)
+	{
+		printf("Error: Failed to read frame dump: %s\r\n", exception.what());
+		return -1;
+	}
+
+	std::unique_ptr<CGSHandler> gs(GetGsHandlerFactoryFunction(gsHandlerName)());
+	gs->SetLoggingEnabled(false);
+	gs->Initialize();
+
+	uint32 lastDrawCallCount = 0;
+	auto newFrameConnection = gs->OnNewFrame.Connect(
+	    [&lastDrawCallCount](uint32 drawCallCount) {
+		    lastDrawCallCount = drawCallCount;
+	    });
+
+	//First replay warms up caches and isn't accounted for
+	ReplayFrameDump(gs.get(), frameDump);
+
+	std::vector<uint64> frameTimes;
+	std::vector<uint32> drawCallCounts;
+	gs->SetPacketProfilingEnabled(true);
+	gs->ResetPacketProfile();
+	for(uint32 i = 0; i < iterationCount; i++)
+	{
+		auto frameStart = std::chrono::steady_clock::now();
+		ReplayFrameDump(gs.get(), frameDump);
+		auto frameTime = std::chrono::steady_clock::now() - frameStart;
+		frameTimes.push_back(std::chrono::duration_cast<std::chrono::nanoseconds>(frameTime).count());
+		drawCallCounts.push_back(lastDrawCallCount);
+	}
+	gs->SetPacketProfilingEnabled(false);
+
+	PrintReport(frameDump, gs->GetPacketProfile(), frameTimes, drawCallCounts);
+
+	newFrameConnection.reset();
+	gs->Release();
+
+	return 0;
+}
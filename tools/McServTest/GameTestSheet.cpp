@@ -81,11 +81,44 @@ void CGameTestSheet::ParseSheet(Framework::CStream& stream)
 			test.maxEntries = Framework::Xml::GetAttributeIntValue(testNode, "MaxEntries");
 			test.result = Framework::Xml::GetAttributeIntValue(testNode, "Result");
 			Framework::Xml::GetAttributeStringValue(testNode, "CurrentDirectory", &test.currentDirectory);
+			auto commandNodes = testNode->SelectNodes("Command");
+			for(const auto& commandNode : commandNodes)
+			{
+				auto commandType = Framework::Xml::GetAttributeStringValue(commandNode, "Type");
+				COMMAND command;
+				command.name = Framework::Xml::GetAttributeStringValue(commandNode, "Name");
+				int commandSize = 0;
+				Framework::Xml::GetAttributeIntValue(commandNode, "Size", &commandSize);
+				command.size = commandSize;
+				int commandResult = 0;
+				Framework::Xml::GetAttributeIntValue(commandNode, "Result", &commandResult);
+				command.result = commandResult;
+				std::string commandClose;
+				Framework::Xml::GetAttributeStringValue(commandNode, "Close", &commandClose);
+				command.close = (commandClose != "false");
+				if(!strcmp(commandType, "CreateDirectory"))
+				{
+					command.type = COMMAND_CREATE_DIRECTORY;
+				}
+				else if(!strcmp(commandType, "WriteFile"))
+				{
+					command.type = COMMAND_WRITE_FILE;
+				}
+				else if(!strcmp(commandType, "Delete"))
+				{
+					command.type = COMMAND_DELETE;
+				}
+				test.commands.push_back(command);
+			}
 			auto entryNodes = testNode->SelectNodes("Entry");
 			for(const auto& entryNode : entryNodes)
 			{
-				auto entryName = Framework::Xml::GetAttributeStringValue(entryNode, "Name");
-				test.entries.push_back(entryName);
+				ENTRY entry;
+				entry.name = Framework::Xml::GetAttributeStringValue(entryNode, "Name");
+				int entrySize = -1;
+				Framework::Xml::GetAttributeIntValue(entryNode, "Size", &entrySize);
+				entry.size = entrySize;
+				test.entries.push_back(entry);
 			}
 			m_tests.push_back(test);
 		}
@@ -24,7 +24,31 @@ public:
 	typedef EnvironmentActionArray ENVIRONMENT;
 	typedef std::unordered_map<uint32, ENVIRONMENT> EnvironmentMap;
 
-	typedef std::vector<std::string> EntryArray;
+	enum COMMAND_TYPE
+	{
+		COMMAND_NONE,
+		COMMAND_CREATE_DIRECTORY,
+		COMMAND_WRITE_FILE,
+		COMMAND_DELETE,
+	};
+
+	//Sent to the server before the test's query
+	struct COMMAND
+	{
+		COMMAND_TYPE type = COMMAND_NONE;
+		std::string name;
+		uint32 size = 0;
+		bool close = true;
+		int32 result = 0;
+	};
+	typedef std::vector<COMMAND> CommandArray;
+
+	struct ENTRY
+	{
+		std::string name;
+		int32 size = -1; //Only checked if specified
+	};
+	typedef std::vector<ENTRY> EntryArray;
 
 	struct TEST
 	{
@@ -33,6 +57,7 @@ public:
 		int32 maxEntries = 0;
 		int32 result = 0;
 		std::string currentDirectory;
+		CommandArray commands;
 		EntryArray entries;
 	};
 	typedef std::vector<TEST> TestArray;
@@ -1,5 +1,7 @@
 #include <stdio.h>
 #include <assert.h>
+#include <algorithm>
+#include <vector>
 #include "iop/IopBios.h"
 #include "iop/Iop_McServ.h"
 #include "iop/Iop_PathUtils.h"
@@ -42,6 +44,82 @@ void PrepareTestEnvironment(const CGameTestSheet::EnvironmentActionArray& enviro
 	}
 }
 
+uint32 OpenFile(Iop::CMcServ* mcServ, const std::string& name, uint32 flags)
+{
+	uint32 result = 0;
+
+	Iop::CMcServ::CMD cmd;
+	memset(&cmd, 0, sizeof(cmd));
+	cmd.flags = flags;
+	assert(name.size() <= sizeof(cmd.name));
+	strncpy(cmd.name, name.c_str(), sizeof(cmd.name));
+
+	mcServ->Invoke(0x2, reinterpret_cast<uint32*>(&cmd), sizeof(cmd), &result, sizeof(uint32), nullptr);
+	return result;
+}
+
+void ExecuteCommand(Iop::CMcServ* mcServ, const CGameTestSheet::COMMAND& command)
+{
+	switch(command.type)
+	{
+	case CGameTestSheet::COMMAND_CREATE_DIRECTORY:
+	{
+		uint32 result = OpenFile(mcServ, command.name, 0x40);
+		CHECK(static_cast<int32>(result) == command.result);
+	}
+	break;
+	case CGameTestSheet::COMMAND_WRITE_FILE:
+	{
+		uint32 handle = OpenFile(mcServ, command.name, Iop::CMcServ::OPEN_FLAG_CREAT | Iop::CMcServ::OPEN_FLAG_WRONLY);
+		CHECK(static_cast<int32>(handle) >= 0);
+
+		//Write in cluster sized chunks like games do, data stays in the server's write buffer
+		std::vector<uint8> data(0x400, 0xAA);
+		for(uint32 position = 0; position < command.size; position += data.size())
+		{
+			uint32 result = 0;
+
+			Iop::CMcServ::FILECMD cmd;
+			memset(&cmd, 0, sizeof(cmd));
+			cmd.handle = handle;
+			cmd.size = std::min<uint32>(command.size - position, data.size());
+
+			mcServ->Invoke(0x6, reinterpret_cast<uint32*>(&cmd), sizeof(cmd), &result, sizeof(uint32), data.data());
+			CHECK(result == cmd.size);
+		}
+
+		if(command.close)
+		{
+			uint32 result = 0;
+
+			Iop::CMcServ::FILECMD cmd;
+			memset(&cmd, 0, sizeof(cmd));
+			cmd.handle = handle;
+
+			mcServ->Invoke(0x3, reinterpret_cast<uint32*>(&cmd), sizeof(cmd), &result, sizeof(uint32), nullptr);
+			CHECK(result == 0);
+		}
+	}
+	break;
+	case CGameTestSheet::COMMAND_DELETE:
+	{
+		uint32 result = 0;
+
+		Iop::CMcServ::CMD cmd;
+		memset(&cmd, 0, sizeof(cmd));
+		assert(command.name.size() <= sizeof(cmd.name));
+		strncpy(cmd.name, command.name.c_str(), sizeof(cmd.name));
+
+		mcServ->Invoke(0xF, reinterpret_cast<uint32*>(&cmd), sizeof(cmd), &result, sizeof(uint32), nullptr);
+		CHECK(static_cast<int32>(result) == command.result);
+	}
+	break;
+	default:
+		CHECK(false);
+		break;
+	}
+}
+
 void ExecuteTest(const CGameTestSheet::TEST& test)
 {
 	Iop::CSubSystem subSystem(true);
@@ -50,6 +128,11 @@ void ExecuteTest(const CGameTestSheet::TEST& test)
 	bios->Reset(std::shared_ptr<Iop::CSifMan>());
 	auto mcServ = bios->GetMcServ();
 
+	for(const auto& command : test.commands)
+	{
+		ExecuteCommand(mcServ, command);
+	}
+
 	if(!test.currentDirectory.empty())
 	{
 		uint32 result = 0;
@@ -88,9 +171,18 @@ void ExecuteTest(const CGameTestSheet::TEST& test)
 		{
 			auto entryCount = std::count_if(entries.begin(), entries.end(),
 			                                [&refEntry](const auto& entry) {
-				                                return strcmp(reinterpret_cast<const char*>(entry.name), refEntry.c_str()) == 0;
+				                                return strcmp(reinterpret_cast<const char*>(entry.name), refEntry.name.c_str()) == 0;
 			                                });
 			CHECK(entryCount == 1);
+
+			if(refEntry.size != -1)
+			{
+				auto entryIterator = std::find_if(entries.begin(), entries.end(),
+				                                  [&refEntry](const auto& entry) {
+					                                  return strcmp(reinterpret_cast<const char*>(entry.name), refEntry.name.c_str()) == 0;
+				                                  });
+				CHECK(entryIterator->size == static_cast<uint32>(refEntry.size));
+			}
 		}
 	}
 }
@@ -49,6 +49,11 @@ void CPsfVm::SetSubSystem(const PsfVmSubSystemPtr& subSystem)
 	});
 }
 
+PsfVmSubSystemPtr CPsfVm::GetSubSystem() const
+{
+	return m_subSystem;
+}
+
 #ifdef DEBUGGER_INCLUDED
 
 #define TAGS_PATH ("./tags/")
@@ -31,6 +31,8 @@ public:
 	Iop::CSpuBase& GetSpuCore(unsigned int);
 
 	void SetSubSystem(const PsfVmSubSystemPtr&);
+	//Subsystem can only be driven by the caller while the VM is paused
+	PsfVmSubSystemPtr GetSubSystem() const;
 
 	CDebuggable GetDebugInfo();
 
@@ -19,6 +19,7 @@ public:
 	void Write(int16*, unsigned int, unsigned int) override;
 	bool HasFreeBuffers() override;
 	void RecycleBuffers() override;
+	unsigned int GetQueuedBufferCount() override;
 
 private:
 	typedef std::deque<ALuint> BufferList;
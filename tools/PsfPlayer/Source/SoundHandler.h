@@ -16,6 +16,8 @@ public:
 	virtual void Write(int16*, unsigned int, unsigned int) = 0;
 	virtual bool HasFreeBuffers() = 0;
 	virtual void RecycleBuffers() = 0;
+	//Number of buffers written to the device that haven't been played yet
+	virtual unsigned int GetQueuedBufferCount() = 0;
 
 private:
 };
@@ -0,0 +1,294 @@
+#include <cstdio>
+#include <cstring>
+#include <cassert>
+#include <atomic>
+#include <vector>
+#include <algorithm>
+#include "filesystem_def.h"
+#include "PsfVm.h"
+#include "PsfLoader.h"
+#include "PsfArchive.h"
+#include "PsfTags.h"
+#include "Playlist.h"
+#include "StdStreamUtils.h"
+#include "ThreadPool.h"
+#include "stricmp.h"
+
+#define SAMPLE_RATE (44100)
+#define CHANNEL_COUNT (2)
+#define DEFAULT_LENGTH (180.0)
+#define DEFAULT_FADE (10.0)
+//Number of updates without any new samples before giving up on a track
+#define MAX_IDLE_UPDATES (0x100000)
+
+//Collects everything the subsystem outputs. Always reports free buffers so
+//the subsystem never throttles itself, which lets rendering run as fast as possible.
+class CCaptureSoundHandler : public CSoundHandler
+{
+public:
+	void Reset() override
+	{
+		m_samples.clear();
+	}
+
+	void Write(int16* samples, unsigned int sampleCount, unsigned int sampleRate) override
+	{
+		assert(sampleRate == SAMPLE_RATE);
+		m_samples.insert(m_samples.end(), samples, samples + sampleCount);
+	}
+
+	bool HasFreeBuffers() override
+	{
+		return true;
+	}
+
+	void RecycleBuffers() override
+	{
+	}
+
+	unsigned int GetQueuedBufferCount() override
+	{
+		return 0;
+	}
+
+	std::vector<int16>& GetSamples()
+	{
+		return m_samples;
+	}
+
+private:
+	std::vector<int16> m_samples;
+};
+
+struct RENDER_OPTIONS
+{
+	double length = -1;
+	double fade = -1;
+};
+
+struct RENDER_JOB
+{
+	std::string filePath;
+	fs::path archivePath;
+	fs::path outputPath;
+};
+
+static void WriteWave(const fs::path& outputPath, const std::vector<int16>& samples)
+{
+	uint32 dataSize = static_cast<uint32>(samples.size() * sizeof(int16));
+
+	auto outputStream = Framework::CreateOutputStdStream(outputPath.native());
+	outputStream.Write("RIFF", 4);
+	outputStream.Write32(36 + dataSize);
+	outputStream.Write("WAVE", 4);
+	outputStream.Write("fmt ", 4);
+	outputStream.Write32(16);
+	outputStream.Write16(1); //PCM
+	outputStream.Write16(CHANNEL_COUNT);
+	outputStream.Write32(SAMPLE_RATE);
+	outputStream.Write32(SAMPLE_RATE * CHANNEL_COUNT * sizeof(int16));
+	outputStream.Write16(CHANNEL_COUNT * sizeof(int16));
+	outputStream.Write16(16);
+	outputStream.Write("data", 4);
+	outputStream.Write32(dataSize);
+	outputStream.Write(samples.data(), dataSize);
+}
+
+static void RenderTrack(const RENDER_JOB& job, const RENDER_OPTIONS& options)
+{
+	CPsfVm virtualMachine;
+
+	CPsfBase::TagMap tagMap;
+	CPsfLoader::LoadPsf(virtualMachine, job.filePath, job.archivePath, &tagMap);
+	CPsfTags tags(tagMap);
+
+	double length = options.length;
+	if(length < 0)
+	{
+		length = tags.HasTag("length") ? CPsfTags::ConvertTimeString(tags.GetTagValue("length").c_str()) : DEFAULT_LENGTH;
+	}
+	double fade = options.fade;
+	if(fade < 0)
+	{
+		fade = tags.HasTag("fade") ? CPsfTags::ConvertTimeString(tags.GetTagValue("fade").c_str()) : DEFAULT_FADE;
+	}
+
+	size_t fadeStartFrame = static_cast<size_t>(length * SAMPLE_RATE);
+	size_t fadeFrameCount = static_cast<size_t>(fade * SAMPLE_RATE);
+	size_t totalFrameCount = fadeStartFrame + fadeFrameCount;
+
+	CCaptureSoundHandler soundHandler;
+	auto& samples = soundHandler.GetSamples();
+	samples.reserve(totalFrameCount * CHANNEL_COUNT);
+
+	//VM stays paused, subsystem is stepped from this thread without any pacing
+	auto subSystem = virtualMachine.GetSubSystem();
+	unsigned int idleUpdateCount = 0;
+	while(samples.size() < (totalFrameCount * CHANNEL_COUNT))
+	{
+		size_t sampleCount = samples.size();
+		subSystem->Update(false, &soundHandler);
+		if(samples.size() != sampleCount)
+		{
+			idleUpdateCount = 0;
+		}
+		else if(++idleUpdateCount == MAX_IDLE_UPDATES)
+		{
+			throw std::runtime_error("Track stopped producing audio.");
+		}
+	}
+	samples.resize(totalFrameCount * CHANNEL_COUNT);
+
+	for(size_t frame = fadeStartFrame; frame < totalFrameCount; frame++)
+	{
+		float gain = static_cast<float>(totalFrameCount - frame) / static_cast<float>(fadeFrameCount);
+		for(unsigned int channel = 0; channel < CHANNEL_COUNT; channel++)
+		{
+			auto& sample = samples[(frame * CHANNEL_COUNT) + channel];
+			sample = static_cast<int16>(static_cast<float>(sample) * gain);
+		}
+	}
+
+	WriteWave(job.outputPath, samples);
+}
+
+static bool IsLoadablePath(const fs::path& path)
+{
+	auto extension = path.extension().string();
+	return !extension.empty() && CPlaylist::IsLoadableExtension(extension.c_str() + 1);
+}
+
+static bool IsArchivePath(const fs::path& path)
+{
+	auto extension = path.extension().string();
+	return !stricmp(extension.c_str(), ".zip") || !stricmp(extension.c_str(), ".rar");
+}
+
+static void AddJobs(std::vector<RENDER_JOB>& jobs, const fs::path& inputPath, const fs::path& outputPath)
+{
+	if(fs::is_directory(inputPath))
+	{
+		for(const auto& entry : fs::recursive_directory_iterator(inputPath))
+		{
+			const auto& entryPath = entry.path();
+			if(fs::is_directory(entryPath)) continue;
+			auto relativePath = fs::relative(entryPath, inputPath);
+			AddJobs(jobs, entryPath, outputPath / relativePath.parent_path());
+		}
+	}
+	else if(IsArchivePath(inputPath))
+	{
+		auto archive = CPsfArchive::CreateFromPath(inputPath);
+		for(const auto& fileInfo : archive->GetFiles())
+		{
+			if(!IsLoadablePath(fileInfo.name)) continue;
+			RENDER_JOB job;
+			job.filePath = fileInfo.name;
+			job.archivePath = inputPath;
+			job.outputPath = outputPath / inputPath.stem() / fs::path(fileInfo.name).filename().replace_extension(".wav");
+			jobs.push_back(job);
+		}
+	}
+	else if(IsLoadablePath(inputPath))
+	{
+		RENDER_JOB job;
+		job.filePath = inputPath.string();
+		job.outputPath = outputPath / inputPath.filename().replace_extension(".wav");
+		jobs.push_back(job);
+	}
+}
+
+static void PrintUsage()
+{
+	printf("PsfRender usage:\r\n");
+	printf("\tPsfRender [options] <file|archive|directory>...\r\n");
+	printf("Options:\r\n");
+	printf("\t --output <path>\t Directory where WAV files are written (default is current directory).\r\n");
+	printf("\t --jobs <count>\t Number of tracks rendered in parallel (default is number of hardware threads).\r\n");
+	printf("\t --length <seconds>\t Overrides track length from tags (default is %0.0f if track has no tag).\r\n", DEFAULT_LENGTH);
+	printf("\t --fade <seconds>\t Overrides fade length from tags (default is %0.0f if track has no tag).\r\n", DEFAULT_FADE);
+}
+
+int main(int argc, const char** argv)
+{
+	RENDER_OPTIONS options;
+	fs::path outputPath = ".";
+	unsigned int jobCount = std::max<unsigned int>(std::thread::hardware_concurrency(), 1);
+	std::vector<fs::path> inputPaths;
+
+	for(int i = 1; i < argc; i++)
+	{
+		bool hasValue = (i + 1) < argc;
+		if(!strcmp(argv[i], "--output") && hasValue)
+		{
+			outputPath = argv[++i];
+		}
+		else if(!strcmp(argv[i], "--jobs") && hasValue)
+		{
+			jobCount = std::max(atoi(argv[++i]), 1);
+		}
+		else if(!strcmp(argv[i], "--length") && hasValue)
+		{
+			options.length = std::max(atof(argv[++i]), 0.0);
+		}
+		else if(!strcmp(argv[i], "--fade") && hasValue)
+		{
+			options.fade = std::max(atof(argv[++i]), 0.0);
+		}
+		else if(!strncmp(argv[i], "--", 2))
+		{
+			PrintUsage();
+			return -1;
+		}
+		else
+		{
+			inputPaths.push_back(argv[i]);
+		}
+	}
+
+	if(inputPaths.empty())
+	{
+		PrintUsage();
+		return -1;
+	}
+
+	std::vector<RENDER_JOB> jobs;
+	try
+	{
+		for(const auto& inputPath : inputPaths)
+		{
+			AddJobs(jobs, inputPath, outputPath);
+		}
+	}
+	catch(const std::exception& exception)
+	{
+		printf("Failed to scan input: %s\r\n", exception.what());
+		return -1;
+	}
+
+	std::atomic<unsigned int> failureCount(0);
+	{
+		Framework::CThreadPool threadPool(jobCount);
+		for(const auto& job : jobs)
+		{
+			threadPool.Enqueue(
+			    [&options, &failureCount, job]() {
+				    try
+				    {
+					    fs::create_directories(job.outputPath.parent_path());
+					    RenderTrack(job, options);
+					    printf("Rendered %s.\r\n", job.outputPath.string().c_str());
+				    }
+				    catch(const std::exception& exception)
+				    {
+					    printf("Failed to render '%s', reason: '%s'.\r\n", job.filePath.c_str(), exception.what());
+					    failureCount++;
+				    }
+				    fflush(stdout);
+			    });
+		}
+	}
+
+	printf("Rendered %d track(s), %d failure(s).\r\n", static_cast<int>(jobs.size() - failureCount), static_cast<int>(failureCount));
+	return (failureCount == 0) ? 0 : -1;
+}
@@ -119,6 +119,16 @@ bool CSH_WaveOut::HasFreeBuffers()
 	return GetFreeBuffer() != NULL;
 }
 
+unsigned int CSH_WaveOut::GetQueuedBufferCount()
+{
+	unsigned int count = 0;
+	for(unsigned int i = 0; i < MAX_BUFFERS; i++)
+	{
+		if((m_buffer[i].dwFlags & WHDR_DONE) == 0) count++;
+	}
+	return count;
+}
+
 void CSH_WaveOut::Write(int16* buffer, unsigned int sampleCount, unsigned int sampleRate)
 {
 	WAVEHDR* waveHeader = GetFreeBuffer();
@@ -15,6 +15,7 @@ public:
 	void Reset() override;
 	bool HasFreeBuffers() override;
 	void RecycleBuffers() override;
+	unsigned int GetQueuedBufferCount() override;
 	void Write(int16*, unsigned int, unsigned int) override;
 
 private:
@@ -96,6 +96,16 @@ bool CSH_XAudio2::HasFreeBuffers()
 	return GetFreeBuffer() != nullptr;
 }
 
+unsigned int CSH_XAudio2::GetQueuedBufferCount()
+{
+	unsigned int count = 0;
+	for(unsigned int i = 0; i < MAX_BUFFERS; i++)
+	{
+		if(m_buffers[i].inUse) count++;
+	}
+	return count;
+}
+
 void CSH_XAudio2::Write(int16* buffer, unsigned int sampleCount, unsigned int sampleRate)
 {
 	auto bufferInfo = GetFreeBuffer();
@@ -16,6 +16,7 @@ public:
 	void Reset();
 	bool HasFreeBuffers();
 	void RecycleBuffers();
+	unsigned int GetQueuedBufferCount();
 	void Write(int16*, unsigned int, unsigned int);
 
 private: